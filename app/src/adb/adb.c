@@ -27,9 +27,11 @@
 #define SC_ADB_COMMAND(...) { sc_adb_get_executable(), __VA_ARGS__, NULL }
 
 static char *adb_executable;
+// Several servers may use adb concurrently (in multi-session mode)
+static unsigned adb_init_count;
 
-bool
-sc_adb_init(void) {
+static bool
+sc_adb_init_executable(void) {
     adb_executable = sc_get_env("ADB");
     if (adb_executable) {
         LOGD("Using adb: %s", adb_executable);
@@ -58,9 +60,23 @@ sc_adb_init(void) {
     return true;
 }
 
+bool
+sc_adb_init(void) {
+    if (!adb_init_count && !sc_adb_init_executable()) {
+        return false;
+    }
+
+    ++adb_init_count;
+    return true;
+}
+
 void
 sc_adb_destroy(void) {
-    free(adb_executable);
+    assert(adb_init_count);
+    if (!--adb_init_count) {
+        free(adb_executable);
+        adb_executable = NULL;
+    }
 }
 
 const char *
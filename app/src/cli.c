@@ -114,6 +114,34 @@ enum {
     OPT_NO_VD_SYSTEM_DECORATIONS,
     OPT_NO_VD_DESTROY_CONTENT,
     OPT_DISPLAY_IME_POLICY,
+    OPT_CAPTURE_STREAM,
+    OPT_REPLAY_STREAM,
+    OPT_REPLAY_SPEED,
+    OPT_NO_ADB,
+    OPT_IO_ENGINE,
+    OPT_IO_URING,
+    OPT_MULTI_SESSION,
+    OPT_DECODER_POOL_SIZE,
+    OPT_VIDEO_DECODE_QUEUE,
+    OPT_VIDEO_DECODER_THREADS,
+    OPT_VIDEO_DECODER_THREAD_TYPE,
+    OPT_VIDEO_CATCH_UP,
+    OPT_VIDEO_LOW_RES,
+    OPT_FRAME_PACING,
+    OPT_VIDEO_PARTIAL_UPLOAD,
+    OPT_NO_PBO,
+    OPT_VIDEO_PREPARE_THREAD,
+    OPT_RENDER_BENCH,
+    OPT_SCREENSHOT_DIR,
+    OPT_SCREENSHOT_FORMAT,
+    OPT_SCREENSHOT_BURST,
+    OPT_RECORD_QUEUE_LIMIT,
+    OPT_RECORD_OVERFLOW,
+    OPT_RECORD_PREALLOC,
+    OPT_REPLAY_BUFFER,
+    OPT_REPLAY_DIR,
+    OPT_REPLAY_FORMAT,
+    OPT_RECORD_FRAGMENT_DURATION,
 };
 
 struct sc_option {
@@ -330,6 +358,15 @@ static const struct sc_option options[] = {
                 "initial device orientation.\n"
                 "Default is 0.",
     },
+    {
+        .longopt_id = OPT_CAPTURE_STREAM,
+        .longopt = "capture-stream",
+        .argdesc = "file",
+        .text = "Write the raw video and audio streams received from the "
+                "device, with their arrival timestamps, to a file.\n"
+                "It can be replayed later without a device (see "
+                "--replay-stream).",
+    },
     {
         // Not really deprecated (--codec has never been released), but without
         // declaring an explicit --codec option, getopt_long() partial matching
@@ -359,6 +396,14 @@ static const struct sc_option options[] = {
         .text = "Use USB device (if there is exactly one, like adb -d).\n"
                 "Also see -e (--select-tcpip).",
     },
+    {
+        .longopt_id = OPT_DECODER_POOL_SIZE,
+        .longopt = "decoder-pool-size",
+        .argdesc = "value",
+        .text = "Set the number of threads decoding the video streams in "
+                "multi-session mode (see --multi-session).\n"
+                "Default is 0 (the number of CPU cores).",
+    },
     {
         .longopt_id = OPT_DISABLE_SCREENSAVER,
         .longopt = "disable-screensaver",
@@ -437,6 +482,17 @@ static const struct sc_option options[] = {
         .longopt_id = OPT_FORWARD_ALL_CLICKS,
         .longopt = "forward-all-clicks",
     },
+    {
+        .longopt_id = OPT_FRAME_PACING,
+        .longopt = "frame-pacing",
+        .argdesc = "ms",
+        .text = "Present each video frame at the display refresh closest to "
+                "its expected reception time plus the given latency budget "
+                "(in milliseconds), to smooth bursty network delivery.\n"
+                "This enables vsync.\n"
+                "Default is 0 (disabled: present each frame as soon as it is "
+                "decoded).",
+    },
     {
         .shortopt = 'G',
         .text = "Same as --gamepad=uhid, or --gamepad=aoa if --otg is set.",
@@ -459,6 +515,30 @@ static const struct sc_option options[] = {
         .longopt = "help",
         .text = "Print this help.",
     },
+    {
+        .longopt_id = OPT_IO_ENGINE,
+        .longopt = "io-engine",
+        .argdesc = "value",
+        .text = "Select how the video, audio and control sockets are read "
+                "and written.\n"
+                "Possible values are \"threads\" and \"epoll\".\n"
+                "\"threads\" uses one blocking thread per socket.\n"
+                "\"epoll\" multiplexes all the sockets on a single thread, "
+                "with non-blocking I/O (Linux only). Note that the packets are "
+                "then also decoded on this thread (except in multi-session "
+                "mode, where all the sessions share this thread, and the "
+                "packets are decoded by the decoder pool).\n"
+                "Default is threads.",
+    },
+    {
+        .longopt_id = OPT_IO_URING,
+        .longopt = "io-uring",
+        .text = "Use io_uring for the blocking socket reads and writes, with "
+                "registered receive buffers. It falls back to the plain "
+                "syscalls if io_uring is not available.\n"
+                "This feature is only available on Linux, if scrcpy is built "
+                "with -Dio_uring=true.",
+    },
     {
         .shortopt = 'K',
         .text = "Same as --keyboard=uhid, or --keyboard=aoa if --otg is set.",
@@ -607,6 +687,18 @@ static const struct sc_option options[] = {
                 "Default is 'bhsn:++++' for SDK mouse, and '++++:bhsn' for AOA "
                 "and UHID.",
     },
+    {
+        .longopt_id = OPT_MULTI_SESSION,
+        .longopt = "multi-session",
+        .argdesc = "serial1,serial2,...",
+        .text = "Mirror the video of several devices from a single process, "
+                "identified by their serial numbers (separated by ',').\n"
+                "Each device is mirrored in its own window (or decoded without "
+                "display with --no-window or --no-video-playback). The videos "
+                "are decoded by a shared pool of threads (see "
+                "--decoder-pool-size).\n"
+                "Audio and control are disabled in this mode.",
+    },
     {
         .shortopt = 'n',
         .longopt = "no-control",
@@ -632,6 +724,14 @@ static const struct sc_option options[] = {
                 "    --new-display         # main display size and density\n"
                 "    --new-display=/240    # main display size and 240 dpi",
     },
+    {
+        .longopt_id = OPT_NO_ADB,
+        .longopt = "no-adb",
+        .text = "Do not use adb: connect directly to a scrcpy server (or a "
+                "compatible fake server) already listening on "
+                "--tunnel-host:--tunnel-port.\n"
+                "This is mainly useful for benchmarks and tests.",
+    },
     {
         .longopt_id = OPT_NO_AUDIO,
         .longopt = "no-audio",
@@ -683,6 +783,14 @@ static const struct sc_option options[] = {
                 "mipmaps are automatically generated to improve downscaling "
                 "quality. This option disables the generation of mipmaps.",
     },
+    {
+        .longopt_id = OPT_NO_PBO,
+        .longopt = "no-pbo",
+        .text = "If the renderer is OpenGL 3.0+ or OpenGL ES 3.0+, then the "
+                "video frames are streamed to the GPU asynchronously through "
+                "pixel buffer objects. This option disables it (the frames "
+                "are uploaded synchronously).",
+    },
     {
         .longopt_id = OPT_NO_MOUSE_HOVER,
         .longopt = "no-mouse-hover",
@@ -812,8 +920,21 @@ static const struct sc_option options[] = {
         .longopt_id = OPT_RECORD_FORMAT,
         .longopt = "record-format",
         .argdesc = "format",
-        .text = "Force recording format (mp4, mkv, m4a, mka, opus, aac, flac "
-                "or wav).",
+        .text = "Force recording format (mp4, fmp4, mkv, m4a, mka, opus, aac, "
+                "flac or wav).\n"
+                "The fmp4 format is a fragmented MP4: the file remains "
+                "playable up to the last fragment written if scrcpy is "
+                "killed, and closing it does not depend on the recording "
+                "duration.",
+    },
+    {
+        .longopt_id = OPT_RECORD_FRAGMENT_DURATION,
+        .longopt = "record-fragment-duration",
+        .argdesc = "ms",
+        .text = "Set the maximum duration of the fragments for "
+                "--record-format=fmp4, in milliseconds. A new fragment is "
+                "also started on every video key frame.\n"
+                "Default is 1000.",
     },
     {
         .longopt_id = OPT_RECORD_ORIENTATION,
@@ -824,6 +945,54 @@ static const struct sc_option options[] = {
                 "the clockwise rotation in degrees.\n"
                 "Default is 0.",
     },
+    {
+        .longopt_id = OPT_RECORD_OVERFLOW,
+        .longopt = "record-overflow",
+        .argdesc = "policy",
+        .text = "Select what to do with the packets to record when the queue "
+                "limit (see --record-queue-limit) is reached:\n"
+                " - \"spill\": write them to a temporary file, and record "
+                "them once the output file catches up;\n"
+                " - \"drop\": drop them, and resume the video recording on "
+                "the next key frame.\n"
+                "Default is spill.",
+    },
+    {
+        .longopt_id = OPT_RECORD_PREALLOC,
+        .longopt = "record-prealloc",
+        .argdesc = "size",
+        .text = "Preallocate the record file space ahead of the writes, by "
+                "chunks of the given size in bytes (K and M suffixes are "
+                "supported), and do not keep the written data in the page "
+                "cache.\n"
+                "This reduces the fragmentation and the memory pressure for "
+                "long recordings. The unused preallocated space is released "
+                "at the end of the recording.\n"
+                "This is only supported on Linux.\n"
+                "Default is 0 (disabled).",
+    },
+    {
+        .longopt_id = OPT_RECORD_QUEUE_LIMIT,
+        .longopt = "record-queue-limit",
+        .argdesc = "size",
+        .text = "Limit the memory used by the packets waiting to be written "
+                "to the record file, in bytes (K and M suffixes are "
+                "supported).\n"
+                "If the output file is too slow (a network share, a slow SD "
+                "card...), the packets exceeding the limit are handled as "
+                "specified by --record-overflow.\n"
+                "Default is 0 (unlimited).",
+    },
+    {
+        .longopt_id = OPT_RENDER_BENCH,
+        .longopt = "render-bench",
+        .text = "Render the video to an offscreen window (using the SDL "
+                "\"offscreen\" video driver, without any display server), "
+                "and log the percentiles of the duration of each display "
+                "stage (upload, mipmap, render and present) on exit.\n"
+                "The OpenGL commands are executed synchronously at the end of "
+                "each stage, so this is only intended for benchmarks.",
+    },
     {
         .longopt_id = OPT_RENDER_DRIVER,
         .longopt = "render-driver",
@@ -834,6 +1003,49 @@ static const struct sc_option options[] = {
                 "\"opengles2\", \"opengles\", \"metal\" and \"software\".\n"
                 "<https://wiki.libsdl.org/SDL_HINT_RENDER_DRIVER>",
     },
+    {
+        .longopt_id = OPT_REPLAY_BUFFER,
+        .longopt = "replay-buffer",
+        .argdesc = "seconds",
+        .text = "Keep (at least) the last given number of seconds of video "
+                "and audio in memory, to save them to a file on MOD+Shift+p "
+                "(see --replay-dir and --replay-format).\n"
+                "The packets are not decoded nor encoded again, and the file "
+                "is written from a separate thread.",
+    },
+    {
+        .longopt_id = OPT_REPLAY_DIR,
+        .longopt = "replay-dir",
+        .argdesc = "path",
+        .text = "Set the directory where the replay buffer is saved (see "
+                "--replay-buffer).\n"
+                "Default is the current directory.",
+    },
+    {
+        .longopt_id = OPT_REPLAY_FORMAT,
+        .longopt = "replay-format",
+        .argdesc = "format",
+        .text = "Set the container format of the saved replay buffer (mp4 or "
+                "mkv).\n"
+                "Default is mp4.",
+    },
+    {
+        .longopt_id = OPT_REPLAY_SPEED,
+        .longopt = "replay-speed",
+        .argdesc = "factor",
+        .text = "Set the speed of the stream replay (see --replay-stream), as "
+                "a multiple of the real time.\n"
+                "If 0, the streams are replayed as fast as possible.\n"
+                "Default is 1.",
+    },
+    {
+        .longopt_id = OPT_REPLAY_STREAM,
+        .longopt = "replay-stream",
+        .argdesc = "file",
+        .text = "Replay streams captured by --capture-stream instead of "
+                "connecting to a device.\n"
+                "Control is disabled.",
+    },
     {
         .longopt_id = OPT_REQUIRE_AUDIO,
         .longopt = "require-audio",
@@ -866,6 +1078,29 @@ static const struct sc_option options[] = {
         .text = "Set the screen off timeout while scrcpy is running (restore "
                 "the initial value on exit).",
     },
+    {
+        .longopt_id = OPT_SCREENSHOT_BURST,
+        .longopt = "screenshot-burst",
+        .argdesc = "n",
+        .text = "Save every Nth video frame to --screenshot-dir, from the "
+                "start. The burst is paused or resumed by MOD+Shift+s.",
+    },
+    {
+        .longopt_id = OPT_SCREENSHOT_DIR,
+        .longopt = "screenshot-dir",
+        .argdesc = "path",
+        .text = "Enable screenshots (MOD+Shift+s), saved in the given "
+                "directory.\n"
+                "The frames are converted and encoded on a separate thread.",
+    },
+    {
+        .longopt_id = OPT_SCREENSHOT_FORMAT,
+        .longopt = "screenshot-format",
+        .argdesc = "format",
+        .text = "Set the screenshot image format (png, jpeg or webp).\n"
+                "WebP requires an FFmpeg build with libwebp.\n"
+                "Default is png.",
+    },
     {
         .longopt_id = OPT_SHORTCUT_MOD,
         .longopt = "shortcut-mod",
@@ -983,6 +1218,17 @@ static const struct sc_option options[] = {
                 "This increases latency to compensate for jitter.\n"
                 "Default is 0 (no buffering).",
     },
+    {
+        .longopt_id = OPT_VIDEO_CATCH_UP,
+        .longopt = "video-catch-up",
+        .argdesc = "ms",
+        .text = "When the video decoding is late by more than the given delay "
+                "(in milliseconds), drop the frames and request a new key "
+                "frame to the device, to resume with the most recent "
+                "content.\n"
+                "This requires control to be enabled.\n"
+                "Default is 0 (disabled).",
+    },
     {
         .longopt_id = OPT_VIDEO_CODEC,
         .longopt = "video-codec",
@@ -1002,6 +1248,40 @@ static const struct sc_option options[] = {
                 "Android documentation: "
                 "<https://d.android.com/reference/android/media/MediaFormat>",
     },
+    {
+        .longopt_id = OPT_VIDEO_DECODE_QUEUE,
+        .longopt = "video-decode-queue",
+        .argdesc = "depth",
+        .text = "Decode the video packets on a dedicated thread, fed by a "
+                "queue of at most 'depth' packets.\n"
+                "This prevents the reception of the stream from being "
+                "delayed by slow decoding. When the queue is full, packets "
+                "are dropped until the next key frame.\n"
+                "Default is 0 (decode synchronously on reception).",
+    },
+    {
+        .longopt_id = OPT_VIDEO_DECODER_THREADS,
+        .longopt = "video-decoder-threads",
+        .argdesc = "n",
+        .text = "Set the number of threads used to decode the video.\n"
+                "If 0, use one thread per CPU core.\n"
+                "Default is 1.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_DECODER_THREAD_TYPE,
+        .longopt = "video-decoder-thread-type",
+        .argdesc = "type",
+        .text = "Select how the video decoding is split across threads (see "
+                "--video-decoder-threads).\n"
+                "Possible values are \"auto\", \"slice\" and \"frame\".\n"
+                "\"slice\" decodes parts of a frame in parallel, without "
+                "adding latency, but only if the stream contains several "
+                "slices (or tiles).\n"
+                "\"frame\" decodes several frames in parallel, which adds "
+                "one frame of latency per additional thread.\n"
+                "\"auto\" selects \"slice\".\n"
+                "Default is auto.",
+    },
     {
         .longopt_id = OPT_VIDEO_ENCODER,
         .longopt = "video-encoder",
@@ -1010,6 +1290,39 @@ static const struct sc_option options[] = {
                 "codec provided by --video-codec).\n"
                 "The available encoders can be listed by --list-encoders.",
     },
+    {
+        .longopt_id = OPT_VIDEO_LOW_RES,
+        .longopt = "video-low-res",
+        .text = "When the window is more than 2 times smaller than the video, "
+                "upload the frames at half resolution, and skip the loop "
+                "filter when decoding non-reference frames.\n"
+                "This saves decoding time and texture upload bandwidth on "
+                "weak computers.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_PARTIAL_UPLOAD,
+        .longopt = "video-partial-upload",
+        .argdesc = "percent",
+        .text = "Only upload the regions of each video frame which changed "
+                "since the previous frame, unless more than the given "
+                "percentage of the frame changed (then the whole frame is "
+                "uploaded).\n"
+                "This saves texture upload bandwidth when only a small part "
+                "of the device screen changes.\n"
+                "Default is 0 (disabled: always upload the whole frame).",
+    },
+    {
+        .longopt_id = OPT_VIDEO_PREPARE_THREAD,
+        .longopt = "video-prepare-thread",
+        .text = "Prepare the frames for their upload (the downscaling of "
+                "--video-low-res and the change detection of "
+                "--video-partial-upload) from a dedicated thread.\n"
+                "The texture uploads and the presentation of the frames still "
+                "run on the main thread (SDL requires the renderer to be used "
+                "from the main thread).\n"
+                "Requires --video-low-res or --video-partial-upload. "
+                "Incompatible with --frame-pacing.",
+    },
     {
         .longopt_id = OPT_VIDEO_SOURCE,
         .longopt = "video-source",
@@ -1094,6 +1407,14 @@ static const struct sc_shortcut shortcuts[] = {
         .shortcuts = { "MOD+Shift+z" },
         .text = "Unpause display",
     },
+    {
+        .shortcuts = { "MOD+Shift+s" },
+        .text = "Take a screenshot (or pause/resume the burst)",
+    },
+    {
+        .shortcuts = { "MOD+Shift+p" },
+        .text = "Save the replay buffer (see --replay-buffer)",
+    },
     {
         .shortcuts = { "MOD+Shift+r" },
         .text = "Reset video capture/encoding",
@@ -1804,6 +2125,193 @@ parse_display_id(const char *s, uint32_t *display_id) {
     return true;
 }
 
+static bool
+parse_decoder_pool_size(const char *s, uint16_t *size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 256, "decoder pool size");
+    if (!ok) {
+        return false;
+    }
+
+    *size = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_video_catch_up(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 60 * 1000,
+                                "video catch-up delay");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_frame_pacing(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 1000,
+                                "frame pacing latency budget");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_video_partial_upload(const char *s, uint8_t *percent) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 100,
+                                "video partial upload threshold");
+    if (!ok) {
+        return false;
+    }
+
+    *percent = value;
+    return true;
+}
+
+static bool
+parse_record_queue_limit(const char *s, uint32_t *limit) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, true, 0, 0x7FFFFFFF,
+                                "record queue limit");
+    if (!ok) {
+        return false;
+    }
+
+    *limit = (uint32_t) value;
+    return true;
+}
+
+static bool
+parse_record_prealloc(const char *s, uint32_t *prealloc) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, true, 0, 0x7FFFFFFF,
+                                "record prealloc size");
+    if (!ok) {
+        return false;
+    }
+
+    *prealloc = (uint32_t) value;
+    return true;
+}
+
+static bool
+parse_record_fragment_duration(const char *s, sc_tick *duration) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0x7FFFFFFF,
+                                "record fragment duration");
+    if (!ok) {
+        return false;
+    }
+
+    *duration = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_record_overflow(const char *optarg, enum sc_record_overflow *overflow) {
+    if (!strcmp(optarg, "spill")) {
+        *overflow = SC_RECORD_OVERFLOW_SPILL;
+        return true;
+    }
+    if (!strcmp(optarg, "drop")) {
+        *overflow = SC_RECORD_OVERFLOW_DROP;
+        return true;
+    }
+    LOGE("Unsupported record overflow policy: %s (expected spill or drop)",
+         optarg);
+    return false;
+}
+
+static bool
+parse_screenshot_format(const char *optarg,
+                        enum sc_screenshot_format *format) {
+    if (!strcmp(optarg, "png")) {
+        *format = SC_SCREENSHOT_FORMAT_PNG;
+        return true;
+    }
+    if (!strcmp(optarg, "jpeg") || !strcmp(optarg, "jpg")) {
+        *format = SC_SCREENSHOT_FORMAT_JPEG;
+        return true;
+    }
+    if (!strcmp(optarg, "webp")) {
+        *format = SC_SCREENSHOT_FORMAT_WEBP;
+        return true;
+    }
+    LOGE("Unsupported screenshot format: %s (expected png, jpeg or webp)",
+         optarg);
+    return false;
+}
+
+static bool
+parse_screenshot_burst(const char *s, uint16_t *interval) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0xFFFF,
+                                "screenshot burst interval");
+    if (!ok) {
+        return false;
+    }
+
+    *interval = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_video_decode_queue(const char *s, uint16_t *depth) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 1000,
+                                "video decode queue depth");
+    if (!ok) {
+        return false;
+    }
+
+    *depth = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_video_decoder_threads(const char *s, uint16_t *threads) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 64,
+                                "video decoder threads");
+    if (!ok) {
+        return false;
+    }
+
+    *threads = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_video_decoder_thread_type(const char *s,
+                                enum sc_video_decoder_thread_type *type) {
+    if (!strcmp(s, "auto")) {
+        *type = SC_VIDEO_DECODER_THREAD_TYPE_AUTO;
+        return true;
+    }
+
+    if (!strcmp(s, "slice")) {
+        *type = SC_VIDEO_DECODER_THREAD_TYPE_SLICE;
+        return true;
+    }
+
+    if (!strcmp(s, "frame")) {
+        *type = SC_VIDEO_DECODER_THREAD_TYPE_FRAME;
+        return true;
+    }
+
+    LOGE("Unsupported video decoder thread type: %s (expected auto, slice or "
+         "frame)", s);
+    return false;
+}
+
 static bool
 parse_log_level(const char *s, enum sc_log_level *log_level) {
     if (!strcmp(s, "verbose")) {
@@ -1917,6 +2425,9 @@ get_record_format(const char *name) {
     if (!strcmp(name, "mp4")) {
         return SC_RECORD_FORMAT_MP4;
     }
+    if (!strcmp(name, "fmp4")) {
+        return SC_RECORD_FORMAT_FMP4;
+    }
     if (!strcmp(name, "mkv")) {
         return SC_RECORD_FORMAT_MKV;
     }
@@ -1945,8 +2456,8 @@ static bool
 parse_record_format(const char *optarg, enum sc_record_format *format) {
     enum sc_record_format fmt = get_record_format(optarg);
     if (!fmt) {
-        LOGE("Unsupported record format: %s (expected mp4, mkv, m4a, mka, "
-             "opus, aac, flac or wav)", optarg);
+        LOGE("Unsupported record format: %s (expected mp4, fmp4, mkv, m4a, "
+             "mka, opus, aac, flac or wav)", optarg);
         return false;
     }
 
@@ -2037,6 +2548,27 @@ parse_video_source(const char *optarg, enum sc_video_source *source) {
     return false;
 }
 
+static bool
+parse_io_engine(const char *optarg, enum sc_io_engine *engine) {
+    if (!strcmp(optarg, "threads")) {
+        *engine = SC_IO_ENGINE_THREADS;
+        return true;
+    }
+
+    if (!strcmp(optarg, "epoll")) {
+#ifdef HAVE_IO_LOOP
+        *engine = SC_IO_ENGINE_EPOLL;
+        return true;
+#else
+        LOGE("I/O engine epoll is not supported on this platform");
+        return false;
+#endif
+    }
+
+    LOGE("Unsupported I/O engine: %s (expected threads or epoll)", optarg);
+    return false;
+}
+
 static bool
 parse_audio_source(const char *optarg, enum sc_audio_source *source) {
     if (!strcmp(optarg, "mic")) {
@@ -2242,6 +2774,45 @@ parse_time_limit(const char *s, sc_tick *tick) {
     return true;
 }
 
+static bool
+parse_replay_buffer(const char *s, uint16_t *seconds) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 3600,
+                                "replay buffer duration");
+    if (!ok) {
+        return false;
+    }
+
+    *seconds = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_replay_format(const char *optarg, enum sc_record_format *format) {
+    if (!strcmp(optarg, "mp4")) {
+        *format = SC_RECORD_FORMAT_MP4;
+        return true;
+    }
+    if (!strcmp(optarg, "mkv")) {
+        *format = SC_RECORD_FORMAT_MKV;
+        return true;
+    }
+    LOGE("Unsupported replay format: %s (expected mp4 or mkv)", optarg);
+    return false;
+}
+
+static bool
+parse_replay_speed(const char *s, uint16_t *speed) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 1000, "replay speed");
+    if (!ok) {
+        return false;
+    }
+
+    *speed = (uint16_t) value;
+    return true;
+}
+
 static bool
 parse_screen_off_timeout(const char *s, sc_tick *tick) {
     long value;
@@ -2571,6 +3142,28 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_RECORD_QUEUE_LIMIT:
+                if (!parse_record_queue_limit(optarg,
+                                              &opts->record_queue_limit)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_OVERFLOW:
+                if (!parse_record_overflow(optarg, &opts->record_overflow)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_PREALLOC:
+                if (!parse_record_prealloc(optarg, &opts->record_prealloc)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_FRAGMENT_DURATION:
+                if (!parse_record_fragment_duration(optarg,
+                                            &opts->record_fragment_duration)) {
+                    return false;
+                }
+                break;
             case OPT_ORIENTATION: {
                 enum sc_orientation orientation;
                 if (!parse_orientation(optarg, &orientation)) {
@@ -2583,9 +3176,33 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_RENDER_DRIVER:
                 opts->render_driver = optarg;
                 break;
+            case OPT_VIDEO_PREPARE_THREAD:
+                opts->video_prepare_thread = true;
+                break;
+            case OPT_RENDER_BENCH:
+                opts->render_bench = true;
+                break;
+            case OPT_SCREENSHOT_DIR:
+                opts->screenshot_dir = optarg;
+                break;
+            case OPT_SCREENSHOT_FORMAT:
+                if (!parse_screenshot_format(optarg,
+                                             &opts->screenshot_format)) {
+                    return false;
+                }
+                break;
+            case OPT_SCREENSHOT_BURST:
+                if (!parse_screenshot_burst(optarg,
+                                            &opts->screenshot_burst)) {
+                    return false;
+                }
+                break;
             case OPT_NO_MIPMAPS:
                 opts->mipmaps = false;
                 break;
+            case OPT_NO_PBO:
+                opts->pbo = false;
+                break;
             case OPT_NO_KEY_REPEAT:
                 opts->forward_key_repeat = false;
                 break;
@@ -2658,6 +3275,69 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_NO_CLEANUP:
                 opts->cleanup = false;
                 break;
+            case OPT_NO_ADB:
+                opts->no_adb = true;
+                break;
+            case OPT_IO_ENGINE:
+                if (!parse_io_engine(optarg, &opts->io_engine)) {
+                    return false;
+                }
+                break;
+            case OPT_IO_URING:
+#ifdef HAVE_IO_URING
+                opts->io_uring = true;
+                break;
+#else
+                LOGE("io_uring (--io-uring) is disabled (or unsupported on "
+                     "this platform).");
+                return false;
+#endif
+            case OPT_MULTI_SESSION:
+                opts->multi_session = optarg;
+                break;
+            case OPT_DECODER_POOL_SIZE:
+                if (!parse_decoder_pool_size(optarg,
+                                             &opts->decoder_pool_size)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_DECODER_THREADS:
+                if (!parse_video_decoder_threads(optarg,
+                                                &opts->video_decoder_threads)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_DECODER_THREAD_TYPE:
+                if (!parse_video_decoder_thread_type(optarg,
+                                        &opts->video_decoder_thread_type)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_CATCH_UP:
+                if (!parse_video_catch_up(optarg, &opts->video_catch_up)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_LOW_RES:
+                opts->video_low_res = true;
+                break;
+            case OPT_FRAME_PACING:
+                if (!parse_frame_pacing(optarg, &opts->frame_pacing)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_PARTIAL_UPLOAD:
+                if (!parse_video_partial_upload(optarg,
+                                                &opts->video_partial_upload)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_DECODE_QUEUE:
+                if (!parse_video_decode_queue(optarg,
+                                              &opts->video_decode_queue)) {
+                    return false;
+                }
+                break;
             case OPT_NO_POWER_ON:
                 opts->power_on = false;
                 break;
@@ -2821,6 +3501,30 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_CAPTURE_STREAM:
+                opts->capture_stream_filename = optarg;
+                break;
+            case OPT_REPLAY_STREAM:
+                opts->replay_stream_filename = optarg;
+                break;
+            case OPT_REPLAY_SPEED:
+                if (!parse_replay_speed(optarg, &opts->replay_speed)) {
+                    return false;
+                }
+                break;
+            case OPT_REPLAY_BUFFER:
+                if (!parse_replay_buffer(optarg, &opts->replay_buffer)) {
+                    return false;
+                }
+                break;
+            case OPT_REPLAY_DIR:
+                opts->replay_dir = optarg;
+                break;
+            case OPT_REPLAY_FORMAT:
+                if (!parse_replay_format(optarg, &opts->replay_format)) {
+                    return false;
+                }
+                break;
             default:
                 // getopt prints the error message on stderr
                 return false;
@@ -2858,6 +3562,101 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
     v4l2 = !!opts->v4l2_device;
 #endif
 
+    if (opts->no_adb) {
+        if (!opts->tunnel_port) {
+            LOGE("--no-adb requires --tunnel-port");
+            return false;
+        }
+        if (selectors || opts->tcpip) {
+            LOGE("Could not select a device without adb");
+            return false;
+        }
+        if (otg) {
+            LOGE("OTG mode: could not use --no-adb");
+            return false;
+        }
+        if (opts->list) {
+            LOGE("Could not list device information without adb");
+            return false;
+        }
+    }
+
+    if (opts->replay_stream_filename) {
+        if (opts->capture_stream_filename) {
+            LOGE("Could not capture replayed streams");
+            return false;
+        }
+        if (otg) {
+            LOGE("OTG mode: could not replay streams");
+            return false;
+        }
+        if (opts->list) {
+            LOGE("Could not list device information while replaying streams");
+            return false;
+        }
+        if (opts->io_engine != SC_IO_ENGINE_THREADS) {
+            // The capture file is read by the demuxer threads
+            LOGE("Could not replay streams with --io-engine=epoll");
+            return false;
+        }
+        // There is no device to control
+        opts->control = false;
+    } else if (opts->replay_speed != 1) {
+        LOGE("Replay speed specified without --replay-stream");
+        return false;
+    }
+
+    if (opts->multi_session) {
+        if (selectors || opts->tcpip) {
+            LOGE("Multi-session mode: the devices are selected by the serials "
+                 "passed to --multi-session");
+            return false;
+        }
+        if (otg) {
+            LOGE("OTG mode: could not use --multi-session");
+            return false;
+        }
+        if (opts->no_adb) {
+            LOGE("Multi-session mode: could not use --no-adb");
+            return false;
+        }
+        if (opts->list) {
+            LOGE("Could not list device information in multi-session mode");
+            return false;
+        }
+        if (opts->capture_stream_filename || opts->replay_stream_filename) {
+            LOGE("Multi-session mode: could not capture or replay streams");
+            return false;
+        }
+        if (opts->record_filename || v4l2) {
+            LOGE("Multi-session mode: could not record or use a V4L2 sink");
+            return false;
+        }
+        if (opts->screenshot_dir) {
+            LOGE("Multi-session mode: could not use --screenshot-dir");
+            return false;
+        }
+        if (opts->replay_buffer) {
+            LOGE("Multi-session mode: could not use --replay-buffer");
+            return false;
+        }
+        if (!opts->video) {
+            LOGE("Multi-session mode: could not disable video");
+            return false;
+        }
+        if (opts->video_decode_queue) {
+            // The decoder pool already queues the packets
+            LOGE("Multi-session mode: could not use --video-decode-queue");
+            return false;
+        }
+        // Only the video is mirrored
+        opts->audio = false;
+        opts->control = false;
+    } else if (opts->decoder_pool_size) {
+        LOGE("Decoder pool size specified without --multi-session");
+        return false;
+    }
+
     if (!opts->window) {
         // Without window, there cannot be any video playback
         opts->video_playback = false;
@@ -2875,8 +3674,9 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         opts->audio_playback = false;
     }
 
+    // In multi-session mode, the video is decoded even without playback
     if (opts->video && !opts->video_playback && !opts->record_filename
-            && !v4l2) {
+            && !v4l2 && !opts->multi_session) {
         LOGI("No video playback, no recording, no V4L2 sink: video disabled");
         opts->video = false;
     }
@@ -3065,7 +3865,8 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         return false;
     }
 
-    if ((opts->tunnel_host || opts->tunnel_port) && !opts->force_adb_forward) {
+    if ((opts->tunnel_host || opts->tunnel_port) && !opts->force_adb_forward
+            && !opts->no_adb) {
         LOGI("Tunnel host/port is set, "
              "--force-adb-forward automatically enabled.");
         opts->force_adb_forward = true;
@@ -3163,6 +3964,57 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         return false;
     }
 
+    if (opts->record_queue_limit && !opts->record_filename) {
+        LOGE("Record queue limit specified without recording");
+        return false;
+    }
+
+    if (opts->record_overflow != SC_RECORD_OVERFLOW_SPILL
+            && !opts->record_queue_limit) {
+        LOGE("Record overflow policy specified without --record-queue-limit");
+        return false;
+    }
+
+    if (opts->record_prealloc && !opts->record_filename) {
+        LOGE("Record prealloc size specified without recording");
+        return false;
+    }
+
+    // The record orientation also applies to the saved replay buffer
+    if ((opts->record_filename || opts->replay_buffer)
+            && sc_orientation_is_mirror(opts->record_orientation)) {
+        LOGE("Record orientation only supports rotation, not flipping: %s",
+             sc_orientation_get_name(opts->record_orientation));
+        return false;
+    }
+
+    if (opts->replay_buffer) {
+        if (!opts->video && !opts->audio) {
+            LOGE("Video and audio disabled, nothing to buffer");
+            return false;
+        }
+
+        if (!opts->window) {
+            // The replay buffer is saved by a shortcut
+            LOGE("--replay-buffer requires a window");
+            return false;
+        }
+
+        if (!opts->replay_format) {
+            opts->replay_format = SC_RECORD_FORMAT_MP4;
+        }
+
+        if (opts->replay_format == SC_RECORD_FORMAT_MP4 && opts->audio
+                && opts->audio_codec == SC_CODEC_RAW) {
+            LOGE("Saving to MP4 container does not support RAW audio "
+                 "(try with --replay-format=mkv)");
+            return false;
+        }
+    } else if (opts->replay_dir || opts->replay_format) {
+        LOGE("Replay directory or format specified without --replay-buffer");
+        return false;
+    }
+
     if (opts->record_filename) {
         if (!opts->video && !opts->audio) {
             LOGE("Video and audio disabled, nothing to record");
@@ -3179,15 +4031,6 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             }
         }
 
-        if (opts->record_orientation != SC_ORIENTATION_0) {
-            if (sc_orientation_is_mirror(opts->record_orientation)) {
-                LOGE("Record orientation only supports rotation, not "
-                     "flipping: %s",
-                     sc_orientation_get_name(opts->record_orientation));
-                return false;
-            }
-        }
-
         if (opts->video
                 && sc_record_format_is_audio_only(opts->record_format)) {
             LOGE("Audio container does not support video stream");
@@ -3222,11 +4065,25 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         }
 
         if ((opts->record_format == SC_RECORD_FORMAT_MP4 ||
+             opts->record_format == SC_RECORD_FORMAT_FMP4 ||
              opts->record_format == SC_RECORD_FORMAT_M4A)
                 && opts->audio_codec == SC_CODEC_RAW) {
             LOGE("Recording to MP4 container does not support RAW audio");
             return false;
         }
+
+        if (opts->record_format == SC_RECORD_FORMAT_FMP4) {
+            if (!opts->record_fragment_duration) {
+                opts->record_fragment_duration = SC_TICK_FROM_SEC(1);
+            }
+        } else if (opts->record_fragment_duration) {
+            LOGE("Record fragment duration specified without "
+                 "--record-format=fmp4");
+            return false;
+        }
+    } else if (opts->record_fragment_duration) {
+        LOGE("Record fragment duration specified without recording");
+        return false;
     }
 
     if (opts->audio_codec == SC_CODEC_FLAC && opts->audio_bit_rate) {
@@ -3266,6 +4123,11 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             LOGE("Cannot start an Android app if control is disabled");
             return false;
         }
+        if (opts->video_catch_up) {
+            LOGE("Cannot request key frames to catch up the video if control "
+                 "is disabled");
+            return false;
+        }
     }
 
 # ifdef _WIN32
@@ -3284,6 +4146,50 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         opts->start_fps_counter = false;
     }
 
+    if (opts->frame_pacing && !opts->video_playback) {
+        LOGW("--frame-pacing has no effect without video playback");
+        opts->frame_pacing = 0;
+    }
+
+    if (opts->video_partial_upload && !opts->video_playback) {
+        LOGW("--video-partial-upload has no effect without video playback");
+        opts->video_partial_upload = 0;
+    }
+
+    if (opts->render_bench && !opts->video_playback) {
+        LOGE("--render-bench requires video playback");
+        return false;
+    }
+
+    if (opts->screenshot_dir && !opts->video_playback) {
+        LOGE("--screenshot-dir requires video playback");
+        return false;
+    }
+
+    if (opts->screenshot_burst && !opts->screenshot_dir) {
+        LOGE("--screenshot-burst requires --screenshot-dir");
+        return false;
+    }
+
+    if (opts->video_prepare_thread) {
+        if (!opts->video_playback) {
+            LOGE("--video-prepare-thread requires video playback");
+            return false;
+        }
+
+        if (!opts->video_low_res && !opts->video_partial_upload) {
+            // The thread only executes the CPU-side part of the uploads
+            LOGE("--video-prepare-thread requires --video-low-res or "
+                 "--video-partial-upload");
+            return false;
+        }
+
+        if (opts->frame_pacing) {
+            LOGE("--video-prepare-thread is incompatible with --frame-pacing");
+            return false;
+        }
+    }
+
     if (otg) {
         // OTG mode is compatible with only very few options.
         // Only report obvious errors.
@@ -61,6 +61,29 @@
 # define SCRCPY_LAVC_HAS_CODECPAR_CODEC_SIDEDATA
 #endif
 
+// In ffmpeg/doc/APIchanges:
+// 2021-04-27 - lavu 57.0.100
+//   The size parameters of the AVBuffer API (including the alloc() callback of
+//   av_buffer_pool_init2()) are now size_t instead of int.
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 0, 100)
+# define SCRCPY_LAVU_HAS_BUFFER_SIZE_T
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2021-03-11 - lavu 56.66.100 - imgutils.h
+//   Add av_image_fill_plane_sizes().
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 66, 100)
+# define SCRCPY_LAVU_HAS_FILL_PLANE_SIZES
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2023-08-02 - lavf 60.8.100 - avio.h
+//   Constify the buffer pointees in the write_packet and write_data_type
+//   callbacks of AVIOContext on the next major bump.
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(61, 0, 100)
+# define SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+#endif
+
 #ifndef HAVE_STRDUP
 char *strdup(const char *s);
 #endif
@@ -1,6 +1,7 @@
 #include "controller.h"
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include "util/log.h"
 
@@ -58,6 +59,9 @@ sc_controller_init(struct sc_controller *controller, sc_socket control_socket,
 
     controller->control_socket = control_socket;
     controller->stopped = false;
+#ifdef HAVE_IO_LOOP
+    controller->io_loop = NULL;
+#endif
 
     assert(cbs && cbs->on_ended);
     controller->cbs = cbs;
@@ -89,6 +93,25 @@ sc_controller_destroy(struct sc_controller *controller) {
     sc_receiver_destroy(&controller->receiver);
 }
 
+// Wake up the sender (the controller thread or the I/O loop)
+static void
+sc_controller_notify(struct sc_controller *controller) {
+    sc_mutex_assert(&controller->mutex);
+
+#ifdef HAVE_IO_LOOP
+    if (controller->io_loop) {
+        // If the watch is not registered yet, the pending messages will be
+        // sent on start
+        if (controller->io_started) {
+            sc_io_loop_post(controller->io_loop, &controller->watch);
+        }
+        return;
+    }
+#endif
+
+    sc_cond_signal(&controller->msg_cond);
+}
+
 bool
 sc_controller_push_msg(struct sc_controller *controller,
                        const struct sc_control_msg *msg) {
@@ -105,12 +128,13 @@ sc_controller_push_msg(struct sc_controller *controller,
         sc_vecdeque_push_noresize(&controller->queue, *msg);
         pushed = true;
         if (was_empty) {
-            sc_cond_signal(&controller->msg_cond);
+            sc_controller_notify(controller);
         }
     } else if (!sc_control_msg_is_droppable(msg)) {
         bool ok = sc_vecdeque_push(&controller->queue, *msg);
         if (ok) {
             pushed = true;
+            // The queue was not empty, so a notification is already pending
         } else {
             // A non-droppable event must be dropped anyway
             LOG_OOM();
@@ -183,8 +207,157 @@ run_controller(void *data) {
     return 0;
 }
 
+#ifdef HAVE_IO_LOOP
+void
+sc_controller_set_io_loop(struct sc_controller *controller,
+                          struct sc_io_loop *loop) {
+    controller->io_loop = loop;
+    controller->io_started = false;
+}
+
+static void
+sc_controller_end_io(struct sc_controller *controller, bool error) {
+    assert(!controller->io_ended);
+
+    sc_io_loop_remove(controller->io_loop, &controller->watch);
+    sc_receiver_close_io(&controller->receiver);
+    free(controller->out);
+    controller->io_ended = true;
+
+    controller->cbs->on_ended(controller, error, controller->cbs_userdata);
+}
+
+// Send the pending messages without blocking.
+// Return false if the controller must stop.
+static bool
+sc_controller_send_io(struct sc_controller *controller, bool *error) {
+    for (;;) {
+        if (controller->out_sent == controller->out_len) {
+            sc_mutex_lock(&controller->mutex);
+            if (controller->stopped) {
+                sc_mutex_unlock(&controller->mutex);
+                LOGD("Controller stopped");
+                *error = false;
+                return false;
+            }
+
+            if (sc_vecdeque_is_empty(&controller->queue)) {
+                sc_mutex_unlock(&controller->mutex);
+                // Nothing more to send, stop watching for writability
+                return sc_io_loop_set_events(controller->io_loop,
+                                             &controller->watch,
+                                             SC_IO_READABLE);
+            }
+
+            struct sc_control_msg msg = sc_vecdeque_pop(&controller->queue);
+            sc_mutex_unlock(&controller->mutex);
+
+            size_t length = sc_control_msg_serialize(&msg, controller->out);
+            sc_control_msg_destroy(&msg);
+            if (!length) {
+                *error = true;
+                return false;
+            }
+
+            controller->out_len = length;
+            controller->out_sent = 0;
+        }
+
+        size_t remaining = controller->out_len - controller->out_sent;
+        ssize_t w = net_send(controller->control_socket,
+                             &controller->out[controller->out_sent],
+                             remaining);
+        if (w == -1 && net_would_block()) {
+            // The socket buffer is full, wait until it is writable
+            return sc_io_loop_set_events(controller->io_loop,
+                                         &controller->watch,
+                                         SC_IO_READABLE | SC_IO_WRITABLE);
+        }
+
+        if (w <= 0) {
+            LOGD("Controller stopped (socket closed)");
+            *error = false;
+            return false;
+        }
+
+        controller->out_sent += w;
+    }
+}
+
+static void
+sc_controller_on_io_event(struct sc_io_watch *watch, unsigned events) {
+    struct sc_controller *controller =
+        container_of(watch, struct sc_controller, watch);
+
+    if (controller->io_ended) {
+        // A stale post (e.g. from sc_controller_stop()) after the end
+        return;
+    }
+
+    bool error = false;
+
+    if (events & SC_IO_READABLE) {
+        if (!sc_receiver_process_io(&controller->receiver, &error)) {
+            sc_controller_end_io(controller, error);
+            return;
+        }
+    }
+
+    if (events & (SC_IO_WRITABLE | SC_IO_POSTED)) {
+        if (!sc_controller_send_io(controller, &error)) {
+            sc_controller_end_io(controller, error);
+            return;
+        }
+    }
+}
+
+static bool
+sc_controller_start_io(struct sc_controller *controller) {
+    LOGD("Starting controller on the I/O loop");
+
+    controller->out = malloc(SC_CONTROL_MSG_MAX_SIZE);
+    if (!controller->out) {
+        LOG_OOM();
+        return false;
+    }
+
+    controller->out_len = 0;
+    controller->out_sent = 0;
+    controller->io_ended = false;
+
+    bool ok = sc_receiver_open_io(&controller->receiver);
+    if (!ok) {
+        free(controller->out);
+        return false;
+    }
+
+    ok = sc_io_loop_add(controller->io_loop, &controller->watch,
+                        controller->control_socket, SC_IO_READABLE,
+                        sc_controller_on_io_event);
+    if (!ok) {
+        sc_receiver_close_io(&controller->receiver);
+        free(controller->out);
+        return false;
+    }
+
+    sc_mutex_lock(&controller->mutex);
+    controller->io_started = true;
+    // Messages may have been pushed before start
+    sc_controller_notify(controller);
+    sc_mutex_unlock(&controller->mutex);
+
+    return true;
+}
+#endif
+
 bool
 sc_controller_start(struct sc_controller *controller) {
+#ifdef HAVE_IO_LOOP
+    if (controller->io_loop) {
+        return sc_controller_start_io(controller);
+    }
+#endif
+
     LOGD("Starting controller thread");
 
     bool ok = sc_thread_create(&controller->thread, run_controller,
@@ -207,12 +380,22 @@ void
 sc_controller_stop(struct sc_controller *controller) {
     sc_mutex_lock(&controller->mutex);
     controller->stopped = true;
-    sc_cond_signal(&controller->msg_cond);
+    sc_controller_notify(controller);
     sc_mutex_unlock(&controller->mutex);
 }
 
 void
 sc_controller_join(struct sc_controller *controller) {
+#ifdef HAVE_IO_LOOP
+    if (controller->io_loop) {
+        // The loop is joined, so it is safe to end from here
+        if (!controller->io_ended) {
+            sc_controller_end_io(controller, false);
+        }
+        return;
+    }
+#endif
+
     sc_thread_join(&controller->thread, NULL);
     sc_receiver_join(&controller->receiver);
 }
@@ -8,6 +8,9 @@
 #include "control_msg.h"
 #include "receiver.h"
 #include "util/acksync.h"
+#ifdef HAVE_IO_LOOP
+# include "util/io_loop.h"
+#endif
 #include "util/net.h"
 #include "util/thread.h"
 #include "util/vecdeque.h"
@@ -23,6 +26,18 @@ struct sc_controller {
     struct sc_control_msg_queue queue;
     struct sc_receiver receiver;
 
+#ifdef HAVE_IO_LOOP
+    // If set, the control socket is read and written from the I/O loop, and
+    // neither the controller thread nor the receiver thread is started
+    struct sc_io_loop *io_loop;
+    struct sc_io_watch watch;
+    uint8_t *out; // the serialized message being sent
+    size_t out_len;
+    size_t out_sent;
+    bool io_started; // protected by the mutex
+    bool io_ended;
+#endif
+
     const struct sc_controller_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -45,12 +60,19 @@ sc_controller_configure(struct sc_controller *controller,
 void
 sc_controller_destroy(struct sc_controller *controller);
 
+#ifdef HAVE_IO_LOOP
+void
+sc_controller_set_io_loop(struct sc_controller *controller,
+                          struct sc_io_loop *loop);
+#endif
+
 bool
 sc_controller_start(struct sc_controller *controller);
 
 void
 sc_controller_stop(struct sc_controller *controller);
 
+// If an I/O loop is used, it must be stopped and joined first
 void
 sc_controller_join(struct sc_controller *controller);
 
@@ -0,0 +1,270 @@
+#include "decode_queue.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+
+#include "util/log.h"
+
+/** Downcast packet_sink to sc_decode_queue */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_decode_queue, packet_sink)
+
+struct sc_decode_queue_item {
+    AVPacket *packet;
+    sc_tick push_date;
+};
+
+static void
+sc_decode_queue_clear(struct sc_decode_queue *dq) {
+    struct sc_decode_queue_item item;
+    while (sc_spsc_queue_pop(&dq->queue, &item)) {
+        av_packet_free(&item.packet);
+    }
+}
+
+static bool
+sc_decode_queue_wait(struct sc_decode_queue *dq) {
+    sc_mutex_lock(&dq->mutex);
+
+    atomic_store_explicit(&dq->waiting, true, memory_order_relaxed);
+    // Pairs with the fence in sc_decode_queue_packet_sink_push(): either the
+    // producer sees waiting == true, or the consumer sees the new item
+    atomic_thread_fence(memory_order_seq_cst);
+
+    while (!dq->stopped && sc_spsc_queue_is_empty(&dq->queue)) {
+        sc_cond_wait(&dq->cond, &dq->mutex);
+    }
+
+    atomic_store_explicit(&dq->waiting, false, memory_order_relaxed);
+    bool stopped = dq->stopped;
+
+    sc_mutex_unlock(&dq->mutex);
+
+    return !stopped;
+}
+
+static int
+run_decode_queue(void *data) {
+    struct sc_decode_queue *dq = data;
+
+    for (;;) {
+        struct sc_decode_queue_item item;
+        if (!sc_spsc_queue_pop(&dq->queue, &item)) {
+            if (!sc_decode_queue_wait(dq)) {
+                break;
+            }
+            continue;
+        }
+
+        sc_tick wait = sc_tick_now() - item.push_date;
+        ++dq->consumer_stats.popped;
+        dq->consumer_stats.wait_sum += wait;
+        if (wait > dq->consumer_stats.wait_max) {
+            dq->consumer_stats.wait_max = wait;
+        }
+
+        bool ok = sc_packet_source_sinks_push(&dq->packet_source,
+                                              item.packet);
+        av_packet_free(&item.packet);
+        if (!ok) {
+            LOGE("Decode queue '%s': packet could not be pushed, stopping",
+                 dq->name);
+            // Prevent to push any new packet
+            atomic_store(&dq->failed, true);
+            break;
+        }
+    }
+
+    LOGD("Decode queue '%s': thread ended", dq->name);
+
+    return 0;
+}
+
+static void
+sc_decode_queue_log_stats(struct sc_decode_queue *dq) {
+    uint64_t pushed = dq->producer_stats.pushed;
+    uint64_t popped = dq->consumer_stats.popped;
+
+    unsigned avg_depth_x100 = pushed
+        ? (unsigned) (dq->producer_stats.depth_sum * 100 / pushed) : 0;
+    sc_tick avg_wait = popped ? dq->consumer_stats.wait_sum / popped : 0;
+
+    LOGI("Decode queue '%s': %" PRIu64_ " packets, depth avg %u.%02u max %"
+         PRIu32 "/%u, wait avg %" PRItick " us max %" PRItick " us, %"
+         PRIu64_ " dropped (%" PRIu64_ " overflows)", dq->name, pushed,
+         avg_depth_x100 / 100, avg_depth_x100 % 100,
+         dq->producer_stats.depth_max, dq->depth, SC_TICK_TO_US(avg_wait),
+         SC_TICK_TO_US(dq->consumer_stats.wait_max),
+         dq->producer_stats.dropped, dq->producer_stats.overflows);
+}
+
+static bool
+sc_decode_queue_packet_sink_open(struct sc_packet_sink *sink,
+                                 AVCodecContext *ctx) {
+    struct sc_decode_queue *dq = DOWNCAST(sink);
+
+    bool ok = sc_spsc_queue_init(&dq->queue,
+                                 sizeof(struct sc_decode_queue_item),
+                                 dq->depth);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_mutex_init(&dq->mutex);
+    if (!ok) {
+        goto error_destroy_queue;
+    }
+
+    ok = sc_cond_init(&dq->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    dq->stopped = false;
+    atomic_init(&dq->waiting, false);
+    atomic_init(&dq->failed, false);
+    dq->dropping = false;
+    memset(&dq->producer_stats, 0, sizeof(dq->producer_stats));
+    memset(&dq->consumer_stats, 0, sizeof(dq->consumer_stats));
+
+    if (!sc_packet_source_sinks_open(&dq->packet_source, ctx)) {
+        goto error_destroy_cond;
+    }
+
+    ok = sc_thread_create(&dq->thread, run_decode_queue, "scrcpy-decq", dq);
+    if (!ok) {
+        LOGE("Decode queue '%s': could not start thread", dq->name);
+        goto error_close_sinks;
+    }
+
+    return true;
+
+error_close_sinks:
+    sc_packet_source_sinks_close(&dq->packet_source);
+error_destroy_cond:
+    sc_cond_destroy(&dq->cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&dq->mutex);
+error_destroy_queue:
+    sc_spsc_queue_destroy(&dq->queue);
+
+    return false;
+}
+
+static void
+sc_decode_queue_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_decode_queue *dq = DOWNCAST(sink);
+
+    sc_mutex_lock(&dq->mutex);
+    dq->stopped = true;
+    sc_cond_signal(&dq->cond);
+    sc_mutex_unlock(&dq->mutex);
+
+    sc_thread_join(&dq->thread, NULL);
+
+    // The packets not consumed yet are discarded
+    sc_decode_queue_clear(dq);
+
+    sc_decode_queue_log_stats(dq);
+
+    sc_packet_source_sinks_close(&dq->packet_source);
+
+    sc_cond_destroy(&dq->cond);
+    sc_mutex_destroy(&dq->mutex);
+    sc_spsc_queue_destroy(&dq->queue);
+}
+
+static bool
+sc_decode_queue_packet_sink_push(struct sc_packet_sink *sink,
+                                 const AVPacket *packet) {
+    struct sc_decode_queue *dq = DOWNCAST(sink);
+
+    if (atomic_load(&dq->failed)) {
+        return false;
+    }
+
+    if (dq->dropping && !(packet->flags & AV_PKT_FLAG_KEY)) {
+        // A config packet may also be dropped, since it is merged into the
+        // following key frame
+        ++dq->producer_stats.dropped;
+        return true;
+    }
+
+    AVPacket *ref = av_packet_alloc();
+    if (!ref) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (av_packet_ref(ref, packet)) {
+        LOG_OOM();
+        av_packet_free(&ref);
+        return false;
+    }
+
+    struct sc_decode_queue_item item = {
+        .packet = ref,
+        .push_date = sc_tick_now(),
+    };
+
+    if (!sc_spsc_queue_push(&dq->queue, &item)) {
+        av_packet_free(&ref);
+        if (!dq->dropping) {
+            LOGW("Decode queue '%s': full, dropping packets until the next "
+                 "key frame", dq->name);
+            dq->dropping = true;
+            ++dq->producer_stats.overflows;
+        }
+        ++dq->producer_stats.dropped;
+        return true;
+    }
+
+    if (dq->dropping) {
+        LOGD("Decode queue '%s': resumed on key frame", dq->name);
+        dq->dropping = false;
+    }
+
+    uint32_t depth = sc_spsc_queue_size(&dq->queue);
+    ++dq->producer_stats.pushed;
+    dq->producer_stats.depth_sum += depth;
+    if (depth > dq->producer_stats.depth_max) {
+        dq->producer_stats.depth_max = depth;
+    }
+
+    // Pairs with the fence in sc_decode_queue_wait()
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&dq->waiting, memory_order_relaxed)) {
+        sc_mutex_lock(&dq->mutex);
+        sc_cond_signal(&dq->cond);
+        sc_mutex_unlock(&dq->mutex);
+    }
+
+    return true;
+}
+
+static void
+sc_decode_queue_packet_sink_disable(struct sc_packet_sink *sink) {
+    struct sc_decode_queue *dq = DOWNCAST(sink);
+    sc_packet_source_sinks_disable(&dq->packet_source);
+}
+
+void
+sc_decode_queue_init(struct sc_decode_queue *dq, const char *name,
+                     uint16_t depth) {
+    assert(depth > 0);
+
+    dq->name = name;
+    dq->depth = depth;
+
+    sc_packet_source_init(&dq->packet_source);
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = sc_decode_queue_packet_sink_open,
+        .close = sc_decode_queue_packet_sink_close,
+        .push = sc_decode_queue_packet_sink_push,
+        .disable = sc_decode_queue_packet_sink_disable,
+    };
+
+    dq->packet_sink.ops = &ops;
+}
@@ -0,0 +1,72 @@
+#ifndef SC_DECODE_QUEUE_H
+#define SC_DECODE_QUEUE_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trait/packet_sink.h"
+#include "trait/packet_source.h"
+#include "util/spsc_queue.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Pipeline stage between the demuxer and the decoder
+ *
+ * The packets pushed by the demuxer are referenced in a bounded lock-free
+ * queue, and pushed to the sinks (the decoder) from a separate thread, so that
+ * slow decoding does not delay the reception of the stream.
+ *
+ * When the queue is full, the packets are dropped until the next key frame.
+ */
+struct sc_decode_queue {
+    struct sc_packet_source packet_source; // packet source trait
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    const char *name; // must be statically allocated (e.g. a string literal)
+    uint16_t depth;
+
+    struct sc_spsc_queue queue; // of struct sc_decode_queue_item
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped; // protected by mutex
+    // Set by the consumer before sleeping on cond, so that the producer only
+    // locks the mutex when necessary
+    atomic_bool waiting;
+    // Set by the consumer when a sink fails, so that the next push fails
+    atomic_bool failed;
+
+    // Accessed only by the producer
+    bool dropping; // dropping packets until the next key frame
+    struct {
+        uint64_t pushed;
+        uint64_t dropped;
+        uint64_t overflows;
+        uint64_t depth_sum;
+        uint32_t depth_max;
+    } producer_stats;
+
+    // Accessed only by the consumer
+    struct {
+        uint64_t popped;
+        sc_tick wait_sum;
+        sc_tick wait_max;
+    } consumer_stats;
+};
+
+/**
+ * Initialize a decode queue
+ *
+ * \param name the name of the stream, for logs
+ * \param depth the maximum number of queued packets (strictly positive)
+ */
+void
+sc_decode_queue_init(struct sc_decode_queue *dq, const char *name,
+                     uint16_t depth);
+
+#endif
@@ -1,46 +1,311 @@
 #include "decoder.h"
 
+#include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <string.h>
 #include <libavcodec/packet.h>
 #include <libavutil/avutil.h>
 
 #include "util/log.h"
 
+// Delay before requesting a key frame again
+#define SC_DECODER_KEY_FRAME_RETRY_DELAY SC_TICK_FROM_SEC(1)
+
 /** Downcast packet_sink to decoder */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_decoder, packet_sink)
 
+static int
+sc_decoder_get_buffer2(AVCodecContext *ctx, AVFrame *frame, int flags) {
+    struct sc_decoder *decoder = ctx->opaque;
+    return sc_frame_pool_get_buffer(&decoder->frame_pool, ctx, frame, flags);
+}
+
 static bool
 sc_decoder_open(struct sc_decoder *decoder, AVCodecContext *ctx) {
+    bool video = ctx->codec_type == AVMEDIA_TYPE_VIDEO;
+
+    decoder->measure = video;
+    sc_vecdeque_init(&decoder->pending);
+    if (decoder->measure
+            && !sc_vecdeque_reserve(&decoder->pending,
+                                    SC_DECODER_MAX_PENDING)) {
+        LOG_OOM();
+        return false;
+    }
+    memset(&decoder->stats, 0, sizeof(decoder->stats));
+
+    decoder->key_frame_wait.active = false;
+    decoder->key_frame_wait.resume = false;
+    decoder->dropped = 0;
+    decoder->idle = false;
+    decoder->idle_packets = 0;
+    decoder->resume_dropped = 0;
+    decoder->low_res = false;
+    sc_clock_init(&decoder->catch_up.clock);
+    decoder->catch_up.count = 0;
+
     decoder->frame = av_frame_alloc();
     if (!decoder->frame) {
         LOG_OOM();
-        return false;
+        goto error_destroy_pending;
+    }
+
+    if (video && !sc_frame_pool_init(&decoder->frame_pool)) {
+        goto error_free_frame;
     }
 
     if (!sc_frame_source_sinks_open(&decoder->frame_source, ctx)) {
-        av_frame_free(&decoder->frame);
-        return false;
+        goto error_destroy_frame_pool;
+    }
+
+    if (decoder->pool
+            && !sc_decoder_pool_slot_init(decoder->pool, &decoder->pool_slot)) {
+        goto error_close_sinks;
     }
 
     decoder->ctx = ctx;
 
+    if (video) {
+        // The codec is open, but no packet has been sent yet
+        ctx->opaque = decoder;
+        ctx->get_buffer2 = sc_decoder_get_buffer2;
+    }
+
     return true;
+
+error_close_sinks:
+    sc_frame_source_sinks_close(&decoder->frame_source);
+error_destroy_frame_pool:
+    if (video) {
+        sc_frame_pool_destroy(&decoder->frame_pool);
+    }
+error_free_frame:
+    av_frame_free(&decoder->frame);
+error_destroy_pending:
+    sc_vecdeque_destroy(&decoder->pending);
+
+    return false;
 }
 
 static void
 sc_decoder_close(struct sc_decoder *decoder) {
+    if (decoder->pool) {
+        // Decode the queued packets before closing the sinks
+        sc_decoder_pool_flush(decoder->pool, decoder);
+        sc_decoder_pool_slot_destroy(decoder->pool, &decoder->pool_slot);
+    }
     sc_frame_source_sinks_close(&decoder->frame_source);
     av_frame_free(&decoder->frame);
+
+    if (decoder->ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        decoder->ctx->get_buffer2 = avcodec_default_get_buffer2;
+        decoder->ctx->opaque = NULL;
+        sc_frame_pool_log_stats(&decoder->frame_pool, decoder->name);
+        sc_frame_pool_destroy(&decoder->frame_pool);
+    }
+
+    if (decoder->idle_packets) {
+        LOGI("Decoder '%s': %" PRIu64_ " packets not decoded (no frame "
+             "needed), %" PRIu64_ " dropped on resume", decoder->name,
+             decoder->idle_packets, decoder->resume_dropped);
+    }
+    if (decoder->dropped) {
+        LOGI("Decoder '%s': %" PRIu64_ " packets dropped to catch up (%u "
+             "catch-ups)", decoder->name, decoder->dropped,
+             decoder->catch_up.count);
+    }
+
+    if (decoder->stats.frames) {
+        sc_tick avg = decoder->stats.time_sum / (sc_tick) decoder->stats.frames;
+        LOGI("Decoder '%s': %" PRIu64_ " frames, decode time avg %" PRItick
+             " us, max %" PRItick " us", decoder->name, decoder->stats.frames,
+             SC_TICK_TO_US(avg), SC_TICK_TO_US(decoder->stats.time_max));
+    }
+    sc_vecdeque_destroy(&decoder->pending);
+}
+
+static void
+sc_decoder_on_packet_sent(struct sc_decoder *decoder, int64_t pts) {
+    if (sc_vecdeque_is_full(&decoder->pending)) {
+        // The codec does not output a frame for every packet
+        (void) sc_vecdeque_popref(&decoder->pending);
+    }
+
+    struct sc_decoder_pending_packet pending = {
+        .pts = pts,
+        .date = sc_tick_now(),
+    };
+    // The capacity is reserved on open
+    sc_vecdeque_push_noresize(&decoder->pending, pending);
+}
+
+static void
+sc_decoder_on_frame_received(struct sc_decoder *decoder, int64_t pts) {
+    if (pts == AV_NOPTS_VALUE) {
+        return;
+    }
+
+    // The frames are output in decoding order (the device encoders do not
+    // produce B-frames), so the packets before the matching one did not
+    // produce any frame
+    while (!sc_vecdeque_is_empty(&decoder->pending)) {
+        struct sc_decoder_pending_packet *pending =
+            sc_vecdeque_popref(&decoder->pending);
+        if (pending->pts == pts) {
+            sc_tick time = sc_tick_now() - pending->date;
+            ++decoder->stats.frames;
+            decoder->stats.time_sum += time;
+            if (time > decoder->stats.time_max) {
+                decoder->stats.time_max = time;
+            }
+            LOGV("Decoder '%s': frame decoded in %" PRItick " us",
+                 decoder->name, SC_TICK_TO_US(time));
+            return;
+        }
+    }
+}
+
+static void
+sc_decoder_request_key_frame(struct sc_decoder *decoder, sc_tick now) {
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_RESET_VIDEO;
+
+    if (!sc_controller_push_msg(decoder->controller, &msg)) {
+        LOGW("Decoder '%s': could not request a key frame", decoder->name);
+    }
+
+    decoder->key_frame_wait.request_date = now;
+}
+
+// Drop the packets until a key frame with a PTS not older than min_pts
+//
+// If resume is true, the decoding resumes from idle: the dropped packets are
+// not late, so they are not reported as catch-up drops.
+static void
+sc_decoder_wait_key_frame(struct sc_decoder *decoder, sc_tick now,
+                          sc_tick min_pts, bool resume) {
+    decoder->key_frame_wait.active = true;
+    decoder->key_frame_wait.min_pts = min_pts;
+    decoder->key_frame_wait.resume = resume;
+    if (decoder->controller) {
+        sc_decoder_request_key_frame(decoder, now);
+    }
+    // Otherwise, wait for the next periodic key frame
+}
+
+static void
+sc_decoder_drop(struct sc_decoder *decoder, sc_tick now) {
+    if (decoder->key_frame_wait.resume) {
+        ++decoder->resume_dropped;
+    } else {
+        ++decoder->dropped;
+        if (decoder->fps_counter) {
+            sc_fps_counter_add_dropped_frame(decoder->fps_counter);
+        }
+    }
+
+    if (decoder->controller && now - decoder->key_frame_wait.request_date
+                                   >= SC_DECODER_KEY_FRAME_RETRY_DELAY) {
+        // The key frame has not been received yet, request it again
+        sc_decoder_request_key_frame(decoder, now);
+    }
 }
 
+// Return true if the packet must be decoded
 static bool
-sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
-    bool is_config = packet->pts == AV_NOPTS_VALUE;
-    if (is_config) {
-        // nothing to do
+sc_decoder_filter(struct sc_decoder *decoder, const AVPacket *packet) {
+    sc_tick now = sc_tick_now();
+    sc_tick pts = SC_TICK_FROM_US(packet->pts);
+    bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+
+    if (!sc_frame_source_sinks_are_active(&decoder->frame_source)) {
+        if (!decoder->idle) {
+            LOGI("Decoder '%s': no frame needed, decoding paused",
+                 decoder->name);
+            decoder->idle = true;
+        }
+        ++decoder->idle_packets;
+        return false;
+    }
+
+    if (decoder->idle) {
+        LOGI("Decoder '%s': decoding resumed", decoder->name);
+        decoder->idle = false;
+        // The previous packets have not been decoded
+        sc_decoder_wait_key_frame(decoder, now, pts, true);
+    }
+
+    if (decoder->key_frame_wait.active) {
+        if (!key_frame || pts < decoder->key_frame_wait.min_pts) {
+            sc_decoder_drop(decoder, now);
+            return false;
+        }
+
+        LOGD("Decoder '%s': resumed on key frame", decoder->name);
+        decoder->key_frame_wait.active = false;
+        // The latency may have changed, restart the estimation
+        sc_clock_init(&decoder->catch_up.clock);
+    }
+
+    if (decoder->catch_up.threshold) {
+        struct sc_clock *clock = &decoder->catch_up.clock;
+        if (clock->range) {
+            sc_tick backlog = now - sc_clock_to_system_time(clock, pts);
+            if (backlog > decoder->catch_up.threshold) {
+                LOGW("Decoder '%s': %" PRItick " ms late, dropping frames "
+                     "until the next key frame", decoder->name,
+                     SC_TICK_TO_MS(backlog));
+                ++decoder->catch_up.count;
+                // The PTS of a frame produced now (according to the
+                // estimation): the key frames already queued are older
+                sc_decoder_wait_key_frame(decoder, now, now - clock->offset,
+                                          false);
+                sc_decoder_drop(decoder, now);
+                return false;
+            }
+        }
+
+        // Late packets are not taken into account, so that the backlog is not
+        // absorbed into the estimation
+        sc_clock_update(clock, now, pts);
+    }
+
+    return true;
+}
+
+static void
+sc_decoder_update_low_res(struct sc_decoder *decoder) {
+    bool low_res = sc_frame_source_sinks_are_low_res(&decoder->frame_source);
+    if (low_res == decoder->low_res) {
+        return;
+    }
+
+    // The decoders used by scrcpy (H.264, H.265, AV1) do not support lowres
+    // decoding, but skipping the loop filter on non-reference frames saves
+    // decoding time without propagating artifacts to the next frames
+    decoder->ctx->skip_loop_filter = low_res ? AVDISCARD_NONREF
+                                             : AVDISCARD_DEFAULT;
+    decoder->low_res = low_res;
+    LOGD("Decoder '%s': loop filter %s on non-reference frames",
+         decoder->name, low_res ? "skipped" : "enabled");
+}
+
+bool
+sc_decoder_decode(struct sc_decoder *decoder, const AVPacket *packet) {
+    if (!sc_decoder_filter(decoder, packet)) {
+        // Not decoded
         return true;
     }
 
+    if (decoder->ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        sc_decoder_update_low_res(decoder);
+    }
+
+    if (decoder->measure) {
+        sc_decoder_on_packet_sent(decoder, packet->pts);
+    }
+
     int ret = avcodec_send_packet(decoder->ctx, packet);
     if (ret < 0 && ret != AVERROR(EAGAIN)) {
         LOGE("Decoder '%s': could not send video packet: %d",
@@ -61,6 +326,10 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
         }
 
         // a frame was received
+        if (decoder->measure) {
+            sc_decoder_on_frame_received(decoder, decoder->frame->pts);
+        }
+
         bool ok = sc_frame_source_sinks_push(&decoder->frame_source,
                                              decoder->frame);
         av_frame_unref(decoder->frame);
@@ -73,6 +342,21 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
     return true;
 }
 
+static bool
+sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+    if (is_config) {
+        // nothing to do
+        return true;
+    }
+
+    if (decoder->pool) {
+        return sc_decoder_pool_push(decoder->pool, decoder, packet);
+    }
+
+    return sc_decoder_decode(decoder, packet);
+}
+
 static bool
 sc_decoder_packet_sink_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
     struct sc_decoder *decoder = DOWNCAST(sink);
@@ -95,6 +379,10 @@ sc_decoder_packet_sink_push(struct sc_packet_sink *sink,
 void
 sc_decoder_init(struct sc_decoder *decoder, const char *name) {
     decoder->name = name; // statically allocated
+    decoder->pool = NULL;
+    decoder->controller = NULL;
+    decoder->fps_counter = NULL;
+    decoder->catch_up.threshold = 0;
     sc_frame_source_init(&decoder->frame_source);
 
     static const struct sc_packet_sink_ops ops = {
@@ -105,3 +393,27 @@ sc_decoder_init(struct sc_decoder *decoder, const char *name) {
 
     decoder->packet_sink.ops = &ops;
 }
+
+void
+sc_decoder_set_controller(struct sc_decoder *decoder,
+                          struct sc_controller *controller) {
+    decoder->controller = controller;
+}
+
+void
+sc_decoder_set_fps_counter(struct sc_decoder *decoder,
+                           struct sc_fps_counter *fps_counter) {
+    decoder->fps_counter = fps_counter;
+}
+
+void
+sc_decoder_set_catch_up(struct sc_decoder *decoder, sc_tick threshold) {
+    assert(threshold > 0);
+    assert(decoder->controller);
+    decoder->catch_up.threshold = threshold;
+}
+
+void
+sc_decoder_set_pool(struct sc_decoder *decoder, struct sc_decoder_pool *pool) {
+    decoder->pool = pool;
+}
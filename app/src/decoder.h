@@ -3,10 +3,26 @@
 
 #include "common.h"
 
+#include <stdbool.h>
 #include <libavcodec/avcodec.h>
 
+#include "clock.h"
+#include "controller.h"
+#include "decoder_pool.h"
+#include "fps_counter.h"
+#include "frame_pool.h"
 #include "trait/frame_source.h"
 #include "trait/packet_sink.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+
+// Maximum number of packets waiting for their frame to measure the decode time
+#define SC_DECODER_MAX_PENDING 32
+
+struct sc_decoder_pending_packet {
+    int64_t pts;
+    sc_tick date; // when the packet was sent to the codec
+};
 
 struct sc_decoder {
     struct sc_packet_sink packet_sink; // packet sink trait
@@ -16,10 +32,92 @@ struct sc_decoder {
 
     AVCodecContext *ctx;
     AVFrame *frame;
+
+    struct sc_decoder_pool *pool; // NULL to decode from the pusher thread
+    struct sc_decoder_pool_slot pool_slot; // only used with a pool
+
+    // Decode time measurement (only for video)
+    bool measure;
+    struct sc_frame_pool frame_pool; // only used for video
+    struct sc_decoder_pending_queue
+        SC_VECDEQUE(struct sc_decoder_pending_packet) pending;
+    struct {
+        uint64_t frames;
+        sc_tick time_sum;
+        sc_tick time_max;
+    } stats;
+
+    // To request key frames to the device (may be NULL)
+    struct sc_controller *controller;
+    // To report the frames dropped to catch up (may be NULL)
+    struct sc_fps_counter *fps_counter;
+
+    // The fields below are only accessed from the decoding thread once open
+
+    // Dropping packets until a key frame (with a PTS not older than min_pts)
+    struct {
+        bool active;
+        sc_tick min_pts;
+        sc_tick request_date; // when the last key frame was requested
+        bool resume; // resuming from idle (not late)
+    } key_frame_wait;
+    uint64_t dropped; // packets dropped to catch up
+
+    // Decoding paused because no frame sink needs frames
+    bool idle;
+    uint64_t idle_packets;
+    uint64_t resume_dropped; // packets dropped resuming from idle
+
+    // Loop filter skipped on non-reference frames because all the frame sinks
+    // render at a reduced resolution (only for video)
+    bool low_res;
+
+    // Catch-up mode
+    struct {
+        sc_tick threshold; // 0 if disabled
+        // Estimation of the system time at which each packet should be decoded
+        struct sc_clock clock;
+        unsigned count; // number of catch-ups
+    } catch_up;
 };
 
 // The name must be statically allocated (e.g. a string literal)
 void
 sc_decoder_init(struct sc_decoder *decoder, const char *name);
 
+// Decode on the worker threads of a pool (must be called before open)
+void
+sc_decoder_set_pool(struct sc_decoder *decoder, struct sc_decoder_pool *pool);
+
+// Request key frames to the device when the decoding must restart (must be
+// called before open)
+void
+sc_decoder_set_controller(struct sc_decoder *decoder,
+                          struct sc_controller *controller);
+
+// Report the frames dropped by the decoder (must be called before open)
+void
+sc_decoder_set_fps_counter(struct sc_decoder *decoder,
+                           struct sc_fps_counter *fps_counter);
+
+/**
+ * Enable the catch-up mode (must be called before open)
+ *
+ * When the decoding is late by more than `threshold` (the packet PTS is
+ * compared to an estimation of the time at which it should be decoded), the
+ * packets are dropped and a new key frame is requested to the device. The
+ * decoding resumes on that key frame.
+ *
+ * A controller must be set.
+ */
+void
+sc_decoder_set_catch_up(struct sc_decoder *decoder, sc_tick threshold);
+
+// Decode a packet and push the resulting frames to the sinks (the decoder pool
+// calls it from its worker threads)
+//
+// The packet is not decoded if no frame sink needs frames.
+bool
+sc_decoder_decode(struct sc_decoder *decoder, const AVPacket *packet);
+
 #endif
@@ -0,0 +1,256 @@
+#include "decoder_pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <SDL3/SDL_cpuinfo.h>
+
+#include "decoder.h"
+#include "util/log.h"
+
+static void
+sc_decoder_pool_slot_clear(struct sc_decoder_pool_slot *slot) {
+    while (!sc_vecdeque_is_empty(&slot->queue)) {
+        AVPacket *packet = sc_vecdeque_pop(&slot->queue);
+        av_packet_free(&packet);
+    }
+}
+
+static int
+run_decoder_pool_worker(void *data) {
+    struct sc_decoder_pool *pool = data;
+
+    sc_mutex_lock(&pool->mutex);
+
+    for (;;) {
+        while (!pool->stopped && sc_vecdeque_is_empty(&pool->ready)) {
+            sc_cond_wait(&pool->cond, &pool->mutex);
+        }
+
+        if (pool->stopped) {
+            break;
+        }
+
+        struct sc_decoder *decoder = sc_vecdeque_pop(&pool->ready);
+        struct sc_decoder_pool_slot *slot = &decoder->pool_slot;
+        assert(slot->scheduled);
+        assert(!sc_vecdeque_is_empty(&slot->queue));
+
+        AVPacket *packet = sc_vecdeque_pop(&slot->queue);
+        // There is space for a new packet
+        sc_cond_signal(&slot->queue_cond);
+
+        sc_mutex_unlock(&pool->mutex);
+        bool ok = sc_decoder_decode(decoder, packet);
+        av_packet_free(&packet);
+        sc_mutex_lock(&pool->mutex);
+
+        if (!ok) {
+            // Error already logged, the next push will fail
+            slot->failed = true;
+            sc_decoder_pool_slot_clear(slot);
+        }
+
+        if (sc_vecdeque_is_empty(&slot->queue)) {
+            slot->scheduled = false;
+            // Wake up sc_decoder_pool_flush()
+            sc_cond_signal(&slot->queue_cond);
+        } else {
+            // Serve the other decoders first. The capacity is reserved for all
+            // the decoders in sc_decoder_pool_slot_init().
+            sc_vecdeque_push_noresize(&pool->ready, decoder);
+        }
+    }
+
+    sc_mutex_unlock(&pool->mutex);
+
+    return 0;
+}
+
+bool
+sc_decoder_pool_init(struct sc_decoder_pool *pool, unsigned thread_count) {
+    if (!thread_count) {
+        int cores = SDL_GetNumLogicalCPUCores();
+        thread_count = cores > 0 ? (unsigned) cores : 1;
+    }
+
+    pool->threads = malloc(thread_count * sizeof(*pool->threads));
+    if (!pool->threads) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&pool->mutex);
+    if (!ok) {
+        goto error_free_threads;
+    }
+
+    ok = sc_cond_init(&pool->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    pool->thread_count = thread_count;
+    pool->slot_count = 0;
+    pool->stopped = false;
+    sc_vecdeque_init(&pool->ready);
+
+    return true;
+
+error_destroy_mutex:
+    sc_mutex_destroy(&pool->mutex);
+error_free_threads:
+    free(pool->threads);
+
+    return false;
+}
+
+void
+sc_decoder_pool_destroy(struct sc_decoder_pool *pool) {
+    assert(!pool->slot_count);
+    sc_vecdeque_destroy(&pool->ready);
+    sc_cond_destroy(&pool->cond);
+    sc_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+}
+
+bool
+sc_decoder_pool_start(struct sc_decoder_pool *pool) {
+    LOGD("Starting decoder pool (%u threads)", pool->thread_count);
+
+    for (unsigned i = 0; i < pool->thread_count; ++i) {
+        bool ok = sc_thread_create(&pool->threads[i], run_decoder_pool_worker,
+                                   "scrcpy-dec-pool", pool);
+        if (!ok) {
+            LOGE("Decoder pool: could not start thread");
+            // Stop and join the threads already started
+            pool->thread_count = i;
+            sc_decoder_pool_stop(pool);
+            sc_decoder_pool_join(pool);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+sc_decoder_pool_stop(struct sc_decoder_pool *pool) {
+    sc_mutex_lock(&pool->mutex);
+    pool->stopped = true;
+    sc_cond_broadcast(&pool->cond);
+    sc_mutex_unlock(&pool->mutex);
+}
+
+void
+sc_decoder_pool_join(struct sc_decoder_pool *pool) {
+    for (unsigned i = 0; i < pool->thread_count; ++i) {
+        sc_thread_join(&pool->threads[i], NULL);
+    }
+}
+
+bool
+sc_decoder_pool_slot_init(struct sc_decoder_pool *pool,
+                          struct sc_decoder_pool_slot *slot) {
+    bool ok = sc_cond_init(&slot->queue_cond);
+    if (!ok) {
+        return false;
+    }
+
+    sc_vecdeque_init(&slot->queue);
+    if (!sc_vecdeque_reserve(&slot->queue, SC_DECODER_POOL_QUEUE_MAX)) {
+        LOG_OOM();
+        sc_cond_destroy(&slot->queue_cond);
+        return false;
+    }
+
+    sc_mutex_lock(&pool->mutex);
+    // Each decoder is at most once in the ready queue, so a worker may always
+    // reschedule a decoder without allocation
+    ok = sc_vecdeque_reserve(&pool->ready, pool->slot_count + 1);
+    if (ok) {
+        ++pool->slot_count;
+    }
+    sc_mutex_unlock(&pool->mutex);
+
+    if (!ok) {
+        LOG_OOM();
+        sc_vecdeque_destroy(&slot->queue);
+        sc_cond_destroy(&slot->queue_cond);
+        return false;
+    }
+
+    slot->scheduled = false;
+    slot->failed = false;
+
+    return true;
+}
+
+void
+sc_decoder_pool_slot_destroy(struct sc_decoder_pool *pool,
+                             struct sc_decoder_pool_slot *slot) {
+    sc_mutex_lock(&pool->mutex);
+    assert(!slot->scheduled);
+    assert(pool->slot_count);
+    --pool->slot_count;
+    sc_mutex_unlock(&pool->mutex);
+
+    sc_decoder_pool_slot_clear(slot);
+    sc_vecdeque_destroy(&slot->queue);
+    sc_cond_destroy(&slot->queue_cond);
+}
+
+bool
+sc_decoder_pool_push(struct sc_decoder_pool *pool, struct sc_decoder *decoder,
+                     const AVPacket *packet) {
+    struct sc_decoder_pool_slot *slot = &decoder->pool_slot;
+
+    AVPacket *ref = av_packet_alloc();
+    if (!ref) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (av_packet_ref(ref, packet)) {
+        LOG_OOM();
+        av_packet_free(&ref);
+        return false;
+    }
+
+    sc_mutex_lock(&pool->mutex);
+
+    while (!pool->stopped && !slot->failed
+            && sc_vecdeque_size(&slot->queue) >= SC_DECODER_POOL_QUEUE_MAX) {
+        sc_cond_wait(&slot->queue_cond, &pool->mutex);
+    }
+
+    if (pool->stopped || slot->failed) {
+        sc_mutex_unlock(&pool->mutex);
+        av_packet_free(&ref);
+        return false;
+    }
+
+    // The capacity is reserved in sc_decoder_pool_slot_init()
+    sc_vecdeque_push_noresize(&slot->queue, ref);
+
+    if (!slot->scheduled) {
+        slot->scheduled = true;
+        sc_vecdeque_push_noresize(&pool->ready, decoder);
+        sc_cond_signal(&pool->cond);
+    }
+
+    sc_mutex_unlock(&pool->mutex);
+
+    return true;
+}
+
+void
+sc_decoder_pool_flush(struct sc_decoder_pool *pool,
+                      struct sc_decoder *decoder) {
+    struct sc_decoder_pool_slot *slot = &decoder->pool_slot;
+
+    sc_mutex_lock(&pool->mutex);
+    while (!pool->stopped && slot->scheduled) {
+        sc_cond_wait(&slot->queue_cond, &pool->mutex);
+    }
+    sc_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,92 @@
+#ifndef SC_DECODER_POOL_H
+#define SC_DECODER_POOL_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <libavcodec/packet.h>
+
+#include "util/thread.h"
+#include "util/vecdeque.h"
+
+/**
+ * Bounded pool of threads shared by several decoders
+ *
+ * By default, a decoder decodes the packets synchronously, from the thread
+ * which pushes them (the demuxer thread). When many streams are decoded in the
+ * same process, this would run one decoding thread per stream: the decoders
+ * may instead be attached to a pool, so that the packets are queued and
+ * decoded by a fixed number of worker threads.
+ *
+ * The packets of a decoder are decoded in order, by at most one worker at a
+ * time. The decoders are served in round-robin.
+ */
+
+// Maximum number of packets queued per decoder before the pusher blocks
+#define SC_DECODER_POOL_QUEUE_MAX 16
+
+struct sc_decoder;
+
+struct sc_decoder_pool {
+    sc_thread *threads;
+    unsigned thread_count;
+
+    sc_mutex mutex;
+    unsigned slot_count; // the number of decoders attached
+    sc_cond cond; // signaled when a decoder is ready, or on stop
+    bool stopped;
+    // The decoders having packets to decode, not currently decoded by a worker
+    struct sc_decoder_pool_ready_queue SC_VECDEQUE(struct sc_decoder *) ready;
+};
+
+// The per-decoder state, protected by the pool mutex
+struct sc_decoder_pool_slot {
+    struct sc_decoder_pool_packet_queue SC_VECDEQUE(AVPacket *) queue;
+    sc_cond queue_cond; // signaled when packets are consumed
+    bool scheduled; // in the ready queue or currently decoded
+    bool failed;
+};
+
+// If thread_count is 0, use the number of CPU cores
+bool
+sc_decoder_pool_init(struct sc_decoder_pool *pool, unsigned thread_count);
+
+void
+sc_decoder_pool_destroy(struct sc_decoder_pool *pool);
+
+bool
+sc_decoder_pool_start(struct sc_decoder_pool *pool);
+
+// It must be called once all the decoders are closed
+void
+sc_decoder_pool_stop(struct sc_decoder_pool *pool);
+
+void
+sc_decoder_pool_join(struct sc_decoder_pool *pool);
+
+// Called by the decoder on open
+bool
+sc_decoder_pool_slot_init(struct sc_decoder_pool *pool,
+                          struct sc_decoder_pool_slot *slot);
+
+// Called by the decoder on close, once flushed
+void
+sc_decoder_pool_slot_destroy(struct sc_decoder_pool *pool,
+                             struct sc_decoder_pool_slot *slot);
+
+/**
+ * Queue a packet to be decoded by a worker
+ *
+ * It blocks while SC_DECODER_POOL_QUEUE_MAX packets are queued for this
+ * decoder. Return false if a previous packet failed to decode.
+ */
+bool
+sc_decoder_pool_push(struct sc_decoder_pool *pool, struct sc_decoder *decoder,
+                     const AVPacket *packet);
+
+// Wait until all the packets queued for this decoder are decoded
+void
+sc_decoder_pool_flush(struct sc_decoder_pool *pool,
+                      struct sc_decoder *decoder);
+
+#endif
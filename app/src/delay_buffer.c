@@ -221,6 +221,20 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
     return true;
 }
 
+static bool
+sc_delay_buffer_frame_sink_is_active(struct sc_frame_sink *sink) {
+    struct sc_delay_buffer *db = DOWNCAST(sink);
+
+    // The delayed frames are only needed if the sinks need them
+    return sc_frame_source_sinks_are_active(&db->frame_source);
+}
+
+static bool
+sc_delay_buffer_frame_sink_is_low_res(struct sc_frame_sink *sink) {
+    struct sc_delay_buffer *db = DOWNCAST(sink);
+    return sc_frame_source_sinks_are_low_res(&db->frame_source);
+}
+
 void
 sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
                      bool first_frame_asap) {
@@ -235,6 +249,8 @@ sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
         .open = sc_delay_buffer_frame_sink_open,
         .close = sc_delay_buffer_frame_sink_close,
         .push = sc_delay_buffer_frame_sink_push,
+        .is_active = sc_delay_buffer_frame_sink_is_active,
+        .is_low_res = sc_delay_buffer_frame_sink_is_low_res,
     };
 
     db->frame_sink.ops = &ops;
@@ -2,15 +2,18 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <string.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/channel_layout.h>
 
-#include "packet_merger.h"
 #include "util/binary.h"
 #include "util/log.h"
 
 #define SC_PACKET_HEADER_SIZE 12
 
+// Large enough to receive many small (audio) packets with a single recv() call
+#define SC_DEMUXER_READER_SIZE (1 << 16) // 64k
+
 #define SC_PACKET_FLAG_CONFIG    (UINT64_C(1) << 63)
 #define SC_PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
 
@@ -51,29 +54,113 @@ sc_demuxer_to_avcodec_id(uint32_t codec_id) {
     }
 }
 
+static bool
+sc_demuxer_recv(struct sc_demuxer *demuxer, uint8_t *buf, size_t len) {
+    if (demuxer->replay) {
+        return sc_stream_replay_reader_read(&demuxer->replay_reader, buf, len);
+    }
+
+    ssize_t r = sc_net_reader_recv_all(&demuxer->reader, buf, len);
+    if (r < 0 || (size_t) r < len) {
+        return false;
+    }
+
+    if (demuxer->capture) {
+        sc_stream_capture_write(demuxer->capture, demuxer->stream, buf, len);
+    }
+
+    return true;
+}
+
+// Make `len` contiguous bytes available, to be parsed in place then consumed
+// by sc_demuxer_consume()
+//
+// From a socket, the bytes are parsed directly from the reader buffer.
+static const uint8_t *
+sc_demuxer_peek(struct sc_demuxer *demuxer, size_t len) {
+    if (demuxer->replay) {
+        assert(len <= sizeof(demuxer->replay_buf));
+        bool ok = sc_stream_replay_reader_read(&demuxer->replay_reader,
+                                               demuxer->replay_buf, len);
+        return ok ? demuxer->replay_buf : NULL;
+    }
+
+    return sc_net_reader_peek(&demuxer->reader, len);
+}
+
+static void
+sc_demuxer_consume(struct sc_demuxer *demuxer, size_t len) {
+    if (demuxer->replay) {
+        // Already read from the replay
+        return;
+    }
+
+    if (demuxer->capture) {
+        const uint8_t *data = sc_net_reader_data(&demuxer->reader);
+        sc_stream_capture_write(demuxer->capture, demuxer->stream, data, len);
+    }
+
+    sc_net_reader_consume(&demuxer->reader, len);
+}
+
 static bool
 sc_demuxer_recv_codec_id(struct sc_demuxer *demuxer, uint32_t *codec_id) {
-    uint8_t data[4];
-    ssize_t r = net_recv_all(demuxer->socket, data, 4);
-    if (r < 4) {
+    const uint8_t *data = sc_demuxer_peek(demuxer, 4);
+    if (!data) {
         return false;
     }
 
     *codec_id = sc_read32be(data);
+    sc_demuxer_consume(demuxer, 4);
     return true;
 }
 
 static bool
 sc_demuxer_recv_video_size(struct sc_demuxer *demuxer, uint32_t *width,
                            uint32_t *height) {
-    uint8_t data[8];
-    ssize_t r = net_recv_all(demuxer->socket, data, 8);
-    if (r < 8) {
+    const uint8_t *data = sc_demuxer_peek(demuxer, 8);
+    if (!data) {
         return false;
     }
 
     *width = sc_read32be(data);
     *height = sc_read32be(data + 4);
+    sc_demuxer_consume(demuxer, 8);
+    return true;
+}
+
+static void
+sc_demuxer_set_packet_flags(AVPacket *packet, uint64_t pts_flags) {
+    if (pts_flags & SC_PACKET_FLAG_CONFIG) {
+        packet->pts = AV_NOPTS_VALUE;
+    } else {
+        packet->pts = pts_flags & SC_PACKET_PTS_MASK;
+    }
+
+    if (pts_flags & SC_PACKET_FLAG_KEY_FRAME) {
+        packet->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    packet->dts = packet->pts;
+}
+
+// Allocate a packet for a payload of len bytes, preceded by the headroom
+// required to prepend the pending config packet (if any) without moving the
+// payload
+static bool
+sc_demuxer_alloc_packet(struct sc_demuxer *demuxer, AVPacket *packet,
+                        uint64_t pts_flags, uint32_t len, size_t *headroom) {
+    size_t size = 0;
+    if (demuxer->must_merge_config_packet
+            && !(pts_flags & SC_PACKET_FLAG_CONFIG)) {
+        size = sc_packet_merger_get_headroom(&demuxer->merger);
+    }
+
+    if (!sc_packet_pool_alloc(&demuxer->pool, packet, size + len)) {
+        return false;
+    }
+
+    *headroom = size;
     return true;
 }
 
@@ -99,68 +186,48 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     // | `- key frame
     //  `-- config packet
 
-    uint8_t header[SC_PACKET_HEADER_SIZE];
-    ssize_t r = net_recv_all(demuxer->socket, header, SC_PACKET_HEADER_SIZE);
-    if (r < SC_PACKET_HEADER_SIZE) {
+    const uint8_t *header = sc_demuxer_peek(demuxer, SC_PACKET_HEADER_SIZE);
+    if (!header) {
         return false;
     }
 
     uint64_t pts_flags = sc_read64be(header);
     uint32_t len = sc_read32be(&header[8]);
     assert(len);
+    sc_demuxer_consume(demuxer, SC_PACKET_HEADER_SIZE);
 
-    if (av_new_packet(packet, len)) {
-        LOG_OOM();
+    size_t headroom;
+    if (!sc_demuxer_alloc_packet(demuxer, packet, pts_flags, len, &headroom)) {
+        // Error already logged
         return false;
     }
 
-    r = net_recv_all(demuxer->socket, packet->data, len);
-    if (r < 0 || ((uint32_t) r) < len) {
+    if (!sc_demuxer_recv(demuxer, packet->data + headroom, len)) {
         av_packet_unref(packet);
         return false;
     }
 
-    if (pts_flags & SC_PACKET_FLAG_CONFIG) {
-        packet->pts = AV_NOPTS_VALUE;
-    } else {
-        packet->pts = pts_flags & SC_PACKET_PTS_MASK;
-    }
-
-    if (pts_flags & SC_PACKET_FLAG_KEY_FRAME) {
-        packet->flags |= AV_PKT_FLAG_KEY;
-    }
-
-    packet->dts = packet->pts;
+    sc_demuxer_set_packet_flags(packet, pts_flags);
     return true;
 }
 
-static int
-run_demuxer(void *data) {
-    struct sc_demuxer *demuxer = data;
-
-    // Flag to report end-of-stream (i.e. device disconnected)
-    enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
-
-    uint32_t raw_codec_id;
-    bool ok = sc_demuxer_recv_codec_id(demuxer, &raw_codec_id);
-    if (!ok) {
-        LOGE("Demuxer '%s': stream disabled due to connection error",
-             demuxer->name);
-        goto end;
-    }
-
+// Return NULL if the stream must not be demuxed (the status is set)
+static const AVCodec *
+sc_demuxer_find_codec(struct sc_demuxer *demuxer, uint32_t raw_codec_id,
+                      enum sc_demuxer_status *status) {
     if (raw_codec_id == 0) {
         LOGW("Demuxer '%s': stream explicitly disabled by the device",
              demuxer->name);
         sc_packet_source_sinks_disable(&demuxer->packet_source);
-        status = SC_DEMUXER_STATUS_DISABLED;
-        goto end;
+        *status = SC_DEMUXER_STATUS_DISABLED;
+        return NULL;
     }
 
     if (raw_codec_id == 1) {
         LOGE("Demuxer '%s': stream configuration error on the device",
              demuxer->name);
-        goto end;
+        *status = SC_DEMUXER_STATUS_ERROR;
+        return NULL;
     }
 
     enum AVCodecID codec_id = sc_demuxer_to_avcodec_id(raw_codec_id);
@@ -168,7 +235,8 @@ run_demuxer(void *data) {
         LOGE("Demuxer '%s': stream disabled due to unsupported codec",
              demuxer->name);
         sc_packet_source_sinks_disable(&demuxer->packet_source);
-        goto end;
+        *status = SC_DEMUXER_STATUS_ERROR;
+        return NULL;
     }
 
     const AVCodec *codec = avcodec_find_decoder(codec_id);
@@ -176,28 +244,42 @@ run_demuxer(void *data) {
         LOGE("Demuxer '%s': stream disabled due to missing decoder",
              demuxer->name);
         sc_packet_source_sinks_disable(&demuxer->packet_source);
-        goto end;
+        *status = SC_DEMUXER_STATUS_ERROR;
+        return NULL;
     }
 
+    return codec;
+}
+
+// The width and height are only used for video streams
+static bool
+sc_demuxer_open_stream(struct sc_demuxer *demuxer, const AVCodec *codec,
+                       uint32_t raw_codec_id, uint32_t width,
+                       uint32_t height) {
     AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
     if (!codec_ctx) {
         LOG_OOM();
-        goto end;
+        return false;
     }
 
     codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
 
     if (codec->type == AVMEDIA_TYPE_VIDEO) {
-        uint32_t width;
-        uint32_t height;
-        ok = sc_demuxer_recv_video_size(demuxer, &width, &height);
-        if (!ok) {
-            goto finally_free_context;
-        }
-
         codec_ctx->width = width;
         codec_ctx->height = height;
         codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+
+        codec_ctx->thread_count = demuxer->decoder_thread_count;
+        if (demuxer->decoder_thread_type == SC_VIDEO_DECODER_THREAD_TYPE_FRAME
+                && demuxer->decoder_thread_count != 1) {
+            // Frame threading delays the output by (thread_count - 1) frames,
+            // and libavcodec disables it in low delay mode
+            codec_ctx->thread_type = FF_THREAD_FRAME;
+            codec_ctx->flags &= ~AV_CODEC_FLAG_LOW_DELAY;
+        } else {
+            // Slice threading does not add latency
+            codec_ctx->thread_type = FF_THREAD_SLICE;
+        }
     } else {
         // Hardcoded audio properties
 #ifdef SCRCPY_LAVU_HAS_CHLAYOUT
@@ -216,72 +298,389 @@ run_demuxer(void *data) {
 
     if (avcodec_open2(codec_ctx, codec, NULL) < 0) {
         LOGE("Demuxer '%s': could not open codec", demuxer->name);
-        goto finally_free_context;
+        goto error_free_context;
+    }
+
+    if (codec->type == AVMEDIA_TYPE_VIDEO && codec_ctx->thread_count != 1) {
+        const char *type = codec_ctx->active_thread_type == FF_THREAD_FRAME
+                         ? "frame"
+                         : codec_ctx->active_thread_type == FF_THREAD_SLICE
+                         ? "slice"
+                         : "no";
+        LOGI("Demuxer '%s': decoding with %d threads (%s threading)",
+             demuxer->name, codec_ctx->thread_count, type);
     }
 
     if (!sc_packet_source_sinks_open(&demuxer->packet_source, codec_ctx)) {
-        goto finally_free_context;
+        goto error_free_context;
+    }
+
+    demuxer->packet = av_packet_alloc();
+    if (!demuxer->packet) {
+        LOG_OOM();
+        goto error_close_sinks;
     }
 
     // Config packets must be merged with the next non-config packet only for
     // H.26x
-    bool must_merge_config_packet = raw_codec_id == SC_CODEC_ID_H264
-                                 || raw_codec_id == SC_CODEC_ID_H265;
+    demuxer->must_merge_config_packet = raw_codec_id == SC_CODEC_ID_H264
+                                     || raw_codec_id == SC_CODEC_ID_H265;
+    if (demuxer->must_merge_config_packet) {
+        sc_packet_merger_init(&demuxer->merger);
+    }
 
-    struct sc_packet_merger merger;
+    sc_packet_pool_init(&demuxer->pool);
+    demuxer->codec_ctx = codec_ctx;
 
-    if (must_merge_config_packet) {
-        sc_packet_merger_init(&merger);
+    return true;
+
+error_close_sinks:
+    sc_packet_source_sinks_close(&demuxer->packet_source);
+error_free_context:
+    avcodec_free_context(&codec_ctx);
+
+    return false;
+}
+
+static void
+sc_demuxer_close_stream(struct sc_demuxer *demuxer) {
+    LOGD("Demuxer '%s': end of frames", demuxer->name);
+    sc_packet_pool_log_stats(&demuxer->pool, demuxer->name);
+
+    if (demuxer->must_merge_config_packet) {
+        sc_packet_merger_destroy(&demuxer->merger);
     }
 
-    AVPacket *packet = av_packet_alloc();
-    if (!packet) {
-        LOG_OOM();
-        goto finally_close_sinks;
+    av_packet_free(&demuxer->packet);
+    sc_packet_pool_destroy(&demuxer->pool);
+    sc_packet_source_sinks_close(&demuxer->packet_source);
+    avcodec_free_context(&demuxer->codec_ctx);
+}
+
+// Push the received packet to the sinks
+static bool
+sc_demuxer_push_packet(struct sc_demuxer *demuxer) {
+    AVPacket *packet = demuxer->packet;
+
+    if (demuxer->must_merge_config_packet) {
+        // Prepend any config packet to the next media packet
+        bool ok = sc_packet_merger_merge(&demuxer->merger, packet);
+        if (!ok) {
+            av_packet_unref(packet);
+            return false;
+        }
+    }
+
+    bool ok = sc_packet_source_sinks_push(&demuxer->packet_source, packet);
+    av_packet_unref(packet);
+    // On error, the sink already logged its concrete error
+    return ok;
+}
+
+static bool
+sc_demuxer_open_input(struct sc_demuxer *demuxer) {
+    if (demuxer->replay) {
+        return sc_stream_replay_reader_init(&demuxer->replay_reader,
+                                            demuxer->replay, demuxer->stream);
+    }
+
+    return sc_net_reader_init(&demuxer->reader, demuxer->socket,
+                              SC_DEMUXER_READER_SIZE);
+}
+
+static void
+sc_demuxer_close_input(struct sc_demuxer *demuxer) {
+    if (demuxer->replay) {
+        sc_stream_replay_reader_destroy(&demuxer->replay_reader);
+    } else {
+        sc_net_reader_destroy(&demuxer->reader);
+    }
+}
+
+static int
+run_demuxer(void *data) {
+    struct sc_demuxer *demuxer = data;
+
+    // Flag to report end-of-stream (i.e. device disconnected)
+    enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
+
+    bool ok = sc_demuxer_open_input(demuxer);
+    if (!ok) {
+        goto end;
+    }
+
+    uint32_t raw_codec_id;
+    ok = sc_demuxer_recv_codec_id(demuxer, &raw_codec_id);
+    if (!ok) {
+        LOGE("Demuxer '%s': stream disabled due to connection error",
+             demuxer->name);
+        goto finally_close_input;
+    }
+
+    const AVCodec *codec =
+        sc_demuxer_find_codec(demuxer, raw_codec_id, &status);
+    if (!codec) {
+        goto finally_close_input;
+    }
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (codec->type == AVMEDIA_TYPE_VIDEO) {
+        ok = sc_demuxer_recv_video_size(demuxer, &width, &height);
+        if (!ok) {
+            goto finally_close_input;
+        }
+    }
+
+    ok = sc_demuxer_open_stream(demuxer, codec, raw_codec_id, width, height);
+    if (!ok) {
+        goto finally_close_input;
     }
 
     for (;;) {
-        bool ok = sc_demuxer_recv_packet(demuxer, packet);
+        ok = sc_demuxer_recv_packet(demuxer, demuxer->packet);
         if (!ok) {
             // end of stream
             status = SC_DEMUXER_STATUS_EOS;
             break;
         }
 
-        if (must_merge_config_packet) {
-            // Prepend any config packet to the next media packet
-            ok = sc_packet_merger_merge(&merger, packet);
-            if (!ok) {
-                av_packet_unref(packet);
+        ok = sc_demuxer_push_packet(demuxer);
+        if (!ok) {
+            break;
+        }
+    }
+
+    sc_demuxer_close_stream(demuxer);
+finally_close_input:
+    sc_demuxer_close_input(demuxer);
+end:
+    demuxer->cbs->on_ended(demuxer, status, demuxer->cbs_userdata);
+
+    return 0;
+}
+
+#ifdef HAVE_IO_LOOP
+static void
+sc_demuxer_end_io(struct sc_demuxer *demuxer, enum sc_demuxer_status status) {
+    assert(!demuxer->io_ended);
+
+    sc_io_loop_remove(demuxer->io_loop, &demuxer->watch);
+
+    if (demuxer->io_state == SC_DEMUXER_IO_STATE_PACKET_DATA) {
+        // Release the partially received packet
+        av_packet_unref(demuxer->packet);
+    }
+
+    if (demuxer->io_state >= SC_DEMUXER_IO_STATE_PACKET_HEADER) {
+        sc_demuxer_close_stream(demuxer);
+    }
+
+    sc_demuxer_close_input(demuxer);
+    demuxer->io_ended = true;
+
+    demuxer->cbs->on_ended(demuxer, status, demuxer->cbs_userdata);
+}
+
+// Process the buffered bytes, return false if the demuxer must stop
+static bool
+sc_demuxer_process_io(struct sc_demuxer *demuxer,
+                      enum sc_demuxer_status *status) {
+    struct sc_net_reader *reader = &demuxer->reader;
+
+    for (;;) {
+        const uint8_t *data = sc_net_reader_data(reader);
+
+        switch (demuxer->io_state) {
+            case SC_DEMUXER_IO_STATE_CODEC_ID: {
+                if (reader->size < 4) {
+                    return true;
+                }
+
+                uint32_t raw_codec_id = sc_read32be(data);
+                sc_net_reader_consume(reader, 4);
+
+                const AVCodec *codec =
+                    sc_demuxer_find_codec(demuxer, raw_codec_id, status);
+                if (!codec) {
+                    return false;
+                }
+
+                demuxer->codec = codec;
+                demuxer->raw_codec_id = raw_codec_id;
+
+                if (codec->type == AVMEDIA_TYPE_VIDEO) {
+                    demuxer->io_state = SC_DEMUXER_IO_STATE_VIDEO_SIZE;
+                    break;
+                }
+
+                if (!sc_demuxer_open_stream(demuxer, codec, raw_codec_id, 0,
+                                            0)) {
+                    *status = SC_DEMUXER_STATUS_ERROR;
+                    return false;
+                }
+
+                demuxer->io_state = SC_DEMUXER_IO_STATE_PACKET_HEADER;
+                break;
+            }
+            case SC_DEMUXER_IO_STATE_VIDEO_SIZE: {
+                if (reader->size < 8) {
+                    return true;
+                }
+
+                uint32_t width = sc_read32be(data);
+                uint32_t height = sc_read32be(&data[4]);
+                sc_net_reader_consume(reader, 8);
+
+                if (!sc_demuxer_open_stream(demuxer, demuxer->codec,
+                                            demuxer->raw_codec_id, width,
+                                            height)) {
+                    *status = SC_DEMUXER_STATUS_ERROR;
+                    return false;
+                }
+
+                demuxer->io_state = SC_DEMUXER_IO_STATE_PACKET_HEADER;
                 break;
             }
+            case SC_DEMUXER_IO_STATE_PACKET_HEADER:
+                // See sc_demuxer_recv_packet() for the header format
+                if (reader->size < SC_PACKET_HEADER_SIZE) {
+                    return true;
+                }
+
+                demuxer->pts_flags = sc_read64be(data);
+                demuxer->packet_len = sc_read32be(&data[8]);
+                sc_net_reader_consume(reader, SC_PACKET_HEADER_SIZE);
+                assert(demuxer->packet_len);
+
+                size_t headroom;
+                if (!sc_demuxer_alloc_packet(demuxer, demuxer->packet,
+                                             demuxer->pts_flags,
+                                             demuxer->packet_len, &headroom)) {
+                    *status = SC_DEMUXER_STATUS_ERROR;
+                    return false;
+                }
+
+                // The payload is received after the headroom
+                demuxer->packet_len += headroom;
+                demuxer->packet_offset = headroom;
+                demuxer->io_state = SC_DEMUXER_IO_STATE_PACKET_DATA;
+                break;
+            case SC_DEMUXER_IO_STATE_PACKET_DATA: {
+                uint32_t remaining =
+                    demuxer->packet_len - demuxer->packet_offset;
+                size_t n = MIN(reader->size, remaining);
+                memcpy(&demuxer->packet->data[demuxer->packet_offset], data,
+                       n);
+                sc_net_reader_consume(reader, n);
+                demuxer->packet_offset += n;
+
+                if (demuxer->packet_offset < demuxer->packet_len) {
+                    return true;
+                }
+
+                sc_demuxer_set_packet_flags(demuxer->packet,
+                                            demuxer->pts_flags);
+                demuxer->io_state = SC_DEMUXER_IO_STATE_PACKET_HEADER;
+
+                if (!sc_demuxer_push_packet(demuxer)) {
+                    *status = SC_DEMUXER_STATUS_ERROR;
+                    return false;
+                }
+                break;
+            }
+            default:
+                assert(!"unexpected demuxer state");
+                return false;
         }
+    }
+}
 
-        ok = sc_packet_source_sinks_push(&demuxer->packet_source, packet);
-        av_packet_unref(packet);
-        if (!ok) {
-            // The sink already logged its concrete error
-            break;
+static ssize_t
+sc_demuxer_recv_io(struct sc_demuxer *demuxer) {
+    struct sc_net_reader *reader = &demuxer->reader;
+
+    uint32_t remaining = demuxer->packet_len - demuxer->packet_offset;
+    if (demuxer->io_state == SC_DEMUXER_IO_STATE_PACKET_DATA
+            && !reader->size && remaining >= reader->cap / 2) {
+        // Large payload, receive directly into the packet
+        uint8_t *dst = &demuxer->packet->data[demuxer->packet_offset];
+        ssize_t r = net_recv(demuxer->socket, dst, remaining);
+        if (r > 0) {
+            if (demuxer->capture) {
+                sc_stream_capture_write(demuxer->capture, demuxer->stream,
+                                        dst, r);
+            }
+            demuxer->packet_offset += r;
         }
+        return r;
     }
 
-    LOGD("Demuxer '%s': end of frames", demuxer->name);
+    ssize_t r = sc_net_reader_fill(reader);
+    if (r > 0 && demuxer->capture) {
+        // The new bytes are at the end of the unread bytes
+        const uint8_t *data = sc_net_reader_data(reader) + reader->size - r;
+        sc_stream_capture_write(demuxer->capture, demuxer->stream, data, r);
+    }
+    return r;
+}
 
-    if (must_merge_config_packet) {
-        sc_packet_merger_destroy(&merger);
+static void
+sc_demuxer_on_io_event(struct sc_io_watch *watch, unsigned events) {
+    (void) events;
+    struct sc_demuxer *demuxer = container_of(watch, struct sc_demuxer, watch);
+
+    ssize_t r = sc_demuxer_recv_io(demuxer);
+    if (r == -1 && net_would_block()) {
+        // Spurious wakeup
+        return;
     }
 
-    av_packet_free(&packet);
-finally_close_sinks:
-    sc_packet_source_sinks_close(&demuxer->packet_source);
-finally_free_context:
-    avcodec_free_context(&codec_ctx);
-end:
-    demuxer->cbs->on_ended(demuxer, status, demuxer->cbs_userdata);
+    if (r <= 0) {
+        enum sc_demuxer_status status;
+        if (demuxer->io_state >= SC_DEMUXER_IO_STATE_PACKET_HEADER) {
+            status = SC_DEMUXER_STATUS_EOS;
+        } else {
+            LOGE("Demuxer '%s': stream disabled due to connection error",
+                 demuxer->name);
+            status = SC_DEMUXER_STATUS_ERROR;
+        }
+        sc_demuxer_end_io(demuxer, status);
+        return;
+    }
 
-    return 0;
+    enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
+    if (!sc_demuxer_process_io(demuxer, &status)) {
+        sc_demuxer_end_io(demuxer, status);
+    }
 }
 
+static bool
+sc_demuxer_start_io(struct sc_demuxer *demuxer) {
+    LOGD("Demuxer '%s': starting on the I/O loop", demuxer->name);
+
+    bool ok = sc_demuxer_open_input(demuxer);
+    if (!ok) {
+        return false;
+    }
+
+    demuxer->io_state = SC_DEMUXER_IO_STATE_CODEC_ID;
+    demuxer->packet_len = 0;
+    demuxer->packet_offset = 0;
+    demuxer->io_ended = false;
+
+    ok = sc_io_loop_add(demuxer->io_loop, &demuxer->watch, demuxer->socket,
+                        SC_IO_READABLE, sc_demuxer_on_io_event);
+    if (!ok) {
+        LOGE("Demuxer '%s': could not watch socket", demuxer->name);
+        sc_demuxer_close_input(demuxer);
+        return false;
+    }
+
+    return true;
+}
+#endif
+
 void
 sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
                 const struct sc_demuxer_callbacks *cbs, void *cbs_userdata) {
@@ -289,6 +688,13 @@ sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
 
     demuxer->name = name; // statically allocated
     demuxer->socket = socket;
+    demuxer->capture = NULL;
+    demuxer->replay = NULL;
+    demuxer->decoder_thread_count = 1;
+    demuxer->decoder_thread_type = SC_VIDEO_DECODER_THREAD_TYPE_AUTO;
+#ifdef HAVE_IO_LOOP
+    demuxer->io_loop = NULL;
+#endif
     sc_packet_source_init(&demuxer->packet_source);
 
     assert(cbs && cbs->on_ended);
@@ -297,8 +703,66 @@ sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
     demuxer->cbs_userdata = cbs_userdata;
 }
 
+void
+sc_demuxer_init_replay(struct sc_demuxer *demuxer, const char *name,
+                       struct sc_stream_replay *replay,
+                       enum sc_stream_capture_stream stream,
+                       const struct sc_demuxer_callbacks *cbs,
+                       void *cbs_userdata) {
+    assert(replay);
+
+    demuxer->name = name; // statically allocated
+    demuxer->socket = SC_SOCKET_NONE;
+    demuxer->stream = stream;
+    demuxer->capture = NULL;
+    demuxer->replay = replay;
+    demuxer->decoder_thread_count = 1;
+    demuxer->decoder_thread_type = SC_VIDEO_DECODER_THREAD_TYPE_AUTO;
+#ifdef HAVE_IO_LOOP
+    demuxer->io_loop = NULL;
+#endif
+    sc_packet_source_init(&demuxer->packet_source);
+
+    assert(cbs && cbs->on_ended);
+
+    demuxer->cbs = cbs;
+    demuxer->cbs_userdata = cbs_userdata;
+}
+
+void
+sc_demuxer_set_capture(struct sc_demuxer *demuxer,
+                       struct sc_stream_capture *capture,
+                       enum sc_stream_capture_stream stream) {
+    assert(!demuxer->replay);
+    demuxer->capture = capture;
+    demuxer->stream = stream;
+}
+
+void
+sc_demuxer_set_decoder_threads(struct sc_demuxer *demuxer,
+                               unsigned thread_count,
+                               enum sc_video_decoder_thread_type type) {
+    demuxer->decoder_thread_count = thread_count;
+    demuxer->decoder_thread_type = type;
+}
+
+#ifdef HAVE_IO_LOOP
+void
+sc_demuxer_set_io_loop(struct sc_demuxer *demuxer, struct sc_io_loop *loop) {
+    // A replayed stream is read from a file, which cannot be polled
+    assert(!demuxer->replay);
+    demuxer->io_loop = loop;
+}
+#endif
+
 bool
 sc_demuxer_start(struct sc_demuxer *demuxer) {
+#ifdef HAVE_IO_LOOP
+    if (demuxer->io_loop) {
+        return sc_demuxer_start_io(demuxer);
+    }
+#endif
+
     LOGD("Demuxer '%s': starting thread", demuxer->name);
 
     bool ok = sc_thread_create(&demuxer->thread, run_demuxer, "scrcpy-demuxer",
@@ -312,5 +776,15 @@ sc_demuxer_start(struct sc_demuxer *demuxer) {
 
 void
 sc_demuxer_join(struct sc_demuxer *demuxer) {
+#ifdef HAVE_IO_LOOP
+    if (demuxer->io_loop) {
+        // The loop is joined, so it is safe to end the stream from here
+        if (!demuxer->io_ended) {
+            sc_demuxer_end_io(demuxer, SC_DEMUXER_STATUS_EOS);
+        }
+        return;
+    }
+#endif
+
     sc_thread_join(&demuxer->thread, NULL);
 }
@@ -4,19 +4,70 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
 
+#include "options.h"
+#include "packet_merger.h"
+#include "packet_pool.h"
+#include "stream_capture.h"
 #include "trait/packet_source.h"
 #include "util/net.h"
 #include "util/thread.h"
+#ifdef HAVE_IO_LOOP
+# include "util/io_loop.h"
+#endif
+
+#ifdef HAVE_IO_LOOP
+enum sc_demuxer_io_state {
+    SC_DEMUXER_IO_STATE_CODEC_ID,
+    SC_DEMUXER_IO_STATE_VIDEO_SIZE,
+    SC_DEMUXER_IO_STATE_PACKET_HEADER,
+    SC_DEMUXER_IO_STATE_PACKET_DATA,
+};
+#endif
 
 struct sc_demuxer {
     struct sc_packet_source packet_source; // packet source trait
 
     const char *name; // must be statically allocated (e.g. a string literal)
 
-    sc_socket socket;
+    sc_socket socket; // SC_SOCKET_NONE if the stream is replayed
+    struct sc_net_reader reader; // initialized by the demuxer thread
     sc_thread thread;
 
+    enum sc_stream_capture_stream stream;
+    struct sc_stream_capture *capture; // NULL if not captured
+    struct sc_stream_replay *replay; // NULL if not replayed
+    // initialized by the demuxer thread
+    struct sc_stream_replay_reader replay_reader;
+    // The last header read from the replay (the packet header is the largest)
+    uint8_t replay_buf[12];
+
+    // Threading of the video decoder, applied when the codec is opened
+    unsigned decoder_thread_count; // 0 for the number of CPU cores
+    enum sc_video_decoder_thread_type decoder_thread_type;
+
+    // Owned by the demuxer thread (or the I/O loop) once the stream is open
+    AVCodecContext *codec_ctx;
+    bool must_merge_config_packet;
+    struct sc_packet_merger merger;
+    struct sc_packet_pool pool;
+    AVPacket *packet;
+
+#ifdef HAVE_IO_LOOP
+    struct sc_io_loop *io_loop; // NULL if the demuxer runs its own thread
+    struct sc_io_watch watch;
+    enum sc_demuxer_io_state io_state;
+    const AVCodec *codec; // set once the codec id is received
+    uint32_t raw_codec_id;
+    uint64_t pts_flags; // of the packet being received
+    uint32_t packet_len; // of the packet being received (headroom included)
+    uint32_t packet_offset; // number of bytes already written (headroom
+                            // included)
+    bool io_ended;
+#endif
+
     const struct sc_demuxer_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -37,9 +88,36 @@ void
 sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
                 const struct sc_demuxer_callbacks *cbs, void *cbs_userdata);
 
+// Read the stream from a capture file instead of a socket
+void
+sc_demuxer_init_replay(struct sc_demuxer *demuxer, const char *name,
+                       struct sc_stream_replay *replay,
+                       enum sc_stream_capture_stream stream,
+                       const struct sc_demuxer_callbacks *cbs,
+                       void *cbs_userdata);
+
+// Write all the bytes received from the socket to the capture
+void
+sc_demuxer_set_capture(struct sc_demuxer *demuxer,
+                       struct sc_stream_capture *capture,
+                       enum sc_stream_capture_stream stream);
+
+// Configure the threads used to decode a video stream (1 thread by default)
+void
+sc_demuxer_set_decoder_threads(struct sc_demuxer *demuxer,
+                               unsigned thread_count,
+                               enum sc_video_decoder_thread_type type);
+
+#ifdef HAVE_IO_LOOP
+// Demux the socket from the I/O loop instead of a dedicated thread
+void
+sc_demuxer_set_io_loop(struct sc_demuxer *demuxer, struct sc_io_loop *loop);
+#endif
+
 bool
 sc_demuxer_start(struct sc_demuxer *demuxer);
 
+// If an I/O loop is used, it must be stopped and joined first
 void
 sc_demuxer_join(struct sc_demuxer *demuxer);
 
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 #include <libavutil/pixfmt.h>
 
@@ -32,9 +33,54 @@ sc_display_init_novideo_icon(struct sc_display *display,
     return true;
 }
 
+static void
+sc_display_init_pbo(struct sc_display *display) {
+    struct sc_opengl *gl = &display->gl;
+
+    if (!sc_pbo_ring_is_supported(gl)) {
+        LOGW("PBO texture streaming disabled "
+             "(OpenGL 3.0+ or ES 3.0+ required)");
+        return;
+    }
+
+    // The context of the renderer is current just after its creation
+    display->pbo_context = SDL_GL_GetCurrentContext();
+    if (!display->pbo_context) {
+        LOGW("PBO texture streaming disabled (no current OpenGL context)");
+        return;
+    }
+
+    if (!sc_pbo_ring_init(&display->pbo_ring, gl)) {
+        return;
+    }
+
+    LOGI("PBO texture streaming enabled");
+    display->pbo = true;
+}
+
+// With several windows, another context may be current
+static void
+sc_display_make_pbo_context_current(struct sc_display *display) {
+    assert(display->pbo);
+    if (SDL_GL_GetCurrentContext() != display->pbo_context) {
+        SDL_Window *window = SDL_GetRenderWindow(display->renderer);
+        if (!SDL_GL_MakeCurrent(window, display->pbo_context)) {
+            LOGW("Could not make OpenGL context current: %s", SDL_GetError());
+        }
+    }
+}
+
+static void
+sc_display_disable_pbo(struct sc_display *display) {
+    assert(display->pbo);
+    sc_display_make_pbo_context_current(display);
+    sc_pbo_ring_destroy(&display->pbo_ring);
+    display->pbo = false;
+}
+
 bool
 sc_display_init(struct sc_display *display, SDL_Window *window,
-                SDL_Surface *icon_novideo, bool mipmaps) {
+                SDL_Surface *icon_novideo, bool mipmaps, bool pbo) {
     display->renderer = SDL_CreateRenderer(window, NULL);
     if (!display->renderer) {
         LOGE("Could not create renderer: %s", SDL_GetError());
@@ -45,6 +91,8 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
     LOGI("Renderer: %s", renderer_name ? renderer_name : "(unknown)");
 
     display->mipmaps = false;
+    display->pbo = false;
+    display->render_bench = false;
 
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
     display->gl_context = NULL;
@@ -52,6 +100,7 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
 
     // starts with "opengl"
     bool use_opengl = renderer_name && !strncmp(renderer_name, "opengl", 6);
+    display->opengl = use_opengl;
     if (use_opengl) {
 
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
@@ -91,10 +140,34 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
         } else {
             LOGI("Trilinear filtering disabled");
         }
+
+        if (pbo) {
+#ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
+            // The renderer does not use the context created above
+            LOGD("PBO texture streaming disabled (OpenGL Core Profile)");
+#else
+            sc_display_init_pbo(display);
+#endif
+        }
     } else if (mipmaps) {
         LOGD("Trilinear filtering disabled (not an OpenGL renderer)");
     }
 
+    display->low_res = false;
+    display->texture_low_res = false;
+    display->texture_size.width = 0;
+    display->texture_size.height = 0;
+    display->texture_upload = NULL;
+    display->texture_seq = 0;
+    sc_display_upload_init(&display->upload);
+
+    display->upload_stats.partial = 0;
+    display->upload_stats.full = 0;
+    display->upload_stats.frame_bytes = 0;
+    display->upload_stats.uploaded_bytes = 0;
+    display->update_stats.count = 0;
+    display->update_stats.duration = 0;
+
     display->texture = NULL;
     display->pending.flags = 0;
     display->pending.frame = NULL;
@@ -103,6 +176,9 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
         // Without video, set a static scrcpy icon as window content
         bool ok = sc_display_init_novideo_icon(display, icon_novideo);
         if (!ok) {
+            if (display->pbo) {
+                sc_display_disable_pbo(display);
+            }
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
             SDL_GL_DestroyContext(display->gl_context);
 #endif
@@ -114,11 +190,48 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
     return true;
 }
 
+static void
+sc_display_log_upload_stats(struct sc_display *display) {
+    uint64_t frame_bytes = display->upload_stats.frame_bytes;
+    if (!frame_bytes) {
+        return;
+    }
+
+    uint64_t uploaded_bytes = display->upload_stats.uploaded_bytes;
+    unsigned percent = uploaded_bytes * 100 / frame_bytes;
+    LOGI("Texture uploads: %" PRIu64_ " partial, %" PRIu64_ " full, %u%% of "
+         "the frame bytes uploaded", display->upload_stats.partial,
+         display->upload_stats.full, percent);
+}
+
+static void
+sc_display_log_update_stats(struct sc_display *display) {
+    uint64_t count = display->update_stats.count;
+    if (!count) {
+        return;
+    }
+
+    sc_tick avg = display->update_stats.duration / (sc_tick) count;
+    LOGD("Texture updates: %" PRIu64_ " frames, %" PRItick " us per frame on "
+         "average%s", count, SC_TICK_TO_US(avg),
+         display->pbo ? " (PBO streaming)" : "");
+}
+
 void
 sc_display_destroy(struct sc_display *display) {
+    sc_display_log_update_stats(display);
+    if (display->render_bench) {
+        sc_render_bench_log(&display->bench);
+        sc_render_bench_destroy(&display->bench);
+    }
+    if (display->pbo) {
+        sc_display_disable_pbo(display);
+    }
     if (display->pending.frame) {
         av_frame_free(&display->pending.frame);
     }
+    sc_display_log_upload_stats(display);
+    sc_display_upload_destroy(&display->upload);
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
     SDL_GL_DestroyContext(display->gl_context);
 #endif
@@ -151,10 +264,64 @@ sc_display_to_sdl_color_space(enum AVColorSpace color_space,
     }
 }
 
+static inline struct sc_size
+sc_display_get_low_res_size(struct sc_size size) {
+    return (struct sc_size) {
+        .width = (size.width + 1) / 2,
+        .height = (size.height + 1) / 2,
+    };
+}
+
+static bool
+sc_display_init_pbo_textures(struct sc_display *display,
+                             SDL_Texture *texture) {
+    // The properties belong to the texture, they must not be destroyed
+    SDL_PropertiesID props = SDL_GetTextureProperties(texture);
+    if (!props) {
+        LOGE("Could not get texture properties: %s", SDL_GetError());
+        return false;
+    }
+
+    const char *renderer_name = SDL_GetRendererName(display->renderer);
+    bool opengl = !renderer_name || !strcmp(renderer_name, "opengl");
+
+    // A YUV texture is implemented by one OpenGL texture per plane
+    int64_t y = SDL_GetNumberProperty(props, opengl
+                            ? SDL_PROP_TEXTURE_OPENGL_TEXTURE_NUMBER
+                            : SDL_PROP_TEXTURE_OPENGLES2_TEXTURE_NUMBER, 0);
+    int64_t u = SDL_GetNumberProperty(props, opengl
+                            ? SDL_PROP_TEXTURE_OPENGL_TEXTURE_U_NUMBER
+                            : SDL_PROP_TEXTURE_OPENGLES2_TEXTURE_U_NUMBER, 0);
+    int64_t v = SDL_GetNumberProperty(props, opengl
+                            ? SDL_PROP_TEXTURE_OPENGL_TEXTURE_V_NUMBER
+                            : SDL_PROP_TEXTURE_OPENGLES2_TEXTURE_V_NUMBER, 0);
+    int64_t target = SDL_GetNumberProperty(props, opengl
+                        ? SDL_PROP_TEXTURE_OPENGL_TEXTURE_TARGET_NUMBER
+                        : SDL_PROP_TEXTURE_OPENGLES2_TEXTURE_TARGET_NUMBER,
+                        GL_TEXTURE_2D);
+    if (!y || !u || !v) {
+        LOGE("Could not get the texture ids of the planes");
+        return false;
+    }
+
+    display->pbo_textures[0] = y;
+    display->pbo_textures[1] = u;
+    display->pbo_textures[2] = v;
+    display->pbo_target = target;
+    return true;
+}
+
+// The size is the frame size (the texture may be smaller in low resolution
+// mode)
 static SDL_Texture *
 sc_display_create_texture(struct sc_display *display,
                           struct sc_size size, enum AVColorSpace color_space,
-                          enum AVColorRange color_range) {
+                          enum AVColorRange color_range, bool low_res) {
+    struct sc_size frame_size = size;
+    if (low_res) {
+        size = sc_display_get_low_res_size(size);
+    }
+
     SDL_PropertiesID props = SDL_CreateProperties();
     if (!props) {
         return NULL;
@@ -225,6 +392,16 @@ sc_display_create_texture(struct sc_display *display,
         gl->BindTexture(GL_TEXTURE_2D, 0);
     }
 
+    if (display->pbo && !sc_display_init_pbo_textures(display, texture)) {
+        LOGW("PBO texture streaming disabled");
+        sc_display_disable_pbo(display);
+    }
+
+    display->texture_low_res = low_res;
+    display->texture_size = frame_size;
+    LOGI("Texture: %" PRIu16 "x%" PRIu16 "%s", size.width, size.height,
+         low_res ? " (low resolution)" : "");
+
     return texture;
 }
 
@@ -260,10 +437,29 @@ sc_display_set_pending_frame(struct sc_display *display, const AVFrame *frame) {
     return true;
 }
 
+// Wait for the completion of the current stage, and record its duration
+//
+// Return the end date of the stage (the start date of the next one).
+static sc_tick
+sc_display_end_bench_stage(struct sc_display *display,
+                           enum sc_render_bench_stage stage, sc_tick start) {
+    assert(display->render_bench);
+
+    // Submit the commands batched by SDL, then wait for their execution
+    SDL_FlushRenderer(display->renderer);
+    if (display->opengl) {
+        display->gl.Finish();
+    }
+
+    sc_tick now = sc_tick_now();
+    sc_render_bench_add(&display->bench, stage, now - start);
+    return now;
+}
+
 // Forward declaration
 static bool
 sc_display_update_texture_internal(struct sc_display *display,
-                                   const AVFrame *frame);
+                                   const struct sc_display_upload *upload);
 
 static bool
 sc_display_apply_pending(struct sc_display *display) {
@@ -273,7 +469,8 @@ sc_display_apply_pending(struct sc_display *display) {
             sc_display_create_texture(display,
                                       display->pending.texture.size,
                                       display->pending.texture.color_space,
-                                      display->pending.texture.color_range);
+                                      display->pending.texture.color_range,
+                                      display->low_res);
         if (!display->texture) {
             return false;
         }
@@ -283,8 +480,11 @@ sc_display_apply_pending(struct sc_display *display) {
 
     if (display->pending.flags & SC_DISPLAY_PENDING_FLAG_FRAME) {
         assert(display->pending.frame);
-        bool ok = sc_display_update_texture_internal(display,
-                                                     display->pending.frame);
+        bool ok = sc_display_upload_prepare(&display->upload,
+                                            display->pending.frame,
+                                            display->low_res)
+               && sc_display_update_texture_internal(display,
+                                                     &display->upload);
         if (!ok) {
             return false;
         }
@@ -300,20 +500,24 @@ static bool
 sc_display_prepare_texture_internal(struct sc_display *display,
                                     struct sc_size size,
                                     enum AVColorSpace color_space,
-                                    enum AVColorRange color_range) {
+                                    enum AVColorRange color_range,
+                                    bool low_res) {
     assert(size.width && size.height);
 
     if (display->texture) {
         SDL_DestroyTexture(display->texture);
     }
 
+    // The content of the new texture is undefined
+    display->texture_upload = NULL;
+
     display->texture =
-            sc_display_create_texture(display, size, color_space, color_range);
+            sc_display_create_texture(display, size, color_space, color_range,
+                                      low_res);
     if (!display->texture) {
         return false;
     }
 
-    LOGI("Texture: %" PRIu16 "x%" PRIu16, size.width, size.height);
     return true;
 }
 
@@ -322,7 +526,8 @@ sc_display_prepare_texture(struct sc_display *display, struct sc_size size,
                            enum AVColorSpace color_space,
                            enum AVColorRange color_range) {
     bool ok = sc_display_prepare_texture_internal(display, size, color_space,
-                                                  color_range);
+                                                  color_range,
+                                                  display->low_res);
     if (!ok) {
         sc_display_set_pending_texture(display, size, color_range);
         return SC_DISPLAY_RESULT_PENDING;
@@ -332,18 +537,335 @@ sc_display_prepare_texture(struct sc_display *display, struct sc_size size,
     return SC_DISPLAY_RESULT_OK;
 }
 
+// Downscale a plane by 2 in both dimensions (each destination pixel is the
+// average of 2x2 source pixels)
+static void
+sc_display_downscale_plane(uint8_t *dst, unsigned dst_width,
+                           unsigned dst_height, const uint8_t *src,
+                           int src_linesize, unsigned src_width,
+                           unsigned src_height) {
+    unsigned even_width = src_width / 2;
+    for (unsigned y = 0; y < dst_height; ++y) {
+        const uint8_t *row0 = src + (size_t) 2 * y * src_linesize;
+        // If the height is odd, the last row is duplicated
+        const uint8_t *row1 = 2 * y + 1 < src_height ? row0 + src_linesize
+                                                     : row0;
+        uint8_t *out = dst + (size_t) y * dst_width;
+
+        // Simple loop, so that the compiler can vectorize it
+        for (unsigned x = 0; x < even_width; ++x) {
+            out[x] = (row0[2 * x] + row0[2 * x + 1]
+                    + row1[2 * x] + row1[2 * x + 1] + 2) >> 2;
+        }
+
+        if (dst_width > even_width) {
+            // If the width is odd, the last column is duplicated
+            unsigned x = even_width;
+            out[x] = (row0[2 * x] + row1[2 * x] + 1) >> 1;
+        }
+    }
+}
+
+// Update the whole texture from the planes of a frame of the given size
+static bool
+sc_display_update_texture_planes(struct sc_display *display,
+                                 struct sc_size size,
+                                 const uint8_t *y, int y_linesize,
+                                 const uint8_t *u, int u_linesize,
+                                 const uint8_t *v, int v_linesize) {
+    if (display->pbo) {
+        struct sc_size chroma_size = sc_display_get_low_res_size(size);
+        const struct sc_pbo_ring_plane planes[] = {
+            {display->pbo_textures[0], y, y_linesize,
+             size.width, size.height},
+            {display->pbo_textures[1], u, u_linesize,
+             chroma_size.width, chroma_size.height},
+            {display->pbo_textures[2], v, v_linesize,
+             chroma_size.width, chroma_size.height},
+        };
+
+        sc_display_make_pbo_context_current(display);
+        // Execute the pending render commands before using OpenGL directly,
+        // and invalidate the OpenGL state cached by SDL
+        SDL_FlushRenderer(display->renderer);
+
+        // The planes are stored in luminance textures by SDL
+        bool ok = sc_pbo_ring_upload(&display->pbo_ring, display->pbo_target,
+                                     GL_LUMINANCE, planes, ARRAY_LEN(planes));
+        if (ok) {
+            return true;
+        }
+
+        LOGW("PBO texture streaming failed, disabling it");
+        sc_display_disable_pbo(display);
+    }
+
+    return SDL_UpdateYUVTexture(display->texture, NULL, y, y_linesize,
+                                u, u_linesize, v, v_linesize);
+}
+
+void
+sc_display_upload_init(struct sc_display_upload *upload) {
+    upload->frame = NULL;
+    upload->seq = 0;
+    upload->low_res = false;
+    upload->low_res_buffer = NULL;
+    upload->low_res_buffer_size = 0;
+    upload->partial_upload = 0;
+    upload->partial = false;
+    upload->prev_frame = NULL;
+    upload->has_prev_frame = false;
+}
+
+void
+sc_display_upload_destroy(struct sc_display_upload *upload) {
+    if (upload->prev_frame) {
+        av_frame_free(&upload->prev_frame);
+    }
+    free(upload->low_res_buffer);
+}
+
+bool
+sc_display_upload_set_partial(struct sc_display_upload *upload,
+                              uint8_t max_percent) {
+    assert(max_percent <= 100);
+    assert(!upload->prev_frame);
+
+    if (!max_percent) {
+        return true;
+    }
+
+    upload->prev_frame = av_frame_alloc();
+    if (!upload->prev_frame) {
+        LOG_OOM();
+        return false;
+    }
+
+    struct sc_tile_diff_impl impl = sc_tile_diff_get_best_impl();
+    LOGD("Partial texture upload (max %u%% changed, %s)", max_percent,
+         impl.name);
+
+    sc_frame_diff_init(&upload->diff, impl.fn);
+    upload->partial_upload = max_percent;
+    return true;
+}
+
+static void
+sc_display_upload_reset_prev_frame(struct sc_display_upload *upload) {
+    if (upload->has_prev_frame) {
+        av_frame_unref(upload->prev_frame);
+        upload->has_prev_frame = false;
+    }
+}
+
+static bool
+sc_display_upload_downscale(struct sc_display_upload *upload,
+                            const AVFrame *frame) {
+    struct sc_size size = {frame->width, frame->height};
+    struct sc_size chroma_size = sc_display_get_low_res_size(size);
+    struct sc_size dst_size = chroma_size;
+    struct sc_size dst_chroma_size = sc_display_get_low_res_size(chroma_size);
+
+    size_t luma_len = (size_t) dst_size.width * dst_size.height;
+    size_t chroma_len = (size_t) dst_chroma_size.width
+                               * dst_chroma_size.height;
+    size_t len = luma_len + 2 * chroma_len;
+    if (len > upload->low_res_buffer_size) {
+        uint8_t *buf = realloc(upload->low_res_buffer, len);
+        if (!buf) {
+            LOG_OOM();
+            return false;
+        }
+        upload->low_res_buffer = buf;
+        upload->low_res_buffer_size = len;
+    }
+
+    uint8_t *y = upload->low_res_buffer;
+    uint8_t *u = y + luma_len;
+    uint8_t *v = u + chroma_len;
+
+    sc_display_downscale_plane(y, dst_size.width, dst_size.height,
+                               frame->data[0], frame->linesize[0],
+                               size.width, size.height);
+    sc_display_downscale_plane(u, dst_chroma_size.width,
+                               dst_chroma_size.height, frame->data[1],
+                               frame->linesize[1], chroma_size.width,
+                               chroma_size.height);
+    sc_display_downscale_plane(v, dst_chroma_size.width,
+                               dst_chroma_size.height, frame->data[2],
+                               frame->linesize[2], chroma_size.width,
+                               chroma_size.height);
+
+    upload->low_res_data[0] = y;
+    upload->low_res_data[1] = u;
+    upload->low_res_data[2] = v;
+    upload->low_res_linesize[0] = dst_size.width;
+    upload->low_res_linesize[1] = dst_chroma_size.width;
+    upload->low_res_linesize[2] = dst_chroma_size.width;
+    return true;
+}
+
+bool
+sc_display_upload_prepare(struct sc_display_upload *upload,
+                          const AVFrame *frame, bool low_res) {
+    upload->frame = frame;
+    ++upload->seq;
+    upload->low_res = low_res;
+    upload->partial = false;
+
+    if (low_res) {
+        // The changes are only detected between full resolution frames
+        sc_display_upload_reset_prev_frame(upload);
+        return sc_display_upload_downscale(upload, frame);
+    }
+
+    if (!upload->partial_upload) {
+        return true;
+    }
+
+    assert(upload->prev_frame);
+    AVFrame *prev = upload->prev_frame;
+
+    upload->partial = upload->has_prev_frame
+                   && prev->width == frame->width
+                   && prev->height == frame->height
+                   && sc_frame_diff_compute(&upload->diff, prev, frame,
+                                            upload->partial_upload);
+
+    // Keep a reference to the frame, to compare the next one
+    sc_display_upload_reset_prev_frame(upload);
+    int r = av_frame_ref(prev, frame);
+    if (r) {
+        // Not fatal, the next frame will be uploaded entirely
+        LOGW("Could not ref frame: %d", r);
+    } else {
+        upload->has_prev_frame = true;
+    }
+
+    return true;
+}
+
+static bool
+sc_display_update_texture_full(struct sc_display *display,
+                               const AVFrame *frame) {
+    struct sc_size size = {frame->width, frame->height};
+    return sc_display_update_texture_planes(display, size,
+                                            frame->data[0], frame->linesize[0],
+                                            frame->data[1], frame->linesize[1],
+                                            frame->data[2], frame->linesize[2]);
+}
+
+static bool
+sc_display_update_texture_rect(struct sc_display *display,
+                               const AVFrame *frame,
+                               const struct sc_frame_diff_rect *rect) {
+    // The rects are aligned on the tile grid, so x and y are even
+    assert(!(rect->x & 1) && !(rect->y & 1));
+    unsigned cx = rect->x / 2;
+    unsigned cy = rect->y / 2;
+
+    const uint8_t *y = frame->data[0]
+                     + (ptrdiff_t) rect->y * frame->linesize[0] + rect->x;
+    const uint8_t *u = frame->data[1]
+                     + (ptrdiff_t) cy * frame->linesize[1] + cx;
+    const uint8_t *v = frame->data[2]
+                     + (ptrdiff_t) cy * frame->linesize[2] + cx;
+
+    SDL_Rect sdl_rect = {
+        .x = rect->x,
+        .y = rect->y,
+        .w = rect->width,
+        .h = rect->height,
+    };
+    return SDL_UpdateYUVTexture(display->texture, &sdl_rect,
+                                y, frame->linesize[0],
+                                u, frame->linesize[1],
+                                v, frame->linesize[2]);
+}
+
+static bool
+sc_display_update_texture_partial(struct sc_display *display,
+                                  const struct sc_display_upload *upload) {
+    const AVFrame *frame = upload->frame;
+
+    // The changes are relative to the previous preparation, they may only be
+    // applied if the texture contains it
+    bool partial = upload->partial
+                && display->texture_upload == upload
+                && display->texture_seq + 1 == upload->seq;
+    bool ok;
+    if (partial) {
+        const struct sc_frame_diff *diff = &upload->diff;
+        ok = true;
+        for (unsigned i = 0; ok && i < diff->rect_count; ++i) {
+            ok = sc_display_update_texture_rect(display, frame,
+                                                &diff->rects[i]);
+        }
+
+        ++display->upload_stats.partial;
+        display->upload_stats.uploaded_bytes += diff->dirty_bytes;
+    } else {
+        ok = sc_display_update_texture_full(display, frame);
+
+        uint64_t frame_bytes = sc_frame_diff_get_frame_bytes(frame);
+        ++display->upload_stats.full;
+        display->upload_stats.uploaded_bytes += frame_bytes;
+    }
+    display->upload_stats.frame_bytes += sc_frame_diff_get_frame_bytes(frame);
+
+    return ok;
+}
+
 static bool
 sc_display_update_texture_internal(struct sc_display *display,
-                                   const AVFrame *frame) {
-    bool ok = SDL_UpdateYUVTexture(display->texture, NULL,
-                                   frame->data[0], frame->linesize[0],
-                                   frame->data[1], frame->linesize[1],
-                                   frame->data[2], frame->linesize[2]);
+                                   const struct sc_display_upload *upload) {
+    const AVFrame *frame = upload->frame;
+    struct sc_size size = {frame->width, frame->height};
+
+    if (display->texture_low_res != upload->low_res
+            || display->texture_size.width != size.width
+            || display->texture_size.height != size.height) {
+        bool ok = sc_display_prepare_texture_internal(display, size,
+                                                      frame->colorspace,
+                                                      frame->color_range,
+                                                      upload->low_res);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    sc_tick start = sc_tick_now();
+
+    bool ok;
+    if (upload->low_res) {
+        struct sc_size low_res_size = sc_display_get_low_res_size(size);
+        ok = sc_display_update_texture_planes(display, low_res_size,
+                                              upload->low_res_data[0],
+                                              upload->low_res_linesize[0],
+                                              upload->low_res_data[1],
+                                              upload->low_res_linesize[1],
+                                              upload->low_res_data[2],
+                                              upload->low_res_linesize[2]);
+    } else if (upload->partial_upload) {
+        ok = sc_display_update_texture_partial(display, upload);
+    } else {
+        ok = sc_display_update_texture_full(display, frame);
+    }
     if (!ok) {
         LOGD("Could not update texture: %s", SDL_GetError());
+        display->texture_upload = NULL;
         return false;
     }
 
+    display->texture_upload = upload;
+    display->texture_seq = upload->seq;
+
+    if (display->render_bench) {
+        start = sc_display_end_bench_stage(display,
+                                           SC_RENDER_BENCH_STAGE_UPLOAD,
+                                           start);
+    }
+
     if (display->mipmaps) {
         assert(display->texture_id);
         struct sc_opengl *gl = &display->gl;
@@ -351,16 +873,25 @@ sc_display_update_texture_internal(struct sc_display *display,
         gl->BindTexture(GL_TEXTURE_2D, display->texture_id);
         gl->GenerateMipmap(GL_TEXTURE_2D);
         gl->BindTexture(GL_TEXTURE_2D, 0);
+
+        if (display->render_bench) {
+            sc_display_end_bench_stage(display, SC_RENDER_BENCH_STAGE_MIPMAP,
+                                       start);
+        }
     }
 
     return true;
 }
 
 enum sc_display_result
-sc_display_update_texture(struct sc_display *display, const AVFrame *frame) {
-    bool ok = sc_display_update_texture_internal(display, frame);
+sc_display_upload(struct sc_display *display,
+                  const struct sc_display_upload *upload) {
+    sc_tick start = sc_tick_now();
+    bool ok = sc_display_update_texture_internal(display, upload);
+    display->update_stats.duration += sc_tick_now() - start;
+    ++display->update_stats.count;
     if (!ok) {
-        ok = sc_display_set_pending_frame(display, frame);
+        ok = sc_display_set_pending_frame(display, upload->frame);
         if (!ok) {
             LOGE("Could not set pending frame");
             return SC_DISPLAY_RESULT_ERROR;
@@ -372,6 +903,51 @@ sc_display_update_texture(struct sc_display *display, const AVFrame *frame) {
     return SC_DISPLAY_RESULT_OK;
 }
 
+enum sc_display_result
+sc_display_update_texture(struct sc_display *display, const AVFrame *frame) {
+    bool ok = sc_display_upload_prepare(&display->upload, frame,
+                                        display->low_res);
+    if (!ok) {
+        return SC_DISPLAY_RESULT_ERROR;
+    }
+
+    return sc_display_upload(display, &display->upload);
+}
+
+bool
+sc_display_set_vsync(struct sc_display *display, bool enabled) {
+    bool ok = SDL_SetRenderVSync(display->renderer, enabled ? 1 : 0);
+    if (!ok) {
+        LOGW("Could not %s vsync: %s", enabled ? "enable" : "disable",
+             SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+bool
+sc_display_set_low_res(struct sc_display *display, bool low_res) {
+    if (display->low_res == low_res) {
+        return false;
+    }
+
+    display->low_res = low_res;
+    return true;
+}
+
+bool
+sc_display_set_partial_upload(struct sc_display *display,
+                              uint8_t max_percent) {
+    return sc_display_upload_set_partial(&display->upload, max_percent);
+}
+
+void
+sc_display_enable_render_bench(struct sc_display *display) {
+    sc_render_bench_init(&display->bench);
+    display->render_bench = true;
+}
+
 enum sc_display_result
 sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
                   enum sc_orientation orientation) {
@@ -384,6 +960,9 @@ sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
         }
     }
 
+    // The pending frame upload, if any, is measured separately
+    sc_tick start = sc_tick_now();
+
     SDL_Renderer *renderer = display->renderer;
     SDL_Texture *texture = display->texture;
 
@@ -420,6 +999,18 @@ sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
         }
     }
 
+    if (display->render_bench) {
+        start = sc_display_end_bench_stage(display,
+                                           SC_RENDER_BENCH_STAGE_RENDER,
+                                           start);
+    }
+
     sc_sdl_render_present(display->renderer);
+
+    if (display->render_bench) {
+        sc_display_end_bench_stage(display, SC_RENDER_BENCH_STAGE_PRESENT,
+                                   start);
+    }
+
     return SC_DISPLAY_RESULT_OK;
 }
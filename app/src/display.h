@@ -9,17 +9,51 @@
 #include <SDL3/SDL.h>
 
 #include "coords.h"
+#include "frame_diff.h"
 #include "opengl.h"
 #include "options.h"
+#include "pbo_ring.h"
+#include "render_bench.h"
+#include "util/tick.h"
 
 #ifdef __APPLE__
 # define SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
 #endif
 
+/**
+ * CPU-side part of a texture update
+ *
+ * Downscaling the frame (in low resolution mode) and detecting the regions
+ * which changed since the previous frame (with partial upload) do not access
+ * the renderer, so sc_display_upload_prepare() may be called from any thread.
+ *
+ * The texture is then updated from the main thread by sc_display_upload().
+ */
+struct sc_display_upload {
+    const AVFrame *frame; // the prepared frame (not owned)
+    uint64_t seq; // incremented on every preparation
+
+    // If set, the planes to upload are the frame downscaled by 2
+    bool low_res;
+    uint8_t *low_res_data[3];
+    int low_res_linesize[3];
+    uint8_t *low_res_buffer;
+    size_t low_res_buffer_size;
+
+    // If non-zero, only the regions which changed since the previous frame
+    // are uploaded, unless more than this percentage of the frame changed
+    uint8_t partial_upload;
+    bool partial; // only the regions of diff changed
+    struct sc_frame_diff diff;
+    AVFrame *prev_frame; // the previous prepared frame (if partial_upload)
+    bool has_prev_frame;
+};
+
 struct sc_display {
     SDL_Renderer *renderer;
     SDL_Texture *texture;
 
+    bool opengl; // the renderer is an OpenGL (ES) renderer
     struct sc_opengl gl;
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
     SDL_GLContext gl_context;
@@ -28,6 +62,44 @@ struct sc_display {
     bool mipmaps;
     uint32_t texture_id; // only set if mipmaps is enabled
 
+    // If set, the frames are streamed to the textures through a ring of pixel
+    // buffer objects
+    bool pbo;
+    struct sc_pbo_ring pbo_ring;
+    SDL_GLContext pbo_context; // the OpenGL context of the renderer
+    GLenum pbo_target; // target of the textures
+    GLuint pbo_textures[3]; // Y, U and V textures of the current texture
+
+    // If set, the frames are uploaded at half their resolution (the texture is
+    // recreated on the next update if needed)
+    bool low_res;
+    bool texture_low_res; // the resolution of the current texture
+    struct sc_size texture_size; // the frame size of the current texture
+    // The last upload applied to the texture (NULL if the texture content is
+    // unknown), so that only the changes of the next preparation are uploaded
+    const struct sc_display_upload *texture_upload;
+    uint64_t texture_seq;
+
+    // The uploads prepared by sc_display_update_texture()
+    struct sc_display_upload upload;
+
+    struct {
+        uint64_t partial; // number of partial uploads
+        uint64_t full; // number of full uploads
+        uint64_t frame_bytes; // total size of the frames
+        uint64_t uploaded_bytes; // total size actually uploaded
+    } upload_stats;
+
+    // Time spent in texture updates
+    struct {
+        uint64_t count;
+        sc_tick duration;
+    } update_stats;
+
+    // If set, the duration of each stage is measured (--render-bench)
+    bool render_bench;
+    struct sc_render_bench bench;
+
     struct {
 #define SC_DISPLAY_PENDING_FLAG_TEXTURE 1
 #define SC_DISPLAY_PENDING_FLAG_FRAME 2
@@ -49,7 +121,7 @@ enum sc_display_result {
 
 bool
 sc_display_init(struct sc_display *display, SDL_Window *window,
-                SDL_Surface *icon_novideo, bool mipmaps);
+                SDL_Surface *icon_novideo, bool mipmaps, bool pbo);
 
 void
 sc_display_destroy(struct sc_display *display);
@@ -59,9 +131,60 @@ sc_display_prepare_texture(struct sc_display *display, struct sc_size size,
                            enum AVColorSpace color_space,
                            enum AVColorRange color_range);
 
+// Prepare and upload the frame (from the main thread)
 enum sc_display_result
 sc_display_update_texture(struct sc_display *display, const AVFrame *frame);
 
+void
+sc_display_upload_init(struct sc_display_upload *upload);
+
+void
+sc_display_upload_destroy(struct sc_display_upload *upload);
+
+// Only detect the changes when less than `max_percent` of the frame changed
+bool
+sc_display_upload_set_partial(struct sc_display_upload *upload,
+                              uint8_t max_percent);
+
+// Prepare the upload of a frame, which must remain valid until it is uploaded
+//
+// It may be called from any thread.
+bool
+sc_display_upload_prepare(struct sc_display_upload *upload,
+                          const AVFrame *frame, bool low_res);
+
+// Upload a prepared frame (from the main thread)
+//
+// If the texture does not contain the previous frame of the same upload (for
+// example if a preparation was not uploaded), the whole frame is uploaded.
+enum sc_display_result
+sc_display_upload(struct sc_display *display,
+                  const struct sc_display_upload *upload);
+
+// Synchronize the presents with the display refresh
+bool
+sc_display_set_vsync(struct sc_display *display, bool enabled);
+
+// Upload the next frames at half their resolution (to be used when the content
+// is rendered downscaled by more than 2)
+//
+// Return true if the mode changed: the current frame must then be updated.
+bool
+sc_display_set_low_res(struct sc_display *display, bool low_res);
+
+// Only upload the regions which changed since the previous frame, unless more
+// than `max_percent` of the frame changed
+bool
+sc_display_set_partial_upload(struct sc_display *display, uint8_t max_percent);
+
+// Measure the duration of each stage of the frame updates and renders, and log
+// their percentiles on destroy
+//
+// The OpenGL commands are executed synchronously at the end of each stage, so
+// that the work of the GPU is attributed to the right stage.
+void
+sc_display_enable_render_bench(struct sc_display *display);
+
 enum sc_display_result
 sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
                   enum sc_orientation orientation);
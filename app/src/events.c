@@ -7,8 +7,17 @@
 
 bool
 sc_push_event_impl(uint32_t type, const char *name) {
-    SDL_Event event;
-    event.type = type;
+    return sc_push_event_with_data_impl(type, NULL, name);
+}
+
+bool
+sc_push_event_with_data_impl(uint32_t type, void *data, const char *name) {
+    SDL_Event event = {
+        .user = {
+            .type = type,
+            .data1 = data,
+        },
+    };
     bool ok = SDL_PushEvent(&event);
     if (!ok) {
         LOGE("Could not post %s event: %s", name, SDL_GetError());
@@ -9,6 +9,8 @@
 
 enum {
     SC_EVENT_NEW_FRAME = SDL_EVENT_USER,
+    SC_EVENT_PRESENT_FRAME,
+    SC_EVENT_FRAME_PREPARED,
     SC_EVENT_RUN_ON_MAIN_THREAD,
     SC_EVENT_DEVICE_DISCONNECTED,
     SC_EVENT_SERVER_CONNECTION_FAILED,
@@ -26,6 +28,14 @@ sc_push_event_impl(uint32_t type, const char *name);
 
 #define sc_push_event(TYPE) sc_push_event_impl(TYPE, # TYPE)
 
+// Push an event with a pointer available in event.user.data1 (for example to
+// identify the component it relates to)
+bool
+sc_push_event_with_data_impl(uint32_t type, void *data, const char *name);
+
+#define sc_push_event_with_data(TYPE, DATA) \
+    sc_push_event_with_data_impl(TYPE, DATA, # TYPE)
+
 typedef void (*sc_runnable_fn)(void *userdata);
 
 bool
@@ -48,7 +48,10 @@ static void
 display_fps(struct sc_fps_counter *counter) {
     unsigned rendered_per_second =
         counter->nr_rendered * SC_TICK_FREQ / SC_FPS_COUNTER_INTERVAL;
-    if (counter->nr_skipped) {
+    if (counter->nr_dropped) {
+        LOGI("%u fps (+%u frames skipped, +%u frames dropped to catch up)",
+             rendered_per_second, counter->nr_skipped, counter->nr_dropped);
+    } else if (counter->nr_skipped) {
         LOGI("%u fps (+%u frames skipped)", rendered_per_second,
                                             counter->nr_skipped);
     } else {
@@ -66,6 +69,7 @@ check_interval_expired(struct sc_fps_counter *counter, sc_tick now) {
     display_fps(counter);
     counter->nr_rendered = 0;
     counter->nr_skipped = 0;
+    counter->nr_dropped = 0;
     // add a multiple of the interval
     uint32_t elapsed_slices =
         (now - counter->next_timestamp) / SC_FPS_COUNTER_INTERVAL + 1;
@@ -101,6 +105,7 @@ sc_fps_counter_start(struct sc_fps_counter *counter) {
     counter->next_timestamp = sc_tick_now() + SC_FPS_COUNTER_INTERVAL;
     counter->nr_rendered = 0;
     counter->nr_skipped = 0;
+    counter->nr_dropped = 0;
     sc_mutex_unlock(&counter->mutex);
 
     set_started(counter, true);
@@ -184,3 +189,16 @@ sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter) {
     ++counter->nr_skipped;
     sc_mutex_unlock(&counter->mutex);
 }
+
+void
+sc_fps_counter_add_dropped_frame(struct sc_fps_counter *counter) {
+    if (!is_started(counter)) {
+        return;
+    }
+
+    sc_mutex_lock(&counter->mutex);
+    sc_tick now = sc_tick_now();
+    check_interval_expired(counter, now);
+    ++counter->nr_dropped;
+    sc_mutex_unlock(&counter->mutex);
+}
@@ -24,6 +24,7 @@ struct sc_fps_counter {
     bool interrupted;
     unsigned nr_rendered;
     unsigned nr_skipped;
+    unsigned nr_dropped; // by the decoder, to catch up
     sc_tick next_timestamp;
 };
 
@@ -56,4 +57,8 @@ sc_fps_counter_add_rendered_frame(struct sc_fps_counter *counter);
 void
 sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter);
 
+// A frame dropped by the decoder to catch up (never decoded)
+void
+sc_fps_counter_add_dropped_frame(struct sc_fps_counter *counter);
+
 #endif
@@ -4,85 +4,78 @@
 
 #include "util/log.h"
 
+#define SC_FRAME_BUFFER_INDEX_MASK 0x3
+// Flag set on fb->pending when the pending frame has not been consumed
+#define SC_FRAME_BUFFER_NEW 0x4
+
 bool
 sc_frame_buffer_init(struct sc_frame_buffer *fb) {
-    fb->pending_frame = av_frame_alloc();
-    if (!fb->pending_frame) {
-        LOG_OOM();
-        return false;
-    }
-
-    fb->tmp_frame = av_frame_alloc();
-    if (!fb->tmp_frame) {
-        LOG_OOM();
-        av_frame_free(&fb->pending_frame);
-        return false;
-    }
-
-    bool ok = sc_mutex_init(&fb->mutex);
-    if (!ok) {
-        av_frame_free(&fb->pending_frame);
-        av_frame_free(&fb->tmp_frame);
-        return false;
+    for (unsigned i = 0; i < 3; ++i) {
+        fb->frames[i] = av_frame_alloc();
+        if (!fb->frames[i]) {
+            LOG_OOM();
+            while (i) {
+                av_frame_free(&fb->frames[--i]);
+            }
+            return false;
+        }
     }
 
+    fb->back = 0;
+    fb->front = 1;
     // there is initially no frame, so consider it has already been consumed
-    fb->pending_frame_consumed = true;
+    atomic_init(&fb->pending, 2);
 
     return true;
 }
 
 void
 sc_frame_buffer_destroy(struct sc_frame_buffer *fb) {
-    sc_mutex_destroy(&fb->mutex);
-    av_frame_free(&fb->pending_frame);
-    av_frame_free(&fb->tmp_frame);
-}
-
-static inline void
-swap_frames(AVFrame **lhs, AVFrame **rhs) {
-    AVFrame *tmp = *lhs;
-    *lhs = *rhs;
-    *rhs = tmp;
+    for (unsigned i = 0; i < 3; ++i) {
+        av_frame_free(&fb->frames[i]);
+    }
 }
 
 bool
 sc_frame_buffer_push(struct sc_frame_buffer *fb, const AVFrame *frame,
                      bool *previous_frame_skipped) {
-    // Use a temporary frame to preserve pending_frame in case of error.
-    // tmp_frame is an empty frame, no need to call av_frame_unref() beforehand.
-    int r = av_frame_ref(fb->tmp_frame, frame);
+    // The back frame is empty (it is unreferenced after each exchange), and on
+    // error, the pending frame is preserved
+    AVFrame *back = fb->frames[fb->back];
+    int r = av_frame_ref(back, frame);
     if (r) {
         LOGE("Could not ref frame: %d", r);
         return false;
     }
 
-    sc_mutex_lock(&fb->mutex);
+    // Publish the back frame (release) and take ownership of the previous
+    // pending frame (acquire)
+    unsigned previous =
+        atomic_exchange_explicit(&fb->pending, fb->back | SC_FRAME_BUFFER_NEW,
+                                 memory_order_acq_rel);
+    fb->back = previous & SC_FRAME_BUFFER_INDEX_MASK;
 
-    // Now that av_frame_ref() succeeded, we can replace the previous
-    // pending_frame
-    swap_frames(&fb->pending_frame, &fb->tmp_frame);
-    av_frame_unref(fb->tmp_frame);
+    // Release the skipped frame (if any) immediately rather than on the next
+    // push
+    av_frame_unref(fb->frames[fb->back]);
 
     if (previous_frame_skipped) {
-        *previous_frame_skipped = !fb->pending_frame_consumed;
+        *previous_frame_skipped = previous & SC_FRAME_BUFFER_NEW;
     }
-    fb->pending_frame_consumed = false;
-
-    sc_mutex_unlock(&fb->mutex);
 
     return true;
 }
 
 void
 sc_frame_buffer_consume(struct sc_frame_buffer *fb, AVFrame *dst) {
-    sc_mutex_lock(&fb->mutex);
-    assert(!fb->pending_frame_consumed);
-    fb->pending_frame_consumed = true;
-
-    av_frame_move_ref(dst, fb->pending_frame);
+    // Give back the front frame (emptied by the previous consume) and take
+    // ownership of the pending frame
+    unsigned previous =
+        atomic_exchange_explicit(&fb->pending, fb->front, memory_order_acq_rel);
+    assert(previous & SC_FRAME_BUFFER_NEW);
+    fb->front = previous & SC_FRAME_BUFFER_INDEX_MASK;
+
+    av_frame_move_ref(dst, fb->frames[fb->front]);
     // av_frame_move_ref() resets its source frame, so no need to call
     // av_frame_unref()
-
-    sc_mutex_unlock(&fb->mutex);
 }
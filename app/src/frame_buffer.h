@@ -3,11 +3,10 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <libavutil/frame.h>
 
-#include "util/thread.h"
-
 // forward declarations
 typedef struct AVFrame AVFrame;
 
@@ -18,15 +17,21 @@ typedef struct AVFrame AVFrame;
  * If a pending frame has not been consumed when the producer pushes a new
  * frame, then it is lost. The intent is to always provide access to the very
  * last frame to minimize latency.
+ *
+ * It is implemented as a lock-free triple buffer, for 1 producer thread and 1
+ * consumer thread: the producer writes to its "back" frame, the consumer reads
+ * from its "front" frame, and each of them exchanges its frame with the
+ * pending frame by a single atomic operation.
  */
 
 struct sc_frame_buffer {
-    AVFrame *pending_frame;
-    AVFrame *tmp_frame; // To preserve the pending frame on error
-
-    sc_mutex mutex;
+    AVFrame *frames[3];
+    unsigned back; // only accessed by the producer
+    unsigned front; // only accessed by the consumer
 
-    bool pending_frame_consumed;
+    // The index of the pending frame, with the SC_FRAME_BUFFER_NEW flag if it
+    // has not been consumed yet
+    atomic_uint pending;
 };
 
 bool
@@ -0,0 +1,134 @@
+#include "frame_diff.h"
+
+#include <assert.h>
+
+void
+sc_frame_diff_init(struct sc_frame_diff *diff, sc_tile_diff_fn *tile_diff) {
+    diff->tile_diff = tile_diff;
+    diff->rect_count = 0;
+    diff->frame_bytes = 0;
+    diff->dirty_bytes = 0;
+}
+
+// Number of bytes covered by a luma rect over the 3 planes
+static uint64_t
+sc_frame_diff_get_bytes(unsigned x, unsigned y, unsigned width,
+                        unsigned height) {
+    unsigned chroma_width = (x + width + 1) / 2 - x / 2;
+    unsigned chroma_height = (y + height + 1) / 2 - y / 2;
+    return (uint64_t) width * height
+         + 2 * (uint64_t) chroma_width * chroma_height;
+}
+
+uint64_t
+sc_frame_diff_get_frame_bytes(const AVFrame *frame) {
+    return sc_frame_diff_get_bytes(0, 0, frame->width, frame->height);
+}
+
+static inline bool
+sc_frame_diff_plane_changed(struct sc_frame_diff *diff, const AVFrame *prev,
+                            const AVFrame *frame, unsigned plane, unsigned x,
+                            unsigned y, unsigned width, unsigned height) {
+    const uint8_t *a = prev->data[plane]
+                     + (ptrdiff_t) y * prev->linesize[plane] + x;
+    const uint8_t *b = frame->data[plane]
+                     + (ptrdiff_t) y * frame->linesize[plane] + x;
+    return diff->tile_diff(a, prev->linesize[plane], b, frame->linesize[plane],
+                           width, height);
+}
+
+static bool
+sc_frame_diff_tile_changed(struct sc_frame_diff *diff, const AVFrame *prev,
+                           const AVFrame *frame, unsigned x, unsigned y,
+                           unsigned width, unsigned height) {
+    if (sc_frame_diff_plane_changed(diff, prev, frame, 0, x, y, width,
+                                    height)) {
+        return true;
+    }
+
+    unsigned cx = x / 2;
+    unsigned cy = y / 2;
+    unsigned cw = (x + width + 1) / 2 - cx;
+    unsigned ch = (y + height + 1) / 2 - cy;
+    return sc_frame_diff_plane_changed(diff, prev, frame, 1, cx, cy, cw, ch)
+        || sc_frame_diff_plane_changed(diff, prev, frame, 2, cx, cy, cw, ch);
+}
+
+// Add a horizontal run of changed tiles
+static bool
+sc_frame_diff_add_run(struct sc_frame_diff *diff, unsigned x, unsigned y,
+                      unsigned width, unsigned height) {
+    diff->dirty_bytes += sc_frame_diff_get_bytes(x, y, width, height);
+
+    // Extend the rect ending just above, if it covers the same columns
+    for (unsigned i = 0; i < diff->rect_count; ++i) {
+        struct sc_frame_diff_rect *rect = &diff->rects[i];
+        if (rect->x == x && rect->width == width
+                && rect->y + rect->height == y) {
+            rect->height += height;
+            return true;
+        }
+    }
+
+    if (diff->rect_count == SC_FRAME_DIFF_MAX_RECTS) {
+        return false;
+    }
+
+    diff->rects[diff->rect_count++] = (struct sc_frame_diff_rect) {
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height,
+    };
+    return true;
+}
+
+bool
+sc_frame_diff_compute(struct sc_frame_diff *diff, const AVFrame *prev,
+                      const AVFrame *frame, unsigned max_percent) {
+    assert(prev->width == frame->width);
+    assert(prev->height == frame->height);
+    assert(max_percent <= 100);
+
+    unsigned frame_width = frame->width;
+    unsigned frame_height = frame->height;
+
+    diff->rect_count = 0;
+    diff->frame_bytes = sc_frame_diff_get_frame_bytes(frame);
+    diff->dirty_bytes = 0;
+    uint64_t max_bytes = diff->frame_bytes * max_percent / 100;
+
+    for (unsigned y = 0; y < frame_height; y += SC_FRAME_DIFF_TILE_SIZE) {
+        unsigned height = MIN(SC_FRAME_DIFF_TILE_SIZE, frame_height - y);
+
+        bool in_run = false;
+        unsigned run_x = 0;
+        for (unsigned x = 0; x < frame_width; x += SC_FRAME_DIFF_TILE_SIZE) {
+            unsigned width = MIN(SC_FRAME_DIFF_TILE_SIZE, frame_width - x);
+            bool changed = sc_frame_diff_tile_changed(diff, prev, frame, x, y,
+                                                      width, height);
+            if (changed && !in_run) {
+                run_x = x;
+                in_run = true;
+            } else if (!changed && in_run) {
+                if (!sc_frame_diff_add_run(diff, run_x, y, x - run_x,
+                                           height)) {
+                    return false;
+                }
+                in_run = false;
+            }
+        }
+
+        if (in_run && !sc_frame_diff_add_run(diff, run_x, y,
+                                             frame_width - run_x, height)) {
+            return false;
+        }
+
+        if (diff->dirty_bytes > max_bytes) {
+            // Too many changes, do not compare the remaining tiles
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef SC_FRAME_DIFF_H
+#define SC_FRAME_DIFF_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavutil/frame.h>
+
+#include "util/tile_diff.h"
+
+// In luma pixels (the chroma tiles of YUV 4:2:0 frames are 32x32)
+#define SC_FRAME_DIFF_TILE_SIZE 64
+// Beyond this number of rectangles, the whole frame is considered changed
+#define SC_FRAME_DIFF_MAX_RECTS 32
+
+// In luma pixels, aligned on the tile grid (except at the right and bottom
+// edges of the frame)
+struct sc_frame_diff_rect {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+};
+
+/**
+ * Detection of the regions which changed between two consecutive YUV 4:2:0
+ * frames, to upload only these regions to the texture
+ *
+ * The frames are compared by tiles of SC_FRAME_DIFF_TILE_SIZE luma pixels
+ * (over the Y, U and V planes). The changed tiles of a tile row are merged
+ * into horizontal runs, which are merged with the identical runs of the
+ * previous tile rows.
+ */
+struct sc_frame_diff {
+    sc_tile_diff_fn *tile_diff;
+
+    struct sc_frame_diff_rect rects[SC_FRAME_DIFF_MAX_RECTS];
+    unsigned rect_count;
+
+    // Number of bytes (over the 3 planes) of the frame and of the rects
+    uint64_t frame_bytes;
+    uint64_t dirty_bytes;
+};
+
+void
+sc_frame_diff_init(struct sc_frame_diff *diff, sc_tile_diff_fn *tile_diff);
+
+// Get the size of a YUV 4:2:0 frame, in bytes (over the 3 planes)
+uint64_t
+sc_frame_diff_get_frame_bytes(const AVFrame *frame);
+
+/**
+ * Compute the regions of `frame` which differ from `prev`
+ *
+ * Both frames must be YUV 4:2:0 frames of the same size.
+ *
+ * Return false if more than `max_percent` of the frame changed (or if there
+ * are too many rects): the whole frame must then be uploaded. Otherwise,
+ * diff->rects contains the changed regions (possibly none).
+ */
+bool
+sc_frame_diff_compute(struct sc_frame_diff *diff, const AVFrame *prev,
+                      const AVFrame *frame, unsigned max_percent);
+
+#endif
@@ -0,0 +1,103 @@
+#include "frame_pacer.h"
+
+#include <assert.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+// Tolerance to consider a present on time, if the refresh period is unknown
+#define SC_FRAME_PACER_DEFAULT_TOLERANCE SC_TICK_FROM_MS(2)
+
+void
+sc_frame_pacer_init(struct sc_frame_pacer *pacer, sc_tick budget) {
+    assert(budget >= 0);
+    pacer->budget = budget;
+    pacer->period = 0;
+    pacer->last_vblank = 0;
+    sc_clock_init(&pacer->clock);
+    pacer->target = 0;
+
+    pacer->stats.presented = 0;
+    pacer->stats.early = 0;
+    pacer->stats.late = 0;
+    pacer->stats.dropped = 0;
+    pacer->stats.error_sum = 0;
+}
+
+void
+sc_frame_pacer_set_refresh_rate(struct sc_frame_pacer *pacer,
+                                float refresh_rate) {
+    sc_tick period = refresh_rate > 0 ? SC_TICK_FREQ / refresh_rate : 0;
+    if (period != pacer->period) {
+        LOGD("Frame pacing: refresh period %" PRItick " us", period);
+        pacer->period = period;
+    }
+}
+
+// Round to the nearest integer (a / b), for any sign of a (b > 0)
+static inline sc_tick
+div_round(sc_tick a, sc_tick b) {
+    assert(b > 0);
+    return a >= 0 ? (a + b / 2) / b : -((-a + b / 2) / b);
+}
+
+sc_tick
+sc_frame_pacer_schedule(struct sc_frame_pacer *pacer, sc_tick now,
+                        sc_tick pts) {
+    sc_clock_update(&pacer->clock, now, pts);
+    sc_tick target = sc_clock_to_system_time(&pacer->clock, pts)
+                   + pacer->budget;
+    pacer->target = target;
+
+    if (!pacer->period || !pacer->last_vblank) {
+        // The vblanks are unknown, render at the target time
+        return target;
+    }
+
+    sc_tick period = pacer->period;
+    sc_tick n = div_round(target - pacer->last_vblank, period);
+    sc_tick vblank = pacer->last_vblank + n * period;
+
+    // The present blocks until the next vblank, so render during the
+    // preceding refresh interval
+    return vblank - period;
+}
+
+void
+sc_frame_pacer_on_vblank(struct sc_frame_pacer *pacer, sc_tick date) {
+    pacer->last_vblank = date;
+}
+
+void
+sc_frame_pacer_on_present(struct sc_frame_pacer *pacer, sc_tick date) {
+    sc_tick tolerance = pacer->period ? pacer->period / 2
+                                      : SC_FRAME_PACER_DEFAULT_TOLERANCE;
+    sc_tick error = date - pacer->target;
+    if (error < -tolerance) {
+        ++pacer->stats.early;
+    } else if (error > tolerance) {
+        ++pacer->stats.late;
+    }
+
+    pacer->stats.error_sum += error >= 0 ? error : -error;
+    ++pacer->stats.presented;
+}
+
+void
+sc_frame_pacer_on_drop(struct sc_frame_pacer *pacer) {
+    ++pacer->stats.dropped;
+}
+
+void
+sc_frame_pacer_log_stats(struct sc_frame_pacer *pacer) {
+    uint64_t presented = pacer->stats.presented;
+    if (!presented) {
+        return;
+    }
+
+    sc_tick avg_error = pacer->stats.error_sum / (sc_tick) presented;
+    LOGI("Frame pacing: %" PRIu64_ " presented (%" PRIu64_ " early, %"
+         PRIu64_ " late, avg error %" PRItick " us), %" PRIu64_ " dropped",
+         presented, pacer->stats.early, pacer->stats.late,
+         SC_TICK_TO_US(avg_error), pacer->stats.dropped);
+}
@@ -0,0 +1,75 @@
+#ifndef SC_FRAME_PACER_H
+#define SC_FRAME_PACER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "util/tick.h"
+
+/**
+ * Frame pacer, to present each frame at the display refresh (vblank) closest
+ * to its target time
+ *
+ * The target time of a frame is the system time at which it is expected to be
+ * received (estimated from its PTS by a sc_clock) plus a latency budget, which
+ * absorbs the jitter of the network delivery.
+ *
+ * With vsync enabled, the present blocks until the next vblank, so the frame
+ * must be rendered during the refresh interval preceding its vblank. The date
+ * at which a present returns is used as an estimation of the vblank phase.
+ */
+struct sc_frame_pacer {
+    sc_tick budget;
+    sc_tick period; // refresh period of the display (0 if unknown)
+    sc_tick last_vblank; // estimated date of the last vblank (0 if unknown)
+    struct sc_clock clock;
+
+    sc_tick target; // target time of the last scheduled frame
+
+    struct {
+        uint64_t presented;
+        uint64_t early; // presented more than half a period before its target
+        uint64_t late; // presented more than half a period after its target
+        uint64_t dropped; // replaced by a newer frame before its present
+        sc_tick error_sum; // sum of the absolute present errors
+    } stats;
+};
+
+void
+sc_frame_pacer_init(struct sc_frame_pacer *pacer, sc_tick budget);
+
+// Set the display refresh rate, in Hz (0 if unknown)
+void
+sc_frame_pacer_set_refresh_rate(struct sc_frame_pacer *pacer,
+                                float refresh_rate);
+
+/**
+ * Schedule the presentation of a frame received at `now`
+ *
+ * Return the date at which the frame must be rendered (if it is not after
+ * `now`, it must be rendered immediately).
+ */
+sc_tick
+sc_frame_pacer_schedule(struct sc_frame_pacer *pacer, sc_tick now, sc_tick pts);
+
+// Notify that the last scheduled frame has been presented (the present
+// returned at `date`)
+void
+sc_frame_pacer_on_present(struct sc_frame_pacer *pacer, sc_tick date);
+
+// Notify that a present returned at `date` with vsync enabled (to track the
+// vblank phase)
+void
+sc_frame_pacer_on_vblank(struct sc_frame_pacer *pacer, sc_tick date);
+
+// Notify that the last scheduled frame has been replaced by a newer frame
+void
+sc_frame_pacer_on_drop(struct sc_frame_pacer *pacer);
+
+void
+sc_frame_pacer_log_stats(struct sc_frame_pacer *pacer);
+
+#endif
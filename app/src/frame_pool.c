@@ -0,0 +1,279 @@
+#include "frame_pool.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+#include "util/log.h"
+
+bool
+sc_frame_pool_init(struct sc_frame_pool *pool) {
+    bool ok = sc_mutex_init(&pool->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    pool->format = AV_PIX_FMT_NONE;
+    pool->width = 0;
+    pool->height = 0;
+    pool->plane_count = 0;
+    for (unsigned i = 0; i < SC_FRAME_POOL_MAX_PLANES; ++i) {
+        pool->linesize[i] = 0;
+        pool->planes[i] = NULL;
+    }
+
+    pool->requests = 0;
+    pool->buffers = 0;
+    pool->high_water_mark = 0;
+    pool->rebuilds = 0;
+
+    return true;
+}
+
+static void
+sc_frame_pool_release_planes(struct sc_frame_pool *pool) {
+    for (int i = 0; i < pool->plane_count; ++i) {
+        // The AVBufferPool is actually freed once all its buffers are
+        // released
+        av_buffer_pool_uninit(&pool->planes[i]);
+    }
+    pool->plane_count = 0;
+    pool->format = AV_PIX_FMT_NONE;
+}
+
+void
+sc_frame_pool_destroy(struct sc_frame_pool *pool) {
+    sc_frame_pool_release_planes(pool);
+    sc_mutex_destroy(&pool->mutex);
+}
+
+#ifdef SCRCPY_LAVU_HAS_BUFFER_SIZE_T
+typedef size_t sc_av_buffer_size;
+#else
+typedef int sc_av_buffer_size;
+#endif
+
+static void
+sc_frame_pool_free_buffer(void *opaque, uint8_t *data) {
+    (void) data;
+    // opaque is the unaligned allocation
+    av_free(opaque);
+}
+
+static AVBufferRef *
+sc_frame_pool_alloc_buffer(void *opaque, sc_av_buffer_size size) {
+    struct sc_frame_pool *pool = opaque;
+
+    // av_malloc() alignment depends on the FFmpeg build (it may be 16 bytes)
+    uint8_t *mem = av_malloc(size + SC_FRAME_POOL_ALIGN - 1);
+    if (!mem) {
+        return NULL;
+    }
+
+    uintptr_t mask = SC_FRAME_POOL_ALIGN - 1;
+    uint8_t *data = (uint8_t *) (((uintptr_t) mem + mask) & ~mask);
+
+    AVBufferRef *buf =
+        av_buffer_create(data, size, sc_frame_pool_free_buffer, mem, 0);
+    if (!buf) {
+        av_free(mem);
+        return NULL;
+    }
+
+    // Only called from av_buffer_pool_get(), with the mutex locked, when no
+    // released buffer is available
+    ++pool->buffers;
+
+    return buf;
+}
+
+static bool
+sc_frame_pool_is_supported(AVCodecContext *ctx, const AVFrame *frame) {
+    if (!(ctx->codec->capabilities & AV_CODEC_CAP_DR1)) {
+        // The codec does not support custom buffers
+        return false;
+    }
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    if (!desc) {
+        return false;
+    }
+
+    uint64_t unsupported_flags = AV_PIX_FMT_FLAG_HWACCEL
+                               | AV_PIX_FMT_FLAG_PAL
+                               | AV_PIX_FMT_FLAG_BITSTREAM;
+    if (desc->flags & unsupported_flags) {
+        return false;
+    }
+
+    return av_pix_fmt_count_planes(frame->format) <= SC_FRAME_POOL_MAX_PLANES;
+}
+
+// Compute the size of each plane (without padding) from the line sizes
+static bool
+sc_frame_pool_fill_plane_sizes(size_t sizes[4], int format, int height,
+                               const int linesize[4]) {
+#ifdef SCRCPY_LAVU_HAS_FILL_PLANE_SIZES
+    ptrdiff_t linesizes[4];
+    for (unsigned i = 0; i < 4; ++i) {
+        linesizes[i] = linesize[i];
+    }
+    return av_image_fill_plane_sizes(sizes, format, height, linesizes) >= 0;
+#else
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    int plane_count = av_pix_fmt_count_planes(format);
+    if (!desc || plane_count < 0) {
+        return false;
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        bool chroma = i == 1 || i == 2;
+        int plane_h = chroma ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h)
+                             : height;
+        sizes[i] = i < plane_count ? (size_t) linesize[i] * plane_h : 0;
+    }
+    return true;
+#endif
+}
+
+// Must be called with the mutex locked
+static bool
+sc_frame_pool_configure(struct sc_frame_pool *pool, AVCodecContext *ctx,
+                        const AVFrame *frame) {
+    int w = frame->width;
+    int h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(ctx, &w, &h, linesize_align);
+
+    if (pool->format == frame->format && pool->width == w
+            && pool->height == h) {
+        // Nothing changed
+        return true;
+    }
+
+    if (pool->format != AV_PIX_FMT_NONE) {
+        LOGD("Frame pool: %" PRIu64_ " frames allocated for %dx%d, "
+             "rebuilding for %dx%d", pool->buffers / pool->plane_count,
+             pool->width, pool->height, w, h);
+        ++pool->rebuilds;
+    }
+
+    sc_frame_pool_release_planes(pool);
+    pool->buffers = 0;
+
+    // Increase the width until all the line sizes are aligned
+    int linesize[4];
+    int aligned_w = w;
+    for (;;) {
+        if (av_image_fill_linesizes(linesize, frame->format, aligned_w) < 0) {
+            LOGE("Frame pool: invalid frame size %dx%d", w, h);
+            return false;
+        }
+
+        bool aligned = true;
+        for (unsigned i = 0; i < 4; ++i) {
+            assert(SC_FRAME_POOL_ALIGN % linesize_align[i] == 0);
+            if (linesize[i] % SC_FRAME_POOL_ALIGN) {
+                aligned = false;
+                break;
+            }
+        }
+
+        if (aligned) {
+            break;
+        }
+
+        // Add the lowest bit set, to double the alignment of the width
+        aligned_w += aligned_w & ~(aligned_w - 1);
+    }
+
+    // The line sizes are already aligned, and the alignment of the data
+    // pointers is handled by the allocator: no other padding is needed
+    size_t plane_sizes[4];
+    if (!sc_frame_pool_fill_plane_sizes(plane_sizes, frame->format, h,
+                                        linesize)) {
+        LOGE("Frame pool: invalid frame size %dx%d", w, h);
+        return false;
+    }
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int plane_count = av_pix_fmt_count_planes(frame->format);
+    assert(plane_count > 0 && plane_count <= SC_FRAME_POOL_MAX_PLANES);
+
+    for (int i = 0; i < plane_count; ++i) {
+        // Like the FFmpeg default allocator, allocate a few more bytes, since
+        // some optimized code may read beyond the end of the plane
+        size_t size = plane_sizes[i] + AV_INPUT_BUFFER_PADDING_SIZE;
+
+        pool->planes[i] = av_buffer_pool_init2(size, pool,
+                                               sc_frame_pool_alloc_buffer,
+                                               NULL);
+        if (!pool->planes[i]) {
+            LOG_OOM();
+            pool->plane_count = i;
+            sc_frame_pool_release_planes(pool);
+            return false;
+        }
+        pool->linesize[i] = linesize[i];
+    }
+
+    pool->plane_count = plane_count;
+    pool->format = frame->format;
+    pool->width = w;
+    pool->height = h;
+
+    LOGD("Frame pool: configured for %dx%d (%s), line size %d", w, h,
+         desc->name, linesize[0]);
+
+    return true;
+}
+
+int
+sc_frame_pool_get_buffer(struct sc_frame_pool *pool, AVCodecContext *ctx,
+                         AVFrame *frame, int flags) {
+    if (!sc_frame_pool_is_supported(ctx, frame)) {
+        return avcodec_default_get_buffer2(ctx, frame, flags);
+    }
+
+    sc_mutex_lock(&pool->mutex);
+
+    if (!sc_frame_pool_configure(pool, ctx, frame)) {
+        sc_mutex_unlock(&pool->mutex);
+        return AVERROR(ENOMEM);
+    }
+
+    ++pool->requests;
+
+    for (int i = 0; i < pool->plane_count; ++i) {
+        frame->buf[i] = av_buffer_pool_get(pool->planes[i]);
+        if (!frame->buf[i]) {
+            sc_mutex_unlock(&pool->mutex);
+            LOG_OOM();
+            av_frame_unref(frame);
+            return AVERROR(ENOMEM);
+        }
+
+        frame->data[i] = frame->buf[i]->data;
+        frame->linesize[i] = pool->linesize[i];
+    }
+
+    uint64_t frames = pool->buffers / pool->plane_count;
+    if (frames > pool->high_water_mark) {
+        pool->high_water_mark = frames;
+    }
+
+    sc_mutex_unlock(&pool->mutex);
+
+    frame->extended_data = frame->data;
+
+    return 0;
+}
+
+void
+sc_frame_pool_log_stats(struct sc_frame_pool *pool, const char *name) {
+    LOGD("Frame pool '%s': %" PRIu64_ " requests, high-water mark %" PRIu64_
+         " frames, %u rebuilds", name, pool->requests, pool->high_water_mark,
+         pool->rebuilds);
+}
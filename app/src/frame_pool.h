@@ -0,0 +1,75 @@
+#ifndef SC_FRAME_POOL_H
+#define SC_FRAME_POOL_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+
+#include "util/thread.h"
+
+/**
+ * Pool of video frame buffers, to be used as AVCodecContext.get_buffer2
+ *
+ * Each plane is allocated from its own AVBufferPool, with data pointers and
+ * line sizes aligned on SC_FRAME_POOL_ALIGN bytes. A buffer is recycled once
+ * all its references (held by the screen, the delay buffer, the v4l2 sink,
+ * etc.) have been released, so that decoding does not allocate in steady
+ * state.
+ *
+ * The pools are rebuilt only when the format or the frame size changes.
+ */
+
+#define SC_FRAME_POOL_ALIGN 64
+#define SC_FRAME_POOL_MAX_PLANES 4
+
+struct sc_frame_pool {
+    // get_buffer2() may be called from several decoding threads
+    sc_mutex mutex;
+
+    // Current configuration (format is AV_PIX_FMT_NONE if none)
+    int format;
+    int width; // aligned for the codec
+    int height; // aligned for the codec
+    int plane_count;
+    int linesize[SC_FRAME_POOL_MAX_PLANES];
+    AVBufferPool *planes[SC_FRAME_POOL_MAX_PLANES];
+
+    // Statistics, protected by the mutex
+    uint64_t requests;
+    uint64_t buffers; // buffers allocated for the current configuration
+    // Maximum number of frames allocated for a configuration, i.e. the maximum
+    // number of frames referenced at the same time
+    uint64_t high_water_mark;
+    unsigned rebuilds;
+};
+
+bool
+sc_frame_pool_init(struct sc_frame_pool *pool);
+
+/**
+ * Release the pool
+ *
+ * The buffers still referenced by frames remain valid, they will be freed once
+ * released.
+ */
+void
+sc_frame_pool_destroy(struct sc_frame_pool *pool);
+
+/**
+ * Allocate the buffers of a frame, to be called from AVCodecContext.get_buffer2
+ *
+ * The formats not supported by the pool fall back to the default allocator.
+ */
+int
+sc_frame_pool_get_buffer(struct sc_frame_pool *pool, AVCodecContext *ctx,
+                         AVFrame *frame, int flags);
+
+void
+sc_frame_pool_log_stats(struct sc_frame_pool *pool, const char *name);
+
+#endif
@@ -13,6 +13,10 @@
 #include "util/log.h"
 #include "util/sdl.h"
 
+// An input event is late if it is processed more than one frame (at 60 fps)
+// after it has been received
+#define SC_INPUT_LATENCY_LATE SC_TICK_FROM_US(16667)
+
 void
 sc_input_manager_init(struct sc_input_manager *im,
                       const struct sc_input_manager_params *params) {
@@ -25,6 +29,7 @@ sc_input_manager_init(struct sc_input_manager *im,
 
     im->controller = params->controller;
     im->fp = params->fp;
+    im->replay_buffer = params->replay_buffer;
     im->screen = params->screen;
     im->kp = params->kp;
     im->mp = params->mp;
@@ -47,6 +52,11 @@ sc_input_manager_init(struct sc_input_manager *im,
     im->key_repeat = 0;
 
     im->next_sequence = 1; // 0 is reserved for SC_SEQUENCE_INVALID
+
+    im->latency_stats.count = 0;
+    im->latency_stats.total = 0;
+    im->latency_stats.max = 0;
+    im->latency_stats.late = 0;
 }
 
 static void
@@ -301,6 +311,16 @@ reset_video(struct sc_input_manager *im) {
     }
 }
 
+static void
+save_replay_buffer(struct sc_input_manager *im) {
+    if (!im->replay_buffer) {
+        LOGW("Replay buffer is disabled (use --replay-buffer)");
+        return;
+    }
+
+    sc_replay_buffer_save(im->replay_buffer);
+}
+
 static void
 apply_orientation_transform(struct sc_input_manager *im,
                             enum sc_orientation transform) {
@@ -415,7 +435,11 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                 }
                 return;
             case SDLK_S:
-                if (im->kp && !shift && !repeat && !paused) {
+                if (shift) {
+                    if (video && down && !repeat) {
+                        sc_screen_take_screenshot(im->screen);
+                    }
+                } else if (im->kp && !repeat && !paused) {
                     action_app_switch(im, action);
                 }
                 return;
@@ -425,7 +449,11 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                 }
                 return;
             case SDLK_P:
-                if (im->kp && !shift && !repeat && !paused) {
+                if (shift) {
+                    if (down && !repeat) {
+                        save_replay_buffer(im);
+                    }
+                } else if (im->kp && !repeat && !paused) {
                     action_power(im, action);
                 }
                 return;
@@ -1005,11 +1033,73 @@ sc_input_manager_process_file(struct sc_input_manager *im,
     }
 }
 
+static bool
+sc_input_manager_is_input_event(uint32_t type) {
+    switch (type) {
+        case SDL_EVENT_TEXT_INPUT:
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_KEY_UP:
+        case SDL_EVENT_MOUSE_MOTION:
+        case SDL_EVENT_MOUSE_WHEEL:
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+        case SDL_EVENT_MOUSE_BUTTON_UP:
+        case SDL_EVENT_FINGER_MOTION:
+        case SDL_EVENT_FINGER_DOWN:
+        case SDL_EVENT_FINGER_UP:
+        case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+        case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+        case SDL_EVENT_GAMEPAD_BUTTON_UP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void
+sc_input_manager_record_latency(struct sc_input_manager *im,
+                                const SDL_Event *event) {
+    // The event timestamps are in the SDL_GetTicksNS() time base
+    Uint64 now = SDL_GetTicksNS();
+    Uint64 timestamp = event->common.timestamp;
+    if (!timestamp || timestamp > now) {
+        // Not set by SDL
+        return;
+    }
+
+    sc_tick latency = SC_TICK_FROM_NS(now - timestamp);
+    ++im->latency_stats.count;
+    im->latency_stats.total += latency;
+    if (latency > im->latency_stats.max) {
+        im->latency_stats.max = latency;
+    }
+    if (latency > SC_INPUT_LATENCY_LATE) {
+        ++im->latency_stats.late;
+    }
+}
+
+void
+sc_input_manager_log_stats(struct sc_input_manager *im) {
+    uint64_t count = im->latency_stats.count;
+    if (!count) {
+        return;
+    }
+
+    sc_tick avg = im->latency_stats.total / (sc_tick) count;
+    LOGI("Input latency: %" PRIu64_ " events, %" PRItick " us on average, "
+         "%" PRItick " us max, %" PRIu64_ " late (> %" PRItick " ms)", count,
+         SC_TICK_TO_US(avg), SC_TICK_TO_US(im->latency_stats.max),
+         im->latency_stats.late, SC_TICK_TO_MS(SC_INPUT_LATENCY_LATE));
+}
+
 void
 sc_input_manager_handle_event(struct sc_input_manager *im,
                               const SDL_Event *event) {
     bool control = im->controller;
     bool paused = im->screen->paused;
+    if (control && !paused && sc_input_manager_is_input_event(event->type)) {
+        sc_input_manager_record_latency(im, event);
+    }
+
     switch (event->type) {
         case SDL_EVENT_TEXT_INPUT:
             if (!im->kp || paused) {
@@ -11,13 +11,16 @@
 #include "controller.h"
 #include "file_pusher.h"
 #include "options.h"
+#include "replay_buffer.h"
 #include "trait/gamepad_processor.h"
 #include "trait/key_processor.h"
 #include "trait/mouse_processor.h"
+#include "util/tick.h"
 
 struct sc_input_manager {
     struct sc_controller *controller;
     struct sc_file_pusher *fp;
+    struct sc_replay_buffer *replay_buffer;
     struct sc_screen *screen;
 
     struct sc_key_processor *kp;
@@ -44,11 +47,22 @@ struct sc_input_manager {
     uint16_t last_mod;
 
     uint64_t next_sequence; // used for request acknowledgements
+
+    // Delay between the input events and their processing, i.e. the moment
+    // the control messages are pushed to the controller (it increases if the
+    // main thread is blocked, for example by a present waiting for vsync)
+    struct {
+        uint64_t count;
+        sc_tick total;
+        sc_tick max;
+        uint64_t late; // number of events delayed by more than a frame
+    } latency_stats;
 };
 
 struct sc_input_manager_params {
     struct sc_controller *controller;
     struct sc_file_pusher *fp;
+    struct sc_replay_buffer *replay_buffer; // NULL if disabled
     struct sc_screen *screen;
     struct sc_key_processor *kp;
     struct sc_mouse_processor *mp;
@@ -68,4 +82,7 @@ void
 sc_input_manager_handle_event(struct sc_input_manager *im,
                               const SDL_Event *event);
 
+void
+sc_input_manager_log_stats(struct sc_input_manager *im);
+
 #endif
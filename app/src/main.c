@@ -8,6 +8,7 @@
 #include <SDL3/SDL.h>
 
 #include "cli.h"
+#include "multi_session.h"
 #include "options.h"
 #include "scrcpy.h"
 #ifdef HAVE_USB
@@ -87,11 +88,15 @@ main_scrcpy(int argc, char *argv[]) {
 
     sc_log_configure();
 
+    if (args.opts.multi_session) {
+        ret = scrcpy_multi_session(&args.opts);
+    } else {
 #ifdef HAVE_USB
-    ret = args.opts.otg ? scrcpy_otg(&args.opts) : scrcpy(&args.opts);
+        ret = args.opts.otg ? scrcpy_otg(&args.opts) : scrcpy(&args.opts);
 #else
-    ret = scrcpy(&args.opts);
+        ret = scrcpy(&args.opts);
 #endif
+    }
 
 end:
     if (args.pause_on_exit == SC_PAUSE_ON_EXIT_TRUE ||
@@ -0,0 +1,723 @@
+#include "multi_session.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+#include "decoder.h"
+#include "decoder_pool.h"
+#include "demuxer.h"
+#include "events.h"
+#include "screen.h"
+#include "server.h"
+#ifdef HAVE_IO_LOOP
+# include "util/io_loop.h"
+#endif
+#include "util/log.h"
+#include "util/rand.h"
+#include "util/tick.h"
+
+/**
+ * Multi-session mode
+ *
+ * Each session mirrors the video of one device: it runs its own server,
+ * demuxer and decoder, and displays the frames in its own window (or only
+ * counts them, without window). The decoders share a bounded pool of worker
+ * threads, so that the number of decoding threads does not grow with the
+ * number of devices.
+ *
+ * With --io-engine=epoll, the video sockets of all the sessions are watched
+ * by a single I/O loop thread instead of one demuxer thread per session. The
+ * packets are then pushed to the decoder pool from this thread (which blocks
+ * while the queue of a session is full).
+ *
+ * Audio and control are not supported in this mode.
+ */
+
+struct sc_session {
+    const char *serial; // points into scrcpy_multi_session.serials
+
+    struct sc_server server;
+    struct sc_demuxer demuxer;
+    struct sc_decoder decoder;
+    struct sc_screen screen;
+
+    // Only used without screen: count the decoded frames
+    struct sc_frame_sink headless_sink;
+    uint64_t headless_frames;
+
+    bool server_initialized;
+    bool server_started;
+    bool screen_initialized;
+    bool demuxer_started;
+    bool ended;
+};
+
+struct scrcpy_multi_session {
+    char *serials; // copy of the option value, split in place
+    struct sc_session *sessions;
+    size_t count;
+
+    struct sc_decoder_pool decoder_pool;
+#ifdef HAVE_IO_LOOP
+    struct sc_io_loop io_loop; // shared by all the sessions
+#endif
+};
+
+/** Downcast frame_sink to sc_session */
+#define DOWNCAST_HEADLESS(SINK) \
+    container_of(SINK, struct sc_session, headless_sink)
+
+static bool
+sc_session_headless_sink_open(struct sc_frame_sink *sink,
+                              const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+sc_session_headless_sink_close(struct sc_frame_sink *sink) {
+    (void) sink;
+}
+
+static bool
+sc_session_headless_sink_push(struct sc_frame_sink *sink,
+                              const AVFrame *frame) {
+    (void) frame;
+
+    struct sc_session *session = DOWNCAST_HEADLESS(sink);
+    // Only accessed by the decoding thread of this session until it is closed
+    ++session->headless_frames;
+    return true;
+}
+
+static void
+sc_session_on_connection_failed(struct sc_server *server, void *userdata) {
+    (void) server;
+
+    struct sc_session *session = userdata;
+    sc_push_event_with_data(SC_EVENT_SERVER_CONNECTION_FAILED, session);
+}
+
+static void
+sc_session_on_connected(struct sc_server *server, void *userdata) {
+    (void) server;
+
+    struct sc_session *session = userdata;
+    sc_push_event_with_data(SC_EVENT_SERVER_CONNECTED, session);
+}
+
+static void
+sc_session_on_disconnected(struct sc_server *server, void *userdata) {
+    (void) server;
+
+    struct sc_session *session = userdata;
+    LOGD("Session %s: server disconnected", session->serial);
+    // Handled by the demuxer end
+}
+
+static void
+sc_session_on_demuxer_ended(struct sc_demuxer *demuxer,
+                            enum sc_demuxer_status status, void *userdata) {
+    (void) demuxer;
+
+    struct sc_session *session = userdata;
+
+    // The device may not decide to disable the video
+    assert(status != SC_DEMUXER_STATUS_DISABLED);
+
+    if (status == SC_DEMUXER_STATUS_EOS) {
+        sc_push_event_with_data(SC_EVENT_DEVICE_DISCONNECTED, session);
+    } else {
+        sc_push_event_with_data(SC_EVENT_DEMUXER_ERROR, session);
+    }
+}
+
+static bool
+sc_session_init_server(struct sc_session *session,
+                       const struct scrcpy_options *options,
+                       struct sc_rand *rand) {
+    struct sc_server_params params = {
+        // Only use 31 bits to avoid issues with signed values on the Java-side
+        .scid = sc_rand_u32(rand) & 0x7FFFFFFF,
+        .req_serial = session->serial,
+        .select_usb = false,
+        .select_tcpip = false,
+        .log_level = options->log_level,
+        .video_codec = options->video_codec,
+        .audio_codec = options->audio_codec,
+        .video_source = options->video_source,
+        .audio_source = options->audio_source,
+        .camera_facing = options->camera_facing,
+        .crop = options->crop,
+        .port_range = options->port_range,
+        .tunnel_host = options->tunnel_host,
+        .tunnel_port = options->tunnel_port,
+        .no_adb = false,
+        .max_size = options->max_size,
+        .video_bit_rate = options->video_bit_rate,
+        .audio_bit_rate = options->audio_bit_rate,
+        .max_fps = options->max_fps,
+        .angle = options->angle,
+        .screen_off_timeout = options->screen_off_timeout,
+        .capture_orientation = options->capture_orientation,
+        .capture_orientation_lock = options->capture_orientation_lock,
+        .control = false,
+        .display_id = options->display_id,
+        .new_display = options->new_display,
+        .display_ime_policy = options->display_ime_policy,
+        .video = true,
+        .audio = false,
+        .audio_dup = false,
+        .show_touches = options->show_touches,
+        .stay_awake = options->stay_awake,
+        .video_codec_options = options->video_codec_options,
+        .audio_codec_options = options->audio_codec_options,
+        .video_encoder = options->video_encoder,
+        .audio_encoder = options->audio_encoder,
+        .camera_id = options->camera_id,
+        .camera_size = options->camera_size,
+        .camera_ar = options->camera_ar,
+        .camera_fps = options->camera_fps,
+        .force_adb_forward = options->force_adb_forward,
+        .power_off_on_close = options->power_off_on_close,
+        .clipboard_autosync = false,
+        .downsize_on_error = options->downsize_on_error,
+        .tcpip = false,
+        .tcpip_dst = NULL,
+        .cleanup = options->cleanup,
+        .power_on = options->power_on,
+        .kill_adb_on_close = false,
+        .camera_high_speed = options->camera_high_speed,
+        .vd_destroy_content = options->vd_destroy_content,
+        .vd_system_decorations = options->vd_system_decorations,
+        .list = 0,
+    };
+
+    static const struct sc_server_callbacks cbs = {
+        .on_connection_failed = sc_session_on_connection_failed,
+        .on_connected = sc_session_on_connected,
+        .on_disconnected = sc_session_on_disconnected,
+    };
+    return sc_server_init(&session->server, &params, &cbs, session);
+}
+
+static bool
+sc_session_init_screen(struct sc_session *session,
+                       const struct scrcpy_options *options) {
+    const char *window_title = options->window_title
+                             ? options->window_title
+                             : session->server.info.device_name;
+
+    struct sc_screen_params screen_params = {
+        .video = true,
+        .controller = NULL,
+        .fp = NULL,
+        .screenshot = NULL,
+        .replay_buffer = NULL,
+        .kp = NULL,
+        .mp = NULL,
+        .gp = NULL,
+        .mouse_bindings = options->mouse_bindings,
+        .legacy_paste = options->legacy_paste,
+        .clipboard_autosync = false,
+        .shortcut_mods = options->shortcut_mods,
+        .window_title = window_title,
+        .always_on_top = options->always_on_top,
+        // Let the window manager place the windows
+        .window_x = SC_WINDOW_POSITION_UNDEFINED,
+        .window_y = SC_WINDOW_POSITION_UNDEFINED,
+        .window_width = options->window_width,
+        .window_height = options->window_height,
+        .window_borderless = options->window_borderless,
+        .orientation = options->display_orientation,
+        .mipmaps = options->mipmaps,
+        .pbo = options->pbo,
+        .low_res = options->video_low_res,
+        .partial_upload = options->video_partial_upload,
+        .frame_pacing = options->frame_pacing,
+        .prepare_thread = options->video_prepare_thread,
+        .render_bench = options->render_bench,
+        .fullscreen = false,
+        .start_fps_counter = options->start_fps_counter,
+    };
+
+    return sc_screen_init(&session->screen, &screen_params);
+}
+
+static bool
+sc_multi_session_split_serials(struct scrcpy_multi_session *ms,
+                               const char *serials) {
+    ms->serials = strdup(serials);
+    if (!ms->serials) {
+        LOG_OOM();
+        return false;
+    }
+
+    size_t count = 1;
+    for (const char *c = serials; *c; ++c) {
+        if (*c == ',') {
+            ++count;
+        }
+    }
+
+    ms->sessions = malloc(count * sizeof(*ms->sessions));
+    if (!ms->sessions) {
+        LOG_OOM();
+        free(ms->serials);
+        return false;
+    }
+
+    char *serial = ms->serials;
+    for (size_t i = 0; i < count; ++i) {
+        char *sep = strchr(serial, ',');
+        if (sep) {
+            *sep = '\0';
+        }
+
+        if (!*serial) {
+            LOGE("Multi-session mode: empty serial in \"%s\"", serials);
+            free(ms->sessions);
+            free(ms->serials);
+            return false;
+        }
+
+        for (size_t j = 0; j < i; ++j) {
+            if (!strcmp(ms->sessions[j].serial, serial)) {
+                LOGE("Multi-session mode: duplicate serial %s", serial);
+                free(ms->sessions);
+                free(ms->serials);
+                return false;
+            }
+        }
+
+        struct sc_session *session = &ms->sessions[i];
+        session->serial = serial;
+        session->headless_frames = 0;
+        session->server_initialized = false;
+        session->server_started = false;
+        session->screen_initialized = false;
+        session->demuxer_started = false;
+        session->ended = false;
+
+        serial = sep + 1; // not dereferenced if sep is NULL (last item)
+    }
+
+    ms->count = count;
+    return true;
+}
+
+static void
+sdl_set_hints(const char *render_driver, bool render_bench) {
+    if (render_driver && !SDL_SetHint(SDL_HINT_RENDER_DRIVER, render_driver)) {
+        LOGW("Could not set render driver");
+    }
+
+    // Render to an offscreen window, without any display server
+    if (render_bench && !SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen")) {
+        LOGW("Could not set offscreen video driver");
+    }
+
+    if (!SDL_SetHint(SDL_HINT_APP_NAME, "scrcpy")) {
+        LOGW("Could not set app name");
+    }
+
+    // Disable compositor bypassing on X11
+    if (!SDL_SetHint(SDL_HINT_VIDEO_X11_NET_WM_BYPASS_COMPOSITOR, "0")) {
+        LOGW("Could not disable X11 compositor bypass");
+    }
+
+    // Do not minimize on focus loss
+    if (!SDL_SetHint(SDL_HINT_VIDEO_MINIMIZE_ON_FOCUS_LOSS, "0")) {
+        LOGW("Could not disable minimize on focus loss");
+    }
+}
+
+// Return true on success, false on error
+static bool
+await_for_servers(struct scrcpy_multi_session *ms, bool *connected) {
+    size_t remaining = ms->count;
+
+    SDL_Event event;
+    while (remaining && SDL_WaitEvent(&event)) {
+        switch (event.type) {
+            case SDL_EVENT_QUIT:
+                *connected = false;
+                return true;
+            case SC_EVENT_SERVER_CONNECTION_FAILED: {
+                struct sc_session *session = event.user.data1;
+                LOGE("Session %s: server connection failed", session->serial);
+                return false;
+            }
+            case SC_EVENT_SERVER_CONNECTED: {
+                struct sc_session *session = event.user.data1;
+                LOGD("Session %s: server connected", session->serial);
+                --remaining;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    if (remaining) {
+        LOGE("SDL_WaitEvent() error: %s", SDL_GetError());
+        return false;
+    }
+
+    *connected = true;
+    return true;
+}
+
+// Return the session owning the screen targeted by the event, if any
+static struct sc_session *
+sc_multi_session_find_target(struct scrcpy_multi_session *ms,
+                             SDL_Event *event) {
+    if (event->type == SC_EVENT_NEW_FRAME
+            || event->type == SC_EVENT_PRESENT_FRAME
+            || event->type == SC_EVENT_FRAME_PREPARED) {
+        struct sc_screen *screen = event->user.data1;
+        return container_of(screen, struct sc_session, screen);
+    }
+
+    SDL_Window *window = SDL_GetWindowFromEvent(event);
+    if (!window) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+        if (session->screen_initialized && session->screen.window == window) {
+            return session;
+        }
+    }
+
+    return NULL;
+}
+
+static enum scrcpy_exit_code
+event_loop(struct scrcpy_multi_session *ms) {
+    size_t active = ms->count;
+    bool failed = false;
+
+    SDL_Event event;
+    while (SDL_WaitEvent(&event)) {
+        switch (event.type) {
+            case SC_EVENT_DEVICE_DISCONNECTED:
+            case SC_EVENT_DEMUXER_ERROR: {
+                struct sc_session *session = event.user.data1;
+                if (event.type == SC_EVENT_DEVICE_DISCONNECTED) {
+                    LOGW("Session %s: device disconnected", session->serial);
+                } else {
+                    LOGE("Session %s: demuxer error", session->serial);
+                    failed = true;
+                }
+
+                assert(!session->ended);
+                session->ended = true;
+                if (session->screen_initialized) {
+                    sc_screen_hide_window(&session->screen);
+                }
+
+                // Keep mirroring the other devices
+                assert(active);
+                if (!--active) {
+                    return failed ? SCRCPY_EXIT_FAILURE
+                                  : SCRCPY_EXIT_DISCONNECTED;
+                }
+                break;
+            }
+            case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
+                // Closing any window terminates all the sessions
+            case SDL_EVENT_QUIT:
+                LOGD("User requested to quit");
+                return failed ? SCRCPY_EXIT_FAILURE : SCRCPY_EXIT_SUCCESS;
+            case SC_EVENT_RUN_ON_MAIN_THREAD: {
+                sc_runnable_fn run = event.user.data1;
+                void *userdata = event.user.data2;
+                run(userdata);
+                break;
+            }
+            default: {
+                struct sc_session *session =
+                    sc_multi_session_find_target(ms, &event);
+                if (session
+                        && !sc_screen_handle_event(&session->screen, &event)) {
+                    return SCRCPY_EXIT_FAILURE;
+                }
+                break;
+            }
+        }
+    }
+    return SCRCPY_EXIT_FAILURE;
+}
+
+enum scrcpy_exit_code
+scrcpy_multi_session(struct scrcpy_options *options) {
+    static struct scrcpy_multi_session multi_session;
+    struct scrcpy_multi_session *ms = &multi_session;
+
+    assert(options->multi_session);
+    // Validated by the command line parser
+    assert(options->video);
+    assert(!options->audio);
+    assert(!options->control);
+
+    // Minimal SDL initialization
+    if (!SDL_Init(SDL_INIT_EVENTS)) {
+        LOGE("Could not initialize SDL: %s", SDL_GetError());
+        return SCRCPY_EXIT_FAILURE;
+    }
+
+    atexit(SDL_Quit);
+
+    if (!sc_multi_session_split_serials(ms, options->multi_session)) {
+        return SCRCPY_EXIT_FAILURE;
+    }
+
+    enum scrcpy_exit_code ret = SCRCPY_EXIT_FAILURE;
+
+    bool decoder_pool_initialized = false;
+    bool decoder_pool_started = false;
+#ifdef HAVE_IO_LOOP
+    bool io_loop_initialized = false;
+    bool io_loop_started = false;
+#endif
+    sc_tick duration = 0; // of the event loop
+
+    LOGI("Multi-session mode: %" SC_PRIsizet " devices", ms->count);
+
+    if (options->video_playback) {
+        // Set hints before starting the server threads to avoid race
+        // conditions in SDL
+        sdl_set_hints(options->render_driver, options->render_bench);
+    }
+
+    struct sc_rand rand;
+    sc_rand_init(&rand);
+
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+        if (!sc_session_init_server(session, options, &rand)) {
+            goto end;
+        }
+        session->server_initialized = true;
+
+        if (!sc_server_start(&session->server)) {
+            goto end;
+        }
+        session->server_started = true;
+    }
+
+    if (options->video_playback) {
+        if (!SDL_Init(SDL_INIT_VIDEO)) {
+            LOGE("Could not initialize SDL video: %s", SDL_GetError());
+            goto end;
+        }
+
+        if (options->disable_screensaver) {
+            if (!SDL_DisableScreenSaver()) {
+                LOGW("Could not disable screen saver");
+            }
+        }
+    }
+
+    // Await for all the servers without blocking Ctrl+C handling
+    bool connected;
+    if (!await_for_servers(ms, &connected)) {
+        goto end;
+    }
+
+    if (!connected) {
+        // This is not an error, user requested to quit
+        LOGD("User requested to quit");
+        ret = SCRCPY_EXIT_SUCCESS;
+        goto end;
+    }
+
+    // A bounded number of decoding threads, whatever the number of devices
+    unsigned thread_count = options->decoder_pool_size;
+    if (!thread_count) {
+        int cores = SDL_GetNumLogicalCPUCores();
+        thread_count = cores > 0 ? (unsigned) cores : 1;
+    }
+    thread_count = MIN(thread_count, ms->count);
+
+    if (!sc_decoder_pool_init(&ms->decoder_pool, thread_count)) {
+        goto end;
+    }
+    decoder_pool_initialized = true;
+
+    if (!sc_decoder_pool_start(&ms->decoder_pool)) {
+        goto end;
+    }
+    decoder_pool_started = true;
+
+#ifdef HAVE_IO_LOOP
+    struct sc_io_loop *io_loop = NULL;
+    if (options->io_engine == SC_IO_ENGINE_EPOLL) {
+        if (!sc_io_loop_init(&ms->io_loop)) {
+            goto end;
+        }
+        io_loop_initialized = true;
+
+        if (!sc_io_loop_start(&ms->io_loop)) {
+            goto end;
+        }
+        io_loop_started = true;
+
+        io_loop = &ms->io_loop;
+    }
+#else
+    // Rejected by the command line parser
+    assert(options->io_engine == SC_IO_ENGINE_THREADS);
+#endif
+
+    static const struct sc_demuxer_callbacks demuxer_cbs = {
+        .on_ended = sc_session_on_demuxer_ended,
+    };
+
+    static const struct sc_frame_sink_ops headless_sink_ops = {
+        .open = sc_session_headless_sink_open,
+        .close = sc_session_headless_sink_close,
+        .push = sc_session_headless_sink_push,
+    };
+
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+
+        LOGI("Session %s: %s", session->serial,
+             session->server.info.device_name);
+
+        sc_demuxer_init(&session->demuxer, "video",
+                        session->server.video_socket, &demuxer_cbs, session);
+        sc_demuxer_set_decoder_threads(&session->demuxer,
+                                       options->video_decoder_threads,
+                                       options->video_decoder_thread_type);
+#ifdef HAVE_IO_LOOP
+        if (io_loop) {
+            sc_demuxer_set_io_loop(&session->demuxer, io_loop);
+        }
+#endif
+
+        sc_decoder_init(&session->decoder, "video");
+        sc_decoder_set_pool(&session->decoder, &ms->decoder_pool);
+        sc_packet_source_add_sink(&session->demuxer.packet_source,
+                                  &session->decoder.packet_sink);
+
+        struct sc_frame_source *src = &session->decoder.frame_source;
+        if (options->video_playback) {
+            if (!sc_session_init_screen(session, options)) {
+                goto end;
+            }
+            session->screen_initialized = true;
+
+            sc_frame_source_add_sink(src, &session->screen.frame_sink);
+        } else {
+            session->headless_sink.ops = &headless_sink_ops;
+            sc_frame_source_add_sink(src, &session->headless_sink);
+        }
+    }
+
+    // Start the demuxers once all the sessions are set up
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+        if (!sc_demuxer_start(&session->demuxer)) {
+            goto end;
+        }
+        session->demuxer_started = true;
+    }
+
+    sc_tick start = sc_tick_now();
+
+    ret = event_loop(ms);
+    LOGD("quit...");
+
+    duration = sc_tick_now() - start;
+
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+        if (session->screen_initialized) {
+            // Close the windows immediately, the demuxers may take time to
+            // terminate
+            sc_screen_hide_window(&session->screen);
+        }
+    }
+
+end:
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+        if (session->screen_initialized) {
+            sc_screen_interrupt(&session->screen);
+        }
+        if (session->server_started) {
+            // shutdown the sockets and kill the server
+            sc_server_stop(&session->server);
+        }
+    }
+
+#ifdef HAVE_IO_LOOP
+    if (io_loop_started) {
+        // The sockets are shutdown, the remaining streams are ended on join
+        sc_io_loop_stop(&ms->io_loop);
+        sc_io_loop_join(&ms->io_loop);
+    }
+#endif
+
+    // The demuxers close their decoder on exit, which flushes the packets
+    // queued in the decoder pool
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+        if (session->demuxer_started) {
+            sc_demuxer_join(&session->demuxer);
+
+            if (!session->screen_initialized) {
+                // The frames are counted only once the decoder is closed
+                uint64_t frames = session->headless_frames;
+                double sec = (double) duration / SC_TICK_FREQ;
+                LOGI("Session %s: %" PRIu64 " frames decoded (%.1f fps)",
+                     session->serial, frames, sec > 0 ? frames / sec : 0);
+            }
+        }
+    }
+
+#ifdef HAVE_IO_LOOP
+    // Destroy the I/O loop only after all its watches are removed
+    if (io_loop_initialized) {
+        sc_io_loop_destroy(&ms->io_loop);
+    }
+#endif
+
+    if (decoder_pool_started) {
+        sc_decoder_pool_stop(&ms->decoder_pool);
+        sc_decoder_pool_join(&ms->decoder_pool);
+    }
+    if (decoder_pool_initialized) {
+        sc_decoder_pool_destroy(&ms->decoder_pool);
+    }
+
+    for (size_t i = 0; i < ms->count; ++i) {
+        struct sc_session *session = &ms->sessions[i];
+        // Destroy the screen only after the demuxer is joined, because
+        // otherwise the screen could receive new frames after destruction
+        if (session->screen_initialized) {
+            sc_screen_join(&session->screen);
+            sc_screen_destroy(&session->screen);
+        }
+        if (session->server_started) {
+            sc_server_join(&session->server);
+        }
+        if (session->server_initialized) {
+            sc_server_destroy(&session->server);
+        }
+    }
+
+    free(ms->sessions);
+    free(ms->serials);
+
+    return ret;
+}
@@ -0,0 +1,13 @@
+#ifndef SC_MULTI_SESSION_H
+#define SC_MULTI_SESSION_H
+
+#include "common.h"
+
+#include "options.h"
+#include "scrcpy.h"
+
+// Mirror the video of all the devices listed in options->multi_session
+enum scrcpy_exit_code
+scrcpy_multi_session(struct scrcpy_options *options);
+
+#endif
@@ -23,10 +23,40 @@ sc_opengl_init(struct sc_opengl *gl) {
                         SDL_GL_GetProcAddress("glTexParameteri");
     assert(gl->TexParameteri);
 
+    gl->GetError = (GLenum (*)(void))
+                   SDL_GL_GetProcAddress("glGetError");
+    assert(gl->GetError);
+
+    gl->PixelStorei = (void (*)(GLenum, GLint))
+                      SDL_GL_GetProcAddress("glPixelStorei");
+    assert(gl->PixelStorei);
+
+    gl->TexSubImage2D = (void (*)(GLenum, GLint, GLint, GLint, GLsizei,
+                                  GLsizei, GLenum, GLenum, const void *))
+                        SDL_GL_GetProcAddress("glTexSubImage2D");
+    assert(gl->TexSubImage2D);
+
+    gl->Finish = (void (*)(void)) SDL_GL_GetProcAddress("glFinish");
+    assert(gl->Finish);
+
     // optional
     gl->GenerateMipmap = (void (*)(GLenum))
                          SDL_GL_GetProcAddress("glGenerateMipmap");
 
+    // optional
+    gl->GenBuffers = (void (*)(GLsizei, GLuint *))
+                     SDL_GL_GetProcAddress("glGenBuffers");
+    gl->DeleteBuffers = (void (*)(GLsizei, const GLuint *))
+                        SDL_GL_GetProcAddress("glDeleteBuffers");
+    gl->BindBuffer = (void (*)(GLenum, GLuint))
+                     SDL_GL_GetProcAddress("glBindBuffer");
+    gl->BufferData = (void (*)(GLenum, GLsizeiptr, const void *, GLenum))
+                     SDL_GL_GetProcAddress("glBufferData");
+    gl->MapBufferRange = (void *(*)(GLenum, GLintptr, GLsizeiptr, GLbitfield))
+                         SDL_GL_GetProcAddress("glMapBufferRange");
+    gl->UnmapBuffer = (GLboolean (*)(GLenum))
+                      SDL_GL_GetProcAddress("glUnmapBuffer");
+
     const char *version = (const char *) gl->GetString(GL_VERSION);
     assert(version);
     gl->version = version;
@@ -26,6 +26,41 @@ struct sc_opengl {
 
     void
     (*GenerateMipmap)(GLenum target);
+
+    void
+    (*Finish)(void);
+
+    GLenum
+    (*GetError)(void);
+
+    void
+    (*PixelStorei)(GLenum pname, GLint param);
+
+    void
+    (*TexSubImage2D)(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                     GLsizei width, GLsizei height, GLenum format, GLenum type,
+                     const void *pixels);
+
+    // optional, for pixel buffer objects (OpenGL 3.0+ or OpenGL ES 3.0+)
+    void
+    (*GenBuffers)(GLsizei n, GLuint *buffers);
+
+    void
+    (*DeleteBuffers)(GLsizei n, const GLuint *buffers);
+
+    void
+    (*BindBuffer)(GLenum target, GLuint buffer);
+
+    void
+    (*BufferData)(GLenum target, GLsizeiptr size, const void *data,
+                  GLenum usage);
+
+    void *
+    (*MapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length,
+                      GLbitfield access);
+
+    GLboolean
+    (*UnmapBuffer)(GLenum target);
 };
 
 void
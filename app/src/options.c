@@ -23,6 +23,16 @@ const struct scrcpy_options scrcpy_options_default = {
     .video_source = SC_VIDEO_SOURCE_DISPLAY,
     .audio_source = SC_AUDIO_SOURCE_AUTO,
     .record_format = SC_RECORD_FORMAT_AUTO,
+    .record_queue_limit = 0,
+    .record_overflow = SC_RECORD_OVERFLOW_SPILL,
+    .record_prealloc = 0,
+    .record_fragment_duration = 0,
+    .screenshot_dir = NULL,
+    .screenshot_format = SC_SCREENSHOT_FORMAT_PNG,
+    .screenshot_burst = 0,
+    .replay_buffer = 0,
+    .replay_dir = NULL,
+    .replay_format = SC_RECORD_FORMAT_AUTO,
     .keyboard_input_mode = SC_KEYBOARD_INPUT_MODE_AUTO,
     .mouse_input_mode = SC_MOUSE_INPUT_MODE_AUTO,
     .gamepad_input_mode = SC_GAMEPAD_INPUT_MODE_DISABLED,
@@ -84,6 +94,11 @@ const struct scrcpy_options scrcpy_options_default = {
     .key_inject_mode = SC_KEY_INJECT_MODE_MIXED,
     .window_borderless = false,
     .mipmaps = true,
+    .pbo = true,
+    .video_low_res = false,
+    .video_partial_upload = 0,
+    .video_prepare_thread = false,
+    .render_bench = false,
     .stay_awake = false,
     .force_adb_forward = false,
     .disable_screensaver = false,
@@ -113,6 +128,21 @@ const struct scrcpy_options scrcpy_options_default = {
     .angle = NULL,
     .vd_destroy_content = true,
     .vd_system_decorations = true,
+    .capture_stream_filename = NULL,
+    .replay_stream_filename = NULL,
+    .replay_speed = 1,
+    .no_adb = false,
+    .io_engine = SC_IO_ENGINE_THREADS,
+#ifdef HAVE_IO_URING
+    .io_uring = false,
+#endif
+    .multi_session = NULL,
+    .decoder_pool_size = 0,
+    .video_decode_queue = 0,
+    .video_decoder_threads = 1,
+    .video_decoder_thread_type = SC_VIDEO_DECODER_THREAD_TYPE_AUTO,
+    .video_catch_up = 0,
+    .frame_pacing = 0,
 };
 
 enum sc_orientation
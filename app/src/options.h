@@ -20,6 +20,7 @@ enum sc_log_level {
 enum sc_record_format {
     SC_RECORD_FORMAT_AUTO,
     SC_RECORD_FORMAT_MP4,
+    SC_RECORD_FORMAT_FMP4, // fragmented MP4
     SC_RECORD_FORMAT_MKV,
     SC_RECORD_FORMAT_M4A,
     SC_RECORD_FORMAT_MKA,
@@ -39,6 +40,17 @@ sc_record_format_is_audio_only(enum sc_record_format fmt) {
         || fmt == SC_RECORD_FORMAT_WAV;
 }
 
+enum sc_record_overflow {
+    SC_RECORD_OVERFLOW_SPILL, // spill to a temporary file
+    SC_RECORD_OVERFLOW_DROP, // drop until the next key frame
+};
+
+enum sc_screenshot_format {
+    SC_SCREENSHOT_FORMAT_PNG,
+    SC_SCREENSHOT_FORMAT_JPEG,
+    SC_SCREENSHOT_FORMAT_WEBP,
+};
+
 enum sc_codec {
     SC_CODEC_H264,
     SC_CODEC_H265,
@@ -54,6 +66,17 @@ enum sc_video_source {
     SC_VIDEO_SOURCE_CAMERA,
 };
 
+enum sc_io_engine {
+    SC_IO_ENGINE_THREADS, // one blocking thread per socket
+    SC_IO_ENGINE_EPOLL, // a single I/O loop thread for all sockets
+};
+
+enum sc_video_decoder_thread_type {
+    SC_VIDEO_DECODER_THREAD_TYPE_AUTO, // slice threading (no added latency)
+    SC_VIDEO_DECODER_THREAD_TYPE_SLICE,
+    SC_VIDEO_DECODER_THREAD_TYPE_FRAME,
+};
+
 enum sc_audio_source {
     SC_AUDIO_SOURCE_AUTO, // OUTPUT for video DISPLAY, MIC for video CAMERA
     SC_AUDIO_SOURCE_OUTPUT,
@@ -248,6 +271,16 @@ struct scrcpy_options {
     enum sc_video_source video_source;
     enum sc_audio_source audio_source;
     enum sc_record_format record_format;
+    uint32_t record_queue_limit; // in bytes, 0 for unlimited
+    enum sc_record_overflow record_overflow;
+    uint32_t record_prealloc; // in bytes, 0 to disable
+    sc_tick record_fragment_duration; // only for fragmented MP4
+    const char *screenshot_dir;
+    enum sc_screenshot_format screenshot_format;
+    uint16_t screenshot_burst; // save every Nth frame, 0 to disable
+    uint16_t replay_buffer; // in seconds, 0 to disable
+    const char *replay_dir;
+    enum sc_record_format replay_format;
     enum sc_keyboard_input_mode keyboard_input_mode;
     enum sc_mouse_input_mode mouse_input_mode;
     enum sc_gamepad_input_mode gamepad_input_mode;
@@ -294,6 +327,11 @@ struct scrcpy_options {
     enum sc_key_inject_mode key_inject_mode;
     bool window_borderless;
     bool mipmaps;
+    bool pbo;
+    bool video_low_res;
+    uint8_t video_partial_upload; // max changed percentage, 0 if disabled
+    bool video_prepare_thread;
+    bool render_bench;
     bool stay_awake;
     bool force_adb_forward;
     bool disable_screensaver;
@@ -327,6 +365,21 @@ struct scrcpy_options {
     const char *start_app;
     bool vd_destroy_content;
     bool vd_system_decorations;
+    const char *capture_stream_filename;
+    const char *replay_stream_filename;
+    uint16_t replay_speed; // 0 for unthrottled
+    bool no_adb;
+    enum sc_io_engine io_engine;
+#ifdef HAVE_IO_URING
+    bool io_uring;
+#endif
+    const char *multi_session; // comma-separated serials
+    uint16_t decoder_pool_size; // 0 for the number of CPU cores
+    uint16_t video_decode_queue; // 0 to decode synchronously
+    uint16_t video_decoder_threads; // 0 for the number of CPU cores
+    enum sc_video_decoder_thread_type video_decoder_thread_type;
+    sc_tick video_catch_up; // 0 if disabled
+    sc_tick frame_pacing; // latency budget, 0 if disabled
 };
 
 extern const struct scrcpy_options scrcpy_options_default;
@@ -1,5 +1,6 @@
 #include "packet_merger.h"
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <libavutil/avutil.h>
@@ -16,6 +17,11 @@ sc_packet_merger_destroy(struct sc_packet_merger *merger) {
     free(merger->config);
 }
 
+size_t
+sc_packet_merger_get_headroom(const struct sc_packet_merger *merger) {
+    return merger->config ? merger->config_size : 0;
+}
+
 bool
 sc_packet_merger_merge(struct sc_packet_merger *merger, AVPacket *packet) {
     bool is_config = packet->pts == AV_NOPTS_VALUE;
@@ -32,16 +38,9 @@ sc_packet_merger_merge(struct sc_packet_merger *merger, AVPacket *packet) {
         memcpy(merger->config, packet->data, packet->size);
         merger->config_size = packet->size;
     } else if (merger->config) {
-        size_t config_size = merger->config_size;
-        size_t media_size = packet->size;
-
-        if (av_grow_packet(packet, config_size)) {
-            LOG_OOM();
-            return false;
-        }
-
-        memmove(packet->data + config_size, packet->data, media_size);
-        memcpy(packet->data, merger->config, config_size);
+        // The headroom has been reserved in front of the media payload
+        assert((size_t) packet->size > merger->config_size);
+        memcpy(packet->data, merger->config, merger->config_size);
 
         free(merger->config);
         merger->config = NULL;
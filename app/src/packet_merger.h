@@ -18,6 +18,10 @@
  *
  * This helper reads every input packet and modifies each media packet which
  * immediately follows a config packet to prepend the config packet payload.
+ *
+ * To avoid moving the (potentially large) media packet payload, the caller
+ * must reserve sc_packet_merger_get_headroom() bytes in front of the payload
+ * when it allocates the media packet.
  */
 
 struct sc_packet_merger {
@@ -31,11 +35,18 @@ sc_packet_merger_init(struct sc_packet_merger *merger);
 void
 sc_packet_merger_destroy(struct sc_packet_merger *merger);
 
+/**
+ * Return the number of bytes to reserve in front of the payload of the next
+ * media packet (0 if no config packet is pending)
+ */
+size_t
+sc_packet_merger_get_headroom(const struct sc_packet_merger *merger);
+
 /**
  * If the packet is a config packet, then keep its data for later.
  * Otherwise (if the packet is a media packet), then if a config packet is
- * pending, prepend the config packet to this packet (so the packet is
- * modified!).
+ * pending, write the config packet into the headroom at the start of the
+ * packet data (so the packet is modified!).
  */
 bool
 sc_packet_merger_merge(struct sc_packet_merger *merger, AVPacket *packet);
@@ -0,0 +1,124 @@
+#include "packet_pool.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+
+#include "util/log.h"
+
+void
+sc_packet_pool_init(struct sc_packet_pool *pool) {
+    for (unsigned i = 0; i < SC_PACKET_POOL_BUCKET_COUNT; ++i) {
+        pool->buckets[i] = NULL;
+    }
+
+    pool->requests = 0;
+    pool->misses = 0;
+    pool->unpooled = 0;
+}
+
+void
+sc_packet_pool_destroy(struct sc_packet_pool *pool) {
+    for (unsigned i = 0; i < SC_PACKET_POOL_BUCKET_COUNT; ++i) {
+        if (pool->buckets[i]) {
+            // The AVBufferPool is actually freed once all its buffers are
+            // released
+            av_buffer_pool_uninit(&pool->buckets[i]);
+        }
+    }
+}
+
+#ifdef SCRCPY_LAVU_HAS_BUFFER_SIZE_T
+typedef size_t sc_av_buffer_size;
+#else
+typedef int sc_av_buffer_size;
+#endif
+
+static AVBufferRef *
+sc_packet_pool_alloc_buffer(void *opaque, sc_av_buffer_size size) {
+    struct sc_packet_pool *pool = opaque;
+
+    // Only called from av_buffer_pool_get(), on the thread calling
+    // sc_packet_pool_alloc(), when no released buffer is available
+    ++pool->misses;
+
+    return av_buffer_alloc(size);
+}
+
+static int
+sc_packet_pool_get_bucket_index(size_t buffer_size) {
+    for (unsigned i = 0; i < SC_PACKET_POOL_BUCKET_COUNT; ++i) {
+        size_t bucket_size = (size_t) 1 << (SC_PACKET_POOL_MIN_SIZE_LOG2 + i);
+        if (buffer_size <= bucket_size) {
+            return i;
+        }
+    }
+
+    // Too large
+    return -1;
+}
+
+static AVBufferRef *
+sc_packet_pool_get_buffer(struct sc_packet_pool *pool, size_t buffer_size) {
+    int index = sc_packet_pool_get_bucket_index(buffer_size);
+    if (index == -1) {
+        ++pool->unpooled;
+        return av_buffer_alloc(buffer_size);
+    }
+
+    AVBufferPool *bucket = pool->buckets[index];
+    if (!bucket) {
+        size_t bucket_size =
+            (size_t) 1 << (SC_PACKET_POOL_MIN_SIZE_LOG2 + index);
+        bucket = av_buffer_pool_init2(bucket_size, pool,
+                                      sc_packet_pool_alloc_buffer, NULL);
+        if (!bucket) {
+            return NULL;
+        }
+
+        pool->buckets[index] = bucket;
+    }
+
+    return av_buffer_pool_get(bucket);
+}
+
+bool
+sc_packet_pool_alloc(struct sc_packet_pool *pool, AVPacket *packet,
+                     size_t size) {
+    assert(!packet->buf);
+
+    if (size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        LOGE("Packet too large: %" SC_PRIsizet " bytes", size);
+        return false;
+    }
+
+    ++pool->requests;
+
+    size_t buffer_size = size + AV_INPUT_BUFFER_PADDING_SIZE;
+    AVBufferRef *buf = sc_packet_pool_get_buffer(pool, buffer_size);
+    if (!buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    // Recycled buffers are not initialized, but the padding must be zeroed
+    memset(buf->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    packet->buf = buf;
+    packet->data = buf->data;
+    packet->size = size;
+
+    return true;
+}
+
+void
+sc_packet_pool_log_stats(struct sc_packet_pool *pool, const char *name) {
+    uint64_t pooled = pool->requests - pool->unpooled;
+    assert(pooled >= pool->misses);
+    uint64_t hits = pooled - pool->misses;
+    LOGD("Packet pool '%s': %" PRIu64_ " requests, %" PRIu64_ " hits, "
+         "%" PRIu64_ " misses, %" PRIu64_ " unpooled", name, pool->requests,
+         hits, pool->misses, pool->unpooled);
+}
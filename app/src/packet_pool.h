@@ -0,0 +1,63 @@
+#ifndef SC_PACKET_POOL_H
+#define SC_PACKET_POOL_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/packet.h>
+#include <libavutil/buffer.h>
+
+/**
+ * Pool of packet buffers, to avoid a new allocation for every packet received
+ * from the device.
+ *
+ * Buffers are grouped into buckets of power-of-two sizes. A buffer is
+ * recycled into its bucket once all its references (held by the decoder, the
+ * recorder, etc.) have been released.
+ *
+ * Packets too large for the biggest bucket are allocated individually.
+ */
+
+#define SC_PACKET_POOL_MIN_SIZE_LOG2 12 // 4 KiB
+#define SC_PACKET_POOL_MAX_SIZE_LOG2 22 // 4 MiB
+#define SC_PACKET_POOL_BUCKET_COUNT \
+    (SC_PACKET_POOL_MAX_SIZE_LOG2 - SC_PACKET_POOL_MIN_SIZE_LOG2 + 1)
+
+struct sc_packet_pool {
+    // lazily initialized
+    AVBufferPool *buckets[SC_PACKET_POOL_BUCKET_COUNT];
+
+    // Statistics, only accessed from the thread calling sc_packet_pool_alloc()
+    uint64_t requests;
+    uint64_t misses; // a new buffer had to be allocated for a bucket
+    uint64_t unpooled; // the packet was too large for any bucket
+};
+
+void
+sc_packet_pool_init(struct sc_packet_pool *pool);
+
+/**
+ * Release the pool
+ *
+ * The buffers still referenced by packets remain valid, they will be freed
+ * once released.
+ */
+void
+sc_packet_pool_destroy(struct sc_packet_pool *pool);
+
+/**
+ * Initialize the (unreferenced) packet with a buffer of `size` bytes
+ *
+ * This is equivalent to av_new_packet(), except that the buffer is taken from
+ * the pool if possible.
+ */
+bool
+sc_packet_pool_alloc(struct sc_packet_pool *pool, AVPacket *packet,
+                     size_t size);
+
+void
+sc_packet_pool_log_stats(struct sc_packet_pool *pool, const char *name);
+
+#endif
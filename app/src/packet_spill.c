@@ -0,0 +1,122 @@
+#include "packet_spill.h"
+
+#include <assert.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+
+// stream_index (4), flags (4), pts (8), dts (8), duration (8), size (4)
+#define SC_PACKET_SPILL_HEADER_SIZE 36
+
+void
+sc_packet_spill_init(struct sc_packet_spill *spill) {
+    // lazy initialization
+    spill->file = NULL;
+    spill->read_offset = 0;
+    spill->write_offset = 0;
+    spill->count = 0;
+}
+
+void
+sc_packet_spill_destroy(struct sc_packet_spill *spill) {
+    if (spill->file) {
+        // A file created by tmpfile() is deleted on close
+        fclose(spill->file);
+    }
+}
+
+static bool
+sc_packet_spill_seek(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+    return !_fseeki64(file, offset, SEEK_SET);
+#else
+    return !fseeko(file, offset, SEEK_SET);
+#endif
+}
+
+bool
+sc_packet_spill_write(struct sc_packet_spill *spill, const AVPacket *packet,
+                      int stream_index) {
+    assert(packet->size >= 0);
+
+    if (!spill->file) {
+        spill->file = tmpfile();
+        if (!spill->file) {
+            LOGE("Could not create temporary file");
+            return false;
+        }
+    }
+
+    uint8_t header[SC_PACKET_SPILL_HEADER_SIZE];
+    sc_write32be(&header[0], stream_index);
+    sc_write32be(&header[4], packet->flags);
+    sc_write64be(&header[8], packet->pts);
+    sc_write64be(&header[16], packet->dts);
+    sc_write64be(&header[24], packet->duration);
+    sc_write32be(&header[32], packet->size);
+
+    // The file is read and written alternately, the position must be set
+    // explicitly on each switch
+    bool ok = sc_packet_spill_seek(spill->file, spill->write_offset)
+           && fwrite(header, sizeof(header), 1, spill->file) == 1
+           && (!packet->size
+               || fwrite(packet->data, packet->size, 1, spill->file) == 1);
+    if (!ok) {
+        LOGE("Could not write to temporary file");
+        return false;
+    }
+
+    spill->write_offset += sizeof(header) + packet->size;
+    ++spill->count;
+
+    return true;
+}
+
+AVPacket *
+sc_packet_spill_read(struct sc_packet_spill *spill) {
+    assert(spill->count);
+    assert(spill->file);
+
+    uint8_t header[SC_PACKET_SPILL_HEADER_SIZE];
+    bool ok = sc_packet_spill_seek(spill->file, spill->read_offset)
+           && fread(header, sizeof(header), 1, spill->file) == 1;
+    if (!ok) {
+        LOGE("Could not read from temporary file");
+        return NULL;
+    }
+
+    uint32_t size = sc_read32be(&header[32]);
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (av_new_packet(packet, size)) {
+        LOG_OOM();
+        av_packet_free(&packet);
+        return NULL;
+    }
+
+    if (size && fread(packet->data, size, 1, spill->file) != 1) {
+        LOGE("Could not read from temporary file");
+        av_packet_free(&packet);
+        return NULL;
+    }
+
+    packet->stream_index = (int32_t) sc_read32be(&header[0]);
+    packet->flags = (int32_t) sc_read32be(&header[4]);
+    packet->pts = (int64_t) sc_read64be(&header[8]);
+    packet->dts = (int64_t) sc_read64be(&header[16]);
+    packet->duration = (int64_t) sc_read64be(&header[24]);
+
+    spill->read_offset += sizeof(header) + size;
+    if (!--spill->count) {
+        // Everything has been read, overwrite the file from the start
+        spill->read_offset = 0;
+        spill->write_offset = 0;
+    }
+
+    return packet;
+}
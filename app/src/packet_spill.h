@@ -0,0 +1,53 @@
+#ifndef SC_PACKET_SPILL_H
+#define SC_PACKET_SPILL_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <libavcodec/packet.h>
+
+/**
+ * FIFO of packets stored in a temporary file
+ *
+ * The packets are appended to the file, and read back in the same order. The
+ * file is created on the first write, and deleted on destroy. Once all the
+ * packets have been read, the file is reused from the start.
+ *
+ * It is not thread-safe.
+ */
+struct sc_packet_spill {
+    FILE *file; // NULL until the first write
+    uint64_t read_offset;
+    uint64_t write_offset;
+    size_t count; // number of packets not read yet
+};
+
+void
+sc_packet_spill_init(struct sc_packet_spill *spill);
+
+void
+sc_packet_spill_destroy(struct sc_packet_spill *spill);
+
+// Append a packet (the data and the properties used for muxing)
+//
+// The packet will be read back with the given stream index.
+bool
+sc_packet_spill_write(struct sc_packet_spill *spill, const AVPacket *packet,
+                      int stream_index);
+
+// Read the oldest packet (the spill must not be empty)
+//
+// The returned packet must be freed by the caller using av_packet_free(). It
+// returns NULL on error.
+AVPacket *
+sc_packet_spill_read(struct sc_packet_spill *spill);
+
+static inline bool
+sc_packet_spill_is_empty(struct sc_packet_spill *spill) {
+    return !spill->count;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "pbo_ring.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "util/log.h"
+
+// Alignment of each plane in a pixel buffer
+#define SC_PBO_RING_PLANE_ALIGN 64
+
+bool
+sc_pbo_ring_is_supported(struct sc_opengl *gl) {
+    bool version_ok =
+        sc_opengl_version_at_least(gl, 3, 0, /* OpenGL 3.0+ */
+                                       3, 0  /* OpenGL ES 3.0+ */);
+    return version_ok
+        && gl->GenBuffers
+        && gl->DeleteBuffers
+        && gl->BindBuffer
+        && gl->BufferData
+        && gl->MapBufferRange
+        && gl->UnmapBuffer;
+}
+
+bool
+sc_pbo_ring_init(struct sc_pbo_ring *ring, struct sc_opengl *gl) {
+    assert(sc_pbo_ring_is_supported(gl));
+
+    ring->gl = gl;
+    gl->GenBuffers(SC_PBO_RING_SIZE, ring->buffers);
+    for (unsigned i = 0; i < SC_PBO_RING_SIZE; ++i) {
+        if (!ring->buffers[i]) {
+            LOGE("Could not generate pixel buffers");
+            gl->DeleteBuffers(SC_PBO_RING_SIZE, ring->buffers);
+            return false;
+        }
+        ring->sizes[i] = 0;
+    }
+
+    ring->next = 0;
+    return true;
+}
+
+void
+sc_pbo_ring_destroy(struct sc_pbo_ring *ring) {
+    ring->gl->DeleteBuffers(SC_PBO_RING_SIZE, ring->buffers);
+}
+
+static inline size_t
+sc_pbo_ring_align(size_t size) {
+    return (size + SC_PBO_RING_PLANE_ALIGN - 1)
+         & ~(size_t) (SC_PBO_RING_PLANE_ALIGN - 1);
+}
+
+// Copy the planes into the buffer currently bound to GL_PIXEL_UNPACK_BUFFER
+static bool
+sc_pbo_ring_fill(struct sc_pbo_ring *ring, size_t size,
+                 const struct sc_pbo_ring_plane *planes, unsigned count,
+                 const size_t *offsets) {
+    struct sc_opengl *gl = ring->gl;
+
+    // Invalidate the previous content, so that the driver never waits for
+    // a pending transfer from this buffer
+    uint8_t *dst = gl->MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                      GL_MAP_WRITE_BIT
+                                          | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dst) {
+        LOGE("Could not map pixel buffer");
+        return false;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        const struct sc_pbo_ring_plane *plane = &planes[i];
+        // Copy the padding too, to copy each plane in a single call
+        memcpy(dst + offsets[i], plane->data,
+               (size_t) plane->linesize * plane->height);
+    }
+
+    if (!gl->UnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        // The buffer content has been corrupted (rare)
+        LOGE("Could not unmap pixel buffer");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+sc_pbo_ring_upload(struct sc_pbo_ring *ring, GLenum target, GLenum format,
+                   const struct sc_pbo_ring_plane *planes, unsigned count) {
+    struct sc_opengl *gl = ring->gl;
+
+    size_t offsets[4];
+    assert(count <= ARRAY_LEN(offsets));
+
+    size_t size = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        assert(planes[i].linesize >= (int) planes[i].width);
+        offsets[i] = size;
+        size = sc_pbo_ring_align(size + (size_t) planes[i].linesize
+                                             * planes[i].height);
+    }
+
+    // Clear the errors not caused by this function (the number of iterations
+    // is bounded, in case the context is lost)
+    for (unsigned i = 0; i < 8; ++i) {
+        if (gl->GetError() == GL_NO_ERROR) {
+            break;
+        }
+    }
+
+    unsigned index = ring->next;
+    gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->buffers[index]);
+
+    if (size > ring->sizes[index]) {
+        gl->BufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        ring->sizes[index] = size;
+    }
+
+    bool ok = sc_pbo_ring_fill(ring, ring->sizes[index], planes, count,
+                               offsets);
+    if (ok) {
+        gl->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned i = 0; i < count; ++i) {
+            const struct sc_pbo_ring_plane *plane = &planes[i];
+            gl->PixelStorei(GL_UNPACK_ROW_LENGTH, plane->linesize);
+            gl->BindTexture(target, plane->texture);
+            // With a buffer bound to GL_PIXEL_UNPACK_BUFFER, the last argument
+            // is an offset in that buffer
+            gl->TexSubImage2D(target, 0, 0, 0, plane->width, plane->height,
+                              format, GL_UNSIGNED_BYTE,
+                              (const void *) (uintptr_t) offsets[i]);
+        }
+        gl->PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        gl->BindTexture(target, 0);
+    }
+
+    // Never leave a pixel buffer bound, SDL uploads from client memory
+    gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    ring->next = (index + 1) % SC_PBO_RING_SIZE;
+
+    if (!ok) {
+        return false;
+    }
+
+    GLenum error = gl->GetError();
+    if (error != GL_NO_ERROR) {
+        LOGE("Could not upload pixel buffer: OpenGL error 0x%x",
+             (unsigned) error);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef SC_PBO_RING_H
+#define SC_PBO_RING_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "opengl.h"
+
+#define SC_PBO_RING_SIZE 3
+
+/**
+ * Ring of OpenGL pixel buffer objects, to stream the frames to the textures
+ *
+ * The planes are copied into the next pixel buffer, then the textures are
+ * updated from it by glTexSubImage2D(). This call returns immediately: the
+ * transfer to the texture is performed asynchronously by the driver, while the
+ * next frame is copied into another buffer of the ring.
+ *
+ * The OpenGL context of the renderer must be current on each call.
+ */
+struct sc_pbo_ring {
+    struct sc_opengl *gl;
+    GLuint buffers[SC_PBO_RING_SIZE];
+    size_t sizes[SC_PBO_RING_SIZE]; // allocated size of each buffer
+    unsigned next; // index of the next buffer to fill
+};
+
+struct sc_pbo_ring_plane {
+    GLuint texture;
+    const uint8_t *data;
+    int linesize;
+    unsigned width;
+    unsigned height;
+};
+
+// Return true if the OpenGL version and functions allow to use a PBO ring
+bool
+sc_pbo_ring_is_supported(struct sc_opengl *gl);
+
+bool
+sc_pbo_ring_init(struct sc_pbo_ring *ring, struct sc_opengl *gl);
+
+void
+sc_pbo_ring_destroy(struct sc_pbo_ring *ring);
+
+/**
+ * Upload the planes to their textures, through the next pixel buffer
+ *
+ * The textures must have been allocated with the given target and format
+ * (and GL_UNSIGNED_BYTE components), at the size of their plane.
+ */
+bool
+sc_pbo_ring_upload(struct sc_pbo_ring *ring, GLenum target, GLenum format,
+                   const struct sc_pbo_ring_plane *planes, unsigned count);
+
+#endif
@@ -0,0 +1,223 @@
+#include "prepare_thread.h"
+
+#include <assert.h>
+
+#include "events.h"
+#include "util/log.h"
+
+static int
+run_prepare_thread(void *data) {
+    struct sc_prepare_thread *pt = data;
+
+    for (;;) {
+        sc_mutex_lock(&pt->mutex);
+        // Wait for the previous upload to be consumed by the main thread
+        while (!pt->stopped
+                && (pt->prepared
+                    || (!pt->has_pending_frame
+                        && (!pt->has_frame
+                            || pt->low_res == pt->prepared_low_res)))) {
+            sc_cond_wait(&pt->cond, &pt->mutex);
+        }
+
+        if (pt->stopped) {
+            sc_mutex_unlock(&pt->mutex);
+            break;
+        }
+
+        bool new_frame = pt->has_pending_frame;
+        if (new_frame) {
+            av_frame_unref(pt->frame);
+            av_frame_move_ref(pt->frame, pt->pending_frame);
+            pt->has_pending_frame = false;
+            pt->has_frame = true;
+        }
+        bool low_res = pt->low_res;
+        sc_mutex_unlock(&pt->mutex);
+
+        if (low_res != pt->prepared_low_res) {
+            LOGD("Low resolution rendering %s",
+                 low_res ? "enabled" : "disabled");
+        }
+
+        // Not protected by the mutex: the main thread does not access the
+        // current frame and the upload until prepared is set
+        bool ok = sc_display_upload_prepare(&pt->upload, pt->frame, low_res);
+        pt->prepared_low_res = low_res;
+
+        sc_mutex_lock(&pt->mutex);
+        pt->prepared = true;
+        pt->prepared_ok = ok;
+        pt->prepared_new_frame = new_frame;
+        sc_mutex_unlock(&pt->mutex);
+
+        sc_push_event_with_data(SC_EVENT_FRAME_PREPARED, pt->event_data);
+    }
+
+    return 0;
+}
+
+bool
+sc_prepare_thread_start(struct sc_prepare_thread *pt,
+                        const struct sc_prepare_thread_params *params) {
+    pt->fps_counter = params->fps_counter;
+    pt->event_data = params->event_data;
+
+    pt->stopped = false;
+    pt->has_pending_frame = false;
+    pt->low_res = false;
+    pt->prepared = false;
+    pt->prepared_ok = false;
+    pt->prepared_new_frame = false;
+    pt->has_frame = false;
+    pt->prepared_low_res = false;
+
+    sc_display_upload_init(&pt->upload);
+    bool ok = sc_display_upload_set_partial(&pt->upload,
+                                            params->partial_upload);
+    if (!ok) {
+        return false;
+    }
+
+    pt->pending_frame = av_frame_alloc();
+    if (!pt->pending_frame) {
+        LOG_OOM();
+        goto error_destroy_upload;
+    }
+
+    pt->frame = av_frame_alloc();
+    if (!pt->frame) {
+        LOG_OOM();
+        goto error_free_pending_frame;
+    }
+
+    ok = sc_mutex_init(&pt->mutex);
+    if (!ok) {
+        goto error_free_frame;
+    }
+
+    ok = sc_cond_init(&pt->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    LOGD("Starting preparation thread");
+
+    ok = sc_thread_create(&pt->thread, run_prepare_thread, "scrcpy-prepare",
+                          pt);
+    if (!ok) {
+        LOGE("Could not start preparation thread");
+        goto error_destroy_cond;
+    }
+
+    return true;
+
+error_destroy_cond:
+    sc_cond_destroy(&pt->cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&pt->mutex);
+error_free_frame:
+    av_frame_free(&pt->frame);
+error_free_pending_frame:
+    av_frame_free(&pt->pending_frame);
+error_destroy_upload:
+    sc_display_upload_destroy(&pt->upload);
+
+    return false;
+}
+
+void
+sc_prepare_thread_stop(struct sc_prepare_thread *pt) {
+    sc_mutex_lock(&pt->mutex);
+    pt->stopped = true;
+    sc_cond_signal(&pt->cond);
+    sc_mutex_unlock(&pt->mutex);
+}
+
+void
+sc_prepare_thread_join(struct sc_prepare_thread *pt) {
+    sc_thread_join(&pt->thread, NULL);
+}
+
+void
+sc_prepare_thread_destroy(struct sc_prepare_thread *pt) {
+    sc_cond_destroy(&pt->cond);
+    sc_mutex_destroy(&pt->mutex);
+    av_frame_free(&pt->frame);
+    av_frame_free(&pt->pending_frame);
+    sc_display_upload_destroy(&pt->upload);
+}
+
+void
+sc_prepare_thread_push_frame(struct sc_prepare_thread *pt, AVFrame *frame) {
+    sc_mutex_lock(&pt->mutex);
+    bool skipped = pt->has_pending_frame;
+    av_frame_unref(pt->pending_frame);
+    av_frame_move_ref(pt->pending_frame, frame);
+    pt->has_pending_frame = true;
+    sc_cond_signal(&pt->cond);
+    sc_mutex_unlock(&pt->mutex);
+
+    if (skipped) {
+        // The previous frame was not prepared in time
+        sc_fps_counter_add_skipped_frame(pt->fps_counter);
+    }
+}
+
+enum sc_display_result
+sc_prepare_thread_upload(struct sc_prepare_thread *pt,
+                         struct sc_display *display) {
+    sc_mutex_lock(&pt->mutex);
+    if (!pt->prepared) {
+        sc_mutex_unlock(&pt->mutex);
+        return SC_DISPLAY_RESULT_PENDING;
+    }
+
+    enum sc_display_result res;
+    if (pt->prepared_ok) {
+        res = sc_display_upload(display, &pt->upload);
+        if (res == SC_DISPLAY_RESULT_OK && pt->prepared_new_frame) {
+            sc_fps_counter_add_rendered_frame(pt->fps_counter);
+        }
+    } else {
+        LOGE("Could not prepare frame upload");
+        res = SC_DISPLAY_RESULT_ERROR;
+    }
+
+    // The preparation thread may prepare the next frame
+    pt->prepared = false;
+    sc_cond_signal(&pt->cond);
+    sc_mutex_unlock(&pt->mutex);
+
+    return res;
+}
+
+bool
+sc_prepare_thread_screenshot(struct sc_prepare_thread *pt,
+                             struct sc_screenshot *ss) {
+    bool ok;
+
+    // The current frame is only replaced with the mutex locked
+    sc_mutex_lock(&pt->mutex);
+    if (pt->has_pending_frame) {
+        ok = sc_screenshot_push(ss, pt->pending_frame);
+    } else if (pt->has_frame) {
+        ok = sc_screenshot_push(ss, pt->frame);
+    } else {
+        // No frame yet
+        ok = false;
+    }
+    sc_mutex_unlock(&pt->mutex);
+
+    return ok;
+}
+
+void
+sc_prepare_thread_set_low_res(struct sc_prepare_thread *pt, bool low_res) {
+    sc_mutex_lock(&pt->mutex);
+    if (pt->low_res != low_res) {
+        pt->low_res = low_res;
+        sc_cond_signal(&pt->cond);
+    }
+    sc_mutex_unlock(&pt->mutex);
+}
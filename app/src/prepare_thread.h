@@ -0,0 +1,100 @@
+#ifndef SC_PREPARE_THREAD_H
+#define SC_PREPARE_THREAD_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavutil/frame.h>
+
+#include "display.h"
+#include "fps_counter.h"
+#include "screenshot.h"
+#include "util/thread.h"
+
+/**
+ * Thread preparing the frames for their upload
+ *
+ * This is not a render thread: SDL requires the renderer to be created and
+ * used from the main thread (its state is also updated by SDL on window
+ * events, from the thread handling the events), so the texture uploads and
+ * SDL_RenderPresent() are still executed on the main thread. Only the
+ * CPU-side part of the texture updates (the downscaling in low resolution
+ * mode and the detection of the changed regions for partial uploads, see
+ * struct sc_display_upload) is moved to this thread.
+ *
+ * Once a frame is prepared, a SC_EVENT_FRAME_PREPARED is posted, and the
+ * main thread uploads it by calling sc_prepare_thread_upload(). The next
+ * frame is not prepared before the previous one is uploaded. Only the most
+ * recent pending frame is kept: if the preparation thread is late, the
+ * previous pending frame is skipped.
+ */
+struct sc_prepare_thread {
+    struct sc_fps_counter *fps_counter;
+    void *event_data; // data of the SC_EVENT_FRAME_PREPARED event
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+
+    // The following fields are protected by the mutex
+    bool stopped;
+    AVFrame *pending_frame;
+    bool has_pending_frame;
+    bool low_res;
+    // Set once the upload is prepared, until it is uploaded by the main thread
+    bool prepared;
+    bool prepared_ok;
+    bool prepared_new_frame; // false if the current frame was prepared again
+
+    // The following fields are only accessed by the preparation thread, or by
+    // the main thread while the upload is prepared
+    AVFrame *frame; // the current frame (referenced by the upload)
+    bool has_frame;
+    bool prepared_low_res; // the mode of the last preparation
+    struct sc_display_upload upload;
+};
+
+struct sc_prepare_thread_params {
+    struct sc_fps_counter *fps_counter;
+    void *event_data;
+
+    uint8_t partial_upload; // max changed percentage, 0 to disable
+};
+
+bool
+sc_prepare_thread_start(struct sc_prepare_thread *pt,
+                        const struct sc_prepare_thread_params *params);
+
+// Request to stop the thread
+void
+sc_prepare_thread_stop(struct sc_prepare_thread *pt);
+
+void
+sc_prepare_thread_join(struct sc_prepare_thread *pt);
+
+void
+sc_prepare_thread_destroy(struct sc_prepare_thread *pt);
+
+// Prepare the upload of the frame (moved from the given frame)
+void
+sc_prepare_thread_push_frame(struct sc_prepare_thread *pt, AVFrame *frame);
+
+// Upload the prepared frame to the display texture (from the main thread, on
+// SC_EVENT_FRAME_PREPARED)
+//
+// Return SC_DISPLAY_RESULT_PENDING if there is nothing to render.
+enum sc_display_result
+sc_prepare_thread_upload(struct sc_prepare_thread *pt,
+                         struct sc_display *display);
+
+// Request to save the current frame (the most recent one pushed)
+bool
+sc_prepare_thread_screenshot(struct sc_prepare_thread *pt,
+                             struct sc_screenshot *ss);
+
+// Prepare the next frames (and the current one) at half their resolution
+void
+sc_prepare_thread_set_low_res(struct sc_prepare_thread *pt, bool low_res);
+
+#endif
@@ -182,45 +182,98 @@ process_msgs(struct sc_receiver *receiver, const uint8_t *buf, size_t len) {
     }
 }
 
+static bool
+sc_receiver_process_buffer(struct sc_receiver *receiver) {
+    struct sc_net_reader *reader = &receiver->reader;
+
+    ssize_t consumed = process_msgs(receiver, sc_net_reader_data(reader),
+                                    reader->size);
+    if (consumed == -1) {
+        // an error occurred
+        return false;
+    }
+
+    sc_net_reader_consume(reader, consumed);
+    return true;
+}
+
+static bool
+sc_receiver_open_reader(struct sc_receiver *receiver) {
+    // A device message never exceeds DEVICE_MSG_MAX_SIZE, so an incomplete
+    // message always fits in the reader buffer
+    return sc_net_reader_init(&receiver->reader, receiver->control_socket,
+                              DEVICE_MSG_MAX_SIZE);
+}
+
 static int
 run_receiver(void *data) {
     struct sc_receiver *receiver = data;
 
-    static uint8_t buf[DEVICE_MSG_MAX_SIZE];
-    size_t head = 0;
-
     bool error = false;
 
+    bool ok = sc_receiver_open_reader(receiver);
+    if (!ok) {
+        error = true;
+        goto end;
+    }
+
     for (;;) {
-        assert(head < DEVICE_MSG_MAX_SIZE);
-        ssize_t r = net_recv(receiver->control_socket, buf + head,
-                             DEVICE_MSG_MAX_SIZE - head);
+        ssize_t r = sc_net_reader_fill(&receiver->reader);
         if (r <= 0) {
             LOGD("Receiver stopped");
             // device disconnected: keep error=false
             break;
         }
 
-        head += r;
-        ssize_t consumed = process_msgs(receiver, buf, head);
-        if (consumed == -1) {
-            // an error occurred
+        if (!sc_receiver_process_buffer(receiver)) {
             error = true;
             break;
         }
-
-        if (consumed) {
-            head -= consumed;
-            // shift the remaining data in the buffer
-            memmove(buf, &buf[consumed], head);
-        }
     }
 
+    sc_net_reader_destroy(&receiver->reader);
+
+end:
     receiver->cbs->on_ended(receiver, error, receiver->cbs_userdata);
 
     return 0;
 }
 
+#ifdef HAVE_IO_LOOP
+bool
+sc_receiver_open_io(struct sc_receiver *receiver) {
+    return sc_receiver_open_reader(receiver);
+}
+
+bool
+sc_receiver_process_io(struct sc_receiver *receiver, bool *error) {
+    ssize_t r = sc_net_reader_fill(&receiver->reader);
+    if (r == -1 && net_would_block()) {
+        // Spurious wakeup
+        return true;
+    }
+
+    if (r <= 0) {
+        LOGD("Receiver stopped");
+        // device disconnected: keep error=false
+        *error = false;
+        return false;
+    }
+
+    if (!sc_receiver_process_buffer(receiver)) {
+        *error = true;
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_receiver_close_io(struct sc_receiver *receiver) {
+    sc_net_reader_destroy(&receiver->reader);
+}
+#endif
+
 bool
 sc_receiver_start(struct sc_receiver *receiver) {
     LOGD("Starting receiver thread");
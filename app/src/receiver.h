@@ -14,6 +14,7 @@
 // managed by the controller
 struct sc_receiver {
     sc_socket control_socket;
+    struct sc_net_reader reader;
     sc_thread thread;
     sc_mutex mutex;
 
@@ -40,6 +41,21 @@ sc_receiver_start(struct sc_receiver *receiver);
 
 // no sc_receiver_stop(), it will automatically stop on control_socket shutdown
 
+#ifdef HAVE_IO_LOOP
+// Non-blocking receiving, driven by the controller from the I/O loop (instead
+// of the receiver thread)
+bool
+sc_receiver_open_io(struct sc_receiver *receiver);
+
+// To be called when the control socket is readable.
+// Return false if the receiver must stop (the on_ended callback is not called).
+bool
+sc_receiver_process_io(struct sc_receiver *receiver, bool *error);
+
+void
+sc_receiver_close_io(struct sc_receiver *receiver);
+#endif
+
 void
 sc_receiver_join(struct sc_receiver *receiver);
 
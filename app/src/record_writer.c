@@ -0,0 +1,481 @@
+#include "record_writer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+#ifdef __linux__
+# include <fcntl.h>
+#endif
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+#include "util/log.h"
+#ifdef _WIN32
+# include "util/str.h"
+#endif
+
+// Size of each of the two buffers written by the writer thread
+#define SC_RECORD_WRITER_BUFFER_SIZE (2 * 1024 * 1024)
+// Size of the AVIOContext internal buffer
+#define SC_RECORD_WRITER_AVIO_BUFFER_SIZE (64 * 1024)
+
+static FILE *
+sc_record_writer_fopen(const char *filename) {
+#ifdef _WIN32
+    // fopen() does not support UTF-8 paths on Windows
+    wchar_t *wide = sc_str_to_wchars(filename);
+    if (!wide) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    FILE *file = _wfopen(wide, L"wb");
+    free(wide);
+    return file;
+#else
+    return fopen(filename, "wb");
+#endif
+}
+
+// Write the buffer at the given file offset (the file position is only used
+// by the writer thread)
+static bool
+sc_record_writer_write_at(FILE *file, const uint8_t *buf, size_t size,
+                          uint64_t offset) {
+#ifdef _WIN32
+    if (_fseeki64(file, offset, SEEK_SET)) {
+        return false;
+    }
+
+    return fwrite(buf, size, 1, file) == 1;
+#else
+    int fd = fileno(file);
+    while (size) {
+        ssize_t w = pwrite(fd, buf, size, offset);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        assert((size_t) w <= size);
+        buf += w;
+        size -= w;
+        offset += w;
+    }
+
+    return true;
+#endif
+}
+
+#ifdef __linux__
+static void
+sc_record_writer_prealloc(struct sc_record_writer *writer, uint64_t end) {
+    // Keep at least half a chunk allocated ahead
+    if (end + writer->prealloc / 2 <= writer->prealloc_end) {
+        return;
+    }
+
+    int fd = fileno(writer->file);
+    uint64_t offset = MAX(end, writer->prealloc_end);
+    // FALLOC_FL_KEEP_SIZE: the file size is only increased by the writes
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, writer->prealloc)) {
+        LOGW("Could not preallocate the output file: %s", strerror(errno));
+        // Do not retry on every write
+        writer->prealloc = 0;
+        return;
+    }
+
+    writer->prealloc_end = offset + writer->prealloc;
+}
+#endif
+
+static void
+sc_record_writer_on_written(struct sc_record_writer *writer, uint64_t offset,
+                            size_t size) {
+#ifdef __linux__
+    sc_record_writer_prealloc(writer, offset + size);
+
+    if (writer->written_size) {
+        // The data will never be read back: drop the previous buffer (its
+        // writeback has been started) from the page cache
+        int fd = fileno(writer->file);
+        posix_fadvise(fd, writer->written_offset, writer->written_size,
+                      POSIX_FADV_DONTNEED);
+    }
+#endif
+
+    writer->written_offset = offset;
+    writer->written_size = size;
+}
+
+static int
+run_record_writer(void *data) {
+    struct sc_record_writer *writer = data;
+
+    for (;;) {
+        sc_mutex_lock(&writer->mutex);
+        while (!writer->stopped && !writer->pending) {
+            sc_cond_wait(&writer->cond, &writer->mutex);
+        }
+
+        // Write the pending buffer even if stopped
+        if (!writer->pending) {
+            assert(writer->stopped);
+            sc_mutex_unlock(&writer->mutex);
+            break;
+        }
+
+        const uint8_t *buf = writer->pending;
+        size_t size = writer->pending_size;
+        uint64_t offset = writer->pending_offset;
+        sc_mutex_unlock(&writer->mutex);
+
+        sc_tick start = sc_tick_now();
+        bool ok = sc_record_writer_write_at(writer->file, buf, size, offset);
+        sc_tick duration = sc_tick_now() - start;
+
+        if (ok) {
+            writer->bytes_written += size;
+            ++writer->writes;
+            writer->total_write_duration += duration;
+            writer->max_write_duration =
+                MAX(writer->max_write_duration, duration);
+
+            if (writer->prealloc) {
+                sc_record_writer_on_written(writer, offset, size);
+            }
+        } else {
+            LOGE("Could not write to output file");
+        }
+
+        sc_mutex_lock(&writer->mutex);
+        writer->pending = NULL;
+        writer->failed = !ok;
+        sc_cond_signal(&writer->done_cond);
+        sc_mutex_unlock(&writer->mutex);
+
+        if (!ok) {
+            break;
+        }
+    }
+
+    LOGD("Record writer stopped");
+
+    return 0;
+}
+
+// Wait for the pending buffer (if any) to be written
+static bool
+sc_record_writer_wait(struct sc_record_writer *writer) {
+    sc_mutex_lock(&writer->mutex);
+    while (writer->pending && !writer->failed) {
+        sc_cond_wait(&writer->done_cond, &writer->mutex);
+    }
+    bool ok = !writer->failed;
+    sc_mutex_unlock(&writer->mutex);
+
+    return ok;
+}
+
+// Pass the current buffer to the writer thread, and fill the other one
+static bool
+sc_record_writer_submit(struct sc_record_writer *writer) {
+    assert(writer->filled);
+
+    sc_mutex_lock(&writer->mutex);
+    // The other buffer must have been written before it is reused
+    while (writer->pending && !writer->failed) {
+        sc_cond_wait(&writer->done_cond, &writer->mutex);
+    }
+
+    bool ok = !writer->failed;
+    if (ok) {
+        writer->pending = writer->buffers[writer->current];
+        writer->pending_size = writer->filled;
+        writer->pending_offset = writer->offset;
+        sc_cond_signal(&writer->cond);
+    }
+    sc_mutex_unlock(&writer->mutex);
+
+    if (!ok) {
+        return false;
+    }
+
+    writer->offset += writer->filled;
+    writer->filled = 0;
+    writer->current ^= 1;
+
+    return true;
+}
+
+// Write all the buffered data to the file
+static bool
+sc_record_writer_drain(struct sc_record_writer *writer) {
+    if (writer->filled && !sc_record_writer_submit(writer)) {
+        return false;
+    }
+
+    return sc_record_writer_wait(writer);
+}
+
+static int
+#ifdef SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+sc_record_writer_write_packet(void *opaque, const uint8_t *buf, int buf_size) {
+#else
+sc_record_writer_write_packet(void *opaque, uint8_t *buf, int buf_size) {
+#endif
+    struct sc_record_writer *writer = opaque;
+
+    assert(buf_size >= 0);
+    size_t remaining = buf_size;
+
+    writer->size = MAX(writer->size,
+                       writer->offset + writer->filled + remaining);
+
+    while (remaining) {
+        size_t len = MIN(remaining,
+                         SC_RECORD_WRITER_BUFFER_SIZE - writer->filled);
+        memcpy(writer->buffers[writer->current] + writer->filled, buf, len);
+        writer->filled += len;
+        buf += len;
+        remaining -= len;
+
+        if (writer->filled == SC_RECORD_WRITER_BUFFER_SIZE) {
+            if (!sc_record_writer_submit(writer)) {
+                return AVERROR(EIO);
+            }
+        }
+    }
+
+    return buf_size;
+}
+
+static int64_t
+sc_record_writer_seek(void *opaque, int64_t offset, int whence) {
+    struct sc_record_writer *writer = opaque;
+
+    whence &= ~AVSEEK_FORCE;
+
+    int64_t target;
+    switch (whence) {
+        case AVSEEK_SIZE:
+            return writer->size;
+        case SEEK_SET:
+            target = offset;
+            break;
+        case SEEK_CUR:
+            target = writer->offset + writer->filled + offset;
+            break;
+        case SEEK_END:
+            target = writer->size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+
+    // Each buffer is written at its own offset: the data buffered so far are
+    // submitted, without waiting for them to be written
+    if (writer->filled && !sc_record_writer_submit(writer)) {
+        return AVERROR(EIO);
+    }
+
+    writer->offset = target;
+    return target;
+}
+
+bool
+sc_record_writer_open(struct sc_record_writer *writer, const char *filename,
+                      uint32_t prealloc) {
+    writer->file = sc_record_writer_fopen(filename);
+    if (!writer->file) {
+        LOGE("Failed to open output file: %s", filename);
+        return false;
+    }
+
+    // The data are already buffered
+    setvbuf(writer->file, NULL, _IONBF, 0);
+
+    // av_malloc() returns memory aligned for SIMD
+    writer->buffers[0] = av_malloc(SC_RECORD_WRITER_BUFFER_SIZE);
+    if (!writer->buffers[0]) {
+        LOG_OOM();
+        goto error_close_file;
+    }
+
+    writer->buffers[1] = av_malloc(SC_RECORD_WRITER_BUFFER_SIZE);
+    if (!writer->buffers[1]) {
+        LOG_OOM();
+        goto error_free_buffer0;
+    }
+
+    uint8_t *avio_buffer = av_malloc(SC_RECORD_WRITER_AVIO_BUFFER_SIZE);
+    if (!avio_buffer) {
+        LOG_OOM();
+        goto error_free_buffer1;
+    }
+
+    writer->avio = avio_alloc_context(avio_buffer,
+                                      SC_RECORD_WRITER_AVIO_BUFFER_SIZE, 1,
+                                      writer, NULL,
+                                      sc_record_writer_write_packet,
+                                      sc_record_writer_seek);
+    if (!writer->avio) {
+        LOG_OOM();
+        av_free(avio_buffer);
+        goto error_free_buffer1;
+    }
+
+    bool ok = sc_mutex_init(&writer->mutex);
+    if (!ok) {
+        goto error_free_avio;
+    }
+
+    ok = sc_cond_init(&writer->cond);
+    if (!ok) {
+        goto error_mutex_destroy;
+    }
+
+    ok = sc_cond_init(&writer->done_cond);
+    if (!ok) {
+        goto error_cond_destroy;
+    }
+
+    writer->stopped = false;
+    writer->current = 0;
+    writer->filled = 0;
+    writer->offset = 0;
+    writer->size = 0;
+    writer->pending = NULL;
+    writer->pending_size = 0;
+    writer->pending_offset = 0;
+    writer->failed = false;
+    writer->prealloc_end = 0;
+    writer->written_offset = 0;
+    writer->written_size = 0;
+    writer->bytes_written = 0;
+    writer->writes = 0;
+    writer->total_write_duration = 0;
+    writer->max_write_duration = 0;
+
+#ifdef __linux__
+    writer->prealloc = prealloc;
+    if (prealloc) {
+        int fd = fileno(writer->file);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        sc_record_writer_prealloc(writer, 0);
+    }
+#else
+    if (prealloc) {
+        LOGW("Output file preallocation is only supported on Linux");
+    }
+    writer->prealloc = 0;
+#endif
+
+    LOGD("Starting record writer thread");
+    ok = sc_thread_create(&writer->thread, run_record_writer,
+                          "scrcpy-recwrite", writer);
+    if (!ok) {
+        LOGE("Could not start record writer thread");
+        goto error_done_cond_destroy;
+    }
+
+    return true;
+
+error_done_cond_destroy:
+    sc_cond_destroy(&writer->done_cond);
+error_cond_destroy:
+    sc_cond_destroy(&writer->cond);
+error_mutex_destroy:
+    sc_mutex_destroy(&writer->mutex);
+error_free_avio:
+    av_freep(&writer->avio->buffer);
+    avio_context_free(&writer->avio);
+error_free_buffer1:
+    av_free(writer->buffers[1]);
+error_free_buffer0:
+    av_free(writer->buffers[0]);
+error_close_file:
+    fclose(writer->file);
+
+    return false;
+}
+
+bool
+sc_record_writer_flush(struct sc_record_writer *writer) {
+    avio_flush(writer->avio);
+    if (writer->avio->error) {
+        return false;
+    }
+
+    return !writer->filled || sc_record_writer_submit(writer);
+}
+
+static void
+sc_record_writer_log_stats(struct sc_record_writer *writer) {
+    if (!writer->writes) {
+        return;
+    }
+
+    sc_tick total_us = MAX(1, SC_TICK_TO_US(writer->total_write_duration));
+    // bytes per microsecond are megabytes per second
+    double throughput = (double) writer->bytes_written / total_us;
+    sc_tick avg = writer->total_write_duration / (sc_tick) writer->writes;
+
+    LOGD("Record writer: %" PRIu64_ " bytes in %" PRIu64_ " writes, "
+         "%.1f MB/s, latency avg %" PRItick " us, max %" PRItick " us",
+         writer->bytes_written, writer->writes, throughput,
+         SC_TICK_TO_US(avg), SC_TICK_TO_US(writer->max_write_duration));
+}
+
+bool
+sc_record_writer_close(struct sc_record_writer *writer) {
+    // Flush the AVIOContext internal buffer to the writer buffers, then the
+    // writer buffers to the file
+    avio_flush(writer->avio);
+    bool ok = !writer->avio->error && sc_record_writer_drain(writer);
+
+    sc_mutex_lock(&writer->mutex);
+    writer->stopped = true;
+    sc_cond_signal(&writer->cond);
+    sc_mutex_unlock(&writer->mutex);
+
+    sc_thread_join(&writer->thread, NULL);
+
+#ifdef __linux__
+    if (writer->prealloc_end > writer->size) {
+        // Release the space preallocated beyond the end of the file
+        int fd = fileno(writer->file);
+        if (ftruncate(fd, writer->size)) {
+            LOGW("Could not release the preallocated space: %s",
+                 strerror(errno));
+        }
+    }
+#endif
+
+    if (fclose(writer->file)) {
+        LOGE("Could not close output file");
+        ok = false;
+    }
+
+    sc_record_writer_log_stats(writer);
+
+    sc_cond_destroy(&writer->done_cond);
+    sc_cond_destroy(&writer->cond);
+    sc_mutex_destroy(&writer->mutex);
+    av_freep(&writer->avio->buffer);
+    avio_context_free(&writer->avio);
+    av_free(writer->buffers[1]);
+    av_free(writer->buffers[0]);
+
+    return ok;
+}
@@ -0,0 +1,91 @@
+#ifndef SC_RECORD_WRITER_H
+#define SC_RECORD_WRITER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <libavformat/avio.h>
+
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Output file of the recorder, written from a separate thread
+ *
+ * It exposes an AVIOContext to be used by the muxer. The muxed data are
+ * copied to large buffers (two of them, alternately filled by the muxer and
+ * written to the file by the writer thread), so that the recorder thread
+ * never blocks on small write() calls.
+ *
+ * Each buffer is written at its own file offset, so seeking (the muxers seek
+ * back to finalize the headers) does not wait for the pending data to be
+ * written.
+ */
+struct sc_record_writer {
+    FILE *file;
+    AVIOContext *avio;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond; // signaled when a buffer is submitted or on stop
+    sc_cond done_cond; // signaled when the pending buffer is written
+    bool stopped;
+
+    uint8_t *buffers[2];
+
+    // The following fields are only accessed by the muxer (recorder thread)
+    unsigned current; // index of the buffer being filled
+    size_t filled;
+    uint64_t offset; // file offset of the buffer being filled
+    uint64_t size; // file size
+
+    // The following fields are protected by the mutex
+    const uint8_t *pending; // buffer to be written, NULL if none
+    size_t pending_size;
+    uint64_t pending_offset; // file offset to write the pending buffer at
+    bool failed;
+
+    // The following fields are only accessed by the writer thread (or after
+    // the writer thread is joined)
+    uint32_t prealloc; // 0 if disabled
+    uint64_t prealloc_end;
+    uint64_t written_offset; // file offset of the last written buffer
+    size_t written_size;
+    uint64_t bytes_written;
+    uint64_t writes;
+    sc_tick total_write_duration;
+    sc_tick max_write_duration;
+};
+
+/**
+ * Open the file and start the writer thread
+ *
+ * If prealloc is not 0, the file space is allocated ahead by chunks of
+ * prealloc bytes, and the written data are not kept in the page cache (only
+ * supported on Linux).
+ */
+bool
+sc_record_writer_open(struct sc_record_writer *writer, const char *filename,
+                      uint32_t prealloc);
+
+/**
+ * Pass the data written so far to the writer thread
+ *
+ * It does not wait for the data to be written. It must be called from the
+ * muxer thread.
+ */
+bool
+sc_record_writer_flush(struct sc_record_writer *writer);
+
+/**
+ * Write the remaining data, stop the writer thread and close the file
+ *
+ * The AVIOContext must not be used anymore. Return false if any write failed.
+ */
+bool
+sc_record_writer_close(struct sc_record_writer *writer);
+
+#endif
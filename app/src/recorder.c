@@ -61,10 +61,176 @@ sc_recorder_queue_clear(struct sc_recorder_queue *queue) {
     }
 }
 
+// Must be called with the mutex locked
+static AVPacket *
+sc_recorder_pop(struct sc_recorder *recorder, struct sc_recorder_queue *queue) {
+    AVPacket *packet = sc_vecdeque_pop(queue);
+    assert(recorder->queue_bytes >= (size_t) packet->size);
+    recorder->queue_bytes -= packet->size;
+    return packet;
+}
+
+// Must be called with the mutex locked
+static void
+sc_recorder_drop_packet(struct sc_recorder *recorder, bool video) {
+    if (!recorder->dropped_packets) {
+        LOGW("Recording is late, dropping packets");
+    }
+    ++recorder->dropped_packets;
+
+    if (video) {
+        // The next video packets depend on the dropped one
+        recorder->video_drop = true;
+    }
+}
+
+// Must be called with the mutex locked
+static void
+sc_recorder_drop_overflow_packet(struct sc_recorder *recorder,
+                                 AVPacket *packet) {
+    bool video = packet->stream_index == recorder->video_stream.index;
+    sc_recorder_drop_packet(recorder, video);
+    av_packet_free(&packet);
+
+    assert(recorder->overflow_packets);
+    --recorder->overflow_packets;
+}
+
+// Move an overflow packet back to its queue
+//
+// Must be called with the mutex locked.
+static bool
+sc_recorder_push_back(struct sc_recorder *recorder, AVPacket *packet) {
+    struct sc_recorder_queue *queue =
+        packet->stream_index == recorder->video_stream.index
+            ? &recorder->video_queue : &recorder->audio_queue;
+    bool ok = sc_vecdeque_push(queue, packet);
+    if (!ok) {
+        LOG_OOM();
+        av_packet_free(&packet);
+        return false;
+    }
+
+    recorder->queue_bytes += packet->size;
+
+    assert(recorder->overflow_packets);
+    --recorder->overflow_packets;
+    return true;
+}
+
+// Whether the overflow packets may be moved back to the queues: while there is
+// room or while a queue is empty (the recorder may wait for a packet of that
+// stream)
+//
+// Must be called with the mutex locked.
+static bool
+sc_recorder_may_push_back(struct sc_recorder *recorder) {
+    bool room = recorder->queue_bytes < recorder->queue_limit / 2;
+    bool starving =
+        (recorder->video && sc_vecdeque_is_empty(&recorder->video_queue))
+     || (recorder->audio && sc_vecdeque_is_empty(&recorder->audio_queue));
+    return room || starving;
+}
+
+// Move the overflow packets back to the queues while possible, and spill the
+// others to the temporary file
+//
+// The file I/O is executed with the mutex unlocked, so that the packets are
+// still pushed meanwhile (they are added to the overflow queue, and spilled
+// on the next call).
+//
+// Must be called with the mutex locked, from the recorder thread.
+static bool
+sc_recorder_process_overflow(struct sc_recorder *recorder) {
+    while (!sc_packet_spill_is_empty(&recorder->spill)
+            && sc_recorder_may_push_back(recorder)) {
+        sc_mutex_unlock(&recorder->mutex);
+        // Only the recorder thread accesses the spill
+        AVPacket *packet = sc_packet_spill_read(&recorder->spill);
+        sc_mutex_lock(&recorder->mutex);
+
+        if (!packet) {
+            return false;
+        }
+
+        bool ok = sc_recorder_push_back(recorder, packet);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    // Once the spill is empty, the overflow packets are moved back directly
+    while (sc_packet_spill_is_empty(&recorder->spill)
+            && !sc_vecdeque_is_empty(&recorder->overflow_queue)
+            && sc_recorder_may_push_back(recorder)) {
+        AVPacket *packet = sc_vecdeque_pop(&recorder->overflow_queue);
+        bool ok = sc_recorder_push_back(recorder, packet);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    if (sc_vecdeque_is_empty(&recorder->overflow_queue)) {
+        return true;
+    }
+
+    if (recorder->spill_failed) {
+        // The packets must not be moved before the ones already spilled
+        while (!sc_vecdeque_is_empty(&recorder->overflow_queue)) {
+            AVPacket *packet = sc_vecdeque_pop(&recorder->overflow_queue);
+            sc_recorder_drop_overflow_packet(recorder, packet);
+        }
+        return true;
+    }
+
+    struct sc_recorder_queue pending = recorder->overflow_queue;
+    sc_vecdeque_init(&recorder->overflow_queue);
+
+    sc_mutex_unlock(&recorder->mutex);
+
+    uint64_t spilled_bytes = 0;
+    AVPacket *failed = NULL;
+    while (!sc_vecdeque_is_empty(&pending)) {
+        AVPacket *packet = sc_vecdeque_pop(&pending);
+        bool ok = sc_packet_spill_write(&recorder->spill, packet,
+                                        packet->stream_index);
+        if (!ok) {
+            failed = packet;
+            break;
+        }
+
+        spilled_bytes += packet->size;
+        av_packet_free(&packet);
+    }
+
+    sc_mutex_lock(&recorder->mutex);
+
+    if (spilled_bytes && !recorder->spilled_bytes) {
+        LOGW("Recording is late, spilling packets to a temporary file");
+    }
+    recorder->spilled_bytes += spilled_bytes;
+
+    if (failed) {
+        LOGW("Could not spill packets, dropping them instead");
+        recorder->spill_failed = true;
+
+        sc_recorder_drop_overflow_packet(recorder, failed);
+        while (!sc_vecdeque_is_empty(&pending)) {
+            AVPacket *packet = sc_vecdeque_pop(&pending);
+            sc_recorder_drop_overflow_packet(recorder, packet);
+        }
+    }
+
+    sc_vecdeque_destroy(&pending);
+
+    return true;
+}
+
 static const char *
 sc_recorder_get_format_name(enum sc_record_format format) {
     switch (format) {
         case SC_RECORD_FORMAT_MP4:
+        case SC_RECORD_FORMAT_FMP4:
         case SC_RECORD_FORMAT_M4A:
         case SC_RECORD_FORMAT_AAC:
             return "mp4";
@@ -117,7 +283,18 @@ sc_recorder_write_stream(struct sc_recorder *recorder,
     } else {
         st->last_pts = packet->pts;
     }
-    return av_interleaved_write_frame(recorder->ctx, packet) >= 0;
+    if (av_interleaved_write_frame(recorder->ctx, packet) < 0) {
+        return false;
+    }
+
+    if (recorder->format == SC_RECORD_FORMAT_FMP4) {
+        // The muxer only writes complete fragments, pass them to the writer
+        // thread immediately so that they reach the file even if scrcpy is
+        // killed (it is a no-op between fragments)
+        return sc_record_writer_flush(&recorder->writer);
+    }
+
+    return true;
 }
 
 static inline bool
@@ -146,19 +323,15 @@ sc_recorder_open_output_file(struct sc_recorder *recorder) {
         return false;
     }
 
-    char *file_url = sc_str_concat("file:", recorder->filename);
-    if (!file_url) {
+    bool ok = sc_record_writer_open(&recorder->writer, recorder->filename,
+                                    recorder->prealloc);
+    if (!ok) {
         avformat_free_context(recorder->ctx);
         return false;
     }
 
-    int ret = avio_open(&recorder->ctx->pb, file_url, AVIO_FLAG_WRITE);
-    free(file_url);
-    if (ret < 0) {
-        LOGE("Failed to open output file: %s", recorder->filename);
-        avformat_free_context(recorder->ctx);
-        return false;
-    }
+    recorder->ctx->pb = recorder->writer.avio;
+    recorder->ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
 
     // contrary to the deprecated API (av_oformat_next()), av_muxer_iterate()
     // returns (on purpose) a pointer-to-const, but AVFormatContext.oformat
@@ -173,10 +346,11 @@ sc_recorder_open_output_file(struct sc_recorder *recorder) {
     return true;
 }
 
-static void
+static bool
 sc_recorder_close_output_file(struct sc_recorder *recorder) {
-    avio_close(recorder->ctx->pb);
+    bool ok = sc_record_writer_close(&recorder->writer);
     avformat_free_context(recorder->ctx);
+    return ok;
 }
 
 static inline bool
@@ -218,14 +392,14 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
     AVPacket *video_pkt = NULL;
     if (!sc_vecdeque_is_empty(&recorder->video_queue)) {
         assert(recorder->video);
-        video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+        video_pkt = sc_recorder_pop(recorder, &recorder->video_queue);
     }
 
     AVPacket *audio_pkt = NULL;
     if (recorder->audio_expects_config_packet &&
             !sc_vecdeque_is_empty(&recorder->audio_queue)) {
         assert(recorder->audio);
-        audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+        audio_pkt = sc_recorder_pop(recorder, &recorder->audio_queue);
     }
 
     sc_mutex_unlock(&recorder->mutex);
@@ -262,7 +436,24 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
         }
     }
 
-    bool ok = avformat_write_header(recorder->ctx, NULL) >= 0;
+    AVDictionary *opts = NULL;
+    if (recorder->format == SC_RECORD_FORMAT_FMP4) {
+        // Write the moov atom (without samples) upfront, then self-contained
+        // fragments on each video key frame or every fragment_duration, so
+        // that the trailer does not have to index the whole recording
+        const char *movflags = "frag_keyframe+empty_moov+default_base_moof";
+        int64_t frag_duration = SC_TICK_TO_US(recorder->fragment_duration);
+        if (av_dict_set(&opts, "movflags", movflags, 0) < 0
+                || av_dict_set_int(&opts, "frag_duration", frag_duration,
+                                   0) < 0) {
+            LOG_OOM();
+            av_dict_free(&opts);
+            goto end;
+        }
+    }
+
+    bool ok = avformat_write_header(recorder->ctx, &opts) >= 0;
+    av_dict_free(&opts);
     if (!ok) {
         LOGE("Failed to write header to %s", recorder->filename);
         goto end;
@@ -302,7 +493,8 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
     for (;;) {
         sc_mutex_lock(&recorder->mutex);
 
-        while (!recorder->stopped) {
+        bool processed = sc_recorder_process_overflow(recorder);
+        while (processed && !recorder->stopped) {
             if (recorder->video && !video_pkt &&
                     !sc_vecdeque_is_empty(&recorder->video_queue)) {
                 // A new packet may be assigned to video_pkt and be processed
@@ -313,7 +505,18 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
                 // A new packet may be assigned to audio_pkt and be processed
                 break;
             }
-            sc_cond_wait(&recorder->cond, &recorder->mutex);
+            if (sc_vecdeque_is_empty(&recorder->overflow_queue)) {
+                sc_cond_wait(&recorder->cond, &recorder->mutex);
+            } // else some packets were pushed during the spill I/O
+            processed = sc_recorder_process_overflow(recorder);
+        }
+
+        if (!processed) {
+            sc_mutex_unlock(&recorder->mutex);
+            LOGE("Could not move the spilled packets back");
+            av_packet_free(&video_pkt_previous);
+            error = true;
+            goto end;
         }
 
         // If stopped is set, continue to process the remaining events (to
@@ -330,16 +533,25 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
                 && sc_vecdeque_is_empty(&recorder->audio_queue)));
 
         if (!video_pkt && !sc_vecdeque_is_empty(&recorder->video_queue)) {
-            video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+            video_pkt = sc_recorder_pop(recorder, &recorder->video_queue);
         }
 
         if (!audio_pkt && !sc_vecdeque_is_empty(&recorder->audio_queue)) {
-            audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+            audio_pkt = sc_recorder_pop(recorder, &recorder->audio_queue);
         }
 
         if (recorder->stopped && !video_pkt && !audio_pkt) {
+            if (recorder->overflow_packets) {
+                // Some packets were pushed during the spill I/O (the spilled
+                // packets are moved back while a queue is empty)
+                assert(!sc_vecdeque_is_empty(&recorder->overflow_queue));
+                sc_mutex_unlock(&recorder->mutex);
+                continue;
+            }
+
             assert(sc_vecdeque_is_empty(&recorder->video_queue));
             assert(sc_vecdeque_is_empty(&recorder->audio_queue));
+            assert(sc_packet_spill_is_empty(&recorder->spill));
             sc_mutex_unlock(&recorder->mutex);
             break;
         }
@@ -460,14 +672,25 @@ end:
 
 static bool
 sc_recorder_record(struct sc_recorder *recorder) {
-    bool ok = sc_recorder_open_output_file(recorder);
-    if (!ok) {
-        return false;
-    }
+    bool ok = sc_recorder_process_packets(recorder);
+    // The output file must be closed even if processing failed
+    bool closed = sc_recorder_close_output_file(recorder);
+    return ok && closed;
+}
 
-    ok = sc_recorder_process_packets(recorder);
-    sc_recorder_close_output_file(recorder);
-    return ok;
+// Must be called with the mutex locked
+static void
+sc_recorder_log_stats(struct sc_recorder *recorder) {
+    LOGD("Recorder queue: max %" SC_PRIsizet " packets (%" SC_PRIsizet
+         " bytes)", recorder->max_queue_packets, recorder->max_queue_bytes);
+    if (recorder->spilled_bytes) {
+        LOGI("Recorder queue: %" PRIu64_ " bytes spilled to a temporary file",
+             recorder->spilled_bytes);
+    }
+    if (recorder->dropped_packets) {
+        LOGW("Recorder queue: %" PRIu64_ " packets dropped",
+             recorder->dropped_packets);
+    }
 }
 
 static int
@@ -486,6 +709,10 @@ run_recorder(void *data) {
     // Discard pending packets
     sc_recorder_queue_clear(&recorder->video_queue);
     sc_recorder_queue_clear(&recorder->audio_queue);
+    sc_recorder_queue_clear(&recorder->overflow_queue);
+    recorder->queue_bytes = 0;
+    recorder->overflow_packets = 0;
+    sc_recorder_log_stats(recorder);
     sc_mutex_unlock(&recorder->mutex);
 
     if (success) {
@@ -596,6 +823,76 @@ sc_recorder_video_packet_sink_close(struct sc_packet_sink *sink) {
     sc_mutex_unlock(&recorder->mutex);
 }
 
+// Must be called with the mutex locked
+static bool
+sc_recorder_queue_packet(struct sc_recorder *recorder,
+                         struct sc_recorder_queue *queue, int stream_index,
+                         const AVPacket *packet) {
+    bool video = queue == &recorder->video_queue;
+    // The config packets are small, and required to write the header
+    bool config = packet->pts == AV_NOPTS_VALUE;
+
+    if (recorder->queue_limit && !config) {
+        bool full =
+            recorder->queue_bytes + packet->size > recorder->queue_limit;
+
+        if (video && recorder->video_drop) {
+            if (full || !(packet->flags & AV_PKT_FLAG_KEY)
+                    || recorder->overflow_packets) {
+                sc_recorder_drop_packet(recorder, video);
+                return true;
+            }
+
+            LOGD("Recording resumed on key frame");
+            recorder->video_drop = false;
+        }
+
+        // Once a packet overflows, the next ones also overflow until all the
+        // overflow packets are moved back to the queues, to preserve the order
+        if (full || recorder->overflow_packets) {
+            if (recorder->overflow != SC_RECORD_OVERFLOW_SPILL
+                    || recorder->spill_failed) {
+                sc_recorder_drop_packet(recorder, video);
+                return true;
+            }
+
+            // The recorder thread spills it if necessary, so that the caller
+            // is never blocked on file I/O
+            queue = &recorder->overflow_queue;
+        }
+    }
+
+    AVPacket *rec = sc_recorder_packet_ref(packet);
+    if (!rec) {
+        LOG_OOM();
+        return false;
+    }
+
+    rec->stream_index = stream_index;
+
+    bool ok = sc_vecdeque_push(queue, rec);
+    if (!ok) {
+        LOG_OOM();
+        av_packet_free(&rec);
+        return false;
+    }
+
+    if (queue == &recorder->overflow_queue) {
+        ++recorder->overflow_packets;
+        return true;
+    }
+
+    recorder->queue_bytes += rec->size;
+
+    size_t packets = sc_vecdeque_size(&recorder->video_queue)
+                   + sc_vecdeque_size(&recorder->audio_queue);
+    recorder->max_queue_packets = MAX(recorder->max_queue_packets, packets);
+    recorder->max_queue_bytes =
+        MAX(recorder->max_queue_bytes, recorder->queue_bytes);
+
+    return true;
+}
+
 static bool
 sc_recorder_video_packet_sink_push(struct sc_packet_sink *sink,
                                    const AVPacket *packet) {
@@ -611,18 +908,9 @@ sc_recorder_video_packet_sink_push(struct sc_packet_sink *sink,
         return false;
     }
 
-    AVPacket *rec = sc_recorder_packet_ref(packet);
-    if (!rec) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    rec->stream_index = recorder->video_stream.index;
-
-    bool ok = sc_vecdeque_push(&recorder->video_queue, rec);
+    bool ok = sc_recorder_queue_packet(recorder, &recorder->video_queue,
+                                       recorder->video_stream.index, packet);
     if (!ok) {
-        LOG_OOM();
         sc_mutex_unlock(&recorder->mutex);
         return false;
     }
@@ -698,18 +986,9 @@ sc_recorder_audio_packet_sink_push(struct sc_packet_sink *sink,
         return false;
     }
 
-    AVPacket *rec = sc_recorder_packet_ref(packet);
-    if (!rec) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    rec->stream_index = recorder->audio_stream.index;
-
-    bool ok = sc_vecdeque_push(&recorder->audio_queue, rec);
+    bool ok = sc_recorder_queue_packet(recorder, &recorder->audio_queue,
+                                       recorder->audio_stream.index, packet);
     if (!ok) {
-        LOG_OOM();
         sc_mutex_unlock(&recorder->mutex);
         return false;
     }
@@ -745,9 +1024,12 @@ sc_recorder_stream_init(struct sc_recorder_stream *stream) {
 bool
 sc_recorder_init(struct sc_recorder *recorder, const char *filename,
                  enum sc_record_format format, bool video, bool audio,
-                 enum sc_orientation orientation,
+                 enum sc_orientation orientation, uint32_t queue_limit,
+                 enum sc_record_overflow overflow, uint32_t prealloc,
+                 sc_tick fragment_duration,
                  const struct sc_recorder_callbacks *cbs, void *cbs_userdata) {
     assert(!sc_orientation_is_mirror(orientation));
+    assert(format != SC_RECORD_FORMAT_FMP4 || fragment_duration > 0);
 
     recorder->filename = strdup(filename);
     if (!recorder->filename) {
@@ -773,8 +1055,23 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
 
     sc_vecdeque_init(&recorder->video_queue);
     sc_vecdeque_init(&recorder->audio_queue);
+    sc_vecdeque_init(&recorder->overflow_queue);
     recorder->stopped = false;
 
+    recorder->queue_limit = queue_limit;
+    recorder->overflow = overflow;
+    recorder->prealloc = prealloc;
+    recorder->fragment_duration = fragment_duration;
+    recorder->queue_bytes = 0;
+    sc_packet_spill_init(&recorder->spill);
+    recorder->overflow_packets = 0;
+    recorder->spill_failed = false;
+    recorder->video_drop = false;
+    recorder->max_queue_packets = 0;
+    recorder->max_queue_bytes = 0;
+    recorder->spilled_bytes = 0;
+    recorder->dropped_packets = 0;
+
     recorder->video_init = false;
     recorder->audio_init = false;
 
@@ -822,10 +1119,18 @@ error_free_filename:
 
 bool
 sc_recorder_start(struct sc_recorder *recorder) {
-    bool ok = sc_thread_create(&recorder->thread, run_recorder,
-                               "scrcpy-recorder", recorder);
+    // Open the file before starting the thread, so that the streams may be
+    // added (on packet sink open) as soon as this function returns
+    bool ok = sc_recorder_open_output_file(recorder);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_thread_create(&recorder->thread, run_recorder, "scrcpy-recorder",
+                          recorder);
     if (!ok) {
         LOGE("Could not start recorder thread");
+        sc_recorder_close_output_file(recorder);
         return false;
     }
 
@@ -847,6 +1152,7 @@ sc_recorder_join(struct sc_recorder *recorder) {
 
 void
 sc_recorder_destroy(struct sc_recorder *recorder) {
+    sc_packet_spill_destroy(&recorder->spill);
     sc_cond_destroy(&recorder->cond);
     sc_mutex_destroy(&recorder->mutex);
     free(recorder->filename);
@@ -9,8 +9,11 @@
 #include <libavformat/avformat.h>
 
 #include "options.h"
+#include "packet_spill.h"
+#include "record_writer.h"
 #include "trait/packet_sink.h"
 #include "util/thread.h"
+#include "util/tick.h"
 #include "util/vecdeque.h"
 
 struct sc_recorder_queue SC_VECDEQUE(AVPacket *);
@@ -40,6 +43,9 @@ struct sc_recorder {
     char *filename;
     enum sc_record_format format;
     AVFormatContext *ctx;
+    struct sc_record_writer writer;
+    uint32_t prealloc;
+    sc_tick fragment_duration; // only for SC_RECORD_FORMAT_FMP4
 
     sc_thread thread;
     sc_mutex mutex;
@@ -49,6 +55,29 @@ struct sc_recorder {
     struct sc_recorder_queue video_queue;
     struct sc_recorder_queue audio_queue;
 
+    // Maximum size of the packets in the queues, 0 for unlimited
+    uint32_t queue_limit;
+    enum sc_record_overflow overflow;
+
+    // The spilled packets, in push order (only accessed by the recorder
+    // thread, with the mutex unlocked)
+    struct sc_packet_spill spill;
+
+    // The following fields are protected by the mutex
+    size_t queue_bytes; // size of the packets in video_queue and audio_queue
+    // The packets pushed while the limit is reached, in push order (with
+    // SC_RECORD_OVERFLOW_SPILL), to be spilled by the recorder thread
+    struct sc_recorder_queue overflow_queue;
+    // Number of packets pushed to the overflow queue and not moved back to
+    // video_queue or audio_queue yet (including the spilled packets)
+    size_t overflow_packets;
+    bool spill_failed;
+    bool video_drop; // drop the video packets until the next key frame
+    size_t max_queue_packets;
+    size_t max_queue_bytes;
+    uint64_t spilled_bytes;
+    uint64_t dropped_packets;
+
     // wake up the recorder thread once the video or audio codec is known
     bool video_init;
     bool audio_init;
@@ -70,7 +99,9 @@ struct sc_recorder_callbacks {
 bool
 sc_recorder_init(struct sc_recorder *recorder, const char *filename,
                  enum sc_record_format format, bool video, bool audio,
-                 enum sc_orientation orientation,
+                 enum sc_orientation orientation, uint32_t queue_limit,
+                 enum sc_record_overflow overflow, uint32_t prealloc,
+                 sc_tick fragment_duration,
                  const struct sc_recorder_callbacks *cbs, void *cbs_userdata);
 
 bool
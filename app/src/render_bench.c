@@ -0,0 +1,72 @@
+#include "render_bench.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+
+static const char *const sc_render_bench_stage_names[] = {
+    [SC_RENDER_BENCH_STAGE_UPLOAD] = "upload",
+    [SC_RENDER_BENCH_STAGE_MIPMAP] = "mipmap",
+    [SC_RENDER_BENCH_STAGE_RENDER] = "render",
+    [SC_RENDER_BENCH_STAGE_PRESENT] = "present",
+};
+
+static_assert(ARRAY_LEN(sc_render_bench_stage_names)
+                  == SC_RENDER_BENCH_STAGE_COUNT, "Missing stage name");
+
+void
+sc_render_bench_init(struct sc_render_bench *bench) {
+    for (unsigned i = 0; i < SC_RENDER_BENCH_STAGE_COUNT; ++i) {
+        sc_vector_init(&bench->samples[i]);
+    }
+    bench->oom = false;
+}
+
+void
+sc_render_bench_destroy(struct sc_render_bench *bench) {
+    for (unsigned i = 0; i < SC_RENDER_BENCH_STAGE_COUNT; ++i) {
+        sc_vector_destroy(&bench->samples[i]);
+    }
+}
+
+void
+sc_render_bench_add(struct sc_render_bench *bench,
+                    enum sc_render_bench_stage stage, sc_tick duration) {
+    assert(stage < SC_RENDER_BENCH_STAGE_COUNT);
+    bool ok = sc_vector_push(&bench->samples[stage], duration);
+    if (!ok && !bench->oom) {
+        // Only report the first failure, the benchmark continues anyway
+        LOG_OOM();
+        bench->oom = true;
+    }
+}
+
+static int
+compare_ticks(const void *lhs, const void *rhs) {
+    sc_tick a = *(const sc_tick *) lhs;
+    sc_tick b = *(const sc_tick *) rhs;
+    return a < b ? -1 : a > b;
+}
+
+void
+sc_render_bench_log(struct sc_render_bench *bench) {
+    for (unsigned i = 0; i < SC_RENDER_BENCH_STAGE_COUNT; ++i) {
+        sc_tick *values = bench->samples[i].data;
+        size_t count = bench->samples[i].size;
+        if (!count) {
+            continue;
+        }
+
+        qsort(values, count, sizeof(*values), compare_ticks);
+
+        LOGI("Render bench %-7s %6" SC_PRIsizet " frames: p50 %6" PRItick
+             " us, p90 %6" PRItick " us, p99 %6" PRItick " us, max %6" PRItick
+             " us", sc_render_bench_stage_names[i], count,
+             SC_TICK_TO_US(values[count / 2]),
+             SC_TICK_TO_US(values[count * 90 / 100]),
+             SC_TICK_TO_US(values[count * 99 / 100]),
+             SC_TICK_TO_US(values[count - 1]));
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef SC_RENDER_BENCH_H
+#define SC_RENDER_BENCH_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "util/tick.h"
+#include "util/vector.h"
+
+enum sc_render_bench_stage {
+    SC_RENDER_BENCH_STAGE_UPLOAD,
+    SC_RENDER_BENCH_STAGE_MIPMAP,
+    SC_RENDER_BENCH_STAGE_RENDER,
+    SC_RENDER_BENCH_STAGE_PRESENT,
+};
+
+#define SC_RENDER_BENCH_STAGE_COUNT 4
+
+/**
+ * Durations of the display stages, for each frame (--render-bench)
+ *
+ * All the samples are kept, to report their percentiles on exit.
+ */
+struct sc_render_bench {
+    struct SC_VECTOR(sc_tick) samples[SC_RENDER_BENCH_STAGE_COUNT];
+    bool oom; // some samples could not be stored
+};
+
+void
+sc_render_bench_init(struct sc_render_bench *bench);
+
+void
+sc_render_bench_destroy(struct sc_render_bench *bench);
+
+void
+sc_render_bench_add(struct sc_render_bench *bench,
+                    enum sc_render_bench_stage stage, sc_tick duration);
+
+// Log the percentiles of each stage (the samples are sorted in place)
+void
+sc_render_bench_log(struct sc_render_bench *bench);
+
+#endif
@@ -0,0 +1,652 @@
+#include "replay_buffer.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/file.h"
+#include "util/log.h"
+
+/** Downcast packet sinks to replay buffer */
+#define DOWNCAST_VIDEO(SINK) \
+    container_of(SINK, struct sc_replay_buffer, video_packet_sink)
+#define DOWNCAST_AUDIO(SINK) \
+    container_of(SINK, struct sc_replay_buffer, audio_packet_sink)
+
+static AVPacket *
+sc_replay_buffer_packet_ref(const AVPacket *packet) {
+    AVPacket *p = av_packet_alloc();
+    if (!p) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (av_packet_ref(p, packet)) {
+        av_packet_free(&p);
+        return NULL;
+    }
+
+    return p;
+}
+
+static inline bool
+sc_replay_buffer_is_config(const AVPacket *packet) {
+    return packet->pts == AV_NOPTS_VALUE;
+}
+
+static inline bool
+sc_replay_buffer_is_key_frame(const AVPacket *packet) {
+    return !sc_replay_buffer_is_config(packet)
+        && (packet->flags & AV_PKT_FLAG_KEY);
+}
+
+static void
+sc_replay_buffer_stream_init(struct sc_replay_buffer_stream *stream) {
+    stream->codec_ctx = NULL;
+    stream->config = NULL;
+    sc_vecdeque_init(&stream->queue);
+    stream->last_pts = AV_NOPTS_VALUE;
+    stream->keyframes = 0;
+}
+
+static void
+sc_replay_buffer_stream_destroy(struct sc_replay_buffer_stream *stream) {
+    while (!sc_vecdeque_is_empty(&stream->queue)) {
+        AVPacket *packet = sc_vecdeque_pop(&stream->queue);
+        av_packet_free(&packet);
+    }
+    sc_vecdeque_destroy(&stream->queue);
+    av_packet_free(&stream->config);
+}
+
+// Must be called with the mutex locked
+static void
+sc_replay_buffer_pop(struct sc_replay_buffer *rb,
+                     struct sc_replay_buffer_stream *stream) {
+    AVPacket *packet = sc_vecdeque_pop(&stream->queue);
+    assert(rb->bytes >= (size_t) packet->size);
+    rb->bytes -= packet->size;
+
+    if (sc_replay_buffer_is_config(packet)) {
+        // It applies to the packets remaining in the queue
+        av_packet_free(&stream->config);
+        stream->config = packet;
+        return;
+    }
+
+    if (sc_replay_buffer_is_key_frame(packet)) {
+        assert(stream->keyframes);
+        --stream->keyframes;
+    }
+    av_packet_free(&packet);
+}
+
+// Must be called with the mutex locked
+static bool
+sc_replay_buffer_push(struct sc_replay_buffer *rb,
+                      struct sc_replay_buffer_stream *stream,
+                      const AVPacket *packet, bool video) {
+    bool config = sc_replay_buffer_is_config(packet);
+
+    if (sc_vecdeque_is_empty(&stream->queue)) {
+        if (config) {
+            AVPacket *p = sc_replay_buffer_packet_ref(packet);
+            if (!p) {
+                return false;
+            }
+
+            av_packet_free(&stream->config);
+            stream->config = p;
+            return true;
+        }
+
+        if (video && !(packet->flags & AV_PKT_FLAG_KEY)) {
+            // The buffer must start on a key frame
+            return true;
+        }
+    }
+
+    AVPacket *p = sc_replay_buffer_packet_ref(packet);
+    if (!p) {
+        return false;
+    }
+
+    bool ok = sc_vecdeque_push(&stream->queue, p);
+    if (!ok) {
+        LOG_OOM();
+        av_packet_free(&p);
+        return false;
+    }
+
+    rb->bytes += p->size;
+
+    if (!config) {
+        stream->last_pts = p->pts;
+        if (p->flags & AV_PKT_FLAG_KEY) {
+            ++stream->keyframes;
+        }
+    }
+
+    return true;
+}
+
+// Remove the first GOP while the next one starts before the requested duration
+// (or while the buffer is too big)
+//
+// Must be called with the mutex locked.
+static void
+sc_replay_buffer_trim_video(struct sc_replay_buffer *rb) {
+    struct sc_replay_buffer_stream *video = &rb->video;
+
+    while (video->keyframes >= 2) {
+        // The queue always starts on a key frame, find the next one
+        size_t size = sc_vecdeque_size(&video->queue);
+        size_t next = 0;
+        for (size_t i = 1; i < size; ++i) {
+            if (sc_replay_buffer_is_key_frame(
+                        sc_vecdeque_get(&video->queue, i))) {
+                next = i;
+                break;
+            }
+        }
+        assert(next);
+
+        AVPacket *next_key_frame = sc_vecdeque_get(&video->queue, next);
+        bool expired =
+            next_key_frame->pts <= video->last_pts - rb->duration;
+        if (!expired && rb->bytes <= SC_REPLAY_BUFFER_MAX_BYTES) {
+            break;
+        }
+
+        for (size_t i = 0; i < next; ++i) {
+            sc_replay_buffer_pop(rb, video);
+        }
+    }
+
+    if (rb->bytes > SC_REPLAY_BUFFER_MAX_BYTES
+            && !sc_vecdeque_is_empty(&video->queue)) {
+        // The current GOP alone is too big: drop it, the next packets are
+        // ignored until the next key frame (the buffer must start on a key
+        // frame)
+        LOGW("Replay buffer: GOP too big, dropped");
+        while (!sc_vecdeque_is_empty(&video->queue)) {
+            sc_replay_buffer_pop(rb, video);
+        }
+        assert(!video->keyframes);
+    }
+}
+
+// Remove the audio packets older than the first video packet (or older than
+// the requested duration if there is no video)
+//
+// Must be called with the mutex locked.
+static void
+sc_replay_buffer_trim_audio(struct sc_replay_buffer *rb) {
+    struct sc_replay_buffer_stream *audio = &rb->audio;
+
+    bool has_video = !sc_vecdeque_is_empty(&rb->video.queue);
+    if (!has_video && audio->last_pts == AV_NOPTS_VALUE) {
+        // No audio packet (except config packets) has been queued
+        return;
+    }
+
+    int64_t start = has_video ? sc_vecdeque_get(&rb->video.queue, 0)->pts
+                              : audio->last_pts - rb->duration;
+
+    while (!sc_vecdeque_is_empty(&audio->queue)) {
+        AVPacket *packet = sc_vecdeque_get(&audio->queue, 0);
+        bool expired = !sc_replay_buffer_is_config(packet)
+                    && packet->pts < start;
+        bool too_big = !has_video && rb->bytes > SC_REPLAY_BUFFER_MAX_BYTES;
+        if (!expired && !too_big) {
+            break;
+        }
+
+        sc_replay_buffer_pop(rb, audio);
+    }
+}
+
+static bool
+sc_replay_buffer_video_packet_sink_open(struct sc_packet_sink *sink,
+                                        AVCodecContext *ctx) {
+    struct sc_replay_buffer *rb = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&rb->mutex);
+    // The codec context is valid until the sink is closed
+    rb->video.codec_ctx = ctx;
+    sc_mutex_unlock(&rb->mutex);
+
+    return true;
+}
+
+static void
+sc_replay_buffer_video_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_replay_buffer *rb = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&rb->mutex);
+    rb->video.codec_ctx = NULL;
+    sc_mutex_unlock(&rb->mutex);
+}
+
+static bool
+sc_replay_buffer_video_packet_sink_push(struct sc_packet_sink *sink,
+                                        const AVPacket *packet) {
+    struct sc_replay_buffer *rb = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&rb->mutex);
+    bool ok = sc_replay_buffer_push(rb, &rb->video, packet, true);
+    if (ok) {
+        sc_replay_buffer_trim_video(rb);
+        sc_replay_buffer_trim_audio(rb);
+    }
+    sc_mutex_unlock(&rb->mutex);
+
+    return ok;
+}
+
+static bool
+sc_replay_buffer_audio_packet_sink_open(struct sc_packet_sink *sink,
+                                        AVCodecContext *ctx) {
+    struct sc_replay_buffer *rb = DOWNCAST_AUDIO(sink);
+
+    sc_mutex_lock(&rb->mutex);
+    // The codec context is valid until the sink is closed
+    rb->audio.codec_ctx = ctx;
+    sc_mutex_unlock(&rb->mutex);
+
+    return true;
+}
+
+static void
+sc_replay_buffer_audio_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_replay_buffer *rb = DOWNCAST_AUDIO(sink);
+
+    sc_mutex_lock(&rb->mutex);
+    rb->audio.codec_ctx = NULL;
+    sc_mutex_unlock(&rb->mutex);
+}
+
+static bool
+sc_replay_buffer_audio_packet_sink_push(struct sc_packet_sink *sink,
+                                        const AVPacket *packet) {
+    struct sc_replay_buffer *rb = DOWNCAST_AUDIO(sink);
+
+    sc_mutex_lock(&rb->mutex);
+    bool ok = sc_replay_buffer_push(rb, &rb->audio, packet, false);
+    if (ok) {
+        sc_replay_buffer_trim_audio(rb);
+    }
+    sc_mutex_unlock(&rb->mutex);
+
+    return ok;
+}
+
+bool
+sc_replay_buffer_init(struct sc_replay_buffer *rb, uint16_t seconds,
+                      const char *dir, enum sc_record_format format,
+                      enum sc_orientation orientation) {
+    assert(seconds);
+    assert(format == SC_RECORD_FORMAT_MP4 || format == SC_RECORD_FORMAT_MKV);
+    assert(!sc_orientation_is_mirror(orientation));
+
+    rb->dir = strdup(dir);
+    if (!rb->dir) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&rb->mutex);
+    if (!ok) {
+        free(rb->dir);
+        return false;
+    }
+
+    rb->duration = SC_TICK_TO_US(SC_TICK_FROM_SEC(seconds));
+    rb->format = format;
+    rb->orientation = orientation;
+
+    sc_replay_buffer_stream_init(&rb->video);
+    sc_replay_buffer_stream_init(&rb->audio);
+    rb->bytes = 0;
+
+    rb->recorder = NULL;
+    atomic_init(&rb->saving, false);
+    rb->index = 0;
+
+    static const struct sc_packet_sink_ops video_ops = {
+        .open = sc_replay_buffer_video_packet_sink_open,
+        .close = sc_replay_buffer_video_packet_sink_close,
+        .push = sc_replay_buffer_video_packet_sink_push,
+    };
+    rb->video_packet_sink.ops = &video_ops;
+
+    static const struct sc_packet_sink_ops audio_ops = {
+        .open = sc_replay_buffer_audio_packet_sink_open,
+        .close = sc_replay_buffer_audio_packet_sink_close,
+        .push = sc_replay_buffer_audio_packet_sink_push,
+    };
+    rb->audio_packet_sink.ops = &audio_ops;
+
+    return true;
+}
+
+static void
+sc_replay_buffer_release_recorder(struct sc_replay_buffer *rb) {
+    if (rb->recorder) {
+        sc_recorder_join(rb->recorder);
+        sc_recorder_destroy(rb->recorder);
+        free(rb->recorder);
+        rb->recorder = NULL;
+    }
+}
+
+void
+sc_replay_buffer_join(struct sc_replay_buffer *rb) {
+    sc_replay_buffer_release_recorder(rb);
+}
+
+void
+sc_replay_buffer_destroy(struct sc_replay_buffer *rb) {
+    assert(!rb->recorder);
+    sc_replay_buffer_stream_destroy(&rb->video);
+    sc_replay_buffer_stream_destroy(&rb->audio);
+    sc_mutex_destroy(&rb->mutex);
+    free(rb->dir);
+}
+
+static char *
+sc_replay_buffer_get_filename(struct sc_replay_buffer *rb) {
+    time_t now = time(NULL);
+    struct tm tm;
+#ifdef _WIN32
+    bool ok = !localtime_s(&tm, &now);
+#else
+    bool ok = localtime_r(&now, &tm);
+#endif
+    char date[32];
+    if (!ok || !strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &tm)) {
+        strcpy(date, "unknown");
+    }
+
+    const char *ext = rb->format == SC_RECORD_FORMAT_MP4 ? "mp4" : "mkv";
+
+    // <dir>/scrcpy-replay-<date>-<index>.<ext>
+    size_t len = strlen(rb->dir) + strlen(date) + strlen(ext) + 40;
+    char *filename = malloc(len);
+    if (!filename) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    snprintf(filename, len, "%s%cscrcpy-replay-%s-%04u.%s", rb->dir,
+             SC_PATH_SEPARATOR, date, rb->index++, ext);
+    return filename;
+}
+
+// Must be called with the mutex locked
+static bool
+sc_replay_buffer_stream_is_ready(struct sc_replay_buffer_stream *stream) {
+    if (!stream->codec_ctx || sc_vecdeque_is_empty(&stream->queue)) {
+        return false;
+    }
+
+    // A config packet is provided for all supported formats except raw audio
+    return stream->config
+        || stream->codec_ctx->codec_id == AV_CODEC_ID_PCM_S16LE;
+}
+
+// The buffered packets of a stream, referenced to be saved without holding
+// the mutex
+struct sc_replay_buffer_snapshot {
+    // A copy of the codec context (the original one is only valid until the
+    // packet sink is closed)
+    AVCodecContext *codec_ctx;
+    AVPacket *config; // NULL if none
+    struct sc_replay_buffer_queue queue;
+};
+
+static void
+sc_replay_buffer_snapshot_init(struct sc_replay_buffer_snapshot *snapshot) {
+    snapshot->codec_ctx = NULL;
+    snapshot->config = NULL;
+    sc_vecdeque_init(&snapshot->queue);
+}
+
+static void
+sc_replay_buffer_snapshot_destroy(struct sc_replay_buffer_snapshot *snapshot) {
+    while (!sc_vecdeque_is_empty(&snapshot->queue)) {
+        AVPacket *packet = sc_vecdeque_pop(&snapshot->queue);
+        av_packet_free(&packet);
+    }
+    sc_vecdeque_destroy(&snapshot->queue);
+    av_packet_free(&snapshot->config);
+    avcodec_free_context(&snapshot->codec_ctx);
+}
+
+// Reference the codec parameters and the packets of the stream
+//
+// Must be called with the mutex locked.
+static bool
+sc_replay_buffer_snapshot_take(struct sc_replay_buffer_snapshot *snapshot,
+                               struct sc_replay_buffer_stream *stream) {
+    const AVCodecContext *ctx = stream->codec_ctx;
+    assert(ctx);
+
+    snapshot->codec_ctx = avcodec_alloc_context3(ctx->codec);
+    if (!snapshot->codec_ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    AVCodecParameters *params = avcodec_parameters_alloc();
+    if (!params) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = avcodec_parameters_from_context(params, ctx) >= 0
+           && avcodec_parameters_to_context(snapshot->codec_ctx, params) >= 0;
+    avcodec_parameters_free(&params);
+    if (!ok) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (stream->config) {
+        snapshot->config = sc_replay_buffer_packet_ref(stream->config);
+        if (!snapshot->config) {
+            return false;
+        }
+    }
+
+    size_t size = sc_vecdeque_size(&stream->queue);
+    if (!sc_vecdeque_reserve(&snapshot->queue, size)) {
+        LOG_OOM();
+        return false;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        AVPacket *p =
+            sc_replay_buffer_packet_ref(sc_vecdeque_get(&stream->queue, i));
+        if (!p) {
+            return false;
+        }
+
+        sc_vecdeque_push_noresize(&snapshot->queue, p);
+    }
+
+    return true;
+}
+
+// Pass the referenced packets to the recorder packet sinks, in timestamps
+// order
+static bool
+sc_replay_buffer_feed(struct sc_recorder *recorder,
+                      struct sc_replay_buffer_snapshot *video,
+                      struct sc_replay_buffer_snapshot *audio) {
+    struct sc_packet_sink *vsink = &recorder->video_packet_sink;
+    struct sc_packet_sink *asink = &recorder->audio_packet_sink;
+
+    if (video && !vsink->ops->open(vsink, video->codec_ctx)) {
+        return false;
+    }
+
+    if (audio && !asink->ops->open(asink, audio->codec_ctx)) {
+        if (video) {
+            vsink->ops->close(vsink);
+        }
+        return false;
+    }
+
+    bool ok = true;
+    if (video && video->config) {
+        ok = vsink->ops->push(vsink, video->config);
+    }
+    if (ok && audio && audio->config) {
+        ok = asink->ops->push(asink, audio->config);
+    }
+
+    size_t vsize = video ? sc_vecdeque_size(&video->queue) : 0;
+    size_t asize = audio ? sc_vecdeque_size(&audio->queue) : 0;
+    size_t vi = 0;
+    size_t ai = 0;
+    while (ok && (vi < vsize || ai < asize)) {
+        AVPacket *vp = vi < vsize ? sc_vecdeque_get(&video->queue, vi)
+                                  : NULL;
+        AVPacket *ap = ai < asize ? sc_vecdeque_get(&audio->queue, ai)
+                                  : NULL;
+
+        // The config packets are pushed as soon as possible
+        bool push_video = vp && (!ap || sc_replay_buffer_is_config(vp)
+                              || (!sc_replay_buffer_is_config(ap)
+                                    && vp->pts <= ap->pts));
+        if (push_video) {
+            ok = vsink->ops->push(vsink, vp);
+            ++vi;
+        } else {
+            ok = asink->ops->push(asink, ap);
+            ++ai;
+        }
+    }
+
+    // Closing the sinks stops the recorder once all the packets are written
+    if (audio) {
+        asink->ops->close(asink);
+    }
+    if (video) {
+        vsink->ops->close(vsink);
+    }
+
+    return ok;
+}
+
+static void
+sc_replay_buffer_on_recorder_ended(struct sc_recorder *recorder, bool success,
+                                   void *userdata) {
+    (void) recorder;
+    (void) success; // the recorder already logs the result
+
+    struct sc_replay_buffer *rb = userdata;
+    atomic_store(&rb->saving, false);
+}
+
+bool
+sc_replay_buffer_save(struct sc_replay_buffer *rb) {
+    if (atomic_load(&rb->saving)) {
+        LOGW("The previous replay is still being saved");
+        return false;
+    }
+
+    // The previous save (if any) is complete
+    sc_replay_buffer_release_recorder(rb);
+
+    struct sc_replay_buffer_snapshot video_snapshot;
+    struct sc_replay_buffer_snapshot audio_snapshot;
+    sc_replay_buffer_snapshot_init(&video_snapshot);
+    sc_replay_buffer_snapshot_init(&audio_snapshot);
+
+    // Only reference the packets with the mutex locked, so that the packet
+    // sinks are not blocked while the recorder is started and fed
+    sc_mutex_lock(&rb->mutex);
+
+    bool video = sc_replay_buffer_stream_is_ready(&rb->video);
+    bool audio = sc_replay_buffer_stream_is_ready(&rb->audio);
+    if (!video && !audio) {
+        sc_mutex_unlock(&rb->mutex);
+        LOGW("The replay buffer is empty");
+        return false;
+    }
+
+    struct sc_replay_buffer_stream *stream = video ? &rb->video : &rb->audio;
+    int64_t start = sc_vecdeque_get(&stream->queue, 0)->pts;
+    int64_t duration = stream->last_pts - start;
+
+    bool ok = (!video
+                || sc_replay_buffer_snapshot_take(&video_snapshot, &rb->video))
+           && (!audio
+                || sc_replay_buffer_snapshot_take(&audio_snapshot, &rb->audio));
+
+    sc_mutex_unlock(&rb->mutex);
+
+    if (!ok) {
+        goto end;
+    }
+
+    LOGI("Saving the last %" PRIi64 " ms", duration / 1000);
+
+    ok = false;
+
+    char *filename = sc_replay_buffer_get_filename(rb);
+    if (!filename) {
+        goto end;
+    }
+
+    struct sc_recorder *recorder = malloc(sizeof(*recorder));
+    if (!recorder) {
+        LOG_OOM();
+        free(filename);
+        goto end;
+    }
+
+    static const struct sc_recorder_callbacks cbs = {
+        .on_ended = sc_replay_buffer_on_recorder_ended,
+    };
+    ok = sc_recorder_init(recorder, filename, rb->format, video, audio,
+                          rb->orientation, 0, SC_RECORD_OVERFLOW_SPILL, 0, 0,
+                          &cbs, rb);
+    free(filename);
+    if (!ok) {
+        free(recorder);
+        goto end;
+    }
+
+    atomic_store(&rb->saving, true);
+
+    ok = sc_recorder_start(recorder);
+    if (!ok) {
+        atomic_store(&rb->saving, false);
+        sc_recorder_destroy(recorder);
+        free(recorder);
+        goto end;
+    }
+
+    ok = sc_replay_buffer_feed(recorder, video ? &video_snapshot : NULL,
+                               audio ? &audio_snapshot : NULL);
+    if (!ok) {
+        LOGE("Could not save the replay buffer");
+        sc_recorder_stop(recorder);
+    }
+
+    // Joined on the next save or on sc_replay_buffer_join()
+    rb->recorder = recorder;
+
+end:
+    // The recorder keeps its own references to the packets
+    sc_replay_buffer_snapshot_destroy(&video_snapshot);
+    sc_replay_buffer_snapshot_destroy(&audio_snapshot);
+
+    return ok;
+}
@@ -0,0 +1,85 @@
+#ifndef SC_REPLAY_BUFFER_H
+#define SC_REPLAY_BUFFER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "options.h"
+#include "recorder.h"
+#include "trait/packet_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+
+// Maximum size of the buffered packets, whatever the duration
+#define SC_REPLAY_BUFFER_MAX_BYTES (256 * 1024 * 1024)
+
+struct sc_replay_buffer_queue SC_VECDEQUE(AVPacket *);
+
+struct sc_replay_buffer_stream {
+    AVCodecContext *codec_ctx; // NULL if the stream is not open
+    // The last config packet received before the first queued packet
+    AVPacket *config;
+    struct sc_replay_buffer_queue queue;
+    int64_t last_pts;
+    size_t keyframes; // number of key frames in the queue
+};
+
+/**
+ * Keep the last packets in memory, to record them on request
+ *
+ * The video packets are removed by whole GOPs (so that the buffer always
+ * starts on a key frame) once the next key frame is older than the requested
+ * duration. The audio packets older than the first video packet are removed.
+ * If a single GOP exceeds SC_REPLAY_BUFFER_MAX_BYTES, the video packets are
+ * dropped until the next key frame.
+ *
+ * On save, the buffered packets are referenced (without holding the mutex
+ * longer), then passed to a new recorder, which writes them from its own
+ * thread.
+ */
+struct sc_replay_buffer {
+    struct sc_packet_sink video_packet_sink;
+    struct sc_packet_sink audio_packet_sink;
+
+    int64_t duration; // in microseconds (the packets timestamps unit)
+    char *dir;
+    enum sc_record_format format;
+    enum sc_orientation orientation;
+    unsigned index; // index of the next file (to generate unique names)
+
+    sc_mutex mutex; // protects the streams and bytes
+    struct sc_replay_buffer_stream video;
+    struct sc_replay_buffer_stream audio;
+    size_t bytes;
+
+    // The recorder of the last save, only accessed from the main thread
+    struct sc_recorder *recorder; // NULL if none
+    // Set by the main thread, reset by the recorder thread
+    atomic_bool saving;
+};
+
+bool
+sc_replay_buffer_init(struct sc_replay_buffer *rb, uint16_t seconds,
+                      const char *dir, enum sc_record_format format,
+                      enum sc_orientation orientation);
+
+// Wait for the pending save (if any) to complete
+void
+sc_replay_buffer_join(struct sc_replay_buffer *rb);
+
+void
+sc_replay_buffer_destroy(struct sc_replay_buffer *rb);
+
+// Record the buffered packets to a new file, from a separate thread
+//
+// It must be called from the main thread.
+bool
+sc_replay_buffer_save(struct sc_replay_buffer *rb);
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "audio_player.h"
 #include "controller.h"
+#include "decode_queue.h"
 #include "decoder.h"
 #include "delay_buffer.h"
 #include "demuxer.h"
@@ -24,8 +25,11 @@
 #include "keyboard_sdk.h"
 #include "mouse_sdk.h"
 #include "recorder.h"
+#include "replay_buffer.h"
 #include "screen.h"
+#include "screenshot.h"
 #include "server.h"
+#include "stream_capture.h"
 #include "uhid/gamepad_uhid.h"
 #include "uhid/keyboard_uhid.h"
 #include "uhid/mouse_uhid.h"
@@ -37,6 +41,12 @@
 # include "usb/usb.h"
 #endif
 #include "util/acksync.h"
+#ifdef HAVE_IO_LOOP
+# include "util/io_loop.h"
+#endif
+#ifdef HAVE_IO_URING
+# include "util/net_uring.h"
+#endif
 #include "util/log.h"
 #include "util/rand.h"
 #include "util/timeout.h"
@@ -51,9 +61,11 @@ struct scrcpy {
     struct sc_audio_player audio_player;
     struct sc_demuxer video_demuxer;
     struct sc_demuxer audio_demuxer;
+    struct sc_decode_queue video_decode_queue;
     struct sc_decoder video_decoder;
     struct sc_decoder audio_decoder;
     struct sc_recorder recorder;
+    struct sc_replay_buffer replay_buffer;
     struct sc_delay_buffer video_buffer;
 #ifdef HAVE_V4L2
     struct sc_v4l2_sink v4l2_sink;
@@ -61,6 +73,10 @@ struct scrcpy {
 #endif
     struct sc_controller controller;
     struct sc_file_pusher file_pusher;
+    struct sc_screenshot screenshot;
+#ifdef HAVE_IO_LOOP
+    struct sc_io_loop io_loop;
+#endif
 #ifdef HAVE_USB
     struct sc_usb usb;
     struct sc_aoa aoa;
@@ -89,6 +105,8 @@ struct scrcpy {
 #endif
     };
     struct sc_timeout timeout;
+    struct sc_stream_capture capture;
+    struct sc_stream_replay replay;
 };
 
 #ifdef _WIN32
@@ -102,11 +120,16 @@ static BOOL WINAPI windows_ctrl_handler(DWORD ctrl_type) {
 #endif // _WIN32
 
 static void
-sdl_set_hints(const char *render_driver) {
+sdl_set_hints(const char *render_driver, bool render_bench) {
     if (render_driver && !SDL_SetHint(SDL_HINT_RENDER_DRIVER, render_driver)) {
         LOGW("Could not set render driver");
     }
 
+    // Render to an offscreen window, without any display server
+    if (render_bench && !SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen")) {
+        LOGW("Could not set offscreen video driver");
+    }
+
     // App name used in various contexts (such as PulseAudio)
     if (!SDL_SetHint(SDL_HINT_APP_NAME, "scrcpy")) {
         LOGW("Could not set app name");
@@ -395,9 +418,18 @@ scrcpy(struct scrcpy_options *options) {
     enum scrcpy_exit_code ret = SCRCPY_EXIT_FAILURE;
 
     bool server_started = false;
+    bool replay_initialized = false;
+    bool capture_initialized = false;
+#ifdef HAVE_IO_LOOP
+    bool io_loop_initialized = false;
+    bool io_loop_started = false;
+#endif
     bool file_pusher_initialized = false;
+    bool screenshot_initialized = false;
+    bool screenshot_started = false;
     bool recorder_initialized = false;
     bool recorder_started = false;
+    bool replay_buffer_initialized = false;
 #ifdef HAVE_V4L2
     bool v4l2_sink_initialized = false;
 #endif
@@ -434,6 +466,7 @@ scrcpy(struct scrcpy_options *options) {
         .port_range = options->port_range,
         .tunnel_host = options->tunnel_host,
         .tunnel_port = options->tunnel_port,
+        .no_adb = options->no_adb,
         .max_size = options->max_size,
         .video_bit_rate = options->video_bit_rate,
         .audio_bit_rate = options->audio_bit_rate,
@@ -474,6 +507,11 @@ scrcpy(struct scrcpy_options *options) {
         .list = options->list,
     };
 
+#ifdef HAVE_IO_URING
+    // Must be set before any socket I/O (each thread creates its own ring)
+    sc_net_uring_set_enabled(options->io_uring);
+#endif
+
     static const struct sc_server_callbacks cbs = {
         .on_connection_failed = sc_server_on_connection_failed,
         .on_connected = sc_server_on_connected,
@@ -486,14 +524,23 @@ scrcpy(struct scrcpy_options *options) {
     if (options->window) {
         // Set hints before starting the server thread to avoid race conditions
         // in SDL
-        sdl_set_hints(options->render_driver);
+        sdl_set_hints(options->render_driver, options->render_bench);
     }
 
-    if (!sc_server_start(&s->server)) {
-        goto end;
-    }
+    if (options->replay_stream_filename) {
+        // Replay captured streams instead of starting the server
+        if (!sc_stream_replay_init(&s->replay, options->replay_stream_filename,
+                                   options->replay_speed)) {
+            goto end;
+        }
+        replay_initialized = true;
+    } else {
+        if (!sc_server_start(&s->server)) {
+            goto end;
+        }
 
-    server_started = true;
+        server_started = true;
+    }
 
     if (options->list) {
         bool ok = await_for_server(NULL);
@@ -538,31 +585,57 @@ scrcpy(struct scrcpy_options *options) {
 
     sdl_configure(options->video_playback, options->disable_screensaver);
 
-    // Await for server without blocking Ctrl+C handling
-    bool connected;
-    if (!await_for_server(&connected)) {
-        LOGE("Server connection failed");
-        goto end;
-    }
+    const char *device_name;
+    const char *serial;
 
-    if (!connected) {
-        // This is not an error, user requested to quit
-        LOGD("User requested to quit");
-        ret = SCRCPY_EXIT_SUCCESS;
-        goto end;
-    }
+    if (replay_initialized) {
+        struct sc_stream_replay *replay = &s->replay;
+        if (options->video
+                && !sc_stream_replay_has_stream(replay,
+                                                SC_STREAM_CAPTURE_VIDEO)) {
+            LOGE("No video stream captured (try with --no-video)");
+            goto end;
+        }
+
+        if (options->audio
+                && !sc_stream_replay_has_stream(replay,
+                                                SC_STREAM_CAPTURE_AUDIO)) {
+            LOGE("No audio stream captured (try with --no-audio)");
+            goto end;
+        }
+
+        device_name = replay->device_name;
+        // There is no device
+        serial = NULL;
+    } else {
+        // Await for server without blocking Ctrl+C handling
+        bool connected;
+        if (!await_for_server(&connected)) {
+            LOGE("Server connection failed");
+            goto end;
+        }
 
-    LOGD("Server connected");
+        if (!connected) {
+            // This is not an error, user requested to quit
+            LOGD("User requested to quit");
+            ret = SCRCPY_EXIT_SUCCESS;
+            goto end;
+        }
 
-    // It is necessarily initialized here, since the device is connected
-    struct sc_server_info *info = &s->server.info;
+        LOGD("Server connected");
 
-    const char *serial = s->server.serial;
-    assert(serial);
+        // It is necessarily initialized here, since the device is connected
+        struct sc_server_info *info = &s->server.info;
+        device_name = info->device_name;
+
+        serial = s->server.serial;
+        assert(serial);
+    }
 
     struct sc_file_pusher *fp = NULL;
 
-    if (options->video_playback && options->control) {
+    // The file pusher executes "adb push"
+    if (options->video_playback && options->control && !options->no_adb) {
         if (!sc_file_pusher_init(&s->file_pusher, serial,
                                  options->push_target)) {
             goto end;
@@ -571,20 +644,109 @@ scrcpy(struct scrcpy_options *options) {
         file_pusher_initialized = true;
     }
 
+    struct sc_screenshot *screenshot = NULL;
+
+    if (options->screenshot_dir) {
+        assert(options->video_playback);
+        if (!sc_screenshot_init(&s->screenshot, options->screenshot_dir,
+                                options->screenshot_format,
+                                options->screenshot_burst)) {
+            goto end;
+        }
+        screenshot_initialized = true;
+
+        if (!sc_screenshot_start(&s->screenshot)) {
+            goto end;
+        }
+        screenshot_started = true;
+        screenshot = &s->screenshot;
+    }
+
+    if (options->capture_stream_filename) {
+        uint8_t streams = 0;
+        if (options->video) {
+            streams |= SC_STREAM_CAPTURE_FLAG(SC_STREAM_CAPTURE_VIDEO);
+        }
+        if (options->audio) {
+            streams |= SC_STREAM_CAPTURE_FLAG(SC_STREAM_CAPTURE_AUDIO);
+        }
+
+        if (!sc_stream_capture_init(&s->capture,
+                                    options->capture_stream_filename,
+                                    device_name, streams)) {
+            goto end;
+        }
+        capture_initialized = true;
+    }
+
+#ifdef HAVE_IO_LOOP
+    struct sc_io_loop *io_loop = NULL;
+    if (options->io_engine == SC_IO_ENGINE_EPOLL) {
+        if (!sc_io_loop_init(&s->io_loop)) {
+            goto end;
+        }
+        io_loop_initialized = true;
+
+        if (!sc_io_loop_start(&s->io_loop)) {
+            goto end;
+        }
+        io_loop_started = true;
+
+        io_loop = &s->io_loop;
+    }
+#else
+    // Rejected by the command line parser
+    assert(options->io_engine == SC_IO_ENGINE_THREADS);
+#endif
+
     if (options->video) {
         static const struct sc_demuxer_callbacks video_demuxer_cbs = {
             .on_ended = sc_video_demuxer_on_ended,
         };
-        sc_demuxer_init(&s->video_demuxer, "video", s->server.video_socket,
-                        &video_demuxer_cbs, NULL);
+        if (replay_initialized) {
+            sc_demuxer_init_replay(&s->video_demuxer, "video", &s->replay,
+                                   SC_STREAM_CAPTURE_VIDEO, &video_demuxer_cbs,
+                                   NULL);
+        } else {
+            sc_demuxer_init(&s->video_demuxer, "video",
+                            s->server.video_socket, &video_demuxer_cbs, NULL);
+            if (capture_initialized) {
+                sc_demuxer_set_capture(&s->video_demuxer, &s->capture,
+                                       SC_STREAM_CAPTURE_VIDEO);
+            }
+#ifdef HAVE_IO_LOOP
+            if (io_loop) {
+                sc_demuxer_set_io_loop(&s->video_demuxer, io_loop);
+            }
+#endif
+        }
+        sc_demuxer_set_decoder_threads(&s->video_demuxer,
+                                       options->video_decoder_threads,
+                                       options->video_decoder_thread_type);
     }
 
     if (options->audio) {
         static const struct sc_demuxer_callbacks audio_demuxer_cbs = {
             .on_ended = sc_audio_demuxer_on_ended,
         };
-        sc_demuxer_init(&s->audio_demuxer, "audio", s->server.audio_socket,
-                        &audio_demuxer_cbs, options);
+        if (replay_initialized) {
+            sc_demuxer_init_replay(&s->audio_demuxer, "audio", &s->replay,
+                                   SC_STREAM_CAPTURE_AUDIO, &audio_demuxer_cbs,
+                                   options);
+        } else {
+            sc_demuxer_init(&s->audio_demuxer, "audio",
+                            s->server.audio_socket, &audio_demuxer_cbs,
+                            options);
+            if (capture_initialized) {
+                sc_demuxer_set_capture(&s->audio_demuxer, &s->capture,
+                                       SC_STREAM_CAPTURE_AUDIO);
+            }
+#ifdef HAVE_IO_LOOP
+            if (io_loop) {
+                sc_demuxer_set_io_loop(&s->audio_demuxer, io_loop);
+            }
+#endif
+        }
     }
 
     bool needs_video_decoder = options->video_playback;
@@ -594,8 +756,15 @@ scrcpy(struct scrcpy_options *options) {
 #endif
     if (needs_video_decoder) {
         sc_decoder_init(&s->video_decoder, "video");
-        sc_packet_source_add_sink(&s->video_demuxer.packet_source,
-                                  &s->video_decoder.packet_sink);
+        struct sc_packet_source *src = &s->video_demuxer.packet_source;
+        if (options->video_decode_queue) {
+            sc_decode_queue_init(&s->video_decode_queue, "video",
+                                 options->video_decode_queue);
+            sc_packet_source_add_sink(src,
+                                      &s->video_decode_queue.packet_sink);
+            src = &s->video_decode_queue.packet_source;
+        }
+        sc_packet_source_add_sink(src, &s->video_decoder.packet_sink);
     }
     if (needs_audio_decoder) {
         sc_decoder_init(&s->audio_decoder, "audio");
@@ -610,6 +779,10 @@ scrcpy(struct scrcpy_options *options) {
         if (!sc_recorder_init(&s->recorder, options->record_filename,
                               options->record_format, options->video,
                               options->audio, options->record_orientation,
+                              options->record_queue_limit,
+                              options->record_overflow,
+                              options->record_prealloc,
+                              options->record_fragment_duration,
                               &recorder_cbs, NULL)) {
             goto end;
         }
@@ -630,6 +803,28 @@ scrcpy(struct scrcpy_options *options) {
         }
     }
 
+    struct sc_replay_buffer *replay_buffer = NULL;
+
+    if (options->replay_buffer) {
+        const char *dir = options->replay_dir ? options->replay_dir : ".";
+        if (!sc_replay_buffer_init(&s->replay_buffer, options->replay_buffer,
+                                   dir, options->replay_format,
+                                   options->record_orientation)) {
+            goto end;
+        }
+        replay_buffer_initialized = true;
+        replay_buffer = &s->replay_buffer;
+
+        if (options->video) {
+            sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                      &s->replay_buffer.video_packet_sink);
+        }
+        if (options->audio) {
+            sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                      &s->replay_buffer.audio_packet_sink);
+        }
+    }
+
     struct sc_controller *controller = NULL;
     struct sc_key_processor *kp = NULL;
     struct sc_mouse_processor *mp = NULL;
@@ -646,6 +841,12 @@ scrcpy(struct scrcpy_options *options) {
         }
         controller_initialized = true;
 
+#ifdef HAVE_IO_LOOP
+        if (io_loop) {
+            sc_controller_set_io_loop(&s->controller, io_loop);
+        }
+#endif
+
         controller = &s->controller;
 
 #ifdef HAVE_USB
@@ -798,12 +999,14 @@ aoa_complete:
 
     if (options->window) {
         const char *window_title =
-            options->window_title ? options->window_title : info->device_name;
+            options->window_title ? options->window_title : device_name;
 
         struct sc_screen_params screen_params = {
             .video = options->video_playback,
             .controller = controller,
             .fp = fp,
+            .screenshot = screenshot,
+            .replay_buffer = replay_buffer,
             .kp = kp,
             .mp = mp,
             .gp = gp,
@@ -820,6 +1023,12 @@ aoa_complete:
             .window_borderless = options->window_borderless,
             .orientation = options->display_orientation,
             .mipmaps = options->mipmaps,
+            .pbo = options->pbo,
+            .low_res = options->video_low_res,
+            .partial_upload = options->video_partial_upload,
+            .frame_pacing = options->frame_pacing,
+            .prepare_thread = options->video_prepare_thread,
+            .render_bench = options->render_bench,
             .fullscreen = options->fullscreen,
             .start_fps_counter = options->start_fps_counter,
         };
@@ -839,6 +1048,13 @@ aoa_complete:
             }
 
             sc_frame_source_add_sink(src, &s->screen.frame_sink);
+
+            if (screenshot && screenshot->burst_interval) {
+                // Receive the frames from the decoder, so that the burst does
+                // not depend on the window visibility
+                sc_frame_source_add_sink(&s->video_decoder.frame_source,
+                                         &screenshot->frame_sink);
+            }
         }
     }
 
@@ -868,6 +1084,22 @@ aoa_complete:
     }
 #endif
 
+    if (needs_video_decoder) {
+        if (controller) {
+            sc_decoder_set_controller(&s->video_decoder, controller);
+        }
+        if (options->video_playback) {
+            sc_decoder_set_fps_counter(&s->video_decoder,
+                                       &s->screen.fps_counter);
+        }
+        if (options->video_catch_up) {
+            // Rejected by the command line parser if control is disabled
+            assert(controller);
+            sc_decoder_set_catch_up(&s->video_decoder,
+                                    options->video_catch_up);
+        }
+    }
+
     // Now that the header values have been consumed, the socket(s) will
     // receive the stream(s). Start the demuxer(s).
 
@@ -984,6 +1216,10 @@ end:
     if (file_pusher_initialized) {
         sc_file_pusher_stop(&s->file_pusher);
     }
+    if (screenshot_started) {
+        // The pending screenshots are saved before the thread terminates
+        sc_screenshot_stop(&s->screenshot);
+    }
     if (recorder_initialized) {
         sc_recorder_stop(&s->recorder);
     }
@@ -995,6 +1231,16 @@ end:
         // shutdown the sockets and kill the server
         sc_server_stop(&s->server);
     }
+    if (replay_initialized) {
+        sc_stream_replay_interrupt(&s->replay);
+    }
+#ifdef HAVE_IO_LOOP
+    if (io_loop_started) {
+        // The sockets are shutdown, the remaining streams are ended on join
+        sc_io_loop_stop(&s->io_loop);
+        sc_io_loop_join(&s->io_loop);
+    }
+#endif
 
     if (timeout_started) {
         sc_timeout_join(&s->timeout);
@@ -1013,6 +1259,13 @@ end:
         sc_demuxer_join(&s->audio_demuxer);
     }
 
+    if (capture_initialized) {
+        sc_stream_capture_destroy(&s->capture);
+    }
+    if (replay_initialized) {
+        sc_stream_replay_destroy(&s->replay);
+    }
+
 #ifdef HAVE_V4L2
     if (v4l2_sink_initialized) {
         sc_v4l2_sink_destroy(&s->v4l2_sink);
@@ -1037,6 +1290,14 @@ end:
         sc_screen_destroy(&s->screen);
     }
 
+    // The screen pushes the frames to save, so it must be destroyed first
+    if (screenshot_started) {
+        sc_screenshot_join(&s->screenshot);
+    }
+    if (screenshot_initialized) {
+        sc_screenshot_destroy(&s->screenshot);
+    }
+
     if (controller_started) {
         sc_controller_join(&s->controller);
     }
@@ -1044,6 +1305,13 @@ end:
         sc_controller_destroy(&s->controller);
     }
 
+#ifdef HAVE_IO_LOOP
+    // Destroy the I/O loop only after all its watches are removed
+    if (io_loop_initialized) {
+        sc_io_loop_destroy(&s->io_loop);
+    }
+#endif
+
     if (recorder_started) {
         sc_recorder_join(&s->recorder);
     }
@@ -1051,6 +1319,13 @@ end:
         sc_recorder_destroy(&s->recorder);
     }
 
+    // The screen may request a save, so it must be destroyed first (a pending
+    // save is completed on join)
+    if (replay_buffer_initialized) {
+        sc_replay_buffer_join(&s->replay_buffer);
+        sc_replay_buffer_destroy(&s->replay_buffer);
+    }
+
     if (file_pusher_initialized) {
         sc_file_pusher_join(&s->file_pusher);
         sc_file_pusher_destroy(&s->file_pusher);
@@ -143,6 +143,30 @@ sc_screen_is_relative_mode(struct sc_screen *screen) {
     return screen->im.mp && screen->im.mp->relative_mode;
 }
 
+static void
+sc_screen_update_low_res(struct sc_screen *screen) {
+    bool low_res = screen->rect.w * 2 < screen->content_size.width
+                && screen->rect.h * 2 < screen->content_size.height;
+    atomic_store_explicit(&screen->low_res, low_res, memory_order_relaxed);
+
+    if (screen->prepare_thread) {
+        // The current frame is prepared again if necessary
+        sc_display_set_low_res(&screen->display, low_res);
+        sc_prepare_thread_set_low_res(&screen->pt, low_res);
+        return;
+    }
+
+    if (sc_display_set_low_res(&screen->display, low_res)) {
+        LOGD("Low resolution rendering %s", low_res ? "enabled" : "disabled");
+        if (screen->has_frame) {
+            // Upload the current frame again at the new resolution
+            enum sc_display_result res =
+                sc_display_update_texture(&screen->display, screen->frame);
+            (void) res; // any error already logged
+        }
+    }
+}
+
 static void
 sc_screen_update_content_rect(struct sc_screen *screen) {
     assert(screen->video);
@@ -159,23 +183,26 @@ sc_screen_update_content_rect(struct sc_screen *screen) {
         rect->y = 0;
         rect->w = drawable_size.width;
         rect->h = drawable_size.height;
-        return;
+    } else {
+        bool keep_width = content_size.width * drawable_size.height
+                        > content_size.height * drawable_size.width;
+        if (keep_width) {
+            rect->x = 0;
+            rect->w = drawable_size.width;
+            rect->h = drawable_size.width * content_size.height
+                                          / content_size.width;
+            rect->y = (drawable_size.height - rect->h) / 2;
+        } else {
+            rect->y = 0;
+            rect->h = drawable_size.height;
+            rect->w = drawable_size.height * content_size.width
+                                           / content_size.height;
+            rect->x = (drawable_size.width - rect->w) / 2;
+        }
     }
 
-    bool keep_width = content_size.width * drawable_size.height
-                    > content_size.height * drawable_size.width;
-    if (keep_width) {
-        rect->x = 0;
-        rect->w = drawable_size.width;
-        rect->h = drawable_size.width * content_size.height
-                                      / content_size.width;
-        rect->y = (drawable_size.height - rect->h) / 2;
-    } else {
-        rect->y = 0;
-        rect->h = drawable_size.height;
-        rect->w = drawable_size.height * content_size.width
-                                       / content_size.height;
-        rect->x = (drawable_size.width - rect->w) / 2;
+    if (screen->low_res_enabled) {
+        sc_screen_update_low_res(screen);
     }
 }
 
@@ -195,6 +222,11 @@ sc_screen_render(struct sc_screen *screen, bool update_content_rect) {
     enum sc_display_result res =
         sc_display_render(&screen->display, &screen->rect, screen->orientation);
     (void) res; // any error already logged
+
+    if (screen->vsync) {
+        // The present returned just after a vblank
+        sc_frame_pacer_on_vblank(&screen->pacer, sc_tick_now());
+    }
 }
 
 static void
@@ -263,6 +295,18 @@ sc_screen_frame_sink_close(struct sc_frame_sink *sink) {
     // nothing to do, the screen lifecycle is not managed by the frame producer
 }
 
+static bool
+sc_screen_frame_sink_is_active(struct sc_frame_sink *sink) {
+    struct sc_screen *screen = DOWNCAST(sink);
+    return atomic_load_explicit(&screen->visible, memory_order_relaxed);
+}
+
+static bool
+sc_screen_frame_sink_is_low_res(struct sc_frame_sink *sink) {
+    struct sc_screen *screen = DOWNCAST(sink);
+    return atomic_load_explicit(&screen->low_res, memory_order_relaxed);
+}
+
 static bool
 sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
     struct sc_screen *screen = DOWNCAST(sink);
@@ -279,8 +323,9 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
         // The SC_EVENT_NEW_FRAME triggered for the previous frame will consume
         // this new frame instead
     } else {
-        // Post the event on the UI thread
-        bool ok = sc_push_event(SC_EVENT_NEW_FRAME);
+        // Post the event on the UI thread (the screen identifies the target
+        // if there are several screens)
+        bool ok = sc_push_event_with_data(SC_EVENT_NEW_FRAME, screen);
         if (!ok) {
             return false;
         }
@@ -295,11 +340,20 @@ sc_screen_init(struct sc_screen *screen,
     screen->resize_pending = false;
     screen->has_frame = false;
     screen->has_video_window = false;
+    atomic_init(&screen->visible, true);
+    screen->low_res_enabled = params->video && params->low_res;
+    atomic_init(&screen->low_res, false);
     screen->paused = false;
     screen->resume_frame = NULL;
     screen->orientation = SC_ORIENTATION_0;
 
     screen->video = params->video;
+    screen->screenshot = params->video ? params->screenshot : NULL;
+    // The preparation thread is only used for the video (without video, there
+    // is no frame to upload)
+    screen->prepare_thread = params->video && params->prepare_thread;
+    // Validated by the command line parser
+    assert(!screen->prepare_thread || !params->frame_pacing);
 
     screen->req.x = params->window_x;
     screen->req.y = params->window_y;
@@ -388,8 +442,9 @@ sc_screen_init(struct sc_screen *screen,
 
     SDL_Surface *icon_novideo = params->video ? NULL : icon;
     bool mipmaps = params->video && params->mipmaps;
+    bool pbo = params->video && params->pbo;
     ok = sc_display_init(&screen->display, screen->window, icon_novideo,
-                         mipmaps);
+                         mipmaps, pbo);
     if (icon) {
         scrcpy_icon_destroy(icon);
     }
@@ -397,15 +452,62 @@ sc_screen_init(struct sc_screen *screen,
         goto error_destroy_window;
     }
 
+    if (!screen->prepare_thread && params->video && params->partial_upload) {
+        ok = sc_display_set_partial_upload(&screen->display,
+                                           params->partial_upload);
+        if (!ok) {
+            goto error_destroy_display;
+        }
+    }
+
+    if (params->video && params->render_bench) {
+        sc_display_enable_render_bench(&screen->display);
+    }
+
+    if (screen->prepare_thread) {
+        // The changed regions are detected by the preparation thread
+        struct sc_prepare_thread_params pt_params = {
+            .fps_counter = &screen->fps_counter,
+            .event_data = screen,
+            .partial_upload = params->partial_upload,
+        };
+        ok = sc_prepare_thread_start(&screen->pt, &pt_params);
+        if (!ok) {
+            goto error_destroy_display;
+        }
+    }
+
     screen->frame = av_frame_alloc();
     if (!screen->frame) {
         LOG_OOM();
-        goto error_destroy_display;
+        goto error_stop_prepare_thread;
+    }
+
+    screen->pacing = params->video && params->frame_pacing;
+    screen->vsync = false;
+    screen->paced_frame = NULL;
+    screen->has_paced_frame = false;
+    screen->pacing_timer = 0;
+    if (screen->pacing) {
+        screen->paced_frame = av_frame_alloc();
+        if (!screen->paced_frame) {
+            LOG_OOM();
+            goto error_free_frame;
+        }
+
+        sc_frame_pacer_init(&screen->pacer, params->frame_pacing);
+        // Without vsync, the frames are rendered at their target time, without
+        // vblank alignment
+        screen->vsync = sc_display_set_vsync(&screen->display, true);
+        LOGI("Frame pacing enabled (latency budget %" PRItick " ms%s)",
+             SC_TICK_TO_MS(params->frame_pacing),
+             screen->vsync ? "" : ", without vsync");
     }
 
     struct sc_input_manager_params im_params = {
         .controller = params->controller,
         .fp = params->fp,
+        .replay_buffer = params->replay_buffer,
         .screen = screen,
         .kp = params->kp,
         .mp = params->mp,
@@ -435,6 +537,8 @@ sc_screen_init(struct sc_screen *screen,
         .open = sc_screen_frame_sink_open,
         .close = sc_screen_frame_sink_close,
         .push = sc_screen_frame_sink_push,
+        .is_active = sc_screen_frame_sink_is_active,
+        .is_low_res = sc_screen_frame_sink_is_low_res,
     };
 
     screen->frame_sink.ops = &ops;
@@ -450,6 +554,14 @@ sc_screen_init(struct sc_screen *screen,
 
     return true;
 
+error_free_frame:
+    av_frame_free(&screen->frame);
+error_stop_prepare_thread:
+    if (screen->prepare_thread) {
+        sc_prepare_thread_stop(&screen->pt);
+        sc_prepare_thread_join(&screen->pt);
+        sc_prepare_thread_destroy(&screen->pt);
+    }
 error_destroy_display:
     sc_display_destroy(&screen->display);
 error_destroy_window:
@@ -462,6 +574,27 @@ error_destroy_frame_buffer:
     return false;
 }
 
+static void
+sc_screen_update_refresh_rate(struct sc_screen *screen) {
+    assert(screen->pacing);
+
+    float refresh_rate = 0;
+    SDL_DisplayID display = SDL_GetDisplayForWindow(screen->window);
+    if (display) {
+        const SDL_DisplayMode *mode = SDL_GetCurrentDisplayMode(display);
+        if (mode) {
+            refresh_rate = mode->refresh_rate;
+        }
+    }
+
+    if (!refresh_rate) {
+        LOGW("Could not get the display refresh rate, frame pacing without "
+             "vblank alignment");
+    }
+
+    sc_frame_pacer_set_refresh_rate(&screen->pacer, refresh_rate);
+}
+
 static void
 sc_screen_show_initial_window(struct sc_screen *screen) {
     int x = screen->req.x != SC_WINDOW_POSITION_UNDEFINED
@@ -491,6 +624,10 @@ sc_screen_show_initial_window(struct sc_screen *screen) {
 
     sc_sdl_show_window(screen->window);
     sc_screen_update_content_rect(screen);
+
+    if (screen->pacing) {
+        sc_screen_update_refresh_rate(screen);
+    }
 }
 
 void
@@ -500,11 +637,17 @@ sc_screen_hide_window(struct sc_screen *screen) {
 
 void
 sc_screen_interrupt(struct sc_screen *screen) {
+    if (screen->prepare_thread) {
+        sc_prepare_thread_stop(&screen->pt);
+    }
     sc_fps_counter_interrupt(&screen->fps_counter);
 }
 
 void
 sc_screen_join(struct sc_screen *screen) {
+    if (screen->prepare_thread) {
+        sc_prepare_thread_join(&screen->pt);
+    }
     sc_fps_counter_join(&screen->fps_counter);
 }
 
@@ -513,7 +656,18 @@ sc_screen_destroy(struct sc_screen *screen) {
 #ifndef NDEBUG
     assert(!screen->open);
 #endif
+    if (screen->pacing) {
+        if (screen->pacing_timer) {
+            SDL_RemoveTimer(screen->pacing_timer);
+        }
+        sc_frame_pacer_log_stats(&screen->pacer);
+        av_frame_free(&screen->paced_frame);
+    }
+    if (screen->prepare_thread) {
+        sc_prepare_thread_destroy(&screen->pt);
+    }
     sc_display_destroy(&screen->display);
+    sc_input_manager_log_stats(&screen->im);
     av_frame_free(&screen->frame);
     SDL_DestroyWindow(screen->window);
     sc_fps_counter_destroy(&screen->fps_counter);
@@ -585,10 +739,86 @@ sc_screen_set_orientation(struct sc_screen *screen,
     sc_screen_render(screen, true);
 }
 
+static void
+sc_screen_show_video_window(struct sc_screen *screen) {
+    assert(screen->has_frame);
+    assert(!screen->has_video_window);
+
+    screen->has_video_window = true;
+    // this is the very first frame, show the window
+    sc_screen_show_initial_window(screen);
+
+    if (sc_screen_is_relative_mode(screen)) {
+        // Capture mouse on start
+        sc_mouse_capture_set_active(&screen->mc, true);
+    }
+}
+
+// Send the frame to the preparation thread, which prepares its upload
+//
+// The texture is updated (and recreated if necessary) on
+// SC_EVENT_FRAME_PREPARED, see sc_screen_upload_prepared_frame().
+static void
+sc_screen_apply_frame_async(struct sc_screen *screen) {
+    assert(screen->prepare_thread);
+
+    AVFrame *frame = screen->frame;
+    struct sc_size new_frame_size = {frame->width, frame->height};
+
+    if (!screen->has_frame
+            || screen->frame_size.width != new_frame_size.width
+            || screen->frame_size.height != new_frame_size.height) {
+        // frame dimension changed
+        screen->frame_size = new_frame_size;
+
+        struct sc_size new_content_size =
+            get_oriented_size(new_frame_size, screen->orientation);
+        if (screen->has_frame) {
+            set_content_size(screen, new_content_size);
+            sc_screen_update_content_rect(screen);
+        } else {
+            // This is the first frame
+            screen->has_frame = true;
+            screen->content_size = new_content_size;
+        }
+    }
+
+    // The rendered and skipped frames are counted by the preparation thread
+    sc_prepare_thread_push_frame(&screen->pt, frame);
+}
+
+static bool
+sc_screen_upload_prepared_frame(struct sc_screen *screen) {
+    assert(screen->prepare_thread);
+
+    enum sc_display_result res =
+        sc_prepare_thread_upload(&screen->pt, &screen->display);
+    if (res == SC_DISPLAY_RESULT_ERROR) {
+        return false;
+    }
+    if (res == SC_DISPLAY_RESULT_PENDING) {
+        // Not an error, but do not continue
+        return true;
+    }
+
+    assert(screen->has_frame);
+    if (!screen->has_video_window) {
+        sc_screen_show_video_window(screen);
+    }
+
+    sc_screen_render(screen, false);
+    return true;
+}
+
 static bool
 sc_screen_apply_frame(struct sc_screen *screen) {
     assert(screen->video);
 
+    if (screen->prepare_thread) {
+        sc_screen_apply_frame_async(screen);
+        return true;
+    }
+
     sc_fps_counter_add_rendered_frame(&screen->fps_counter);
 
     AVFrame *frame = screen->frame;
@@ -635,17 +865,135 @@ sc_screen_apply_frame(struct sc_screen *screen) {
 
     assert(screen->has_frame);
     if (!screen->has_video_window) {
-        screen->has_video_window = true;
-        // this is the very first frame, show the window
-        sc_screen_show_initial_window(screen);
+        sc_screen_show_video_window(screen);
+    }
+
+    sc_screen_render(screen, false);
+    return true;
+}
 
-        if (sc_screen_is_relative_mode(screen)) {
-            // Capture mouse on start
-            sc_mouse_capture_set_active(&screen->mc, true);
+// Make screen->resume_frame an empty frame, to store the last frame received
+// while paused
+static bool
+sc_screen_prepare_resume_frame(struct sc_screen *screen) {
+    if (!screen->resume_frame) {
+        screen->resume_frame = av_frame_alloc();
+        if (!screen->resume_frame) {
+            LOG_OOM();
+            return false;
         }
+    } else {
+        av_frame_unref(screen->resume_frame);
+    }
+
+    return true;
+}
+
+static bool
+sc_screen_present_paced_frame(struct sc_screen *screen);
+
+static Uint64 SDLCALL
+sc_screen_on_pacing_timer(void *userdata, SDL_TimerID timer_id,
+                          Uint64 interval) {
+    (void) timer_id;
+    (void) interval;
+
+    struct sc_screen *screen = userdata;
+    // Present on the main thread
+    sc_push_event_with_data(SC_EVENT_PRESENT_FRAME, screen);
+
+    return 0; // do not repeat
+}
+
+static bool
+sc_screen_start_pacing_timer(struct sc_screen *screen, sc_tick now) {
+    assert(screen->has_paced_frame);
+    assert(screen->paced_render_date > now);
+
+    if (screen->pacing_timer) {
+        // Scheduled for a previous frame (it may have already fired)
+        SDL_RemoveTimer(screen->pacing_timer);
+    }
+
+    sc_tick delay = screen->paced_render_date - now;
+    screen->pacing_timer = SDL_AddTimerNS(SC_TICK_TO_NS(delay),
+                                          sc_screen_on_pacing_timer, screen);
+    if (!screen->pacing_timer) {
+        LOGW("Could not schedule frame: %s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_screen_present_paced_frame(struct sc_screen *screen) {
+    assert(screen->pacing);
+
+    if (!screen->has_paced_frame) {
+        // Already presented
+        return true;
+    }
+
+    sc_tick now = sc_tick_now();
+    if (now < screen->paced_render_date
+            && sc_screen_start_pacing_timer(screen, now)) {
+        // Obsolete event, from a timer started for a replaced frame
+        return true;
+    }
+
+    if (screen->pacing_timer) {
+        SDL_RemoveTimer(screen->pacing_timer);
+        screen->pacing_timer = 0;
+    }
+
+    screen->has_paced_frame = false;
+
+    if (screen->paused) {
+        if (!sc_screen_prepare_resume_frame(screen)) {
+            return false;
+        }
+        av_frame_move_ref(screen->resume_frame, screen->paced_frame);
+        return true;
+    }
+
+    av_frame_unref(screen->frame);
+    av_frame_move_ref(screen->frame, screen->paced_frame);
+    bool ok = sc_screen_apply_frame(screen);
+    sc_frame_pacer_on_present(&screen->pacer, sc_tick_now());
+    return ok;
+}
+
+static bool
+sc_screen_schedule_frame(struct sc_screen *screen) {
+    assert(screen->pacing);
+
+    if (screen->has_paced_frame) {
+        // The previous frame has not been presented yet, replace it
+        sc_frame_pacer_on_drop(&screen->pacer);
+        sc_fps_counter_add_skipped_frame(&screen->fps_counter);
+        av_frame_unref(screen->paced_frame);
+    }
+
+    sc_frame_buffer_consume(&screen->fb, screen->paced_frame);
+    screen->has_paced_frame = true;
+
+    AVFrame *frame = screen->paced_frame;
+    if (frame->pts == AV_NOPTS_VALUE) {
+        // No target time
+        return sc_screen_present_paced_frame(screen);
+    }
+
+    sc_tick now = sc_tick_now();
+    sc_tick pts = SC_TICK_FROM_US(frame->pts);
+    screen->paced_render_date =
+        sc_frame_pacer_schedule(&screen->pacer, now, pts);
+
+    if (screen->paced_render_date <= now
+            || !sc_screen_start_pacing_timer(screen, now)) {
+        return sc_screen_present_paced_frame(screen);
     }
 
-    sc_screen_render(screen, false);
     return true;
 }
 
@@ -654,19 +1002,17 @@ sc_screen_update_frame(struct sc_screen *screen) {
     assert(screen->video);
 
     if (screen->paused) {
-        if (!screen->resume_frame) {
-            screen->resume_frame = av_frame_alloc();
-            if (!screen->resume_frame) {
-                LOG_OOM();
-                return false;
-            }
-        } else {
-            av_frame_unref(screen->resume_frame);
+        if (!sc_screen_prepare_resume_frame(screen)) {
+            return false;
         }
         sc_frame_buffer_consume(&screen->fb, screen->resume_frame);
         return true;
     }
 
+    if (screen->pacing) {
+        return sc_screen_schedule_frame(screen);
+    }
+
     av_frame_unref(screen->frame);
     sc_frame_buffer_consume(&screen->fb, screen->frame);
     return sc_screen_apply_frame(screen);
@@ -701,6 +1047,36 @@ sc_screen_set_paused(struct sc_screen *screen, bool paused) {
     screen->paused = paused;
 }
 
+void
+sc_screen_take_screenshot(struct sc_screen *screen) {
+    assert(screen->video);
+
+    struct sc_screenshot *ss = screen->screenshot;
+    if (!ss) {
+        LOGW("Screenshots are disabled (use --screenshot-dir)");
+        return;
+    }
+
+    if (ss->burst_interval) {
+        sc_screenshot_toggle_burst(ss);
+        return;
+    }
+
+    // Save the frame currently displayed
+    bool ok;
+    if (screen->prepare_thread) {
+        ok = sc_prepare_thread_screenshot(&screen->pt, ss);
+    } else if (screen->has_frame) {
+        ok = sc_screenshot_push(ss, screen->frame);
+    } else {
+        ok = false;
+    }
+
+    if (!ok) {
+        LOGW("Could not take screenshot");
+    }
+}
+
 void
 sc_screen_toggle_fullscreen(struct sc_screen *screen) {
     assert(screen->video);
@@ -760,6 +1136,19 @@ sc_screen_resize_to_pixel_perfect(struct sc_screen *screen) {
                                             content_size.height);
 }
 
+static void
+sc_screen_set_visible(struct sc_screen *screen, bool visible) {
+    if (!screen->has_video_window) {
+        return;
+    }
+
+    bool previous = atomic_exchange_explicit(&screen->visible, visible,
+                                             memory_order_relaxed);
+    if (previous != visible) {
+        LOGD("Window %s", visible ? "visible" : "not visible");
+    }
+}
+
 bool
 sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
     // !video implies !has_video_window
@@ -773,7 +1162,29 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
             }
             return true;
         }
+        case SC_EVENT_PRESENT_FRAME: {
+            bool ok = sc_screen_present_paced_frame(screen);
+            if (!ok) {
+                LOGE("Frame presentation failed");
+                return false;
+            }
+            return true;
+        }
+        case SC_EVENT_FRAME_PREPARED: {
+            bool ok = sc_screen_upload_prepared_frame(screen);
+            if (!ok) {
+                LOGE("Frame upload failed");
+                return false;
+            }
+            return true;
+        }
+        case SDL_EVENT_WINDOW_DISPLAY_CHANGED:
+            if (screen->pacing) {
+                sc_screen_update_refresh_rate(screen);
+            }
+            return true;
         case SDL_EVENT_WINDOW_EXPOSED:
+            sc_screen_set_visible(screen, true);
             if (!screen->video) {
                 sc_screen_render_novideo(screen);
             } else if (screen->has_video_window) {
@@ -785,7 +1196,17 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
                 sc_screen_render(screen, true);
             }
             return true;
+        case SDL_EVENT_WINDOW_MINIMIZED:
+        case SDL_EVENT_WINDOW_OCCLUDED:
+        case SDL_EVENT_WINDOW_HIDDEN:
+            sc_screen_set_visible(screen, false);
+            return true;
+        case SDL_EVENT_WINDOW_SHOWN:
+        case SDL_EVENT_WINDOW_MAXIMIZED:
+            sc_screen_set_visible(screen, true);
+            return true;
         case SDL_EVENT_WINDOW_RESTORED:
+            sc_screen_set_visible(screen, true);
             if (screen->has_video_window && is_windowed(screen)) {
                 apply_pending_resize(screen);
                 sc_screen_render(screen, true);
@@ -3,6 +3,7 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <SDL3/SDL.h>
@@ -15,9 +16,12 @@
 #include "display.h"
 #include "fps_counter.h"
 #include "frame_buffer.h"
+#include "frame_pacer.h"
 #include "input_manager.h"
 #include "mouse_capture.h"
 #include "options.h"
+#include "prepare_thread.h"
+#include "screenshot.h"
 #include "trait/key_processor.h"
 #include "trait/frame_sink.h"
 #include "trait/mouse_processor.h"
@@ -32,10 +36,14 @@ struct sc_screen {
     bool video;
 
     struct sc_display display;
+    // If set, the frame uploads are prepared by a dedicated thread
+    bool prepare_thread;
+    struct sc_prepare_thread pt;
     struct sc_input_manager im;
     struct sc_mouse_capture mc; // only used in mouse relative mode
     struct sc_frame_buffer fb;
     struct sc_fps_counter fps_counter;
+    struct sc_screenshot *screenshot; // NULL if screenshots are disabled
 
     // The initial requested window properties
     struct {
@@ -62,11 +70,27 @@ struct sc_screen {
     struct SDL_Rect rect;
     bool has_frame;
     bool has_video_window;
+    // false while the window is minimized, hidden or occluded (read by the
+    // decoder to skip decoding)
+    atomic_bool visible;
+    // Render at reduced resolution while the content is downscaled by more
+    // than 2 (read by the decoder to reduce the decoding quality)
+    bool low_res_enabled;
+    atomic_bool low_res;
 
     AVFrame *frame;
 
     bool paused;
     AVFrame *resume_frame;
+
+    // Frame pacing (only used if pacing is enabled)
+    bool pacing;
+    bool vsync;
+    struct sc_frame_pacer pacer;
+    AVFrame *paced_frame; // the frame waiting for its presentation
+    bool has_paced_frame;
+    sc_tick paced_render_date;
+    SDL_TimerID pacing_timer; // 0 if none
 };
 
 struct sc_screen_params {
@@ -74,6 +98,8 @@ struct sc_screen_params {
 
     struct sc_controller *controller;
     struct sc_file_pusher *fp;
+    struct sc_screenshot *screenshot;
+    struct sc_replay_buffer *replay_buffer;
     struct sc_key_processor *kp;
     struct sc_mouse_processor *mp;
     struct sc_gamepad_processor *gp;
@@ -95,6 +121,12 @@ struct sc_screen_params {
 
     enum sc_orientation orientation;
     bool mipmaps;
+    bool pbo;
+    bool low_res;
+    uint8_t partial_upload; // max changed percentage, 0 to disable
+    sc_tick frame_pacing; // latency budget, 0 to disable frame pacing
+    bool prepare_thread;
+    bool render_bench;
 
     bool fullscreen;
     bool start_fps_counter;
@@ -145,6 +177,10 @@ sc_screen_set_orientation(struct sc_screen *screen,
 void
 sc_screen_set_paused(struct sc_screen *screen, bool paused);
 
+// save the current frame (or pause/resume the burst in burst mode)
+void
+sc_screen_take_screenshot(struct sc_screen *screen);
+
 // react to SDL events
 // If this function returns false, scrcpy must exit with an error.
 bool
@@ -0,0 +1,645 @@
+#include "screenshot.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/pixdesc.h>
+
+#include "util/file.h"
+#include "util/log.h"
+#include "util/str.h"
+
+#define DOWNCAST(SINK) container_of(SINK, struct sc_screenshot, frame_sink)
+
+// JPEG quantizer scale (1 is the best quality, 31 the worst)
+#define SC_SCREENSHOT_JPEG_QSCALE 2
+
+// Fixed-point coefficients (16 bits fractional part)
+#define SC_FIX(x) ((int32_t) ((x) * (1 << 16) + 0.5))
+
+struct sc_yuv_coeffs {
+    int32_t y;
+    int32_t rv;
+    int32_t gu;
+    int32_t gv;
+    int32_t bu;
+    uint8_t y_offset;
+};
+
+static const struct sc_yuv_coeffs bt601_limited = {
+    SC_FIX(1.164), SC_FIX(1.596), SC_FIX(0.392), SC_FIX(0.813), SC_FIX(2.017),
+    16,
+};
+
+static const struct sc_yuv_coeffs bt601_full = {
+    SC_FIX(1.0), SC_FIX(1.402), SC_FIX(0.344), SC_FIX(0.714), SC_FIX(1.772),
+    0,
+};
+
+static const struct sc_yuv_coeffs bt709_limited = {
+    SC_FIX(1.164), SC_FIX(1.793), SC_FIX(0.213), SC_FIX(0.533), SC_FIX(2.112),
+    16,
+};
+
+static const struct sc_yuv_coeffs bt709_full = {
+    SC_FIX(1.0), SC_FIX(1.5748), SC_FIX(0.1873), SC_FIX(0.4681), SC_FIX(1.8556),
+    0,
+};
+
+static const char *
+sc_screenshot_get_extension(enum sc_screenshot_format format) {
+    switch (format) {
+        case SC_SCREENSHOT_FORMAT_PNG:
+            return "png";
+        case SC_SCREENSHOT_FORMAT_JPEG:
+            return "jpg";
+        case SC_SCREENSHOT_FORMAT_WEBP:
+            return "webp";
+        default:
+            assert(!"unexpected screenshot format");
+            return NULL;
+    }
+}
+
+static enum AVCodecID
+sc_screenshot_get_codec_id(enum sc_screenshot_format format) {
+    switch (format) {
+        case SC_SCREENSHOT_FORMAT_PNG:
+            return AV_CODEC_ID_PNG;
+        case SC_SCREENSHOT_FORMAT_JPEG:
+            return AV_CODEC_ID_MJPEG;
+        case SC_SCREENSHOT_FORMAT_WEBP:
+            return AV_CODEC_ID_WEBP;
+        default:
+            assert(!"unexpected screenshot format");
+            return AV_CODEC_ID_NONE;
+    }
+}
+
+static inline uint8_t
+sc_screenshot_clamp(int32_t value) {
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+static bool
+sc_screenshot_is_full_range(const AVFrame *frame) {
+    return frame->color_range == AVCOL_RANGE_JPEG
+        || frame->format == AV_PIX_FMT_YUVJ420P;
+}
+
+static bool
+sc_screenshot_check_format(const AVFrame *frame) {
+    if (frame->format == AV_PIX_FMT_YUV420P
+            || frame->format == AV_PIX_FMT_YUVJ420P) {
+        return true;
+    }
+
+    const char *name = av_get_pix_fmt_name(frame->format);
+    LOGE("Could not save screenshot: unsupported pixel format %s (only "
+         "yuv420p and yuvj420p are supported)", name ? name : "unknown");
+    return false;
+}
+
+static AVFrame *
+sc_screenshot_alloc_frame(const AVFrame *src, enum AVPixelFormat format) {
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    frame->format = format;
+    frame->width = src->width;
+    frame->height = src->height;
+
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        LOG_OOM();
+        av_frame_free(&frame);
+        return NULL;
+    }
+
+    return frame;
+}
+
+// Convert a YUV 4:2:0 frame to RGB (for the PNG encoder)
+static AVFrame *
+sc_screenshot_convert_to_rgb(const AVFrame *src) {
+    AVFrame *frame = sc_screenshot_alloc_frame(src, AV_PIX_FMT_RGB24);
+    if (!frame) {
+        return NULL;
+    }
+
+    bool full_range = sc_screenshot_is_full_range(src);
+    const struct sc_yuv_coeffs *k;
+    if (src->colorspace == AVCOL_SPC_BT709) {
+        k = full_range ? &bt709_full : &bt709_limited;
+    } else {
+        // Consider any other colorspace as BT.601
+        k = full_range ? &bt601_full : &bt601_limited;
+    }
+
+    const int32_t half = 1 << 15;
+    for (int y = 0; y < src->height; ++y) {
+        const uint8_t *py = src->data[0] + y * src->linesize[0];
+        const uint8_t *pu = src->data[1] + (y / 2) * src->linesize[1];
+        const uint8_t *pv = src->data[2] + (y / 2) * src->linesize[2];
+        uint8_t *out = frame->data[0] + y * frame->linesize[0];
+
+        for (int x = 0; x < src->width; ++x) {
+            int32_t luma = (py[x] - k->y_offset) * k->y + half;
+            int32_t u = pu[x / 2] - 128;
+            int32_t v = pv[x / 2] - 128;
+            out[0] = sc_screenshot_clamp((luma + k->rv * v) >> 16);
+            out[1] = sc_screenshot_clamp((luma - k->gu * u - k->gv * v) >> 16);
+            out[2] = sc_screenshot_clamp((luma + k->bu * u) >> 16);
+            out += 3;
+        }
+    }
+
+    return frame;
+}
+
+// Expand the YUV values to full range (for the JPEG encoder)
+static AVFrame *
+sc_screenshot_convert_to_full_range(const AVFrame *src) {
+    if (sc_screenshot_is_full_range(src)) {
+        // Nothing to convert, but a writable frame is returned anyway (the
+        // caller sets its properties)
+        return av_frame_clone(src);
+    }
+
+    AVFrame *frame = sc_screenshot_alloc_frame(src, AV_PIX_FMT_YUV420P);
+    if (!frame) {
+        return NULL;
+    }
+
+    frame->colorspace = src->colorspace;
+    frame->color_range = AVCOL_RANGE_JPEG;
+
+    uint8_t luma_lut[256];
+    uint8_t chroma_lut[256];
+    for (int i = 0; i < 256; ++i) {
+        luma_lut[i] = sc_screenshot_clamp(((i - 16) * 255 + 109) / 219);
+        chroma_lut[i] = sc_screenshot_clamp(128 + (i - 128) * 255 / 224);
+    }
+
+    for (unsigned plane = 0; plane < 3; ++plane) {
+        const uint8_t *lut = plane ? chroma_lut : luma_lut;
+        int width = plane ? (src->width + 1) / 2 : src->width;
+        int height = plane ? (src->height + 1) / 2 : src->height;
+
+        for (int y = 0; y < height; ++y) {
+            const uint8_t *in = src->data[plane] + y * src->linesize[plane];
+            uint8_t *out = frame->data[plane] + y * frame->linesize[plane];
+            for (int x = 0; x < width; ++x) {
+                out[x] = lut[in[x]];
+            }
+        }
+    }
+
+    return frame;
+}
+
+// Convert the frame to a pixel format accepted by the encoder
+static AVFrame *
+sc_screenshot_convert(struct sc_screenshot *ss, const AVFrame *src) {
+    // Checked on push
+    assert(src->format == AV_PIX_FMT_YUV420P
+            || src->format == AV_PIX_FMT_YUVJ420P);
+
+    switch (ss->format) {
+        case SC_SCREENSHOT_FORMAT_PNG:
+            return sc_screenshot_convert_to_rgb(src);
+        case SC_SCREENSHOT_FORMAT_JPEG:
+            return sc_screenshot_convert_to_full_range(src);
+        case SC_SCREENSHOT_FORMAT_WEBP:
+            // The WebP encoder accepts YUV 4:2:0 directly
+            return av_frame_clone(src);
+        default:
+            assert(!"unexpected screenshot format");
+            return NULL;
+    }
+}
+
+static bool
+sc_screenshot_encode(struct sc_screenshot *ss, AVFrame *frame,
+                     AVPacket *packet) {
+    enum AVCodecID codec_id = sc_screenshot_get_codec_id(ss->format);
+    const AVCodec *codec = avcodec_find_encoder(codec_id);
+    if (!codec) {
+        LOGE("Image encoder not found: %s", avcodec_get_name(codec_id));
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    ctx->width = frame->width;
+    ctx->height = frame->height;
+    ctx->pix_fmt = frame->format;
+    ctx->colorspace = frame->colorspace;
+    ctx->color_range = frame->color_range;
+    ctx->time_base = (AVRational) {1, 1};
+
+    if (ss->format == SC_SCREENSHOT_FORMAT_JPEG) {
+        ctx->flags |= AV_CODEC_FLAG_QSCALE;
+        ctx->global_quality = FF_QP2LAMBDA * SC_SCREENSHOT_JPEG_QSCALE;
+        // With AV_CODEC_FLAG_QSCALE, the quality is read from the frame
+        frame->quality = ctx->global_quality;
+    }
+
+    bool ok = false;
+
+    int ret = avcodec_open2(ctx, codec, NULL);
+    if (ret < 0) {
+        LOGE("Could not open image encoder: %s", codec->name);
+        goto end;
+    }
+
+    ret = avcodec_send_frame(ctx, frame);
+    if (ret < 0) {
+        LOGE("Could not encode screenshot: %d", ret);
+        goto end;
+    }
+
+    // Flush the encoder, to receive the packet immediately
+    ret = avcodec_send_frame(ctx, NULL);
+    if (ret < 0) {
+        LOGE("Could not flush image encoder: %d", ret);
+        goto end;
+    }
+
+    ret = avcodec_receive_packet(ctx, packet);
+    if (ret < 0) {
+        LOGE("Could not receive screenshot packet: %d", ret);
+        goto end;
+    }
+
+    ok = true;
+
+end:
+    avcodec_free_context(&ctx);
+    return ok;
+}
+
+static char *
+sc_screenshot_get_filename(struct sc_screenshot *ss, time_t time) {
+    struct tm tm;
+#ifdef _WIN32
+    bool ok = !localtime_s(&tm, &time);
+#else
+    bool ok = localtime_r(&time, &tm);
+#endif
+    char date[32];
+    if (!ok || !strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &tm)) {
+        strcpy(date, "unknown");
+    }
+
+    const char *ext = sc_screenshot_get_extension(ss->format);
+
+    // <dir>/scrcpy-<date>-<index>.<ext>
+    size_t len = strlen(ss->dir) + strlen(date) + strlen(ext) + 32;
+    char *filename = malloc(len);
+    if (!filename) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    snprintf(filename, len, "%s%cscrcpy-%s-%04u.%s", ss->dir,
+             SC_PATH_SEPARATOR, date, ss->index++, ext);
+    return filename;
+}
+
+static bool
+sc_screenshot_write_file(const char *filename, const AVPacket *packet) {
+    char *file_url = sc_str_concat("file:", filename);
+    if (!file_url) {
+        return false;
+    }
+
+    AVIOContext *pb;
+    int ret = avio_open(&pb, file_url, AVIO_FLAG_WRITE);
+    free(file_url);
+    if (ret < 0) {
+        LOGE("Could not open screenshot file: %s", filename);
+        return false;
+    }
+
+    avio_write(pb, packet->data, packet->size);
+
+    // Any write error is reported on close
+    ret = avio_closep(&pb);
+    if (ret < 0) {
+        LOGE("Could not write screenshot file: %s", filename);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_screenshot_save(struct sc_screenshot *ss,
+                   const struct sc_screenshot_request *req, AVPacket *packet) {
+    AVFrame *frame = sc_screenshot_convert(ss, req->frame);
+    if (!frame) {
+        return false;
+    }
+
+    bool ok = sc_screenshot_encode(ss, frame, packet);
+    av_frame_free(&frame);
+    if (!ok) {
+        return false;
+    }
+
+    char *filename = sc_screenshot_get_filename(ss, req->time);
+    if (!filename) {
+        av_packet_unref(packet);
+        return false;
+    }
+
+    ok = sc_screenshot_write_file(filename, packet);
+    av_packet_unref(packet);
+
+    if (ok) {
+        if (ss->burst_interval) {
+            LOGD("Screenshot saved to %s", filename);
+        } else {
+            LOGI("Screenshot saved to %s", filename);
+        }
+    }
+
+    free(filename);
+    return ok;
+}
+
+static int
+run_screenshot(void *data) {
+    struct sc_screenshot *ss = data;
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        return 0;
+    }
+
+    for (;;) {
+        sc_mutex_lock(&ss->mutex);
+        while (!ss->stopped && sc_vecdeque_is_empty(&ss->queue)) {
+            sc_cond_wait(&ss->queue_cond, &ss->mutex);
+        }
+        if (sc_vecdeque_is_empty(&ss->queue)) {
+            // Stopped, and all the pending screenshots have been saved
+            assert(ss->stopped);
+            sc_mutex_unlock(&ss->mutex);
+            break;
+        }
+
+        struct sc_screenshot_request req = sc_vecdeque_pop(&ss->queue);
+        sc_mutex_unlock(&ss->mutex);
+
+        sc_tick start = sc_tick_now();
+        bool ok = sc_screenshot_save(ss, &req, packet);
+        if (ok) {
+            ++ss->saved;
+            ss->total_duration += sc_tick_now() - start;
+        }
+
+        av_frame_free(&req.frame);
+    }
+
+    av_packet_free(&packet);
+
+    return 0;
+}
+
+static bool
+sc_screenshot_frame_sink_open(struct sc_frame_sink *sink,
+                              const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    // nothing to do, the screenshot thread is started independently
+    return true;
+}
+
+static void
+sc_screenshot_frame_sink_close(struct sc_frame_sink *sink) {
+    (void) sink;
+    // nothing to do, the pending frames are saved until the thread is stopped
+}
+
+static bool
+sc_screenshot_frame_sink_push(struct sc_frame_sink *sink,
+                              const AVFrame *frame) {
+    struct sc_screenshot *ss = DOWNCAST(sink);
+    assert(ss->burst_interval);
+
+    if (!atomic_load_explicit(&ss->burst_active, memory_order_relaxed)) {
+        // Save the first frame as soon as the burst is resumed
+        ss->burst_counter = 0;
+        return true;
+    }
+
+    if (!ss->burst_counter) {
+        if (!sc_screenshot_check_format(frame)) {
+            // Do not fail the decoder, only stop the burst
+            atomic_store_explicit(&ss->burst_active, false,
+                                  memory_order_relaxed);
+            LOGW("Screenshot burst paused");
+            return true;
+        }
+
+        // On failure, the frame is just skipped (the drops are counted)
+        sc_screenshot_push(ss, frame);
+    }
+
+    ss->burst_counter = (ss->burst_counter + 1) % ss->burst_interval;
+    return true;
+}
+
+static bool
+sc_screenshot_frame_sink_is_active(struct sc_frame_sink *sink) {
+    struct sc_screenshot *ss = DOWNCAST(sink);
+    // The frames are needed while the burst is active, whatever the window
+    return atomic_load_explicit(&ss->burst_active, memory_order_relaxed);
+}
+
+static bool
+sc_screenshot_frame_sink_is_low_res(struct sc_frame_sink *sink) {
+    struct sc_screenshot *ss = DOWNCAST(sink);
+    // The saved frames need full quality
+    return !atomic_load_explicit(&ss->burst_active, memory_order_relaxed);
+}
+
+bool
+sc_screenshot_init(struct sc_screenshot *ss, const char *dir,
+                   enum sc_screenshot_format format, uint16_t burst_interval) {
+    assert(dir);
+
+    sc_vecdeque_init(&ss->queue);
+    // The requests are pushed without allocation
+    if (!sc_vecdeque_reserve(&ss->queue, SC_SCREENSHOT_QUEUE_LIMIT)) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&ss->mutex);
+    if (!ok) {
+        goto error_destroy_queue;
+    }
+
+    ok = sc_cond_init(&ss->queue_cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    ss->dir = strdup(dir);
+    if (!ss->dir) {
+        LOG_OOM();
+        goto error_destroy_cond;
+    }
+
+    ss->format = format;
+    ss->burst_interval = burst_interval;
+    ss->stopped = false;
+
+    // In burst mode, the burst is active from the start
+    atomic_init(&ss->burst_active, burst_interval != 0);
+    ss->burst_counter = 0;
+
+    ss->dropped = 0;
+    ss->index = 0;
+    ss->saved = 0;
+    ss->total_duration = 0;
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_screenshot_frame_sink_open,
+        .close = sc_screenshot_frame_sink_close,
+        .push = sc_screenshot_frame_sink_push,
+        .is_active = sc_screenshot_frame_sink_is_active,
+        .is_low_res = sc_screenshot_frame_sink_is_low_res,
+    };
+
+    ss->frame_sink.ops = &ops;
+
+    return true;
+
+error_destroy_cond:
+    sc_cond_destroy(&ss->queue_cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&ss->mutex);
+error_destroy_queue:
+    sc_vecdeque_destroy(&ss->queue);
+
+    return false;
+}
+
+void
+sc_screenshot_destroy(struct sc_screenshot *ss) {
+    if (ss->saved) {
+        LOGD("Screenshots: %" PRIu64_ " saved (avg %" PRItick " ms)",
+             ss->saved, SC_TICK_TO_MS(ss->total_duration / ss->saved));
+    }
+    if (ss->dropped) {
+        LOGW("Screenshots: %" PRIu64_ " dropped (too many pending)",
+             ss->dropped);
+    }
+
+    while (!sc_vecdeque_is_empty(&ss->queue)) {
+        struct sc_screenshot_request *req = sc_vecdeque_popref(&ss->queue);
+        av_frame_free(&req->frame);
+    }
+    sc_vecdeque_destroy(&ss->queue);
+
+    free(ss->dir);
+    sc_cond_destroy(&ss->queue_cond);
+    sc_mutex_destroy(&ss->mutex);
+}
+
+bool
+sc_screenshot_start(struct sc_screenshot *ss) {
+    LOGD("Starting screenshot thread");
+
+    bool ok = sc_thread_create(&ss->thread, run_screenshot, "scrcpy-shot", ss);
+    if (!ok) {
+        LOGE("Could not start screenshot thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_screenshot_stop(struct sc_screenshot *ss) {
+    sc_mutex_lock(&ss->mutex);
+    ss->stopped = true;
+    sc_cond_signal(&ss->queue_cond);
+    sc_mutex_unlock(&ss->mutex);
+}
+
+void
+sc_screenshot_join(struct sc_screenshot *ss) {
+    sc_thread_join(&ss->thread, NULL);
+}
+
+bool
+sc_screenshot_push(struct sc_screenshot *ss, const AVFrame *frame) {
+    if (!sc_screenshot_check_format(frame)) {
+        return false;
+    }
+
+    // Only take a new reference, the frame data is not copied
+    AVFrame *ref = av_frame_alloc();
+    if (!ref) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (av_frame_ref(ref, frame)) {
+        LOG_OOM();
+        av_frame_free(&ref);
+        return false;
+    }
+
+    struct sc_screenshot_request req = {
+        .frame = ref,
+        .time = time(NULL),
+    };
+
+    sc_mutex_lock(&ss->mutex);
+    bool full = sc_vecdeque_size(&ss->queue) >= SC_SCREENSHOT_QUEUE_LIMIT;
+    if (full) {
+        ++ss->dropped;
+    } else {
+        bool was_empty = sc_vecdeque_is_empty(&ss->queue);
+        sc_vecdeque_push_noresize(&ss->queue, req);
+        if (was_empty) {
+            sc_cond_signal(&ss->queue_cond);
+        }
+    }
+    sc_mutex_unlock(&ss->mutex);
+
+    if (full) {
+        av_frame_free(&ref);
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_screenshot_toggle_burst(struct sc_screenshot *ss) {
+    assert(ss->burst_interval);
+
+    bool active =
+        !atomic_load_explicit(&ss->burst_active, memory_order_relaxed);
+    atomic_store_explicit(&ss->burst_active, active, memory_order_relaxed);
+
+    LOGI("Screenshot burst %s", active ? "resumed" : "paused");
+}
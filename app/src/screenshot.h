@@ -0,0 +1,95 @@
+#ifndef SC_SCREENSHOT_H
+#define SC_SCREENSHOT_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <libavutil/frame.h>
+
+#include "options.h"
+#include "trait/frame_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+
+// Maximum number of frames waiting to be saved
+#define SC_SCREENSHOT_QUEUE_LIMIT 16
+
+struct sc_screenshot_request {
+    AVFrame *frame;
+    time_t time;
+};
+
+struct sc_screenshot_queue SC_VECDEQUE(struct sc_screenshot_request);
+
+/**
+ * Save frames to image files from a separate thread
+ *
+ * The caller only takes a new reference on the frame (no copy); the color
+ * conversion, the encoding and the file writing are executed by the
+ * screenshot thread.
+ *
+ * In burst mode, the screenshot is also a frame sink of the video decoder:
+ * every Nth decoded frame is saved while the burst is active, even if the
+ * window is hidden or minimized.
+ *
+ * Only YUV 4:2:0 frames (yuv420p or yuvj420p) are supported.
+ */
+struct sc_screenshot {
+    struct sc_frame_sink frame_sink; // frame sink trait (burst mode only)
+
+    char *dir;
+    enum sc_screenshot_format format;
+    uint16_t burst_interval; // 0 if burst mode is disabled
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond queue_cond;
+    bool stopped;
+    struct sc_screenshot_queue queue;
+
+    // Written by the main thread, read by the decoder thread
+    atomic_bool burst_active;
+    // Only accessed by the decoder thread
+    uint16_t burst_counter;
+
+    // The following fields are protected by the mutex
+    uint64_t dropped;
+
+    // The following fields are only accessed by the screenshot thread
+    unsigned index; // index of the next file (to generate unique names)
+    uint64_t saved;
+    sc_tick total_duration;
+};
+
+bool
+sc_screenshot_init(struct sc_screenshot *ss, const char *dir,
+                   enum sc_screenshot_format format, uint16_t burst_interval);
+
+void
+sc_screenshot_destroy(struct sc_screenshot *ss);
+
+bool
+sc_screenshot_start(struct sc_screenshot *ss);
+
+void
+sc_screenshot_stop(struct sc_screenshot *ss);
+
+void
+sc_screenshot_join(struct sc_screenshot *ss);
+
+// Request to save the frame (a new reference is taken)
+//
+// The frame is dropped (and false is returned) if too many frames are pending
+// or if its pixel format is not supported.
+bool
+sc_screenshot_push(struct sc_screenshot *ss, const AVFrame *frame);
+
+// Start or stop saving every Nth frame (only in burst mode)
+void
+sc_screenshot_toggle_burst(struct sc_screenshot *ss);
+
+#endif
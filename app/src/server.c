@@ -589,7 +589,8 @@ static bool
 sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
     struct sc_adb_tunnel *tunnel = &server->tunnel;
 
-    assert(tunnel->enabled);
+    bool no_adb = server->params.no_adb;
+    assert(no_adb || tunnel->enabled);
 
     const char *serial = server->serial;
     assert(serial);
@@ -601,7 +602,7 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
     sc_socket video_socket = SC_SOCKET_NONE;
     sc_socket audio_socket = SC_SOCKET_NONE;
     sc_socket control_socket = SC_SOCKET_NONE;
-    if (!tunnel->forward) {
+    if (!no_adb && !tunnel->forward) {
         if (video) {
             video_socket =
                 net_accept_intr(&server->intr, tunnel->server_socket);
@@ -633,6 +634,7 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
 
         uint16_t tunnel_port = server->params.tunnel_port;
         if (!tunnel_port) {
+            assert(!no_adb);
             tunnel_port = tunnel->local_port;
         }
 
@@ -689,9 +691,11 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
         (void) ok; // error already logged
     }
 
-    // we don't need the adb tunnel anymore
-    sc_adb_tunnel_close(tunnel, &server->intr, serial,
-                        server->device_socket_name);
+    if (tunnel->enabled) {
+        // we don't need the adb tunnel anymore
+        sc_adb_tunnel_close(tunnel, &server->intr, serial,
+                            server->device_socket_name);
+    }
 
     sc_socket first_socket = video ? video_socket
                            : audio ? audio_socket
@@ -937,12 +941,80 @@ sc_server_kill_adb_if_requested(struct sc_server *server) {
     }
 }
 
+static void
+sc_server_wait_stopped(struct sc_server *server) {
+    sc_mutex_lock(&server->mutex);
+    while (!server->stopped) {
+        sc_cond_wait(&server->cond_stopped, &server->mutex);
+    }
+    sc_mutex_unlock(&server->mutex);
+
+    // Interrupt sockets to wake up socket blocking calls on the server
+
+    if (server->video_socket != SC_SOCKET_NONE) {
+        // There is no video_socket if --no-video is set
+        net_interrupt(server->video_socket);
+    }
+
+    if (server->audio_socket != SC_SOCKET_NONE) {
+        // There is no audio_socket if --no-audio is set
+        net_interrupt(server->audio_socket);
+    }
+
+    if (server->control_socket != SC_SOCKET_NONE) {
+        // There is no control_socket if --no-control is set
+        net_interrupt(server->control_socket);
+    }
+}
+
+static int
+run_server_no_adb(struct sc_server *server) {
+    const struct sc_server_params *params = &server->params;
+
+    uint32_t host = params->tunnel_host ? params->tunnel_host
+                                        : IPV4_LOCALHOST;
+    uint16_t port = params->tunnel_port;
+    assert(port);
+
+    // There is no adb device, identify the "device" by its address
+    int r = asprintf(&server->serial, "%" PRIu32 ".%" PRIu32 ".%" PRIu32
+                     ".%" PRIu32 ":%" PRIu16, host >> 24, (host >> 16) & 0xFF,
+                     (host >> 8) & 0xFF, host & 0xFF, port);
+    if (r == -1) {
+        LOG_OOM();
+        goto error_connection_failed;
+    }
+
+    LOGI("Connecting to %s without adb", server->serial);
+
+    bool ok = sc_server_connect_to(server, &server->info);
+    if (!ok) {
+        goto error_connection_failed;
+    }
+
+    // Now connected
+    server->cbs->on_connected(server, server->cbs_userdata);
+
+    // Wait for server_stop()
+    sc_server_wait_stopped(server);
+
+    return 0;
+
+error_connection_failed:
+    server->cbs->on_connection_failed(server, server->cbs_userdata);
+    return -1;
+}
+
 static int
 run_server(void *data) {
     struct sc_server *server = data;
 
     const struct sc_server_params *params = &server->params;
 
+    if (params->no_adb) {
+        return run_server_no_adb(server);
+    }
+
     // Execute "adb start-server" before "adb devices" so that daemon starting
     // output/errors is correctly printed in the console ("adb devices" output
     // is parsed, so it is not output)
@@ -1098,28 +1170,7 @@ run_server(void *data) {
     server->cbs->on_connected(server, server->cbs_userdata);
 
     // Wait for server_stop()
-    sc_mutex_lock(&server->mutex);
-    while (!server->stopped) {
-        sc_cond_wait(&server->cond_stopped, &server->mutex);
-    }
-    sc_mutex_unlock(&server->mutex);
-
-    // Interrupt sockets to wake up socket blocking calls on the server
-
-    if (server->video_socket != SC_SOCKET_NONE) {
-        // There is no video_socket if --no-video is set
-        net_interrupt(server->video_socket);
-    }
-
-    if (server->audio_socket != SC_SOCKET_NONE) {
-        // There is no audio_socket if --no-audio is set
-        net_interrupt(server->audio_socket);
-    }
-
-    if (server->control_socket != SC_SOCKET_NONE) {
-        // There is no control_socket if --no-control is set
-        net_interrupt(server->control_socket);
-    }
+    sc_server_wait_stopped(server);
 
     // Give some delay for the server to terminate properly
 #define WATCHDOG_DELAY SC_TICK_FROM_SEC(1)
@@ -39,6 +39,9 @@ struct sc_server_params {
     struct sc_port_range port_range;
     uint32_t tunnel_host;
     uint16_t tunnel_port;
+    // Connect directly to tunnel_host:tunnel_port, without adb and without
+    // executing the server (it must already be listening)
+    bool no_adb;
     uint16_t max_size;
     uint32_t video_bit_rate;
     uint32_t audio_bit_rate;
@@ -0,0 +1,286 @@
+#include "stream_capture.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+#include "util/str.h"
+
+#define SC_STREAM_CAPTURE_MAGIC "scrcpycap"
+#define SC_STREAM_CAPTURE_MAGIC_SIZE (sizeof(SC_STREAM_CAPTURE_MAGIC) - 1)
+#define SC_STREAM_CAPTURE_VERSION 1
+#define SC_STREAM_CAPTURE_HEADER_SIZE \
+    (SC_STREAM_CAPTURE_MAGIC_SIZE + 2 + SC_DEVICE_NAME_FIELD_LENGTH)
+#define SC_STREAM_CAPTURE_RECORD_HEADER_SIZE 13
+
+bool
+sc_stream_capture_init(struct sc_stream_capture *capture, const char *filename,
+                       const char *device_name, uint8_t streams) {
+    capture->file = fopen(filename, "wb");
+    if (!capture->file) {
+        LOGE("Could not open stream capture file: %s", filename);
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&capture->mutex);
+    if (!ok) {
+        goto error_close_file;
+    }
+
+    uint8_t header[SC_STREAM_CAPTURE_HEADER_SIZE];
+    memcpy(header, SC_STREAM_CAPTURE_MAGIC, SC_STREAM_CAPTURE_MAGIC_SIZE);
+    uint8_t *p = &header[SC_STREAM_CAPTURE_MAGIC_SIZE];
+    p[0] = SC_STREAM_CAPTURE_VERSION;
+    p[1] = streams;
+    memset(&p[2], 0, SC_DEVICE_NAME_FIELD_LENGTH);
+    sc_strncpy((char *) &p[2], device_name, SC_DEVICE_NAME_FIELD_LENGTH);
+
+    if (fwrite(header, sizeof(header), 1, capture->file) != 1) {
+        LOGE("Could not write stream capture header");
+        goto error_destroy_mutex;
+    }
+
+    capture->failed = false;
+    capture->start = sc_tick_now();
+
+    LOGI("Capturing streams to %s", filename);
+
+    return true;
+
+error_destroy_mutex:
+    sc_mutex_destroy(&capture->mutex);
+error_close_file:
+    fclose(capture->file);
+
+    return false;
+}
+
+void
+sc_stream_capture_destroy(struct sc_stream_capture *capture) {
+    if (fclose(capture->file)) {
+        LOGE("Could not close stream capture file");
+    }
+    sc_mutex_destroy(&capture->mutex);
+}
+
+void
+sc_stream_capture_write(struct sc_stream_capture *capture,
+                        enum sc_stream_capture_stream stream,
+                        const uint8_t *data, size_t len) {
+    assert(len <= UINT32_MAX);
+
+    // Timestamp the bytes before waiting for the lock
+    sc_tick timestamp = sc_tick_now() - capture->start;
+    assert(timestamp >= 0);
+
+    uint8_t header[SC_STREAM_CAPTURE_RECORD_HEADER_SIZE];
+    header[0] = stream;
+    sc_write64be(&header[1], SC_TICK_TO_US(timestamp));
+    sc_write32be(&header[9], len);
+
+    sc_mutex_lock(&capture->mutex);
+    if (!capture->failed) {
+        bool ok = fwrite(header, sizeof(header), 1, capture->file) == 1
+               && fwrite(data, len, 1, capture->file) == 1;
+        if (!ok) {
+            // Do not stop mirroring, just stop capturing
+            LOGE("Could not write stream capture, capture stopped");
+            capture->failed = true;
+        }
+    }
+    sc_mutex_unlock(&capture->mutex);
+}
+
+static bool
+sc_stream_replay_read_header(struct sc_stream_replay *replay, FILE *file) {
+    uint8_t header[SC_STREAM_CAPTURE_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, file) != 1
+            || memcmp(header, SC_STREAM_CAPTURE_MAGIC,
+                      SC_STREAM_CAPTURE_MAGIC_SIZE)) {
+        LOGE("Not a stream capture file: %s", replay->filename);
+        return false;
+    }
+
+    const uint8_t *p = &header[SC_STREAM_CAPTURE_MAGIC_SIZE];
+    if (p[0] != SC_STREAM_CAPTURE_VERSION) {
+        LOGE("Unsupported stream capture version: %u", (unsigned) p[0]);
+        return false;
+    }
+
+    replay->streams = p[1];
+    memcpy(replay->device_name, &p[2], SC_DEVICE_NAME_FIELD_LENGTH);
+    // Do not trust the content of the file
+    replay->device_name[SC_DEVICE_NAME_FIELD_LENGTH - 1] = '\0';
+
+    return true;
+}
+
+bool
+sc_stream_replay_init(struct sc_stream_replay *replay, const char *filename,
+                      unsigned speed) {
+    replay->filename = filename;
+
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        LOGE("Could not open stream capture file: %s", filename);
+        return false;
+    }
+
+    bool ok = sc_stream_replay_read_header(replay, file);
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_mutex_init(&replay->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&replay->cond);
+    if (!ok) {
+        sc_mutex_destroy(&replay->mutex);
+        return false;
+    }
+
+    replay->speed = speed;
+    replay->interrupted = false;
+    replay->started = false;
+
+    LOGI("Replaying stream capture %s (device: %s)", filename,
+         replay->device_name);
+
+    return true;
+}
+
+void
+sc_stream_replay_destroy(struct sc_stream_replay *replay) {
+    sc_cond_destroy(&replay->cond);
+    sc_mutex_destroy(&replay->mutex);
+}
+
+void
+sc_stream_replay_interrupt(struct sc_stream_replay *replay) {
+    sc_mutex_lock(&replay->mutex);
+    replay->interrupted = true;
+    sc_cond_broadcast(&replay->cond);
+    sc_mutex_unlock(&replay->mutex);
+}
+
+// Wait until the record received at `timestamp` must be delivered
+static bool
+sc_stream_replay_wait(struct sc_stream_replay *replay, uint64_t timestamp) {
+    sc_mutex_lock(&replay->mutex);
+    if (replay->speed) {
+        sc_tick offset = SC_TICK_FROM_US(timestamp) / replay->speed;
+        if (!replay->started) {
+            // Deliver the first record immediately
+            replay->start = sc_tick_now() - offset;
+            replay->started = true;
+        }
+
+        sc_tick deadline = replay->start + offset;
+        bool timed_out = false;
+        while (!replay->interrupted && !timed_out) {
+            timed_out = !sc_cond_timedwait(&replay->cond, &replay->mutex,
+                                           deadline);
+        }
+    }
+    bool interrupted = replay->interrupted;
+    sc_mutex_unlock(&replay->mutex);
+
+    return !interrupted;
+}
+
+bool
+sc_stream_replay_reader_init(struct sc_stream_replay_reader *reader,
+                             struct sc_stream_replay *replay,
+                             enum sc_stream_capture_stream stream) {
+    reader->file = fopen(replay->filename, "rb");
+    if (!reader->file) {
+        LOGE("Could not open stream capture file: %s", replay->filename);
+        return false;
+    }
+
+    if (fseek(reader->file, SC_STREAM_CAPTURE_HEADER_SIZE, SEEK_SET)) {
+        LOGE("Could not seek stream capture file");
+        fclose(reader->file);
+        return false;
+    }
+
+    reader->replay = replay;
+    reader->stream = stream;
+    reader->remaining = 0;
+
+    return true;
+}
+
+void
+sc_stream_replay_reader_destroy(struct sc_stream_replay_reader *reader) {
+    fclose(reader->file);
+}
+
+static bool
+sc_stream_replay_reader_next_record(struct sc_stream_replay_reader *reader) {
+    assert(!reader->remaining);
+
+    for (;;) {
+        uint8_t header[SC_STREAM_CAPTURE_RECORD_HEADER_SIZE];
+        size_t r = fread(header, 1, sizeof(header), reader->file);
+        if (r != sizeof(header)) {
+            if (r) {
+                LOGW("Stream capture truncated");
+            }
+            // end of capture
+            return false;
+        }
+
+        uint8_t stream = header[0];
+        uint64_t timestamp = sc_read64be(&header[1]);
+        uint32_t len = sc_read32be(&header[9]);
+
+        if (stream != reader->stream) {
+            // The record belongs to another stream, read by another reader
+            if (fseek(reader->file, len, SEEK_CUR)) {
+                LOGE("Could not seek stream capture file");
+                return false;
+            }
+            continue;
+        }
+
+        if (!sc_stream_replay_wait(reader->replay, timestamp)) {
+            // interrupted
+            return false;
+        }
+
+        reader->remaining = len;
+        if (len) {
+            return true;
+        }
+    }
+}
+
+bool
+sc_stream_replay_reader_read(struct sc_stream_replay_reader *reader,
+                             uint8_t *buf, size_t len) {
+    while (len) {
+        if (!reader->remaining) {
+            if (!sc_stream_replay_reader_next_record(reader)) {
+                return false;
+            }
+        }
+
+        size_t chunk = len < reader->remaining ? len : reader->remaining;
+        if (fread(buf, chunk, 1, reader->file) != 1) {
+            LOGW("Stream capture truncated");
+            return false;
+        }
+
+        buf += chunk;
+        len -= chunk;
+        reader->remaining -= chunk;
+    }
+
+    return true;
+}
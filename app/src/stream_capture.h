@@ -0,0 +1,134 @@
+#ifndef SC_STREAM_CAPTURE_H
+#define SC_STREAM_CAPTURE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "server.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Capture of the raw video and audio streams received from the device, to be
+ * replayed later without a device.
+ *
+ * The file starts with a header:
+ *
+ *     [magic "scrcpycap"][u8 version][u8 streams][64 bytes device name]
+ *
+ * followed by records, each containing bytes received on one stream socket:
+ *
+ *     [u8 stream][u64be arrival timestamp (us)][u32be length][bytes]
+ *
+ * The concatenation of the bytes of all the records of a stream is exactly
+ * the content received on its socket (codec id, video size, packets).
+ */
+
+enum sc_stream_capture_stream {
+    SC_STREAM_CAPTURE_VIDEO,
+    SC_STREAM_CAPTURE_AUDIO,
+};
+
+#define SC_STREAM_CAPTURE_FLAG(stream) (1 << (stream))
+
+struct sc_stream_capture {
+    FILE *file;
+    sc_tick start;
+
+    sc_mutex mutex;
+    bool failed;
+};
+
+/**
+ * Open a capture file for writing
+ *
+ * `streams` is a mask of the streams to be captured (for example
+ * SC_STREAM_CAPTURE_FLAG(SC_STREAM_CAPTURE_VIDEO)).
+ */
+bool
+sc_stream_capture_init(struct sc_stream_capture *capture, const char *filename,
+                       const char *device_name, uint8_t streams);
+
+void
+sc_stream_capture_destroy(struct sc_stream_capture *capture);
+
+/**
+ * Write the bytes just received on a stream socket
+ *
+ * This function may be called concurrently from several demuxer threads.
+ */
+void
+sc_stream_capture_write(struct sc_stream_capture *capture,
+                        enum sc_stream_capture_stream stream,
+                        const uint8_t *data, size_t len);
+
+/**
+ * Replay of a capture file
+ *
+ * Each demuxer reads its own stream using a separate reader. The records are
+ * delivered according to their arrival timestamps, accelerated by `speed`
+ * (0 means unthrottled).
+ */
+struct sc_stream_replay {
+    const char *filename;
+    char device_name[SC_DEVICE_NAME_FIELD_LENGTH];
+    uint8_t streams;
+    unsigned speed;
+
+    sc_mutex mutex;
+    sc_cond cond;
+    bool interrupted;
+    // The replay clock starts on the first record read by any reader
+    bool started;
+    sc_tick start;
+};
+
+struct sc_stream_replay_reader {
+    struct sc_stream_replay *replay;
+    enum sc_stream_capture_stream stream;
+    FILE *file;
+    // Remaining bytes of the current record
+    uint32_t remaining;
+};
+
+bool
+sc_stream_replay_init(struct sc_stream_replay *replay, const char *filename,
+                      unsigned speed);
+
+void
+sc_stream_replay_destroy(struct sc_stream_replay *replay);
+
+static inline bool
+sc_stream_replay_has_stream(struct sc_stream_replay *replay,
+                            enum sc_stream_capture_stream stream) {
+    return replay->streams & SC_STREAM_CAPTURE_FLAG(stream);
+}
+
+/**
+ * Wake up and stop all the readers
+ */
+void
+sc_stream_replay_interrupt(struct sc_stream_replay *replay);
+
+bool
+sc_stream_replay_reader_init(struct sc_stream_replay_reader *reader,
+                             struct sc_stream_replay *replay,
+                             enum sc_stream_capture_stream stream);
+
+void
+sc_stream_replay_reader_destroy(struct sc_stream_replay_reader *reader);
+
+/**
+ * Read exactly `len` bytes of the stream, as they were received on the socket
+ *
+ * Return false on end-of-stream, on error or if interrupted.
+ */
+bool
+sc_stream_replay_reader_read(struct sc_stream_replay_reader *reader,
+                             uint8_t *buf, size_t len);
+
+#endif
@@ -20,6 +20,27 @@ struct sc_frame_sink_ops {
     bool (*open)(struct sc_frame_sink *sink, const AVCodecContext *ctx);
     void (*close)(struct sc_frame_sink *sink);
     bool (*push)(struct sc_frame_sink *sink, const AVFrame *frame);
+
+    /**
+     * Indicate whether the sink currently needs frames (optional)
+     *
+     * If it returns false, the source may skip producing frames (the sink
+     * must still accept them). It may be called from any thread.
+     *
+     * If NULL, the sink is always active.
+     */
+    bool (*is_active)(struct sc_frame_sink *sink);
+
+    /**
+     * Indicate whether the sink currently renders the frames at a reduced
+     * resolution (optional)
+     *
+     * If all the sinks return true, the source may reduce the quality of the
+     * frames. It may be called from any thread.
+     *
+     * If NULL, the sink needs full quality frames.
+     */
+    bool (*is_low_res)(struct sc_frame_sink *sink);
 };
 
 #endif
@@ -59,3 +59,29 @@ sc_frame_source_sinks_push(struct sc_frame_source *source,
 
     return true;
 }
+
+bool
+sc_frame_source_sinks_are_active(struct sc_frame_source *source) {
+    assert(source->sink_count);
+    for (unsigned i = 0; i < source->sink_count; ++i) {
+        struct sc_frame_sink *sink = source->sinks[i];
+        if (!sink->ops->is_active || sink->ops->is_active(sink)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+sc_frame_source_sinks_are_low_res(struct sc_frame_source *source) {
+    assert(source->sink_count);
+    for (unsigned i = 0; i < source->sink_count; ++i) {
+        struct sc_frame_sink *sink = source->sinks[i];
+        if (!sink->ops->is_low_res || !sink->ops->is_low_res(sink)) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -7,7 +7,7 @@
 
 #include "trait/frame_sink.h"
 
-#define SC_FRAME_SOURCE_MAX_SINKS 2
+#define SC_FRAME_SOURCE_MAX_SINKS 3
 
 /**
  * Frame source trait
@@ -37,4 +37,12 @@ bool
 sc_frame_source_sinks_push(struct sc_frame_source *source,
                            const AVFrame *frame);
 
+// Return true if at least one sink needs frames
+bool
+sc_frame_source_sinks_are_active(struct sc_frame_source *source);
+
+// Return true if all the sinks render the frames at a reduced resolution
+bool
+sc_frame_source_sinks_are_low_res(struct sc_frame_source *source);
+
 #endif
@@ -0,0 +1,301 @@
+#include "io_loop.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "util/log.h"
+
+#ifdef SC_SOCKET_CLOSE_ON_INTERRUPT
+# error "The I/O loop requires raw socket file descriptors"
+#endif
+
+#define SC_IO_LOOP_MAX_EVENTS 16
+
+static uint32_t
+sc_io_loop_to_epoll_events(unsigned events) {
+    uint32_t epoll_events = 0;
+    if (events & SC_IO_READABLE) {
+        epoll_events |= EPOLLIN;
+    }
+    if (events & SC_IO_WRITABLE) {
+        epoll_events |= EPOLLOUT;
+    }
+    return epoll_events;
+}
+
+static unsigned
+sc_io_loop_from_epoll_events(const struct sc_io_watch *watch,
+                             uint32_t epoll_events) {
+    unsigned events = 0;
+    if (epoll_events & EPOLLIN) {
+        events |= SC_IO_READABLE;
+    }
+    if (epoll_events & EPOLLOUT) {
+        events |= SC_IO_WRITABLE;
+    }
+    if (epoll_events & (EPOLLERR | EPOLLHUP)) {
+        // Let the callback detect the error or the end-of-stream on its next
+        // recv() or send()
+        events |= watch->events;
+    }
+    return events;
+}
+
+bool
+sc_io_loop_init(struct sc_io_loop *loop) {
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd == -1) {
+        LOGE("I/O loop: could not create epoll instance");
+        return false;
+    }
+
+    loop->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (loop->event_fd == -1) {
+        LOGE("I/O loop: could not create eventfd");
+        goto error_close_epoll;
+    }
+
+    // The eventfd is identified by a NULL watch
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.ptr = NULL,
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->event_fd, &ev)) {
+        LOGE("I/O loop: could not watch eventfd");
+        goto error_close_eventfd;
+    }
+
+    bool ok = sc_mutex_init(&loop->mutex);
+    if (!ok) {
+        goto error_close_eventfd;
+    }
+
+    loop->stopped = false;
+    sc_vector_init(&loop->posted);
+    sc_vector_init(&loop->dispatched);
+
+    return true;
+
+error_close_eventfd:
+    close(loop->event_fd);
+error_close_epoll:
+    close(loop->epoll_fd);
+
+    return false;
+}
+
+void
+sc_io_loop_destroy(struct sc_io_loop *loop) {
+    sc_vector_destroy(&loop->dispatched);
+    sc_vector_destroy(&loop->posted);
+    sc_mutex_destroy(&loop->mutex);
+    close(loop->event_fd);
+    close(loop->epoll_fd);
+}
+
+static bool
+sc_io_loop_wakeup(struct sc_io_loop *loop) {
+    uint64_t value = 1;
+    ssize_t w = write(loop->event_fd, &value, sizeof(value));
+    // EAGAIN means that the counter is already non-zero, so the loop will
+    // wake up anyway
+    if (w == -1 && errno != EAGAIN) {
+        LOGE("I/O loop: could not write to eventfd");
+        return false;
+    }
+
+    return true;
+}
+
+static void
+sc_io_loop_dispatch_posted(struct sc_io_loop *loop) {
+    assert(!loop->dispatched.size);
+
+    sc_mutex_lock(&loop->mutex);
+    // Swap the vectors, so that the callbacks may post again without
+    // interfering with the current dispatch
+    struct sc_io_watch_vec tmp = loop->dispatched;
+    loop->dispatched = loop->posted;
+    loop->posted = tmp;
+    for (size_t i = 0; i < loop->dispatched.size; ++i) {
+        loop->dispatched.data[i]->posted = false;
+    }
+    sc_mutex_unlock(&loop->mutex);
+
+    // A callback may remove its watch (and only its watch), so consume the
+    // vector from the front
+    while (loop->dispatched.size) {
+        struct sc_io_watch *watch = loop->dispatched.data[0];
+        sc_vector_remove_noshrink(&loop->dispatched, 0);
+        watch->cb(watch, SC_IO_POSTED);
+    }
+}
+
+static int
+run_io_loop(void *data) {
+    struct sc_io_loop *loop = data;
+
+    struct epoll_event events[SC_IO_LOOP_MAX_EVENTS];
+
+    for (;;) {
+        int n = epoll_wait(loop->epoll_fd, events, ARRAY_LEN(events), -1);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGE("I/O loop: epoll_wait() failed");
+            break;
+        }
+
+        sc_mutex_lock(&loop->mutex);
+        bool stopped = loop->stopped;
+        sc_mutex_unlock(&loop->mutex);
+
+        if (stopped) {
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            struct sc_io_watch *watch = events[i].data.ptr;
+            if (!watch) {
+                uint64_t value;
+                ssize_t r = read(loop->event_fd, &value, sizeof(value));
+                (void) r; // the counter is reset, the value does not matter
+                continue;
+            }
+
+            unsigned ev = sc_io_loop_from_epoll_events(watch, events[i].events);
+            if (ev) {
+                watch->cb(watch, ev);
+            }
+        }
+
+        sc_io_loop_dispatch_posted(loop);
+    }
+
+    LOGD("I/O loop stopped");
+
+    return 0;
+}
+
+bool
+sc_io_loop_start(struct sc_io_loop *loop) {
+    LOGD("Starting I/O loop thread");
+
+    bool ok = sc_thread_create(&loop->thread, run_io_loop, "scrcpy-io", loop);
+    if (!ok) {
+        LOGE("I/O loop: could not start thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_io_loop_stop(struct sc_io_loop *loop) {
+    sc_mutex_lock(&loop->mutex);
+    loop->stopped = true;
+    sc_mutex_unlock(&loop->mutex);
+
+    sc_io_loop_wakeup(loop);
+}
+
+void
+sc_io_loop_join(struct sc_io_loop *loop) {
+    sc_thread_join(&loop->thread, NULL);
+}
+
+bool
+sc_io_loop_add(struct sc_io_loop *loop, struct sc_io_watch *watch,
+               sc_socket socket, unsigned events, sc_io_watch_cb *cb) {
+    assert(cb);
+
+    if (!net_set_nonblocking(socket, true)) {
+        LOGE("I/O loop: could not set socket non-blocking");
+        return false;
+    }
+
+    watch->socket = socket;
+    watch->events = events;
+    watch->cb = cb;
+    watch->posted = false;
+
+    struct epoll_event ev = {
+        .events = sc_io_loop_to_epoll_events(events),
+        .data.ptr = watch,
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, socket, &ev)) {
+        LOGE("I/O loop: could not watch socket");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+sc_io_loop_set_events(struct sc_io_loop *loop, struct sc_io_watch *watch,
+                      unsigned events) {
+    if (events == watch->events) {
+        // Nothing to do
+        return true;
+    }
+
+    struct epoll_event ev = {
+        .events = sc_io_loop_to_epoll_events(events),
+        .data.ptr = watch,
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, watch->socket, &ev)) {
+        LOGE("I/O loop: could not modify socket events");
+        return false;
+    }
+
+    watch->events = events;
+    return true;
+}
+
+void
+sc_io_loop_remove(struct sc_io_loop *loop, struct sc_io_watch *watch) {
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, watch->socket, NULL)) {
+        LOGW("I/O loop: could not unwatch socket");
+    }
+
+    // Never call the callback of a removed watch
+    ssize_t index = sc_vector_index_of(&loop->dispatched, watch);
+    if (index != -1) {
+        sc_vector_remove_noshrink(&loop->dispatched, index);
+    }
+
+    sc_mutex_lock(&loop->mutex);
+    if (watch->posted) {
+        index = sc_vector_index_of(&loop->posted, watch);
+        assert(index != -1);
+        sc_vector_remove_noshrink(&loop->posted, index);
+        watch->posted = false;
+    }
+    sc_mutex_unlock(&loop->mutex);
+}
+
+bool
+sc_io_loop_post(struct sc_io_loop *loop, struct sc_io_watch *watch) {
+    sc_mutex_lock(&loop->mutex);
+    if (watch->posted) {
+        // Already posted, the callback has not been called yet
+        sc_mutex_unlock(&loop->mutex);
+        return true;
+    }
+
+    bool ok = sc_vector_push(&loop->posted, watch);
+    if (!ok) {
+        sc_mutex_unlock(&loop->mutex);
+        LOG_OOM();
+        return false;
+    }
+    watch->posted = true;
+    sc_mutex_unlock(&loop->mutex);
+
+    return sc_io_loop_wakeup(loop);
+}
@@ -0,0 +1,101 @@
+#ifndef SC_IO_LOOP_H
+#define SC_IO_LOOP_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "util/net.h"
+#include "util/thread.h"
+#include "util/vector.h"
+
+/**
+ * Single-threaded I/O event loop (Linux only)
+ *
+ * Instead of running one blocking thread per socket, several non-blocking
+ * sockets may be watched from a single thread. A callback is called on the
+ * loop thread whenever a watched socket is ready.
+ */
+
+#define SC_IO_READABLE 1
+#define SC_IO_WRITABLE 2
+// sc_io_loop_post() has been called
+#define SC_IO_POSTED   4
+
+struct sc_io_watch;
+
+typedef void sc_io_watch_cb(struct sc_io_watch *watch, unsigned events);
+
+struct sc_io_watch {
+    sc_socket socket;
+    unsigned events; // the requested events (SC_IO_READABLE|SC_IO_WRITABLE)
+    sc_io_watch_cb *cb;
+    bool posted; // protected by the loop mutex
+};
+
+struct sc_io_watch_vec SC_VECTOR(struct sc_io_watch *);
+
+struct sc_io_loop {
+    int epoll_fd;
+    int event_fd; // to wake up the loop
+
+    sc_thread thread;
+    sc_mutex mutex;
+    bool stopped;
+    struct sc_io_watch_vec posted; // protected by the mutex
+    struct sc_io_watch_vec dispatched; // accessed only from the loop thread
+};
+
+bool
+sc_io_loop_init(struct sc_io_loop *loop);
+
+void
+sc_io_loop_destroy(struct sc_io_loop *loop);
+
+bool
+sc_io_loop_start(struct sc_io_loop *loop);
+
+// Once stopped, no more callbacks are called (the pending events are lost)
+void
+sc_io_loop_stop(struct sc_io_loop *loop);
+
+void
+sc_io_loop_join(struct sc_io_loop *loop);
+
+/**
+ * Start watching a socket
+ *
+ * The socket is set non-blocking. It may be called from any thread.
+ */
+bool
+sc_io_loop_add(struct sc_io_loop *loop, struct sc_io_watch *watch,
+               sc_socket socket, unsigned events, sc_io_watch_cb *cb);
+
+/**
+ * Change the events a watch is interested in
+ *
+ * It must be called from the loop thread (typically from the callback).
+ */
+bool
+sc_io_loop_set_events(struct sc_io_loop *loop, struct sc_io_watch *watch,
+                      unsigned events);
+
+/**
+ * Stop watching a socket
+ *
+ * It must be called from the loop thread (from the callback of this watch
+ * only), or once the loop is joined.
+ */
+void
+sc_io_loop_remove(struct sc_io_loop *loop, struct sc_io_watch *watch);
+
+/**
+ * Request the loop to call the watch callback with SC_IO_POSTED
+ *
+ * It may be called from any thread. Several posts before the callback is
+ * called are coalesced.
+ */
+bool
+sc_io_loop_post(struct sc_io_loop *loop, struct sc_io_watch *watch);
+
+#endif
@@ -1,8 +1,10 @@
 #include "net.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
 # include <ws2tcpip.h>
@@ -22,6 +24,9 @@
 #endif
 
 #include "util/log.h"
+#ifdef HAVE_IO_URING
+# include "util/net_uring.h"
+#endif
 
 bool
 net_init(void) {
@@ -206,18 +211,64 @@ net_accept(sc_socket server_socket) {
 ssize_t
 net_recv(sc_socket socket, void *buf, size_t len) {
     sc_raw_socket raw_sock = unwrap(socket);
+#ifdef HAVE_IO_URING
+    if (sc_net_uring_is_enabled()) {
+        ssize_t r = sc_net_uring_recv(raw_sock, buf, len, 0);
+        if (r != SC_NET_URING_UNAVAILABLE) {
+            return r;
+        }
+    }
+#endif
     return recv(raw_sock, buf, len, 0);
 }
 
+#ifdef HAVE_IO_URING
+// Return SC_NET_URING_UNAVAILABLE if nothing has been received
+static ssize_t
+net_recv_all_uring(sc_raw_socket raw_sock, void *buf, size_t len) {
+    size_t received = 0;
+    while (received < len) {
+        // MSG_WAITALL is not honored by all kernel versions, so loop anyway
+        ssize_t r = sc_net_uring_recv(raw_sock, (char *) buf + received,
+                                      len - received, MSG_WAITALL);
+        if (r == SC_NET_URING_UNAVAILABLE) {
+            assert(!received); // the ring of a thread never disappears
+            return r;
+        }
+        if (r <= 0) {
+            return received ? (ssize_t) received : r;
+        }
+        received += r;
+    }
+    return received;
+}
+#endif
+
 ssize_t
 net_recv_all(sc_socket socket, void *buf, size_t len) {
     sc_raw_socket raw_sock = unwrap(socket);
+#ifdef HAVE_IO_URING
+    if (sc_net_uring_is_enabled()) {
+        ssize_t r = net_recv_all_uring(raw_sock, buf, len);
+        if (r != SC_NET_URING_UNAVAILABLE) {
+            return r;
+        }
+    }
+#endif
     return recv(raw_sock, buf, len, MSG_WAITALL);
 }
 
 ssize_t
 net_send(sc_socket socket, const void *buf, size_t len) {
     sc_raw_socket raw_sock = unwrap(socket);
+#ifdef HAVE_IO_URING
+    if (sc_net_uring_is_enabled()) {
+        ssize_t w = sc_net_uring_send(raw_sock, buf, len, 0);
+        if (w != SC_NET_URING_UNAVAILABLE) {
+            return w;
+        }
+    }
+#endif
     return send(raw_sock, buf, len, 0);
 }
 
@@ -284,6 +335,42 @@ net_set_tcp_nodelay(sc_socket socket, bool tcp_nodelay) {
     return true;
 }
 
+bool
+net_set_nonblocking(sc_socket socket, bool nonblocking) {
+    sc_raw_socket raw_sock = unwrap(socket);
+
+#ifdef _WIN32
+    u_long value = nonblocking ? 1 : 0;
+    if (ioctlsocket(raw_sock, FIONBIO, &value)) {
+        net_perror("ioctlsocket(FIONBIO)");
+        return false;
+    }
+#else
+    int flags = fcntl(raw_sock, F_GETFL);
+    if (flags == -1) {
+        net_perror("fcntl(F_GETFL)");
+        return false;
+    }
+
+    flags = nonblocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    if (fcntl(raw_sock, F_SETFL, flags) == -1) {
+        net_perror("fcntl(F_SETFL)");
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+bool
+net_would_block(void) {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
 bool
 net_parse_ipv4(const char *s, uint32_t *ipv4) {
     struct in_addr addr;
@@ -295,3 +382,163 @@ net_parse_ipv4(const char *s, uint32_t *ipv4) {
     *ipv4 = ntohl(addr.s_addr);
     return true;
 }
+
+bool
+sc_net_reader_init(struct sc_net_reader *reader, sc_socket socket,
+                   size_t cap) {
+    assert(cap);
+
+    reader->buf = malloc(cap);
+    if (!reader->buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    reader->socket = socket;
+    reader->cap = cap;
+    reader->head = 0;
+    reader->size = 0;
+#ifdef HAVE_IO_URING
+    reader->uring_registration_tried = false;
+    reader->uring_registered = false;
+#endif
+
+    return true;
+}
+
+void
+sc_net_reader_destroy(struct sc_net_reader *reader) {
+#ifdef HAVE_IO_URING
+    if (reader->uring_registered) {
+        sc_net_uring_unregister_buffer(reader->buf);
+    }
+#endif
+    free(reader->buf);
+}
+
+#ifdef HAVE_IO_URING
+static ssize_t
+sc_net_reader_recv_uring(struct sc_net_reader *reader, uint8_t *dst,
+                         size_t len) {
+    if (!sc_net_uring_is_enabled()) {
+        return SC_NET_URING_UNAVAILABLE;
+    }
+
+    if (!reader->uring_registration_tried) {
+        // Register from the thread which reads (the rings are per-thread)
+        reader->uring_registration_tried = true;
+        reader->uring_registered =
+            sc_net_uring_register_buffer(reader->buf, reader->cap);
+    }
+
+    if (!reader->uring_registered) {
+        return SC_NET_URING_UNAVAILABLE;
+    }
+
+    return sc_net_uring_recv_fixed(unwrap(reader->socket), reader->buf, dst,
+                                   len);
+}
+#endif
+
+static void
+sc_net_reader_compact(struct sc_net_reader *reader) {
+    if (reader->head) {
+        memmove(reader->buf, &reader->buf[reader->head], reader->size);
+        reader->head = 0;
+    }
+}
+
+ssize_t
+sc_net_reader_fill(struct sc_net_reader *reader) {
+    assert(reader->size < reader->cap);
+
+    if (!reader->size) {
+        // Nothing to preserve, restart from the beginning of the buffer
+        reader->head = 0;
+    } else if (reader->head + reader->size == reader->cap) {
+        // No space left at the end
+        sc_net_reader_compact(reader);
+    }
+
+    size_t tail = reader->head + reader->size;
+    uint8_t *dst = &reader->buf[tail];
+    size_t len = reader->cap - tail;
+#ifdef HAVE_IO_URING
+    ssize_t r = sc_net_reader_recv_uring(reader, dst, len);
+    if (r == SC_NET_URING_UNAVAILABLE) {
+        r = net_recv(reader->socket, dst, len);
+    }
+#else
+    ssize_t r = net_recv(reader->socket, dst, len);
+#endif
+    if (r > 0) {
+        reader->size += r;
+    }
+
+    return r;
+}
+
+void
+sc_net_reader_consume(struct sc_net_reader *reader, size_t len) {
+    assert(len <= reader->size);
+    reader->head += len;
+    reader->size -= len;
+}
+
+const uint8_t *
+sc_net_reader_peek(struct sc_net_reader *reader, size_t len) {
+    assert(len <= reader->cap);
+
+    if (reader->head + len > reader->cap) {
+        // The requested bytes would straddle the end of the buffer
+        sc_net_reader_compact(reader);
+    }
+
+    while (reader->size < len) {
+        ssize_t r = sc_net_reader_fill(reader);
+        if (r <= 0) {
+            return NULL;
+        }
+    }
+
+    return sc_net_reader_data(reader);
+}
+
+ssize_t
+sc_net_reader_recv_all(struct sc_net_reader *reader, void *buf, size_t len) {
+    uint8_t *dst = buf;
+
+    size_t copied = MIN(reader->size, len);
+    memcpy(dst, sc_net_reader_data(reader), copied);
+    sc_net_reader_consume(reader, copied);
+
+    while (copied < len) {
+        size_t remaining = len - copied;
+        if (remaining >= reader->cap / 2) {
+            // Large read, bypass the buffer
+            ssize_t r = net_recv_all(reader->socket, &dst[copied], remaining);
+            if (r <= 0) {
+                return copied ? (ssize_t) copied : r;
+            }
+
+            copied += r;
+            if ((size_t) r < remaining) {
+                // end-of-stream
+                break;
+            }
+        } else {
+            assert(!reader->size);
+            ssize_t r = sc_net_reader_fill(reader);
+            if (r <= 0) {
+                return copied ? (ssize_t) copied : r;
+            }
+
+            size_t n = MIN(reader->size, remaining);
+            memcpy(&dst[copied], sc_net_reader_data(reader), n);
+            sc_net_reader_consume(reader, n);
+            copied += n;
+        }
+    }
+
+    return copied;
+}
@@ -87,10 +87,96 @@ net_close(sc_socket socket);
 bool
 net_set_tcp_nodelay(sc_socket socket, bool tcp_nodelay);
 
+// Set the socket in non-blocking mode (or back to blocking mode)
+bool
+net_set_nonblocking(sc_socket socket, bool nonblocking);
+
+// Return true if the last failed net_recv() or net_send() on a non-blocking
+// socket failed only because it would have blocked
+bool
+net_would_block(void);
+
 /**
  * Parse `ip` "xxx.xxx.xxx.xxx" to an IPv4 host representation
  */
 bool
 net_parse_ipv4(const char *ip, uint32_t *ipv4);
 
+/**
+ * Buffered reader over a socket
+ *
+ * The socket is read by large chunks, so that a stream of small messages
+ * (e.g. packet headers followed by small payloads) requires far fewer recv()
+ * calls.
+ *
+ * Once a reader is used, all the reads from the socket must go through it.
+ */
+struct sc_net_reader {
+    sc_socket socket;
+    uint8_t *buf;
+    size_t cap;
+    size_t head; // index of the first unread byte
+    size_t size; // number of unread bytes
+#ifdef HAVE_IO_URING
+    // The buffer is registered lazily by the thread which fills it
+    bool uring_registration_tried;
+    bool uring_registered;
+#endif
+};
+
+bool
+sc_net_reader_init(struct sc_net_reader *reader, sc_socket socket,
+                   size_t cap);
+
+void
+sc_net_reader_destroy(struct sc_net_reader *reader);
+
+/**
+ * Receive more data into the buffer
+ *
+ * There must be some space available (the buffer must not be full).
+ *
+ * Return the number of bytes received, 0 on end-of-stream or -1 on error
+ * (including if a non-blocking socket has no data, see net_would_block()).
+ */
+ssize_t
+sc_net_reader_fill(struct sc_net_reader *reader);
+
+/**
+ * Return a pointer to the unread bytes
+ *
+ * There are reader->size bytes available.
+ */
+static inline const uint8_t *
+sc_net_reader_data(struct sc_net_reader *reader) {
+    return &reader->buf[reader->head];
+}
+
+/**
+ * Mark the first `len` unread bytes as read
+ */
+void
+sc_net_reader_consume(struct sc_net_reader *reader, size_t len);
+
+/**
+ * Make (at least) `len` contiguous bytes available (blocking)
+ *
+ * The bytes are moved to the start of the buffer only if they would cross its
+ * end. The requested length must not exceed the buffer capacity.
+ *
+ * Return a pointer to the available bytes (to be consumed by the caller), or
+ * NULL on end-of-stream or error.
+ */
+const uint8_t *
+sc_net_reader_peek(struct sc_net_reader *reader, size_t len);
+
+/**
+ * Read exactly `len` bytes into `buf` (blocking), like net_recv_all()
+ *
+ * The buffered bytes are copied first. For a large remaining length, the data
+ * is received directly into `buf`, without intermediate copy.
+ */
+ssize_t
+sc_net_reader_recv_all(struct sc_net_reader *reader, void *buf, size_t len);
+
 #endif
@@ -0,0 +1,307 @@
+#include "net_uring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <liburing.h>
+
+#include "util/log.h"
+
+// Only one operation is in flight at a time (the API is blocking)
+#define SC_NET_URING_ENTRIES 4
+
+struct sc_net_uring {
+    struct io_uring ring;
+    void *registered_buf; // NULL if no buffer is registered
+    uint64_t seq; // user_data of the last submitted operation
+};
+
+static atomic_bool sc_net_uring_enabled;
+
+static pthread_key_t sc_net_uring_key;
+static pthread_once_t sc_net_uring_key_once = PTHREAD_ONCE_INIT;
+static bool sc_net_uring_key_ok;
+
+// A thread for which io_uring is unavailable, to not retry on every call
+static char sc_net_uring_unavailable_marker;
+#define SC_NET_URING_UNAVAILABLE_MARKER ((void *) &sc_net_uring_unavailable_marker)
+
+static void
+sc_net_uring_release(void *data) {
+    if (data == SC_NET_URING_UNAVAILABLE_MARKER) {
+        return;
+    }
+
+    struct sc_net_uring *uring = data;
+    // The registered buffer (if any) is unregistered with the ring
+    io_uring_queue_exit(&uring->ring);
+    free(uring);
+}
+
+static void
+sc_net_uring_create_key(void) {
+    sc_net_uring_key_ok =
+        !pthread_key_create(&sc_net_uring_key, sc_net_uring_release);
+}
+
+void
+sc_net_uring_set_enabled(bool enabled) {
+    atomic_store_explicit(&sc_net_uring_enabled, enabled,
+                          memory_order_relaxed);
+}
+
+bool
+sc_net_uring_is_enabled(void) {
+    return atomic_load_explicit(&sc_net_uring_enabled, memory_order_relaxed);
+}
+
+// Return the ring of the current thread, or NULL if unavailable
+static struct sc_net_uring *
+sc_net_uring_get(void) {
+    pthread_once(&sc_net_uring_key_once, sc_net_uring_create_key);
+    if (!sc_net_uring_key_ok) {
+        return NULL;
+    }
+
+    void *data = pthread_getspecific(sc_net_uring_key);
+    if (data == SC_NET_URING_UNAVAILABLE_MARKER) {
+        return NULL;
+    }
+    if (data) {
+        return data;
+    }
+
+    struct sc_net_uring *uring = malloc(sizeof(*uring));
+    if (!uring) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    int ret = io_uring_queue_init(SC_NET_URING_ENTRIES, &uring->ring, 0);
+    if (ret < 0) {
+        LOGW("io_uring unavailable (error %d), fallback to syscalls", -ret);
+        free(uring);
+        pthread_setspecific(sc_net_uring_key, SC_NET_URING_UNAVAILABLE_MARKER);
+        return NULL;
+    }
+
+    uring->registered_buf = NULL;
+    uring->seq = 0;
+
+    if (pthread_setspecific(sc_net_uring_key, uring)) {
+        io_uring_queue_exit(&uring->ring);
+        free(uring);
+        return NULL;
+    }
+
+    return uring;
+}
+
+// user_data of the cancellation requests (the operations are tagged from 1)
+#define SC_NET_URING_CANCEL_DATA 0
+
+static inline void
+sc_net_uring_set_seq(struct io_uring_sqe *sqe, uint64_t seq) {
+    io_uring_sqe_set_data(sqe, (void *) (uintptr_t) seq);
+}
+
+static ssize_t
+sc_net_uring_result(int res) {
+    if (res < 0) {
+        errno = -res;
+        return -1;
+    }
+
+    return res;
+}
+
+// Wait for the completion of the operation tagged `seq`, and return its result
+// in `res`
+//
+// The other completions (of cancellation requests, or of previous operations
+// which could not be waited) are drained.
+//
+// Return false if the wait failed (the operation is still in flight).
+static bool
+sc_net_uring_reap(struct sc_net_uring *uring, uint64_t seq, int *res) {
+    for (;;) {
+        struct io_uring_cqe *cqe;
+        int ret = io_uring_wait_cqe(&uring->ring, &cqe);
+        if (ret == -EINTR) {
+            // Interrupted by a signal, the operation is still in flight
+            continue;
+        }
+        if (ret < 0) {
+            errno = -ret;
+            return false;
+        }
+
+        uintptr_t data = (uintptr_t) io_uring_cqe_get_data(cqe);
+        int cqe_res = cqe->res;
+        io_uring_cqe_seen(&uring->ring, cqe);
+
+        if (data == (uintptr_t) seq) {
+            *res = cqe_res;
+            return true;
+        }
+    }
+}
+
+// Cancel the operation tagged `seq`, in flight after a failed wait, and reap
+// its completion, so that the kernel never accesses the caller buffer once the
+// call has returned
+static ssize_t
+sc_net_uring_cancel(struct sc_net_uring *uring, uint64_t seq, int error) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&uring->ring);
+    assert(sqe); // only the operation and its cancellation
+    io_uring_prep_cancel(sqe, (void *) (uintptr_t) seq, 0);
+    sc_net_uring_set_seq(sqe, SC_NET_URING_CANCEL_DATA);
+
+    int ret;
+    do {
+        ret = io_uring_submit(&uring->ring);
+    } while (ret == -EINTR);
+
+    int res;
+    if (ret < 0 || !sc_net_uring_reap(uring, seq, &res)) {
+        // The kernel could write to the buffer at any time
+        LOGE("Could not cancel the pending io_uring operation");
+        abort();
+    }
+
+    if (res == -ECANCELED) {
+        errno = error;
+        return -1;
+    }
+
+    // The operation completed before its cancellation
+    return sc_net_uring_result(res);
+}
+
+// Submit the prepared sqe and wait for its completion
+static ssize_t
+sc_net_uring_complete(struct sc_net_uring *uring,
+                      struct io_uring_sqe *sqe) {
+    // Identify the completion of this operation, to never consume the
+    // completion of a previous operation which could not be waited
+    uint64_t seq = ++uring->seq;
+    sc_net_uring_set_seq(sqe, seq);
+
+    // Submit and wait with a single io_uring_enter() in the common case
+    int ret;
+    do {
+        ret = io_uring_submit_and_wait(&uring->ring, 1);
+        // If interrupted by a signal, only submit again if the sqe has not
+        // been consumed: the operation must never be submitted twice
+    } while (ret == -EINTR && io_uring_sq_ready(&uring->ring));
+
+    if (ret < 0 && ret != -EINTR) {
+        if (io_uring_sq_ready(&uring->ring)) {
+            // The sqe is still queued, it would be submitted along with the
+            // next operation: make it harmless
+            io_uring_prep_nop(sqe);
+            sc_net_uring_set_seq(sqe, seq);
+            errno = -ret;
+            return -1;
+        }
+
+        return sc_net_uring_cancel(uring, seq, -ret);
+    }
+
+    // The completion is usually already available (no additional syscall)
+    int res;
+    if (!sc_net_uring_reap(uring, seq, &res)) {
+        return sc_net_uring_cancel(uring, seq, errno);
+    }
+
+    return sc_net_uring_result(res);
+}
+
+ssize_t
+sc_net_uring_recv(int fd, void *buf, size_t len, int flags) {
+    struct sc_net_uring *uring = sc_net_uring_get();
+    if (!uring) {
+        return SC_NET_URING_UNAVAILABLE;
+    }
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&uring->ring);
+    assert(sqe); // only one operation in flight
+    io_uring_prep_recv(sqe, fd, buf, len, flags);
+
+    return sc_net_uring_complete(uring, sqe);
+}
+
+ssize_t
+sc_net_uring_send(int fd, const void *buf, size_t len, int flags) {
+    struct sc_net_uring *uring = sc_net_uring_get();
+    if (!uring) {
+        return SC_NET_URING_UNAVAILABLE;
+    }
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&uring->ring);
+    assert(sqe); // only one operation in flight
+    io_uring_prep_send(sqe, fd, buf, len, flags);
+
+    return sc_net_uring_complete(uring, sqe);
+}
+
+bool
+sc_net_uring_register_buffer(void *buf, size_t len) {
+    struct sc_net_uring *uring = sc_net_uring_get();
+    if (!uring || uring->registered_buf) {
+        return false;
+    }
+
+    struct iovec iov = {
+        .iov_base = buf,
+        .iov_len = len,
+    };
+    int ret = io_uring_register_buffers(&uring->ring, &iov, 1);
+    if (ret < 0) {
+        // Typically ENOMEM if RLIMIT_MEMLOCK is too low
+        LOGD("Could not register io_uring buffer (error %d)", -ret);
+        return false;
+    }
+
+    uring->registered_buf = buf;
+    return true;
+}
+
+void
+sc_net_uring_unregister_buffer(void *buf) {
+    pthread_once(&sc_net_uring_key_once, sc_net_uring_create_key);
+    if (!sc_net_uring_key_ok) {
+        return;
+    }
+
+    void *data = pthread_getspecific(sc_net_uring_key);
+    if (!data || data == SC_NET_URING_UNAVAILABLE_MARKER) {
+        return;
+    }
+
+    struct sc_net_uring *uring = data;
+    if (uring->registered_buf == buf) {
+        io_uring_unregister_buffers(&uring->ring);
+        uring->registered_buf = NULL;
+    }
+}
+
+ssize_t
+sc_net_uring_recv_fixed(int fd, void *buf, void *dst, size_t len) {
+    struct sc_net_uring *uring = sc_net_uring_get();
+    if (!uring || uring->registered_buf != buf) {
+        // Not registered to this thread
+        return SC_NET_URING_UNAVAILABLE;
+    }
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&uring->ring);
+    assert(sqe); // only one operation in flight
+    // Offset 0: a socket is not seekable
+    io_uring_prep_read_fixed(sqe, fd, dst, len, 0, 0);
+
+    return sc_net_uring_complete(uring, sqe);
+}
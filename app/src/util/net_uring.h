@@ -0,0 +1,64 @@
+#ifndef SC_NET_URING_H
+#define SC_NET_URING_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * io_uring backend for the blocking net_* functions (Linux only)
+ *
+ * Each thread lazily creates its own ring on first use (a ring must not be
+ * shared between threads without synchronization), which is released when the
+ * thread terminates.
+ *
+ * All the functions return SC_NET_URING_UNAVAILABLE if io_uring cannot be
+ * used by the current thread (not supported by the kernel, forbidden by a
+ * seccomp filter, out of resources…), so that the caller falls back to the
+ * plain syscalls.
+ */
+
+#define SC_NET_URING_UNAVAILABLE -2
+
+// Enable or disable the backend for all threads
+void
+sc_net_uring_set_enabled(bool enabled);
+
+bool
+sc_net_uring_is_enabled(void);
+
+// Same semantics as recv(fd, buf, len, flags)
+ssize_t
+sc_net_uring_recv(int fd, void *buf, size_t len, int flags);
+
+// Same semantics as send(fd, buf, len, flags)
+ssize_t
+sc_net_uring_send(int fd, const void *buf, size_t len, int flags);
+
+/**
+ * Register a long-lived buffer to the ring of the current thread
+ *
+ * A registered buffer is mapped once in the kernel, instead of on every read.
+ * Only one buffer may be registered per thread.
+ *
+ * Return true if the buffer is registered.
+ */
+bool
+sc_net_uring_register_buffer(void *buf, size_t len);
+
+// Unregister the buffer if it is registered to the ring of the current thread
+// (otherwise, it is released with the ring on thread exit)
+void
+sc_net_uring_unregister_buffer(void *buf);
+
+/**
+ * Read from fd into [dst; dst+len[, a part of the registered buffer `buf`
+ *
+ * Same semantics as recv(fd, dst, len, 0).
+ */
+ssize_t
+sc_net_uring_recv_fixed(int fd, void *buf, void *dst, size_t len);
+
+#endif
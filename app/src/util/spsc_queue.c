@@ -0,0 +1,78 @@
+#include "spsc_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/memory.h"
+
+bool
+sc_spsc_queue_init(struct sc_spsc_queue *queue, size_t item_size,
+                   uint32_t capacity) {
+    assert(item_size);
+    assert(capacity && capacity < UINT32_MAX);
+
+    // The actual capacity is (alloc_size - 1) so that head == tail is
+    // non-ambiguous
+    queue->alloc_size = capacity + 1;
+    queue->data = sc_allocarray(queue->alloc_size, item_size);
+    if (!queue->data) {
+        LOG_OOM();
+        return false;
+    }
+
+    queue->item_size = item_size;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+
+    return true;
+}
+
+void
+sc_spsc_queue_destroy(struct sc_spsc_queue *queue) {
+    free(queue->data);
+}
+
+bool
+sc_spsc_queue_push(struct sc_spsc_queue *queue, const void *item) {
+    // Only the producer thread can write head, so memory_order_relaxed is
+    // sufficient
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    // The tail cursor is updated after the item is consumed by the reader
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    uint32_t new_head = (head + 1) % queue->alloc_size;
+    if (new_head == tail) {
+        // Full
+        return false;
+    }
+
+    memcpy(queue->data + (head * queue->item_size), item, queue->item_size);
+
+    atomic_store_explicit(&queue->head, new_head, memory_order_release);
+
+    return true;
+}
+
+bool
+sc_spsc_queue_pop(struct sc_spsc_queue *queue, void *item) {
+    // Only the consumer thread can write tail, so memory_order_relaxed is
+    // sufficient
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    // The head cursor is updated after the item is written to the array
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (tail == head) {
+        // Empty
+        return false;
+    }
+
+    memcpy(item, queue->data + (tail * queue->item_size), queue->item_size);
+
+    uint32_t new_tail = (tail + 1) % queue->alloc_size;
+    atomic_store_explicit(&queue->tail, new_tail, memory_order_release);
+
+    return true;
+}
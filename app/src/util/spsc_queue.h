@@ -0,0 +1,71 @@
+#ifndef SC_SPSC_QUEUE_H
+#define SC_SPSC_QUEUE_H
+
+#include "common.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bounded lock-free queue for a single producer and a single consumer
+ *
+ * Items are copied by value (each item takes item_size bytes). Only one thread
+ * may push, and only one thread may pop (it may be a different thread).
+ */
+struct sc_spsc_queue {
+    uint8_t *data;
+    uint32_t alloc_size; // in items
+    size_t item_size;
+
+    atomic_uint_least32_t head; // writer cursor, in items
+    atomic_uint_least32_t tail; // reader cursor, in items
+    // empty: tail == head
+    // full: ((head + 1) % alloc_size) == tail
+};
+
+bool
+sc_spsc_queue_init(struct sc_spsc_queue *queue, size_t item_size,
+                   uint32_t capacity);
+
+void
+sc_spsc_queue_destroy(struct sc_spsc_queue *queue);
+
+/**
+ * Push an item (producer only)
+ *
+ * Return false if the queue is full.
+ */
+bool
+sc_spsc_queue_push(struct sc_spsc_queue *queue, const void *item);
+
+/**
+ * Pop an item (consumer only)
+ *
+ * Return false if the queue is empty.
+ */
+bool
+sc_spsc_queue_pop(struct sc_spsc_queue *queue, void *item);
+
+static inline uint32_t
+sc_spsc_queue_capacity(struct sc_spsc_queue *queue) {
+    assert(queue->alloc_size);
+    return queue->alloc_size - 1;
+}
+
+// The result is exact only if called from the producer or the consumer
+static inline uint32_t
+sc_spsc_queue_size(struct sc_spsc_queue *queue) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return (queue->alloc_size + head - tail) % queue->alloc_size;
+}
+
+static inline bool
+sc_spsc_queue_is_empty(struct sc_spsc_queue *queue) {
+    return !sc_spsc_queue_size(queue);
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include "tile_diff.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+# define SC_TILE_DIFF_SSE2
+# include <emmintrin.h>
+#endif
+
+// AVX2 is not enabled at compile time by default, it is selected at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define SC_TILE_DIFF_AVX2
+# include <immintrin.h>
+#endif
+
+// vmaxvq_u8() is only available on AArch64
+#if defined(__ARM_NEON) && defined(__aarch64__)
+# define SC_TILE_DIFF_NEON
+# include <arm_neon.h>
+#endif
+
+// Compare the bytes of a single row which do not fill a vector
+static inline bool
+sc_tile_diff_row_tail(const uint8_t *a, const uint8_t *b, unsigned len) {
+    uint8_t acc = 0;
+    for (unsigned i = 0; i < len; ++i) {
+        acc |= a[i] ^ b[i];
+    }
+    return acc;
+}
+
+static bool
+sc_tile_diff_scalar(const uint8_t *a, ptrdiff_t a_linesize,
+                    const uint8_t *b, ptrdiff_t b_linesize,
+                    unsigned width, unsigned height) {
+    unsigned words_width = width & ~7u;
+    for (unsigned y = 0; y < height; ++y) {
+        // Accumulate the differences of the whole row, to test only once
+        uint64_t acc = 0;
+        for (unsigned x = 0; x < words_width; x += 8) {
+            uint64_t wa;
+            uint64_t wb;
+            memcpy(&wa, a + x, 8);
+            memcpy(&wb, b + x, 8);
+            acc |= wa ^ wb;
+        }
+        if (acc || sc_tile_diff_row_tail(a + words_width, b + words_width,
+                                         width - words_width)) {
+            return true;
+        }
+
+        a += a_linesize;
+        b += b_linesize;
+    }
+
+    return false;
+}
+
+#ifdef SC_TILE_DIFF_SSE2
+static bool
+sc_tile_diff_sse2(const uint8_t *a, ptrdiff_t a_linesize,
+                  const uint8_t *b, ptrdiff_t b_linesize,
+                  unsigned width, unsigned height) {
+    unsigned vec_width = width & ~15u;
+    __m128i zero = _mm_setzero_si128();
+    for (unsigned y = 0; y < height; ++y) {
+        __m128i acc = zero;
+        for (unsigned x = 0; x < vec_width; x += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i *) (a + x));
+            __m128i vb = _mm_loadu_si128((const __m128i *) (b + x));
+            acc = _mm_or_si128(acc, _mm_xor_si128(va, vb));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF
+                || sc_tile_diff_row_tail(a + vec_width, b + vec_width,
+                                         width - vec_width)) {
+            return true;
+        }
+
+        a += a_linesize;
+        b += b_linesize;
+    }
+
+    return false;
+}
+#endif
+
+#ifdef SC_TILE_DIFF_AVX2
+__attribute__((target("avx2")))
+static bool
+sc_tile_diff_avx2(const uint8_t *a, ptrdiff_t a_linesize,
+                  const uint8_t *b, ptrdiff_t b_linesize,
+                  unsigned width, unsigned height) {
+    unsigned vec_width = width & ~31u;
+    for (unsigned y = 0; y < height; ++y) {
+        __m256i acc = _mm256_setzero_si256();
+        for (unsigned x = 0; x < vec_width; x += 32) {
+            __m256i va = _mm256_loadu_si256((const __m256i *) (a + x));
+            __m256i vb = _mm256_loadu_si256((const __m256i *) (b + x));
+            acc = _mm256_or_si256(acc, _mm256_xor_si256(va, vb));
+        }
+        if (!_mm256_testz_si256(acc, acc)
+                || sc_tile_diff_row_tail(a + vec_width, b + vec_width,
+                                         width - vec_width)) {
+            return true;
+        }
+
+        a += a_linesize;
+        b += b_linesize;
+    }
+
+    return false;
+}
+#endif
+
+#ifdef SC_TILE_DIFF_NEON
+static bool
+sc_tile_diff_neon(const uint8_t *a, ptrdiff_t a_linesize,
+                  const uint8_t *b, ptrdiff_t b_linesize,
+                  unsigned width, unsigned height) {
+    unsigned vec_width = width & ~15u;
+    for (unsigned y = 0; y < height; ++y) {
+        uint8x16_t acc = vdupq_n_u8(0);
+        for (unsigned x = 0; x < vec_width; x += 16) {
+            uint8x16_t va = vld1q_u8(a + x);
+            uint8x16_t vb = vld1q_u8(b + x);
+            acc = vorrq_u8(acc, veorq_u8(va, vb));
+        }
+        if (vmaxvq_u8(acc)
+                || sc_tile_diff_row_tail(a + vec_width, b + vec_width,
+                                         width - vec_width)) {
+            return true;
+        }
+
+        a += a_linesize;
+        b += b_linesize;
+    }
+
+    return false;
+}
+#endif
+
+size_t
+sc_tile_diff_get_impls(struct sc_tile_diff_impl *impls) {
+    size_t count = 0;
+
+#ifdef SC_TILE_DIFF_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        impls[count++] = (struct sc_tile_diff_impl) {
+            .name = "avx2",
+            .fn = sc_tile_diff_avx2,
+        };
+    }
+#endif
+
+#ifdef SC_TILE_DIFF_SSE2
+    impls[count++] = (struct sc_tile_diff_impl) {
+        .name = "sse2",
+        .fn = sc_tile_diff_sse2,
+    };
+#endif
+
+#ifdef SC_TILE_DIFF_NEON
+    impls[count++] = (struct sc_tile_diff_impl) {
+        .name = "neon",
+        .fn = sc_tile_diff_neon,
+    };
+#endif
+
+    impls[count++] = (struct sc_tile_diff_impl) {
+        .name = "scalar",
+        .fn = sc_tile_diff_scalar,
+    };
+
+    assert(count <= SC_TILE_DIFF_MAX_IMPLS);
+    return count;
+}
+
+struct sc_tile_diff_impl
+sc_tile_diff_get_best_impl(void) {
+    struct sc_tile_diff_impl impls[SC_TILE_DIFF_MAX_IMPLS];
+    size_t count = sc_tile_diff_get_impls(impls);
+    (void) count;
+    assert(count);
+    return impls[0];
+}
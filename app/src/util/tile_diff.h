@@ -0,0 +1,41 @@
+#ifndef SC_TILE_DIFF_H
+#define SC_TILE_DIFF_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compare a rectangle of `width` x `height` bytes of two planes
+ *
+ * Return true if any byte differs.
+ */
+typedef bool sc_tile_diff_fn(const uint8_t *a, ptrdiff_t a_linesize,
+                             const uint8_t *b, ptrdiff_t b_linesize,
+                             unsigned width, unsigned height);
+
+struct sc_tile_diff_impl {
+    const char *name;
+    sc_tile_diff_fn *fn;
+};
+
+#define SC_TILE_DIFF_MAX_IMPLS 4
+
+/**
+ * Get the implementations supported by the current CPU, the best one first
+ *
+ * The array must be able to store SC_TILE_DIFF_MAX_IMPLS items. The last one
+ * is always the scalar implementation.
+ *
+ * Return the number of implementations.
+ */
+size_t
+sc_tile_diff_get_impls(struct sc_tile_diff_impl *impls);
+
+// Get the best implementation supported by the current CPU
+struct sc_tile_diff_impl
+sc_tile_diff_get_best_impl(void);
+
+#endif
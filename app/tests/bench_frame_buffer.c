@@ -0,0 +1,286 @@
+/**
+ * Microbenchmark of sc_frame_buffer under contention
+ *
+ * A producer thread pushes frames as fast as possible, while the main thread
+ * consumes them as soon as they are available (like the screen does on each
+ * SC_EVENT_NEW_FRAME). The duration of each push and consume call is measured.
+ *
+ * It is run once with the lock-free sc_frame_buffer, then once with a
+ * mutex-based frame buffer (the previous implementation) for reference.
+ */
+
+#include "common.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <libavutil/frame.h>
+
+#include "frame_buffer.h"
+#include "util/thread.h"
+
+#define ITERATIONS 1000000
+
+// The previous implementation, protected by a mutex
+struct mutex_frame_buffer {
+    AVFrame *pending_frame;
+    AVFrame *tmp_frame;
+    sc_mutex mutex;
+    bool pending_frame_consumed;
+};
+
+static bool
+mutex_frame_buffer_init(void *userdata) {
+    struct mutex_frame_buffer *fb = userdata;
+    fb->pending_frame = av_frame_alloc();
+    fb->tmp_frame = av_frame_alloc();
+    bool ok = sc_mutex_init(&fb->mutex);
+    if (!fb->pending_frame || !fb->tmp_frame || !ok) {
+        return false;
+    }
+    fb->pending_frame_consumed = true;
+    return true;
+}
+
+static void
+mutex_frame_buffer_destroy(void *userdata) {
+    struct mutex_frame_buffer *fb = userdata;
+    sc_mutex_destroy(&fb->mutex);
+    av_frame_free(&fb->pending_frame);
+    av_frame_free(&fb->tmp_frame);
+}
+
+static bool
+mutex_frame_buffer_push(void *userdata, const AVFrame *frame, bool *skipped) {
+    struct mutex_frame_buffer *fb = userdata;
+    if (av_frame_ref(fb->tmp_frame, frame)) {
+        return false;
+    }
+
+    sc_mutex_lock(&fb->mutex);
+    AVFrame *tmp = fb->pending_frame;
+    fb->pending_frame = fb->tmp_frame;
+    fb->tmp_frame = tmp;
+    av_frame_unref(fb->tmp_frame);
+    *skipped = !fb->pending_frame_consumed;
+    fb->pending_frame_consumed = false;
+    sc_mutex_unlock(&fb->mutex);
+
+    return true;
+}
+
+static void
+mutex_frame_buffer_consume(void *userdata, AVFrame *dst) {
+    struct mutex_frame_buffer *fb = userdata;
+    sc_mutex_lock(&fb->mutex);
+    assert(!fb->pending_frame_consumed);
+    fb->pending_frame_consumed = true;
+    av_frame_move_ref(dst, fb->pending_frame);
+    sc_mutex_unlock(&fb->mutex);
+}
+
+static bool
+frame_buffer_init(void *userdata) {
+    return sc_frame_buffer_init(userdata);
+}
+
+static void
+frame_buffer_destroy(void *userdata) {
+    sc_frame_buffer_destroy(userdata);
+}
+
+static bool
+frame_buffer_push(void *userdata, const AVFrame *frame, bool *skipped) {
+    return sc_frame_buffer_push(userdata, frame, skipped);
+}
+
+static void
+frame_buffer_consume(void *userdata, AVFrame *dst) {
+    sc_frame_buffer_consume(userdata, dst);
+}
+
+struct bench_ops {
+    const char *name;
+    bool (*init)(void *fb);
+    void (*destroy)(void *fb);
+    bool (*push)(void *fb, const AVFrame *frame, bool *skipped);
+    void (*consume)(void *fb, AVFrame *dst);
+};
+
+struct bench {
+    const struct bench_ops *ops;
+    void *fb;
+    const AVFrame *frame;
+
+    atomic_uint events; // pushes which did not skip the previous frame
+    atomic_bool done;
+
+    uint64_t *push_ns; // ITERATIONS items
+    uint64_t *consume_ns; // at most ITERATIONS items
+    size_t consume_count;
+    bool ok;
+};
+
+static inline uint64_t
+now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+run_producer(void *data) {
+    struct bench *bench = data;
+
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        bool skipped;
+        uint64_t start = now_ns();
+        bool ok = bench->ops->push(bench->fb, bench->frame, &skipped);
+        bench->push_ns[i] = now_ns() - start;
+        if (!ok) {
+            bench->ok = false;
+            break;
+        }
+        if (!skipped) {
+            atomic_fetch_add(&bench->events, 1);
+        }
+    }
+
+    atomic_store(&bench->done, true);
+    return 0;
+}
+
+static void
+consume(struct bench *bench) {
+    AVFrame *dst = av_frame_alloc();
+    assert(dst);
+
+    for (;;) {
+        // Read done before events, so that no event may be missed
+        bool done = atomic_load(&bench->done);
+        if (!atomic_load(&bench->events)) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        atomic_fetch_sub(&bench->events, 1);
+
+        uint64_t start = now_ns();
+        bench->ops->consume(bench->fb, dst);
+        bench->consume_ns[bench->consume_count++] = now_ns() - start;
+        av_frame_unref(dst);
+    }
+
+    av_frame_free(&dst);
+}
+
+static int
+compare_u64(const void *lhs, const void *rhs) {
+    uint64_t a = *(const uint64_t *) lhs;
+    uint64_t b = *(const uint64_t *) rhs;
+    return a < b ? -1 : a > b;
+}
+
+static void
+print_stats(const char *label, uint64_t *values, size_t count) {
+    assert(count);
+    qsort(values, count, sizeof(*values), compare_u64);
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += values[i];
+    }
+
+    printf("  %-8s %8zu calls  avg %6.0f ns  p50 %6" PRIu64 " ns  "
+           "p99 %7" PRIu64 " ns  max %9" PRIu64 " ns\n", label, count,
+           (double) sum / count, values[count / 2], values[count * 99 / 100],
+           values[count - 1]);
+}
+
+static bool
+run_bench(const struct bench_ops *ops, void *fb, const AVFrame *frame) {
+    struct bench bench = {
+        .ops = ops,
+        .fb = fb,
+        .frame = frame,
+        .consume_count = 0,
+        .ok = true,
+    };
+    atomic_init(&bench.events, 0);
+    atomic_init(&bench.done, false);
+
+    bench.push_ns = malloc(ITERATIONS * sizeof(*bench.push_ns));
+    bench.consume_ns = malloc(ITERATIONS * sizeof(*bench.consume_ns));
+    if (!bench.push_ns || !bench.consume_ns || !ops->init(fb)) {
+        free(bench.push_ns);
+        free(bench.consume_ns);
+        return false;
+    }
+
+    sc_thread thread;
+    bool ok = sc_thread_create(&thread, run_producer, "bench-producer",
+                               &bench);
+    if (ok) {
+        consume(&bench);
+        sc_thread_join(&thread, NULL);
+        ok = bench.ok;
+    }
+
+    if (ok) {
+        printf("%s: %zu frames skipped\n", ops->name,
+               ITERATIONS - bench.consume_count);
+        print_stats("push", bench.push_ns, ITERATIONS);
+        print_stats("consume", bench.consume_ns, bench.consume_count);
+    }
+
+    ops->destroy(fb);
+    free(bench.push_ns);
+    free(bench.consume_ns);
+    return ok;
+}
+
+int
+main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    // A 1080p frame (av_frame_ref() only references its buffers)
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        return 1;
+    }
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 1920;
+    frame->height = 1080;
+    if (av_frame_get_buffer(frame, 0)) {
+        av_frame_free(&frame);
+        return 1;
+    }
+
+    static const struct bench_ops lock_free_ops = {
+        .name = "lock-free",
+        .init = frame_buffer_init,
+        .destroy = frame_buffer_destroy,
+        .push = frame_buffer_push,
+        .consume = frame_buffer_consume,
+    };
+    static const struct bench_ops mutex_ops = {
+        .name = "mutex",
+        .init = mutex_frame_buffer_init,
+        .destroy = mutex_frame_buffer_destroy,
+        .push = mutex_frame_buffer_push,
+        .consume = mutex_frame_buffer_consume,
+    };
+
+    struct sc_frame_buffer fb;
+    struct mutex_frame_buffer mfb;
+    bool ok = run_bench(&lock_free_ops, &fb, frame)
+           && run_bench(&mutex_ops, &mfb, frame);
+
+    av_frame_free(&frame);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+/**
+ * Benchmark of the partial texture upload (--video-partial-upload)
+ *
+ * Each frame is compared to the previous one by sc_frame_diff_compute(), like
+ * sc_display does before uploading it. It reports the number of bytes which
+ * would be uploaded per frame, compared to a full upload, and the duration of
+ * the comparison for each tile diff implementation supported by the CPU.
+ *
+ * The frames are read from a raw YUV 4:2:0 file, for example extracted from a
+ * recording:
+ *
+ *     scrcpy --no-audio --record=file.mp4
+ *     ffmpeg -i file.mp4 -f rawvideo -pix_fmt yuv420p file.yuv
+ *     bench_frame_diff --input=file.yuv --size=1080x2400
+ *
+ * Without input file, synthetic frames simulating a phone UI are generated (a
+ * small animated area, then a scroll, then a static screen).
+ */
+
+#include "common.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libavutil/frame.h>
+
+#include "frame_diff.h"
+#include "util/str.h"
+#include "util/tile_diff.h"
+
+#define SYNTHETIC_FRAME_COUNT 300
+
+struct bench_params {
+    const char *input; // NULL for synthetic frames
+    uint16_t width;
+    uint16_t height;
+    unsigned max_percent;
+};
+
+struct frame_reader {
+    const struct bench_params *params;
+    FILE *file;
+    unsigned index;
+};
+
+static inline uint64_t
+now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+fill_rect(AVFrame *frame, unsigned x, unsigned y, unsigned w, unsigned h,
+          uint8_t luma) {
+    for (unsigned row = y; row < y + h && row < (unsigned) frame->height;
+            ++row) {
+        uint8_t *line = frame->data[0] + (ptrdiff_t) row * frame->linesize[0];
+        for (unsigned col = x; col < x + w && col < (unsigned) frame->width;
+                ++col) {
+            line[col] = luma;
+        }
+    }
+}
+
+static void
+generate_frame(AVFrame *frame, unsigned index) {
+    unsigned width = frame->width;
+    unsigned height = frame->height;
+
+    // A list of items, scrolled between the frames 150 and 200
+    unsigned scroll = index < 150 ? 0 : index < 200 ? (index - 150) * 16 : 800;
+    for (unsigned y = 0; y < height; ++y) {
+        uint8_t *line = frame->data[0] + (ptrdiff_t) y * frame->linesize[0];
+        unsigned item = (y + scroll) / 120;
+        unsigned item_y = (y + scroll) % 120;
+        for (unsigned x = 0; x < width; ++x) {
+            bool text = item_y > 40 && item_y < 80 && x > 100
+                     && x < 100 + (item * 37) % (width - 200)
+                     && (x / 8 + item) % 3;
+            line[x] = text ? 40 : item % 2 ? 235 : 225;
+        }
+    }
+
+    unsigned chroma_height = (height + 1) / 2;
+    for (unsigned plane = 1; plane < 3; ++plane) {
+        memset(frame->data[plane], 128,
+               (size_t) chroma_height * frame->linesize[plane]);
+    }
+
+    // The status bar clock, updated every 60 frames
+    fill_rect(frame, 40, 20, 100, 30, 16 + (index / 60) * 8);
+
+    // A progress animation, during the first 150 frames
+    if (index < 150) {
+        fill_rect(frame, width / 2 - 50 + (index % 50) * 2, height / 2, 20,
+                  20, 16);
+    }
+}
+
+static bool
+read_frame(struct frame_reader *reader, AVFrame *frame) {
+    const struct bench_params *params = reader->params;
+    if (!params->input) {
+        if (reader->index == SYNTHETIC_FRAME_COUNT) {
+            return false;
+        }
+        generate_frame(frame, reader->index++);
+        return true;
+    }
+
+    for (unsigned plane = 0; plane < 3; ++plane) {
+        unsigned w = plane ? (params->width + 1) / 2 : params->width;
+        unsigned h = plane ? (params->height + 1) / 2 : params->height;
+        for (unsigned y = 0; y < h; ++y) {
+            uint8_t *line = frame->data[plane]
+                          + (ptrdiff_t) y * frame->linesize[plane];
+            if (fread(line, 1, w, reader->file) != w) {
+                return false;
+            }
+        }
+    }
+
+    ++reader->index;
+    return true;
+}
+
+static AVFrame *
+alloc_frame(const struct bench_params *params) {
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        return NULL;
+    }
+
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = params->width;
+    frame->height = params->height;
+    if (av_frame_get_buffer(frame, 0)) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+
+    return frame;
+}
+
+struct bench_result {
+    unsigned frames; // compared frames (the first one is not compared)
+    unsigned partial; // frames uploaded partially
+    uint64_t frame_bytes;
+    uint64_t uploaded_bytes;
+    uint64_t duration_ns;
+};
+
+static bool
+run_bench(const struct bench_params *params, sc_tile_diff_fn *tile_diff,
+          struct bench_result *result) {
+    struct frame_reader reader = {
+        .params = params,
+        .file = NULL,
+        .index = 0,
+    };
+
+    if (params->input) {
+        reader.file = fopen(params->input, "rb");
+        if (!reader.file) {
+            fprintf(stderr, "Could not open %s\n", params->input);
+            return false;
+        }
+    }
+
+    AVFrame *prev = alloc_frame(params);
+    AVFrame *frame = alloc_frame(params);
+    if (!prev || !frame) {
+        av_frame_free(&prev);
+        av_frame_free(&frame);
+        if (reader.file) {
+            fclose(reader.file);
+        }
+        return false;
+    }
+
+    struct sc_frame_diff diff;
+    sc_frame_diff_init(&diff, tile_diff);
+
+    memset(result, 0, sizeof(*result));
+
+    bool ok = read_frame(&reader, prev);
+    while (ok && read_frame(&reader, frame)) {
+        uint64_t start = now_ns();
+        bool partial = sc_frame_diff_compute(&diff, prev, frame,
+                                             params->max_percent);
+        result->duration_ns += now_ns() - start;
+
+        ++result->frames;
+        result->frame_bytes += diff.frame_bytes;
+        if (partial) {
+            ++result->partial;
+            result->uploaded_bytes += diff.dirty_bytes;
+        } else {
+            result->uploaded_bytes += diff.frame_bytes;
+        }
+
+        AVFrame *tmp = prev;
+        prev = frame;
+        frame = tmp;
+    }
+
+    av_frame_free(&prev);
+    av_frame_free(&frame);
+    if (reader.file) {
+        fclose(reader.file);
+    }
+
+    if (!result->frames) {
+        fprintf(stderr, "Not enough frames\n");
+        return false;
+    }
+
+    return true;
+}
+
+int
+main(int argc, char *argv[]) {
+    struct bench_params params = {
+        .input = NULL,
+        .width = 1080,
+        .height = 2400,
+        .max_percent = 50,
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        long value;
+        uint16_t width;
+        uint16_t height;
+        if (!strncmp(arg, "--input=", 8) && arg[8]) {
+            params.input = arg + 8;
+        } else if (!strncmp(arg, "--size=", 7)
+                && sscanf(arg + 7, "%" SCNu16 "x%" SCNu16, &width,
+                          &height) == 2
+                && width && height) {
+            params.width = width;
+            params.height = height;
+        } else if (!strncmp(arg, "--threshold=", 12)
+                && sc_str_parse_integer(arg + 12, &value)
+                && value > 0 && value <= 100) {
+            params.max_percent = value;
+        } else {
+            fprintf(stderr, "Usage: %s [--input=file.yuv] [--size=WxH] "
+                            "[--threshold=percent]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%s frames %" PRIu16 "x%" PRIu16 ", threshold %u%%\n",
+           params.input ? params.input : "Synthetic", params.width,
+           params.height, params.max_percent);
+
+    struct sc_tile_diff_impl impls[SC_TILE_DIFF_MAX_IMPLS];
+    size_t count = sc_tile_diff_get_impls(impls);
+
+    struct bench_result first = {0};
+    for (size_t i = 0; i < count; ++i) {
+        struct bench_result result;
+        if (!run_bench(&params, impls[i].fn, &result)) {
+            return 1;
+        }
+
+        if (!i) {
+            first = result;
+            unsigned frames = result.frames;
+            uint64_t saved = result.frame_bytes - result.uploaded_bytes;
+            printf("%u frames compared, %u uploaded partially\n", frames,
+                   result.partial);
+            printf("Upload per frame: %" PRIu64 " bytes (full: %" PRIu64
+                   " bytes), saved %" PRIu64 " bytes (%.1f%%)\n",
+                   result.uploaded_bytes / frames,
+                   result.frame_bytes / frames, saved / frames,
+                   100.0 * saved / result.frame_bytes);
+        } else {
+            // All implementations must give the same results
+            assert(result.uploaded_bytes == first.uploaded_bytes);
+            assert(result.partial == first.partial);
+        }
+
+        printf("  %-8s diff %8.1f us/frame\n", impls[i].name,
+               (double) result.duration_ns / result.frames / 1000);
+    }
+
+    return 0;
+}
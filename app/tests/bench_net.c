@@ -0,0 +1,257 @@
+/**
+ * Microbenchmark of the net_* backends over loopback
+ *
+ * A thread sends a given amount of data over a TCP loopback connection, while
+ * the main thread receives it like the demuxer does (through a sc_net_reader,
+ * or by net_recv_all() of large chunks). It is run once with the plain
+ * syscalls, then once with io_uring (if built with -Dio_uring=true).
+ *
+ * For each run, it reports the number of receive calls and the CPU time of
+ * the receiving thread per GiB. A receive call issues a single syscall:
+ * recv(), or io_uring_enter() which submits the operation and waits for its
+ * completion at once (only a call interrupted by a signal issues more).
+ */
+
+#include "common.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "util/log.h"
+#include "util/net.h"
+#include "util/str.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#ifdef HAVE_IO_URING
+# include "util/net_uring.h"
+#endif
+
+#define SEND_CHUNK_SIZE (1 << 20) // 1M
+#define READER_SIZE (1 << 16) // 64k, like the demuxer
+
+struct bench_params {
+    uint16_t port;
+    uint64_t total;
+    size_t recv_all_size; // 0 to receive through a sc_net_reader
+};
+
+struct sender {
+    uint16_t port;
+    uint64_t total;
+    bool ok;
+};
+
+static int
+run_sender(void *data) {
+    struct sender *sender = data;
+    sender->ok = false;
+
+    uint8_t *buf = malloc(SEND_CHUNK_SIZE);
+    if (!buf) {
+        LOG_OOM();
+        return 0;
+    }
+    memset(buf, 0x42, SEND_CHUNK_SIZE);
+
+    sc_socket socket = net_socket();
+    if (socket == SC_SOCKET_NONE) {
+        goto end;
+    }
+
+    if (!net_connect(socket, IPV4_LOCALHOST, sender->port)) {
+        goto close;
+    }
+
+    uint64_t remaining = sender->total;
+    while (remaining) {
+        size_t len = MIN(remaining, SEND_CHUNK_SIZE);
+        ssize_t w = net_send_all(socket, buf, len);
+        if (w < 0 || (size_t) w != len) {
+            LOGE("Send failed");
+            goto close;
+        }
+        remaining -= len;
+    }
+
+    sender->ok = true;
+
+close:
+    net_close(socket);
+end:
+    free(buf);
+    return 0;
+}
+
+static sc_tick
+thread_cpu_time(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage)) {
+        return 0;
+    }
+
+    return SC_TICK_FROM_SEC(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+         + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static bool
+receive(sc_socket socket, const struct bench_params *params,
+        uint64_t *calls) {
+    uint64_t received = 0;
+
+    if (params->recv_all_size) {
+        uint8_t *buf = malloc(params->recv_all_size);
+        if (!buf) {
+            LOG_OOM();
+            return false;
+        }
+
+        while (received < params->total) {
+            size_t len = MIN(params->total - received, params->recv_all_size);
+            ssize_t r = net_recv_all(socket, buf, len);
+            ++*calls;
+            if (r <= 0) {
+                break;
+            }
+            received += r;
+        }
+
+        free(buf);
+    } else {
+        struct sc_net_reader reader;
+        if (!sc_net_reader_init(&reader, socket, READER_SIZE)) {
+            return false;
+        }
+
+        while (received < params->total) {
+            ssize_t r = sc_net_reader_fill(&reader);
+            ++*calls;
+            if (r <= 0) {
+                break;
+            }
+            received += r;
+            sc_net_reader_consume(&reader, reader.size);
+        }
+
+        sc_net_reader_destroy(&reader);
+    }
+
+    if (received != params->total) {
+        LOGE("Received %" PRIu64 " bytes instead of %" PRIu64, received,
+             params->total);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+run_bench(const char *name, const struct bench_params *params) {
+    sc_socket server_socket = net_socket();
+    if (server_socket == SC_SOCKET_NONE) {
+        return false;
+    }
+
+    bool ok = false;
+
+    if (!net_listen(server_socket, IPV4_LOCALHOST, params->port, 1)) {
+        goto close_server;
+    }
+
+    struct sender sender = {
+        .port = params->port,
+        .total = params->total,
+    };
+    sc_thread thread;
+    if (!sc_thread_create(&thread, run_sender, "bench-sender", &sender)) {
+        goto close_server;
+    }
+
+    sc_socket socket = net_accept(server_socket);
+    if (socket == SC_SOCKET_NONE) {
+        sc_thread_join(&thread, NULL);
+        goto close_server;
+    }
+
+    uint64_t calls = 0;
+    sc_tick cpu_start = thread_cpu_time();
+    sc_tick start = sc_tick_now();
+
+    ok = receive(socket, params, &calls);
+
+    sc_tick elapsed = sc_tick_now() - start;
+    sc_tick cpu = thread_cpu_time() - cpu_start;
+
+    net_close(socket);
+    sc_thread_join(&thread, NULL);
+    ok &= sender.ok;
+
+    if (ok) {
+        double gib = (double) params->total / (1 << 30);
+        double sec = (double) elapsed / SC_TICK_FREQ;
+        printf("%-8s %10" PRIu64 " calls %10.0f calls/GiB %8.1f ms CPU/GiB "
+               "%8.2f GiB/s\n", name, calls, calls / gib,
+               SC_TICK_TO_US(cpu) / 1000.0 / gib, gib / sec);
+    }
+
+close_server:
+    net_close(server_socket);
+    return ok;
+}
+
+int
+main(int argc, char *argv[]) {
+    struct bench_params params = {
+        .port = 27310,
+        .total = UINT64_C(1) << 30, // 1G
+        .recv_all_size = 0,
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        long value;
+        if (!strncmp(arg, "--port=", 7)
+                && sc_str_parse_integer(arg + 7, &value)
+                && value > 0 && value <= 0xFFFF) {
+            params.port = value;
+        } else if (!strncmp(arg, "--size=", 7)
+                && sc_str_parse_integer_with_suffix(arg + 7, &value)
+                && value > 0) {
+            params.total = value;
+        } else if (!strncmp(arg, "--recv-all=", 11)
+                && sc_str_parse_integer_with_suffix(arg + 11, &value)
+                && value > 0) {
+            params.recv_all_size = value;
+        } else {
+            fprintf(stderr, "Usage: %s [--port=port] [--size=bytes] "
+                            "[--recv-all=chunk_size]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!net_init()) {
+        return 1;
+    }
+
+    printf("Receiving %" PRIu64 " bytes %s\n", params.total,
+           params.recv_all_size ? "by net_recv_all()" : "through a reader");
+
+    bool ok = run_bench("syscalls", &params);
+
+#ifdef HAVE_IO_URING
+    sc_net_uring_set_enabled(true);
+    // Use another port, the previous one may be in TIME_WAIT
+    ++params.port;
+    ok &= run_bench("io_uring", &params);
+    sc_net_uring_set_enabled(false);
+#else
+    printf("io_uring: not built (meson -Dio_uring=true)\n");
+#endif
+
+    net_cleanup();
+
+    return ok ? 0 : 1;
+}
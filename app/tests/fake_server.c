@@ -0,0 +1,1109 @@
+/**
+ * Fake scrcpy server, to run the client end-to-end without any device.
+ *
+ * It speaks the same socket protocol as the real server in "forward" mode:
+ * it listens on localhost, writes a dummy byte on the first accepted socket,
+ * the device name, the codec metadata, then packets prefixed by the 12-byte
+ * header, paced at the configured frame rate.
+ *
+ * The video and audio streams are synthetic content encoded with libavcodec
+ * on startup (a loop of SC_FAKE_LOOP_SEC seconds, starting with a key frame),
+ * so that the encoding cost is not part of the measurements.
+ *
+ * If a command is passed after "--", it is executed (typically a scrcpy client
+ * started with --no-adb --tunnel-port=<port>), and the fake server exits once
+ * the client has terminated.
+ *
+ * Usage:
+ *
+ *     scrcpy-fake-server [options] [-- command...]
+ */
+
+#include "common.h"
+
+#include <assert.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+
+#include "options.h"
+#include "scrcpy.h"
+#include "util/binary.h"
+#include "util/log.h"
+#include "util/net.h"
+#include "util/process.h"
+#include "util/str.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vector.h"
+
+#define SC_FAKE_LOOP_SEC 2
+#define SC_FAKE_PACKET_HEADER_SIZE 12
+#define SC_FAKE_AUDIO_SAMPLE_RATE 48000
+
+#define SC_PACKET_FLAG_CONFIG    (UINT64_C(1) << 63)
+#define SC_PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+#define SC_CODEC_ID_H264 UINT32_C(0x68323634) // "h264" in ASCII
+#define SC_CODEC_ID_H265 UINT32_C(0x68323635) // "h265" in ASCII
+#define SC_CODEC_ID_OPUS UINT32_C(0x6f707573) // "opus" in ASCII
+
+// Time to wait for the client to terminate once the streams are closed
+#define SC_FAKE_CLIENT_TIMEOUT SC_TICK_FROM_SEC(5)
+
+struct sc_fake_server_params {
+    uint16_t port;
+    const char *device_name;
+    bool video;
+    bool audio;
+    bool control;
+    bool pacing;
+    enum sc_codec video_codec;
+    const char *video_encoder;
+    uint16_t width;
+    uint16_t height;
+    uint16_t fps;
+    uint32_t video_bit_rate;
+    uint32_t audio_bit_rate;
+    sc_tick duration; // 0 for unlimited
+    const char *const *client_argv; // NULL if no client must be executed
+};
+
+struct sc_fake_packet {
+    // The 12-byte header followed by the payload, so that each packet is
+    // written by a single send() call
+    uint8_t *data;
+    size_t size; // including the header
+    bool key_frame;
+};
+
+struct sc_fake_stream {
+    const char *name;
+    struct sc_fake_server *server;
+
+    uint32_t codec_id;
+    struct sc_fake_packet config; // data is NULL if there is no config packet
+    struct SC_VECTOR(struct sc_fake_packet) packets;
+    sc_tick packet_duration;
+
+    sc_socket socket;
+    sc_thread thread;
+
+    // Statistics, written by the stream thread, read after join
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    sc_tick blocked; // total time blocked in send()
+    sc_tick max_blocked;
+    sc_tick elapsed;
+};
+
+struct sc_fake_server {
+    struct sc_fake_server_params params;
+
+    sc_mutex mutex;
+    sc_cond cond_stopped;
+    bool stopped;
+
+    sc_socket server_socket;
+    sc_socket control_socket;
+    sc_thread control_thread;
+    uint64_t control_bytes;
+
+    struct sc_fake_stream video;
+    struct sc_fake_stream audio;
+};
+
+static void
+sc_fake_stream_init(struct sc_fake_stream *stream, const char *name,
+                    struct sc_fake_server *server) {
+    stream->name = name;
+    stream->server = server;
+    stream->config.data = NULL;
+    sc_vector_init(&stream->packets);
+    stream->socket = SC_SOCKET_NONE;
+    stream->packets_sent = 0;
+    stream->bytes_sent = 0;
+    stream->blocked = 0;
+    stream->max_blocked = 0;
+    stream->elapsed = 0;
+}
+
+static void
+sc_fake_stream_destroy(struct sc_fake_stream *stream) {
+    free(stream->config.data);
+    for (size_t i = 0; i < stream->packets.size; ++i) {
+        free(stream->packets.data[i].data);
+    }
+    sc_vector_destroy(&stream->packets);
+}
+
+static bool
+sc_fake_packet_init(struct sc_fake_packet *packet, const uint8_t *payload,
+                    size_t len, bool key_frame) {
+    assert(len <= UINT32_MAX);
+
+    packet->size = SC_FAKE_PACKET_HEADER_SIZE + len;
+    packet->data = malloc(packet->size);
+    if (!packet->data) {
+        LOG_OOM();
+        return false;
+    }
+
+    // The PTS is written on send
+    sc_write64be(packet->data, 0);
+    sc_write32be(&packet->data[8], len);
+    memcpy(&packet->data[SC_FAKE_PACKET_HEADER_SIZE], payload, len);
+    packet->key_frame = key_frame;
+
+    return true;
+}
+
+static bool
+sc_fake_stream_set_config(struct sc_fake_stream *stream,
+                          const AVCodecContext *ctx) {
+    if (!ctx->extradata_size) {
+        // The codec headers are in the key frames
+        return true;
+    }
+
+    bool ok = sc_fake_packet_init(&stream->config, ctx->extradata,
+                                  ctx->extradata_size, false);
+    if (!ok) {
+        return false;
+    }
+
+    sc_write64be(stream->config.data, SC_PACKET_FLAG_CONFIG);
+    return true;
+}
+
+static bool
+sc_fake_stream_receive_packets(struct sc_fake_stream *stream,
+                               AVCodecContext *ctx, AVPacket *packet) {
+    for (;;) {
+        int ret = avcodec_receive_packet(ctx, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+        if (ret) {
+            LOGE("Fake %s: could not receive packet: %d", stream->name, ret);
+            return false;
+        }
+
+        struct sc_fake_packet p;
+        bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+        bool ok = sc_fake_packet_init(&p, packet->data, packet->size,
+                                      key_frame);
+        av_packet_unref(packet);
+        if (!ok) {
+            return false;
+        }
+
+        ok = sc_vector_push(&stream->packets, p);
+        if (!ok) {
+            LOG_OOM();
+            free(p.data);
+            return false;
+        }
+    }
+}
+
+static bool
+sc_fake_stream_encode(struct sc_fake_stream *stream, AVCodecContext *ctx,
+                      AVFrame *frame, unsigned frame_count,
+                      void (*fill)(AVFrame *frame, unsigned index)) {
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = false;
+
+    for (unsigned i = 0; i < frame_count; ++i) {
+        if (av_frame_make_writable(frame) < 0) {
+            LOGE("Fake %s: could not make frame writable", stream->name);
+            goto end;
+        }
+
+        fill(frame, i);
+        frame->pts = (int64_t) i * (frame->nb_samples ? frame->nb_samples : 1);
+
+        if (avcodec_send_frame(ctx, frame) < 0) {
+            LOGE("Fake %s: could not send frame", stream->name);
+            goto end;
+        }
+
+        if (!sc_fake_stream_receive_packets(stream, ctx, packet)) {
+            goto end;
+        }
+    }
+
+    // Flush
+    if (avcodec_send_frame(ctx, NULL) < 0) {
+        LOGE("Fake %s: could not flush encoder", stream->name);
+        goto end;
+    }
+
+    ok = sc_fake_stream_receive_packets(stream, ctx, packet);
+
+end:
+    av_packet_free(&packet);
+    return ok;
+}
+
+static void
+sc_fake_fill_video_frame(AVFrame *frame, unsigned index) {
+    // A moving gradient with a moving square, so that every frame differs
+    unsigned w = frame->width;
+    unsigned h = frame->height;
+
+    for (unsigned y = 0; y < h; ++y) {
+        uint8_t *line = &frame->data[0][y * frame->linesize[0]];
+        for (unsigned x = 0; x < w; ++x) {
+            line[x] = (x + y + 4 * index) & 0xFF;
+        }
+    }
+
+    for (unsigned y = 0; y < h / 2; ++y) {
+        uint8_t *u = &frame->data[1][y * frame->linesize[1]];
+        uint8_t *v = &frame->data[2][y * frame->linesize[2]];
+        for (unsigned x = 0; x < w / 2; ++x) {
+            u[x] = (x + 2 * index) & 0xFF;
+            v[x] = (y + 3 * index) & 0xFF;
+        }
+    }
+
+    unsigned size = h / 4;
+    unsigned sx = (index * 8) % (w - size);
+    unsigned sy = (index * 4) % (h - size);
+    for (unsigned y = sy; y < sy + size; ++y) {
+        memset(&frame->data[0][y * frame->linesize[0] + sx], 0xEB, size);
+    }
+}
+
+static void
+sc_fake_fill_audio_frame(AVFrame *frame, unsigned index) {
+    // A 440 Hz sine wave (interleaved stereo)
+    int16_t *samples = (int16_t *) frame->data[0];
+    for (int i = 0; i < frame->nb_samples; ++i) {
+        unsigned t = index * frame->nb_samples + i;
+        double s = sin(2 * M_PI * 440 * t / SC_FAKE_AUDIO_SAMPLE_RATE);
+        int16_t value = (int16_t) (s * 8000);
+        samples[2 * i] = value;
+        samples[2 * i + 1] = value;
+    }
+}
+
+static const AVCodec *
+sc_fake_find_video_encoder(const struct sc_fake_server_params *params) {
+    if (params->video_encoder) {
+        return avcodec_find_encoder_by_name(params->video_encoder);
+    }
+
+    // Prefer software encoders, always available and deterministic
+    if (params->video_codec == SC_CODEC_H265) {
+        const AVCodec *codec = avcodec_find_encoder_by_name("libx265");
+        return codec ? codec : avcodec_find_encoder(AV_CODEC_ID_HEVC);
+    }
+
+    assert(params->video_codec == SC_CODEC_H264);
+    const AVCodec *codec = avcodec_find_encoder_by_name("libx264");
+    return codec ? codec : avcodec_find_encoder(AV_CODEC_ID_H264);
+}
+
+static bool
+sc_fake_encode_video(struct sc_fake_stream *stream,
+                     const struct sc_fake_server_params *params) {
+    const AVCodec *codec = sc_fake_find_video_encoder(params);
+    if (!codec) {
+        LOGE("Fake video: encoder not found");
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = false;
+
+    unsigned frame_count = params->fps * SC_FAKE_LOOP_SEC;
+
+    ctx->width = params->width;
+    ctx->height = params->height;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->time_base = (AVRational) {1, params->fps};
+    ctx->framerate = (AVRational) {params->fps, 1};
+    ctx->bit_rate = params->video_bit_rate;
+    // Only the first frame of the loop is a key frame
+    ctx->gop_size = frame_count;
+    ctx->max_b_frames = 0;
+    // Like MediaCodec, provide the codec headers in a separate config packet
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    // Ignore errors, these options only exist for some encoders
+    av_opt_set(ctx->priv_data, "preset", "ultrafast", 0);
+    av_opt_set(ctx->priv_data, "tune", "zerolatency", 0);
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGE("Fake video: could not open encoder %s", codec->name);
+        goto free_context;
+    }
+
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        LOG_OOM();
+        goto free_context;
+    }
+
+    frame->format = ctx->pix_fmt;
+    frame->width = ctx->width;
+    frame->height = ctx->height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        LOG_OOM();
+        goto free_frame;
+    }
+
+    stream->codec_id = params->video_codec == SC_CODEC_H265 ? SC_CODEC_ID_H265
+                                                            : SC_CODEC_ID_H264;
+    stream->packet_duration = SC_TICK_FREQ / params->fps;
+
+    LOGI("Fake video: encoding %u frames %" PRIu16 "x%" PRIu16 " with %s...",
+         frame_count, params->width, params->height, codec->name);
+
+    ok = sc_fake_stream_set_config(stream, ctx)
+      && sc_fake_stream_encode(stream, ctx, frame, frame_count,
+                               sc_fake_fill_video_frame);
+
+free_frame:
+    av_frame_free(&frame);
+free_context:
+    avcodec_free_context(&ctx);
+
+    return ok;
+}
+
+static bool
+sc_fake_encode_audio(struct sc_fake_stream *stream,
+                     const struct sc_fake_server_params *params) {
+    const AVCodec *codec = avcodec_find_encoder_by_name("libopus");
+    if (!codec) {
+        LOGE("Fake audio: libopus encoder not found");
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = false;
+
+    ctx->sample_rate = SC_FAKE_AUDIO_SAMPLE_RATE;
+    ctx->sample_fmt = AV_SAMPLE_FMT_S16;
+    ctx->time_base = (AVRational) {1, SC_FAKE_AUDIO_SAMPLE_RATE};
+    ctx->bit_rate = params->audio_bit_rate;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    ctx->ch_layout = (AVChannelLayout) AV_CHANNEL_LAYOUT_STEREO;
+#else
+    ctx->channel_layout = AV_CH_LAYOUT_STEREO;
+    ctx->channels = 2;
+#endif
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGE("Fake audio: could not open encoder %s", codec->name);
+        goto free_context;
+    }
+
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        LOG_OOM();
+        goto free_context;
+    }
+
+    frame->format = ctx->sample_fmt;
+    frame->nb_samples = ctx->frame_size;
+    frame->sample_rate = ctx->sample_rate;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    if (av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout) < 0) {
+        LOG_OOM();
+        goto free_frame;
+    }
+#else
+    frame->channel_layout = ctx->channel_layout;
+    frame->channels = ctx->channels;
+#endif
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        LOG_OOM();
+        goto free_frame;
+    }
+
+    unsigned frame_count =
+        SC_FAKE_AUDIO_SAMPLE_RATE * SC_FAKE_LOOP_SEC / ctx->frame_size;
+
+    stream->codec_id = SC_CODEC_ID_OPUS;
+    stream->packet_duration =
+        (sc_tick) ctx->frame_size * SC_TICK_FREQ / SC_FAKE_AUDIO_SAMPLE_RATE;
+
+    LOGI("Fake audio: encoding %u frames with %s...", frame_count,
+         codec->name);
+
+    // The OPUS extradata is the OpusHead, exactly what the real server sends
+    // in its config packet
+    ok = sc_fake_stream_set_config(stream, ctx)
+      && sc_fake_stream_encode(stream, ctx, frame, frame_count,
+                               sc_fake_fill_audio_frame);
+
+free_frame:
+    av_frame_free(&frame);
+free_context:
+    avcodec_free_context(&ctx);
+
+    return ok;
+}
+
+static bool
+sc_fake_server_init(struct sc_fake_server *server,
+                    const struct sc_fake_server_params *params) {
+    server->params = *params;
+
+    bool ok = sc_mutex_init(&server->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&server->cond_stopped);
+    if (!ok) {
+        sc_mutex_destroy(&server->mutex);
+        return false;
+    }
+
+    server->stopped = false;
+    server->server_socket = SC_SOCKET_NONE;
+    server->control_socket = SC_SOCKET_NONE;
+    server->control_bytes = 0;
+
+    sc_fake_stream_init(&server->video, "video", server);
+    sc_fake_stream_init(&server->audio, "audio", server);
+
+    return true;
+}
+
+static void
+sc_fake_server_close_socket(sc_socket *socket) {
+    if (*socket != SC_SOCKET_NONE) {
+        net_close(*socket);
+        *socket = SC_SOCKET_NONE;
+    }
+}
+
+static void
+sc_fake_server_destroy(struct sc_fake_server *server) {
+    sc_fake_server_close_socket(&server->video.socket);
+    sc_fake_server_close_socket(&server->audio.socket);
+    sc_fake_server_close_socket(&server->control_socket);
+    sc_fake_server_close_socket(&server->server_socket);
+
+    sc_fake_stream_destroy(&server->video);
+    sc_fake_stream_destroy(&server->audio);
+
+    sc_cond_destroy(&server->cond_stopped);
+    sc_mutex_destroy(&server->mutex);
+}
+
+// May be called from any thread
+static void
+sc_fake_server_stop(struct sc_fake_server *server) {
+    sc_mutex_lock(&server->mutex);
+    server->stopped = true;
+    sc_cond_broadcast(&server->cond_stopped);
+
+    // Wake up blocking calls
+    sc_socket sockets[] = {
+        server->server_socket,
+        server->video.socket,
+        server->audio.socket,
+        server->control_socket,
+    };
+    for (size_t i = 0; i < ARRAY_LEN(sockets); ++i) {
+        if (sockets[i] != SC_SOCKET_NONE) {
+            net_interrupt(sockets[i]);
+        }
+    }
+    sc_mutex_unlock(&server->mutex);
+}
+
+// Return false if stopped
+static bool
+sc_fake_server_sleep(struct sc_fake_server *server, sc_tick deadline) {
+    sc_mutex_lock(&server->mutex);
+    bool timed_out = false;
+    while (!server->stopped && !timed_out) {
+        timed_out = !sc_cond_timedwait(&server->cond_stopped,
+                                       &server->mutex, deadline);
+    }
+    bool stopped = server->stopped;
+    sc_mutex_unlock(&server->mutex);
+
+    return !stopped;
+}
+
+// Accept a connection, unless the server is stopped
+static bool
+sc_fake_server_accept(struct sc_fake_server *server, sc_socket *socket) {
+    sc_socket s = net_accept(server->server_socket);
+    if (s == SC_SOCKET_NONE) {
+        return false;
+    }
+
+    sc_mutex_lock(&server->mutex);
+    bool stopped = server->stopped;
+    if (!stopped) {
+        // Register the socket so that it is interrupted on stop
+        *socket = s;
+    }
+    sc_mutex_unlock(&server->mutex);
+
+    if (stopped) {
+        net_close(s);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_fake_server_send_all(sc_socket socket, const void *buf, size_t len) {
+    ssize_t w = net_send_all(socket, buf, len);
+    return w >= 0 && (size_t) w == len;
+}
+
+static bool
+sc_fake_server_connect(struct sc_fake_server *server) {
+    const struct sc_fake_server_params *params = &server->params;
+
+    // Same order as the real server: video, audio, control
+    sc_socket first_socket = SC_SOCKET_NONE;
+    sc_socket *sockets[] = {
+        params->video ? &server->video.socket : NULL,
+        params->audio ? &server->audio.socket : NULL,
+        params->control ? &server->control_socket : NULL,
+    };
+    for (size_t i = 0; i < ARRAY_LEN(sockets); ++i) {
+        if (!sockets[i]) {
+            continue;
+        }
+
+        if (!sc_fake_server_accept(server, sockets[i])) {
+            return false;
+        }
+
+        if (first_socket == SC_SOCKET_NONE) {
+            first_socket = *sockets[i];
+            // The client reads one byte to detect a working connection
+            uint8_t dummy = 0;
+            if (!sc_fake_server_send_all(first_socket, &dummy, 1)) {
+                return false;
+            }
+        }
+    }
+
+    assert(first_socket != SC_SOCKET_NONE);
+
+    uint8_t device_name[64] = {0};
+    sc_strncpy((char *) device_name, params->device_name,
+               sizeof(device_name));
+    if (!sc_fake_server_send_all(first_socket, device_name,
+                                 sizeof(device_name))) {
+        return false;
+    }
+
+    if (params->video) {
+        uint8_t header[12];
+        sc_write32be(header, server->video.codec_id);
+        sc_write32be(&header[4], params->width);
+        sc_write32be(&header[8], params->height);
+        if (!sc_fake_server_send_all(server->video.socket, header,
+                                     sizeof(header))) {
+            return false;
+        }
+    }
+
+    if (params->audio) {
+        uint8_t header[4];
+        sc_write32be(header, server->audio.codec_id);
+        if (!sc_fake_server_send_all(server->audio.socket, header,
+                                     sizeof(header))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int
+run_fake_stream(void *data) {
+    struct sc_fake_stream *stream = data;
+    struct sc_fake_server *server = stream->server;
+    sc_tick duration = server->params.duration;
+    bool pacing = server->params.pacing;
+
+    assert(stream->packets.size);
+
+    if (stream->config.data) {
+        if (!sc_fake_server_send_all(stream->socket, stream->config.data,
+                                     stream->config.size)) {
+            LOGD("Fake %s: client disconnected", stream->name);
+            return 0;
+        }
+    }
+
+    sc_tick start = sc_tick_now();
+    for (uint64_t n = 0;; ++n) {
+        sc_tick pts = n * stream->packet_duration;
+        if (duration && pts >= duration) {
+            break;
+        }
+
+        if (pacing && !sc_fake_server_sleep(server, start + pts)) {
+            // stopped
+            break;
+        }
+
+        struct sc_fake_packet *packet =
+            &stream->packets.data[n % stream->packets.size];
+
+        uint64_t pts_flags = pts;
+        if (packet->key_frame) {
+            pts_flags |= SC_PACKET_FLAG_KEY_FRAME;
+        }
+        sc_write64be(packet->data, pts_flags);
+
+        sc_tick t = sc_tick_now();
+        bool ok = sc_fake_server_send_all(stream->socket, packet->data,
+                                          packet->size);
+        sc_tick blocked = sc_tick_now() - t;
+        if (!ok) {
+            LOGD("Fake %s: client disconnected", stream->name);
+            break;
+        }
+
+        ++stream->packets_sent;
+        stream->bytes_sent += packet->size;
+        stream->blocked += blocked;
+        if (blocked > stream->max_blocked) {
+            stream->max_blocked = blocked;
+        }
+    }
+
+    stream->elapsed = sc_tick_now() - start;
+
+    return 0;
+}
+
+static int
+run_fake_control(void *data) {
+    struct sc_fake_server *server = data;
+
+    // Consume (and ignore) the control messages
+    uint8_t buf[4096];
+    for (;;) {
+        ssize_t r = net_recv(server->control_socket, buf, sizeof(buf));
+        if (r <= 0) {
+            break;
+        }
+        server->control_bytes += r;
+    }
+
+    return 0;
+}
+
+static void
+sc_fake_stream_log_stats(struct sc_fake_stream *stream) {
+    double sec = (double) stream->elapsed / SC_TICK_FREQ;
+    double mib = (double) stream->bytes_sent / (1024 * 1024);
+    LOGI("Fake %s: %" PRIu64 " packets, %.2f MiB in %.3f s "
+         "(%.1f packets/s, %.2f MiB/s), blocked in send: %" PRItick " ms "
+         "(max %" PRItick " ms)", stream->name, stream->packets_sent, mib, sec,
+         sec > 0 ? stream->packets_sent / sec : 0, sec > 0 ? mib / sec : 0,
+         SC_TICK_TO_MS(stream->blocked), SC_TICK_TO_MS(stream->max_blocked));
+}
+
+static void
+sc_fake_server_on_client_terminated(void *userdata) {
+    struct sc_fake_server *server = userdata;
+    LOGD("Fake server: client terminated");
+    sc_fake_server_stop(server);
+}
+
+static bool
+sc_fake_server_run(struct sc_fake_server *server) {
+    const struct sc_fake_server_params *params = &server->params;
+
+    if (params->video && !sc_fake_encode_video(&server->video, params)) {
+        return false;
+    }
+
+    if (params->audio && !sc_fake_encode_audio(&server->audio, params)) {
+        return false;
+    }
+
+    server->server_socket = net_socket();
+    if (server->server_socket == SC_SOCKET_NONE) {
+        LOGE("Fake server: could not create socket");
+        return false;
+    }
+
+    bool ok = net_listen(server->server_socket, IPV4_LOCALHOST, params->port,
+                         1);
+    if (!ok) {
+        LOGE("Fake server: could not listen on port %" PRIu16, params->port);
+        return false;
+    }
+
+    LOGI("Fake server: listening on port %" PRIu16, params->port);
+
+    sc_pid pid = SC_PROCESS_NONE;
+    struct sc_process_observer observer;
+    if (params->client_argv) {
+        enum sc_process_result r =
+            sc_process_execute(params->client_argv, &pid, 0);
+        if (r != SC_PROCESS_SUCCESS) {
+            LOGE("Fake server: could not execute %s", params->client_argv[0]);
+            return false;
+        }
+
+        static const struct sc_process_listener listener = {
+            .on_terminated = sc_fake_server_on_client_terminated,
+        };
+        ok = sc_process_observer_init(&observer, pid, &listener, server);
+        if (!ok) {
+            sc_process_terminate(pid);
+            sc_process_wait(pid, true); // ignore exit code
+            return false;
+        }
+    }
+
+    bool success = false;
+    bool video_started = false;
+    bool audio_started = false;
+    bool control_started = false;
+
+    ok = sc_fake_server_connect(server);
+    if (!ok) {
+        LOGE("Fake server: connection failed");
+        goto stop;
+    }
+
+    if (params->video) {
+        video_started = sc_thread_create(&server->video.thread,
+                                         run_fake_stream, "fake-video",
+                                         &server->video);
+        if (!video_started) {
+            goto join;
+        }
+    }
+
+    if (params->audio) {
+        audio_started = sc_thread_create(&server->audio.thread,
+                                         run_fake_stream, "fake-audio",
+                                         &server->audio);
+        if (!audio_started) {
+            goto join;
+        }
+    }
+
+    if (params->control) {
+        control_started = sc_thread_create(&server->control_thread,
+                                           run_fake_control, "fake-control",
+                                           server);
+        if (!control_started) {
+            goto join;
+        }
+    }
+
+    success = true;
+
+join:
+    if (!success) {
+        sc_fake_server_stop(server);
+    }
+
+    if (video_started) {
+        sc_thread_join(&server->video.thread, NULL);
+        sc_fake_stream_log_stats(&server->video);
+    }
+    if (audio_started) {
+        sc_thread_join(&server->audio.thread, NULL);
+        sc_fake_stream_log_stats(&server->audio);
+    }
+
+stop:
+    // The streams are finished (or the client is gone): close the
+    // connections, the client will detect a device disconnection
+    sc_fake_server_stop(server);
+
+    if (control_started) {
+        sc_thread_join(&server->control_thread, NULL);
+        LOGI("Fake control: %" PRIu64 " bytes received",
+             server->control_bytes);
+    }
+
+    if (params->client_argv) {
+        sc_tick deadline = sc_tick_now() + SC_FAKE_CLIENT_TIMEOUT;
+        bool terminated = sc_process_observer_timedwait(&observer, deadline);
+        if (!terminated) {
+            LOGW("Fake server: killing the client...");
+            sc_process_terminate(pid);
+        }
+
+        sc_process_observer_join(&observer);
+        sc_process_observer_destroy(&observer);
+
+        sc_exit_code code = sc_process_wait(pid, true);
+        LOGI("Fake server: client exited with code %" SC_PRIexitcode, code);
+        // The client reports a disconnection when the streams are closed
+        if (code != SCRCPY_EXIT_SUCCESS && code != SCRCPY_EXIT_DISCONNECTED) {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+static void
+print_usage(const char *arg0) {
+    printf("Usage: %s [options] [-- command...]\n"
+           "\n"
+           "    --port=port              listening port (default 27183)\n"
+           "    --device-name=name       device name sent to the client\n"
+           "    --video-codec=name       h264 (default) or h265\n"
+           "    --video-encoder=name     libavcodec encoder name\n"
+           "    --size=WxH               video size (default 1920x1080)\n"
+           "    --fps=value              video frame rate (default 60)\n"
+           "    --video-bit-rate=value   default 8M\n"
+           "    --audio-bit-rate=value   default 128K\n"
+           "    --duration=seconds       0 for unlimited (default 10)\n"
+           "    --no-video\n"
+           "    --no-audio\n"
+           "    --no-control\n"
+           "    --no-pacing              send the packets as fast as possible\n"
+           "\n"
+           "The command, if any, is executed once the server listens, and the\n"
+           "server exits when it terminates.\n", arg0);
+}
+
+static bool
+parse_integer(const char *s, long min, long max, long *out) {
+    long value;
+    if (!sc_str_parse_integer_with_suffix(s, &value)
+            || value < min || value > max) {
+        LOGE("Invalid value: %s", s);
+        return false;
+    }
+
+    *out = value;
+    return true;
+}
+
+static bool
+parse_size(const char *s, uint16_t *width, uint16_t *height) {
+    char *end;
+    long w = strtol(s, &end, 10);
+    if (*end != 'x') {
+        LOGE("Invalid size: %s", s);
+        return false;
+    }
+
+    long h;
+    if (!parse_integer(end + 1, 16, 0xFFFF, &h)
+            || w < 16 || w > 0xFFFF || w % 2 || h % 2) {
+        LOGE("Invalid size: %s", s);
+        return false;
+    }
+
+    *width = w;
+    *height = h;
+    return true;
+}
+
+enum {
+    OPT_PORT = 1000,
+    OPT_DEVICE_NAME,
+    OPT_VIDEO_CODEC,
+    OPT_VIDEO_ENCODER,
+    OPT_SIZE,
+    OPT_FPS,
+    OPT_VIDEO_BIT_RATE,
+    OPT_AUDIO_BIT_RATE,
+    OPT_DURATION,
+    OPT_NO_VIDEO,
+    OPT_NO_AUDIO,
+    OPT_NO_CONTROL,
+    OPT_NO_PACING,
+    OPT_HELP,
+};
+
+static bool
+parse_args(struct sc_fake_server_params *params, int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"port",           required_argument, NULL, OPT_PORT},
+        {"device-name",    required_argument, NULL, OPT_DEVICE_NAME},
+        {"video-codec",    required_argument, NULL, OPT_VIDEO_CODEC},
+        {"video-encoder",  required_argument, NULL, OPT_VIDEO_ENCODER},
+        {"size",           required_argument, NULL, OPT_SIZE},
+        {"fps",            required_argument, NULL, OPT_FPS},
+        {"video-bit-rate", required_argument, NULL, OPT_VIDEO_BIT_RATE},
+        {"audio-bit-rate", required_argument, NULL, OPT_AUDIO_BIT_RATE},
+        {"duration",       required_argument, NULL, OPT_DURATION},
+        {"no-video",       no_argument,       NULL, OPT_NO_VIDEO},
+        {"no-audio",       no_argument,       NULL, OPT_NO_AUDIO},
+        {"no-control",     no_argument,       NULL, OPT_NO_CONTROL},
+        {"no-pacing",      no_argument,       NULL, OPT_NO_PACING},
+        {"help",           no_argument,       NULL, OPT_HELP},
+        {NULL,             0,                 NULL, 0},
+    };
+
+    long value;
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (c) {
+            case OPT_PORT:
+                if (!parse_integer(optarg, 1, 0xFFFF, &value)) {
+                    return false;
+                }
+                params->port = value;
+                break;
+            case OPT_DEVICE_NAME:
+                params->device_name = optarg;
+                break;
+            case OPT_VIDEO_CODEC:
+                if (!strcmp(optarg, "h264")) {
+                    params->video_codec = SC_CODEC_H264;
+                } else if (!strcmp(optarg, "h265")) {
+                    params->video_codec = SC_CODEC_H265;
+                } else {
+                    LOGE("Unsupported video codec: %s", optarg);
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_ENCODER:
+                params->video_encoder = optarg;
+                break;
+            case OPT_SIZE:
+                if (!parse_size(optarg, &params->width, &params->height)) {
+                    return false;
+                }
+                break;
+            case OPT_FPS:
+                if (!parse_integer(optarg, 1, 1000, &value)) {
+                    return false;
+                }
+                params->fps = value;
+                break;
+            case OPT_VIDEO_BIT_RATE:
+                if (!parse_integer(optarg, 1, 0x7FFFFFFF, &value)) {
+                    return false;
+                }
+                params->video_bit_rate = value;
+                break;
+            case OPT_AUDIO_BIT_RATE:
+                if (!parse_integer(optarg, 1, 0x7FFFFFFF, &value)) {
+                    return false;
+                }
+                params->audio_bit_rate = value;
+                break;
+            case OPT_DURATION:
+                if (!parse_integer(optarg, 0, 24 * 3600, &value)) {
+                    return false;
+                }
+                params->duration = SC_TICK_FROM_SEC(value);
+                break;
+            case OPT_NO_VIDEO:
+                params->video = false;
+                break;
+            case OPT_NO_AUDIO:
+                params->audio = false;
+                break;
+            case OPT_NO_CONTROL:
+                params->control = false;
+                break;
+            case OPT_NO_PACING:
+                params->pacing = false;
+                break;
+            case OPT_HELP:
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                // getopt prints the error message on stderr
+                return false;
+        }
+    }
+
+    if (!params->video && !params->audio && !params->control) {
+        LOGE("No video, no audio, no control: nothing to do");
+        return false;
+    }
+
+    if (optind < argc) {
+        // getopt_long() permutes the arguments, so the command after "--" is
+        // at the end
+        params->client_argv = (const char *const *) &argv[optind];
+    }
+
+    return true;
+}
+
+int
+main(int argc, char *argv[]) {
+    struct sc_fake_server_params params = {
+        .port = 27183,
+        .device_name = "scrcpy-fake-server",
+        .video = true,
+        .audio = true,
+        .control = true,
+        .pacing = true,
+        .video_codec = SC_CODEC_H264,
+        .video_encoder = NULL,
+        .width = 1920,
+        .height = 1080,
+        .fps = 60,
+        .video_bit_rate = 8000000,
+        .audio_bit_rate = 128000,
+        .duration = SC_TICK_FROM_SEC(10),
+        .client_argv = NULL,
+    };
+
+    if (!parse_args(&params, argc, argv)) {
+        return 1;
+    }
+
+    if (!params.duration && !params.client_argv) {
+        LOGI("Fake server: no duration and no client, run until killed");
+    }
+
+    if (!net_init()) {
+        return 1;
+    }
+
+    static struct sc_fake_server server;
+    if (!sc_fake_server_init(&server, &params)) {
+        net_cleanup();
+        return 1;
+    }
+
+    bool ok = sc_fake_server_run(&server);
+
+    sc_fake_server_destroy(&server);
+    net_cleanup();
+
+    return ok ? 0 : 1;
+}
@@ -121,6 +121,55 @@ static void test_options2(void) {
     assert(opts->record_format == SC_RECORD_FORMAT_MP4);
 }
 
+static void test_options_multi_session(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--multi-session=0123456789abcdef,192.168.1.1:5555",
+        "--decoder-pool-size=2",
+        "--no-window",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(!strcmp(opts->multi_session, "0123456789abcdef,192.168.1.1:5555"));
+    assert(opts->decoder_pool_size == 2);
+    // The video is decoded even without playback
+    assert(opts->video);
+    assert(!opts->video_playback);
+    assert(!opts->audio);
+    assert(!opts->control);
+}
+
+static void test_options_video_decoder_threads(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--video-decoder-threads=0",
+        "--video-decoder-thread-type=frame",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(opts->video_decoder_threads == 0);
+    assert(opts->video_decoder_thread_type
+            == SC_VIDEO_DECODER_THREAD_TYPE_FRAME);
+}
+
 static void test_parse_shortcut_mods(void) {
     uint8_t mods;
     bool ok;
@@ -157,6 +206,8 @@ int main(int argc, char *argv[]) {
     test_flag_help();
     test_options();
     test_options2();
+    test_options_multi_session();
+    test_options_video_decoder_threads();
     test_parse_shortcut_mods();
     return 0;
 }
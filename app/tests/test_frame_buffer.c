@@ -0,0 +1,165 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <libavutil/frame.h>
+
+#include "frame_buffer.h"
+#include "util/thread.h"
+
+#define STRESS_FRAME_COUNT 100000
+
+static AVFrame *
+create_frame(int64_t pts) {
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 16;
+    frame->height = 16;
+    int r = av_frame_get_buffer(frame, 0);
+    assert(!r);
+    (void) r;
+
+    frame->pts = pts;
+    // Check the content of the frame on consume
+    frame->data[0][0] = (uint8_t) pts;
+
+    return frame;
+}
+
+static void
+push_frame(struct sc_frame_buffer *fb, int64_t pts, bool *skipped) {
+    AVFrame *frame = create_frame(pts);
+    bool ok = sc_frame_buffer_push(fb, frame, skipped);
+    assert(ok);
+    (void) ok;
+    // The frame buffer holds its own reference
+    av_frame_free(&frame);
+}
+
+static void
+consume_frame(struct sc_frame_buffer *fb, AVFrame *dst, int64_t pts) {
+    sc_frame_buffer_consume(fb, dst);
+    assert(dst->pts == pts);
+    assert(dst->data[0][0] == (uint8_t) pts);
+    av_frame_unref(dst);
+}
+
+static void test_frame_buffer_simple(void) {
+    struct sc_frame_buffer fb;
+    bool ok = sc_frame_buffer_init(&fb);
+    assert(ok);
+
+    AVFrame *dst = av_frame_alloc();
+    assert(dst);
+
+    bool skipped;
+    push_frame(&fb, 1, &skipped);
+    assert(!skipped);
+    consume_frame(&fb, dst, 1);
+
+    push_frame(&fb, 2, &skipped);
+    assert(!skipped);
+    // The frame 2 has not been consumed
+    push_frame(&fb, 3, &skipped);
+    assert(skipped);
+    consume_frame(&fb, dst, 3);
+
+    push_frame(&fb, 4, &skipped);
+    assert(!skipped);
+    consume_frame(&fb, dst, 4);
+
+    // The skipped flag is optional
+    push_frame(&fb, 5, NULL);
+    push_frame(&fb, 6, NULL);
+    consume_frame(&fb, dst, 6);
+
+    av_frame_free(&dst);
+    sc_frame_buffer_destroy(&fb);
+}
+
+struct stress {
+    struct sc_frame_buffer fb;
+    // Incremented on each push which did not skip the previous frame (the
+    // screen posts a SC_EVENT_NEW_FRAME in that case)
+    atomic_uint events;
+    atomic_bool done;
+    unsigned skipped; // only accessed by the producer until joined
+};
+
+static int
+run_producer(void *data) {
+    struct stress *stress = data;
+
+    for (int64_t pts = 0; pts < STRESS_FRAME_COUNT; ++pts) {
+        bool skipped;
+        push_frame(&stress->fb, pts, &skipped);
+        if (skipped) {
+            ++stress->skipped;
+        } else {
+            atomic_fetch_add(&stress->events, 1);
+        }
+    }
+
+    atomic_store(&stress->done, true);
+    return 0;
+}
+
+static void test_frame_buffer_stress(void) {
+    struct stress stress;
+    bool ok = sc_frame_buffer_init(&stress.fb);
+    assert(ok);
+    atomic_init(&stress.events, 0);
+    atomic_init(&stress.done, false);
+    stress.skipped = 0;
+
+    AVFrame *dst = av_frame_alloc();
+    assert(dst);
+
+    sc_thread thread;
+    ok = sc_thread_create(&thread, run_producer, "test-producer", &stress);
+    assert(ok);
+
+    int64_t last_pts = -1;
+    unsigned consumed = 0;
+    for (;;) {
+        // Read done before events, so that no event may be missed
+        bool done = atomic_load(&stress.done);
+        if (!atomic_load(&stress.events)) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        atomic_fetch_sub(&stress.events, 1);
+
+        // An event guarantees that a frame is pending
+        sc_frame_buffer_consume(&stress.fb, dst);
+        // Frames are never consumed twice nor out of order
+        assert(dst->pts > last_pts);
+        assert(dst->data[0][0] == (uint8_t) dst->pts);
+        last_pts = dst->pts;
+        ++consumed;
+        av_frame_unref(dst);
+    }
+
+    sc_thread_join(&thread, NULL);
+
+    // The last frame is never skipped
+    assert(last_pts == STRESS_FRAME_COUNT - 1);
+    assert(consumed + stress.skipped == STRESS_FRAME_COUNT);
+
+    av_frame_free(&dst);
+    sc_frame_buffer_destroy(&stress.fb);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_frame_buffer_simple();
+    test_frame_buffer_stress();
+
+    return 0;
+}
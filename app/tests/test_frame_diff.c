@@ -0,0 +1,127 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+#include <libavutil/frame.h>
+
+#include "frame_diff.h"
+#include "util/tile_diff.h"
+
+static void test_tile_diff_impls(void) {
+    struct sc_tile_diff_impl impls[SC_TILE_DIFF_MAX_IMPLS];
+    size_t count = sc_tile_diff_get_impls(impls);
+    assert(count >= 1);
+    assert(!strcmp(impls[count - 1].name, "scalar"));
+
+    // Larger than a tile, with a linesize not multiple of the vector sizes
+    uint8_t a[70 * 10];
+    uint8_t b[70 * 10];
+    for (size_t i = 0; i < sizeof(a); ++i) {
+        a[i] = i * 7;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        sc_tile_diff_fn *fn = impls[i].fn;
+
+        // Test every width, to cover the vector loops and the tails
+        for (unsigned width = 1; width <= 70; ++width) {
+            memcpy(b, a, sizeof(a));
+            assert(!fn(a, 70, b, 70, width, 10));
+
+            // A change in the last column of the last row
+            b[9 * 70 + width - 1] ^= 0x80;
+            assert(fn(a, 70, b, 70, width, 10));
+            // Not in the compared rows
+            assert(!fn(a, 70, b, 70, width, 9));
+            b[9 * 70 + width - 1] ^= 0x80;
+
+            // A change in the first column of the first row
+            b[0] ^= 1;
+            assert(fn(a, 70, b, 70, width, 10));
+            b[0] ^= 1;
+
+            if (width < 70) {
+                // A change just outside the compared columns
+                b[5 * 70 + width] ^= 1;
+                assert(!fn(a, 70, b, 70, width, 10));
+            }
+        }
+    }
+}
+
+static AVFrame *
+create_frame(int width, int height) {
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = width;
+    frame->height = height;
+    int r = av_frame_get_buffer(frame, 0);
+    assert(!r);
+    (void) r;
+
+    for (int plane = 0; plane < 3; ++plane) {
+        int h = plane ? (height + 1) / 2 : height;
+        memset(frame->data[plane], 0x42, (size_t) h * frame->linesize[plane]);
+    }
+
+    return frame;
+}
+
+static void test_frame_diff(void) {
+    // Not multiple of the tile size
+    AVFrame *prev = create_frame(300, 200);
+    AVFrame *frame = create_frame(300, 200);
+
+    struct sc_tile_diff_impl impl = sc_tile_diff_get_best_impl();
+    struct sc_frame_diff diff;
+    sc_frame_diff_init(&diff, impl.fn);
+
+    bool ok = sc_frame_diff_compute(&diff, prev, frame, 50);
+    assert(ok);
+    assert(diff.rect_count == 0);
+    assert(diff.dirty_bytes == 0);
+    assert(diff.frame_bytes == 300 * 200 + 2 * 150 * 100);
+
+    // Change a luma pixel in the tile (1, 1), and a chroma pixel in the tile
+    // (2, 1), so that they are merged horizontally
+    frame->data[0][70 * frame->linesize[0] + 100] = 0;
+    frame->data[2][40 * frame->linesize[2] + 70] = 0;
+    // Change a pixel in the tiles (1, 2) and (2, 2), to extend the rect
+    frame->data[0][130 * frame->linesize[0] + 64] = 0;
+    frame->data[0][191 * frame->linesize[0] + 191] = 0;
+    // Change a pixel in the last (partial) tile
+    frame->data[1][99 * frame->linesize[1] + 149] = 0;
+
+    ok = sc_frame_diff_compute(&diff, prev, frame, 50);
+    assert(ok);
+    assert(diff.rect_count == 2);
+    assert(diff.rects[0].x == 64);
+    assert(diff.rects[0].y == 64);
+    assert(diff.rects[0].width == 128);
+    assert(diff.rects[0].height == 128);
+    assert(diff.rects[1].x == 256);
+    assert(diff.rects[1].y == 192);
+    assert(diff.rects[1].width == 44);
+    assert(diff.rects[1].height == 8);
+    assert(diff.dirty_bytes == 128 * 128 + 2 * 64 * 64
+                             + 44 * 8 + 2 * 22 * 4);
+
+    // With a lower threshold, the whole frame must be uploaded
+    ok = sc_frame_diff_compute(&diff, prev, frame, 10);
+    assert(!ok);
+
+    av_frame_free(&prev);
+    av_frame_free(&frame);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_tile_diff_impls();
+    test_frame_diff();
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "frame_pacer.h"
+
+static void test_frame_pacer_no_vblank(void) {
+    struct sc_frame_pacer pacer;
+    sc_frame_pacer_init(&pacer, SC_TICK_FROM_MS(20));
+
+    // Without known vblanks, render at the target time
+    sc_tick render_date = sc_frame_pacer_schedule(&pacer, 1000000, 0);
+    assert(render_date == 1020000);
+    assert(pacer.target == 1020000);
+
+    // Presented 1ms late: on time (default tolerance)
+    sc_frame_pacer_on_present(&pacer, 1021000);
+    assert(pacer.stats.presented == 1);
+    assert(!pacer.stats.early);
+    assert(!pacer.stats.late);
+}
+
+static void test_frame_pacer_vblank(void) {
+    struct sc_frame_pacer pacer;
+    sc_frame_pacer_init(&pacer, SC_TICK_FROM_MS(20));
+    sc_frame_pacer_set_refresh_rate(&pacer, 50); // 20ms period
+    assert(pacer.period == 20000);
+
+    sc_frame_pacer_on_vblank(&pacer, 1003000);
+
+    // target = 1020000 + 20000 = 1040000, the closest vblank is 1043000, so
+    // render during the preceding refresh interval
+    sc_tick render_date = sc_frame_pacer_schedule(&pacer, 1020000, 0);
+    assert(render_date == 1023000);
+
+    // Same stream/system offset: target = 1049000 + 20000 = 1069000 rounds to
+    // the vblank 1063000
+    render_date = sc_frame_pacer_schedule(&pacer, 1049000, 29000);
+    assert(pacer.target == 1069000);
+    assert(render_date == 1043000);
+
+    // Presented 11ms after its target (more than half a period)
+    sc_frame_pacer_on_present(&pacer, 1080000);
+    assert(pacer.stats.late == 1);
+
+    // Presented 11ms before its target
+    sc_frame_pacer_on_present(&pacer, 1058000);
+    assert(pacer.stats.early == 1);
+
+    // Vblanks before the last known one
+    render_date = sc_frame_pacer_schedule(&pacer, 900000, -120000);
+    assert(pacer.target == 920000);
+    assert(render_date == 903000);
+
+    sc_frame_pacer_on_drop(&pacer);
+    assert(pacer.stats.dropped == 1);
+    assert(pacer.stats.presented == 2);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_frame_pacer_no_vblank();
+    test_frame_pacer_vblank();
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+#include <libavcodec/packet.h>
+
+#include "packet_spill.h"
+
+static AVPacket *
+create_packet(int64_t pts, int size) {
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+
+    int r = av_new_packet(packet, size);
+    assert(!r);
+    (void) r;
+
+    memset(packet->data, (uint8_t) pts, size);
+    packet->pts = pts;
+    packet->dts = pts;
+    packet->duration = 16667;
+    packet->flags = pts % 10 ? 0 : AV_PKT_FLAG_KEY;
+
+    return packet;
+}
+
+static void
+write_packet(struct sc_packet_spill *spill, int64_t pts, int size,
+             int stream_index) {
+    AVPacket *packet = create_packet(pts, size);
+    bool ok = sc_packet_spill_write(spill, packet, stream_index);
+    assert(ok);
+    (void) ok;
+    av_packet_free(&packet);
+}
+
+static void
+read_packet(struct sc_packet_spill *spill, int64_t pts, int size,
+            int stream_index) {
+    AVPacket *packet = sc_packet_spill_read(spill);
+    assert(packet);
+    assert(packet->pts == pts);
+    assert(packet->dts == pts);
+    assert(packet->duration == 16667);
+    assert(packet->flags == (pts % 10 ? 0 : AV_PKT_FLAG_KEY));
+    assert(packet->stream_index == stream_index);
+    assert(packet->size == size);
+    for (int i = 0; i < size; ++i) {
+        assert(packet->data[i] == (uint8_t) pts);
+    }
+    av_packet_free(&packet);
+}
+
+static void test_packet_spill_fifo(void) {
+    struct sc_packet_spill spill;
+    sc_packet_spill_init(&spill);
+    assert(sc_packet_spill_is_empty(&spill));
+
+    write_packet(&spill, 0, 1000, 0);
+    write_packet(&spill, 1, 10, 1);
+    write_packet(&spill, 2, 0, 0);
+    assert(!sc_packet_spill_is_empty(&spill));
+
+    read_packet(&spill, 0, 1000, 0);
+
+    // Interleave writes and reads
+    write_packet(&spill, 3, 500, 1);
+    read_packet(&spill, 1, 10, 1);
+    read_packet(&spill, 2, 0, 0);
+    write_packet(&spill, 4, 42, 0);
+    read_packet(&spill, 3, 500, 1);
+    read_packet(&spill, 4, 42, 0);
+
+    assert(sc_packet_spill_is_empty(&spill));
+
+    sc_packet_spill_destroy(&spill);
+}
+
+static void test_packet_spill_reuse(void) {
+    struct sc_packet_spill spill;
+    sc_packet_spill_init(&spill);
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 100; ++i) {
+            write_packet(&spill, i, 100 + i, i % 2);
+        }
+        for (int i = 0; i < 100; ++i) {
+            read_packet(&spill, i, 100 + i, i % 2);
+        }
+        assert(sc_packet_spill_is_empty(&spill));
+        // The file is overwritten from the start once drained
+        assert(!spill.read_offset);
+        assert(!spill.write_offset);
+    }
+
+    sc_packet_spill_destroy(&spill);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_packet_spill_fifo();
+    test_packet_spill_reuse();
+
+    return 0;
+}
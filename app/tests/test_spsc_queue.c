@@ -0,0 +1,90 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "util/spsc_queue.h"
+
+struct item {
+    uint32_t a;
+    uint64_t b;
+};
+
+static void test_spsc_queue_simple(void) {
+    struct sc_spsc_queue queue;
+
+    bool ok = sc_spsc_queue_init(&queue, sizeof(struct item), 3);
+    assert(ok);
+    assert(sc_spsc_queue_capacity(&queue) == 3);
+    assert(sc_spsc_queue_is_empty(&queue));
+
+    struct item item;
+    ok = sc_spsc_queue_pop(&queue, &item);
+    assert(!ok);
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        struct item in = {.a = i, .b = 100 + i};
+        ok = sc_spsc_queue_push(&queue, &in);
+        assert(ok);
+        assert(sc_spsc_queue_size(&queue) == i + 1);
+    }
+
+    struct item extra = {.a = 42, .b = 42};
+    ok = sc_spsc_queue_push(&queue, &extra);
+    assert(!ok); // full
+    assert(sc_spsc_queue_size(&queue) == 3);
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        ok = sc_spsc_queue_pop(&queue, &item);
+        assert(ok);
+        assert(item.a == i);
+        assert(item.b == 100 + i);
+    }
+
+    assert(sc_spsc_queue_is_empty(&queue));
+
+    sc_spsc_queue_destroy(&queue);
+}
+
+static void test_spsc_queue_wrap(void) {
+    struct sc_spsc_queue queue;
+
+    bool ok = sc_spsc_queue_init(&queue, sizeof(uint32_t), 4);
+    assert(ok);
+
+    uint32_t next_push = 0;
+    uint32_t next_pop = 0;
+
+    // Keep 2 or 3 items in the queue while the cursors wrap around
+    for (int i = 0; i < 20; ++i) {
+        while (sc_spsc_queue_size(&queue) < 3) {
+            ok = sc_spsc_queue_push(&queue, &next_push);
+            assert(ok);
+            ++next_push;
+        }
+
+        uint32_t v;
+        ok = sc_spsc_queue_pop(&queue, &v);
+        assert(ok);
+        assert(v == next_pop);
+        ++next_pop;
+    }
+
+    uint32_t v;
+    while (sc_spsc_queue_pop(&queue, &v)) {
+        assert(v == next_pop);
+        ++next_pop;
+    }
+    assert(next_pop == next_push);
+
+    sc_spsc_queue_destroy(&queue);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_spsc_queue_simple();
+    test_spsc_queue_wrap();
+
+    return 0;
+}
@@ -184,6 +184,35 @@ static void test_vecdeque_push_hole(void) {
     sc_vecdeque_destroy(&vdq);
 }
 
+static void test_vecdeque_get(void) {
+    struct SC_VECDEQUE(int) vdq = SC_VECDEQUE_INITIALIZER;
+
+    bool ok = sc_vecdeque_reserve(&vdq, 10);
+    assert(ok);
+
+    for (int i = 0; i < 8; ++i) {
+        sc_vecdeque_push_noresize(&vdq, i);
+    }
+
+    // Wrap around the end of the buffer
+    for (int i = 0; i < 5; ++i) {
+        sc_vecdeque_pop(&vdq);
+    }
+    for (int i = 8; i < 14; ++i) {
+        sc_vecdeque_push_noresize(&vdq, i);
+    }
+
+    assert(sc_vecdeque_size(&vdq) == 9);
+    for (int i = 0; i < 9; ++i) {
+        assert(sc_vecdeque_get(&vdq, i) == i + 5);
+    }
+
+    // get() does not remove the item
+    assert(sc_vecdeque_pop(&vdq) == 5);
+
+    sc_vecdeque_destroy(&vdq);
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -192,6 +221,7 @@ int main(int argc, char *argv[]) {
     test_vecdeque_reserve();
     test_vecdeque_grow();
     test_vecdeque_push_hole();
+    test_vecdeque_get();
 
     return 0;
 }